@@ -0,0 +1,46 @@
+#ifndef BENCHMARKS_BENCHMARK_H
+#define BENCHMARKS_BENCHMARK_H
+
+#include <chrono>
+#include "Core/Types.h"
+
+// Measures the wall-clock time of the code between construction (or Reset())
+// and the call to Seconds().
+class BenchmarkTimer {
+public:
+    BenchmarkTimer() : m_start(std::chrono::steady_clock::now()) {}
+
+    void Reset() { m_start = std::chrono::steady_clock::now(); }
+
+    double Seconds() const
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        return elapsed.count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Print a result line in a fixed format, so that runs can be compared with
+// diff, or as a CSV row if the benchmarks were run with --csv. Names shouldn't
+// contain commas.
+
+// Reports a throughput in MB/s (10^6 bytes per second).
+void BenchmarkReport(const char* name, double bytes, double seconds);
+
+// Reports the mean time of an operation that was run nOps times, in ns/op.
+void BenchmarkReportOps(const char* name, double nOps, double seconds);
+
+// Reports a measurement other than a time, such as an error metric.
+void BenchmarkReportValue(const char* name, double value, const char* unit);
+
+// Keeps the compiler from optimizing away a computation whose result is
+// otherwise unused.
+void BenchmarkUse(const void* data);
+
+// The benchmark suites. Each runs all of its benchmarks and reports them.
+void RunTextureCodecBenchmarks();
+void RunContainerBenchmarks();
+
+#endif // BENCHMARKS_BENCHMARK_H
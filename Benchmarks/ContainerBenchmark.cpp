@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Core/Hash.h"
+#include "Core/HashTypes.h"
+#include "Core/IDLookupTable.h"
+#include "Core/List.h"
+
+// The number of operations in each measurement. Small containers repeat their
+// operations until they reach it, so that each measurement takes long enough
+// to time.
+const u32 OPS_PER_MEASUREMENT = 1 << 20;
+
+// The THash capacities and load factors to measure. Inserting capacity * load
+// factor / 100 keys grows a THash to exactly the capacity (it grows when it's
+// over 90% full).
+static const u32 s_hashCapacities[] = { 1 << 10, 1 << 16, 1 << 20 };
+static const u32 s_hashLoadPercents[] = { 50, 75, 90 };
+
+static const u32 s_idTableSizes[] = { 1 << 10, 1 << 16 };
+static const u32 s_listSizes[] = { 1 << 10, 1 << 16, 1 << 20 };
+static const u32 s_stringLengths[] = { 8, 32, 128 };
+
+static u32 Random(u32& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+static void Shuffle(std::vector<u32>& values, u32 seed)
+{
+    for (size_t i = values.size(); i > 1; --i) {
+        size_t j = Random(seed) % i;
+        u32 temp = values[i - 1];
+        values[i - 1] = values[j];
+        values[j] = temp;
+    }
+}
+
+static u32 Reps(u32 opsPerRep)
+{
+    return (opsPerRep >= OPS_PER_MEASUREMENT) ? 1 : OPS_PER_MEASUREMENT / opsPerRep;
+}
+
+// Writes a size as e.g. "1K" or "64K".
+static void FormatSize(char* dst, size_t dstChars, u32 size)
+{
+    if (size >= (1 << 20) && size % (1 << 20) == 0)
+        snprintf(dst, dstChars, "%uM", size >> 20);
+    else if (size >= (1 << 10) && size % (1 << 10) == 0)
+        snprintf(dst, dstChars, "%uK", size >> 10);
+    else
+        snprintf(dst, dstChars, "%u", size);
+}
+
+// -----------------------------------------------------------------------------
+// THash and std::unordered_map
+// -----------------------------------------------------------------------------
+
+struct BenchKey {
+    u32 value;
+
+    // The finalizer of MurmurHash3, as integer keys need mixing before their
+    // low bits can be used as an index.
+    u32 GetHashValue() const
+    {
+        u32 h = value;
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return h;
+    }
+};
+
+inline bool operator==(const BenchKey& a, const BenchKey& b)
+{
+    return a.value == b.value;
+}
+
+struct BenchValue {
+    u32 key;
+    u32 payload[3];
+};
+
+struct GetBenchKey {
+    BenchKey operator()(const BenchValue& value) const
+    {
+        BenchKey key;
+        key.value = value.key;
+        return key;
+    }
+};
+
+// std::unordered_map uses the same hash function as THash, so that only the
+// tables are compared.
+struct BenchKeyHasher {
+    size_t operator()(u32 value) const
+    {
+        BenchKey key;
+        key.value = value;
+        return key.GetHashValue();
+    }
+};
+
+// Gives THash and std::unordered_map the same interface.
+class THashAdapter {
+public:
+    static const char* Name() { return "THash"; }
+
+    void Insert(const BenchValue& value) { m_table.Insert(value, GetBenchKey()); }
+
+    const BenchValue* Get(u32 key) const
+    {
+        BenchKey k;
+        k.value = key;
+        return m_table.Get(k, GetBenchKey());
+    }
+
+    void Delete(u32 key)
+    {
+        BenchKey k;
+        k.value = key;
+        m_table.Delete(k, GetBenchKey());
+    }
+
+private:
+    THash<BenchKey, BenchValue> m_table;
+};
+
+class UnorderedMapAdapter {
+public:
+    static const char* Name() { return "unordered_map"; }
+
+    void Insert(const BenchValue& value) { m_table[value.key] = value; }
+
+    const BenchValue* Get(u32 key) const
+    {
+        std::unordered_map<u32, BenchValue, BenchKeyHasher>::const_iterator it
+            = m_table.find(key);
+        return (it == m_table.end()) ? NULL : &it->second;
+    }
+
+    void Delete(u32 key) { m_table.erase(key); }
+
+private:
+    std::unordered_map<u32, BenchValue, BenchKeyHasher> m_table;
+};
+
+// Multiplying by an odd constant is a bijection on u32, so the keys are
+// distinct and scattered. Keys from index count onwards aren't in the table.
+static u32 KeyFromIndex(u32 index)
+{
+    return index * 2654435761u;
+}
+
+static void MakeBenchValue(u32 key, BenchValue* value)
+{
+    value->key = key;
+    value->payload[0] = key ^ 1;
+    value->payload[1] = key ^ 2;
+    value->payload[2] = key ^ 3;
+}
+
+template<class Table>
+static void BenchmarkHashTable(u32 capacity, u32 loadPercent)
+{
+    u32 count = (u32)((u64)capacity * loadPercent / 100);
+    u32 reps = Reps(count);
+    double nOps = (double)count * reps;
+
+    // The keys are inserted in one order and looked up and deleted in another,
+    // as they usually are.
+    std::vector<u32> insertKeys(count);
+    std::vector<u32> lookupKeys(count);
+    std::vector<u32> missingKeys(count);
+    for (u32 i = 0; i < count; ++i) {
+        insertKeys[i] = KeyFromIndex(i);
+        lookupKeys[i] = KeyFromIndex(i);
+        missingKeys[i] = KeyFromIndex(count + i);
+    }
+    Shuffle(insertKeys, 1);
+    Shuffle(lookupKeys, 2);
+
+    char size[16];
+    FormatSize(size, sizeof size, capacity);
+    char name[64];
+
+    // Insertion starts from an empty table, so it includes the growth of the
+    // table.
+    double seconds = 0.0;
+    for (u32 rep = 0; rep < reps; ++rep) {
+        Table* table = new Table;
+        BenchmarkTimer timer;
+        for (u32 i = 0; i < count; ++i) {
+            BenchValue value;
+            MakeBenchValue(insertKeys[i], &value);
+            table->Insert(value);
+        }
+        seconds += timer.Seconds();
+        delete table;
+    }
+    snprintf(name, sizeof name, "%s %s@%u%% insert", Table::Name(), size, loadPercent);
+    BenchmarkReportOps(name, nOps, seconds);
+
+    Table table;
+    for (u32 i = 0; i < count; ++i) {
+        BenchValue value;
+        MakeBenchValue(insertKeys[i], &value);
+        table.Insert(value);
+    }
+
+    u32 sum = 0;
+    BenchmarkTimer timer;
+    for (u32 rep = 0; rep < reps; ++rep) {
+        for (u32 i = 0; i < count; ++i)
+            sum += table.Get(lookupKeys[i])->payload[0];
+    }
+    seconds = timer.Seconds();
+    BenchmarkUse(&sum);
+    snprintf(name, sizeof name, "%s %s@%u%% lookup hit", Table::Name(), size, loadPercent);
+    BenchmarkReportOps(name, nOps, seconds);
+
+    u32 nFound = 0;
+    timer.Reset();
+    for (u32 rep = 0; rep < reps; ++rep) {
+        for (u32 i = 0; i < count; ++i)
+            nFound += (table.Get(missingKeys[i]) != NULL);
+    }
+    seconds = timer.Seconds();
+    BenchmarkUse(&nFound);
+    snprintf(name, sizeof name, "%s %s@%u%% lookup miss", Table::Name(), size, loadPercent);
+    BenchmarkReportOps(name, nOps, seconds);
+
+    seconds = 0.0;
+    for (u32 rep = 0; rep < reps; ++rep) {
+        Table* fullTable = new Table;
+        for (u32 i = 0; i < count; ++i) {
+            BenchValue value;
+            MakeBenchValue(insertKeys[i], &value);
+            fullTable->Insert(value);
+        }
+        timer.Reset();
+        for (u32 i = 0; i < count; ++i)
+            fullTable->Delete(lookupKeys[i]);
+        seconds += timer.Seconds();
+        delete fullTable;
+    }
+    snprintf(name, sizeof name, "%s %s@%u%% delete", Table::Name(), size, loadPercent);
+    BenchmarkReportOps(name, nOps, seconds);
+}
+
+// -----------------------------------------------------------------------------
+// Hash_Murmur32
+// -----------------------------------------------------------------------------
+
+static void BenchmarkStringHash(u32 length)
+{
+    const u32 nStrings = 4096;
+    const u32 nPasses = (64 << 20) / (nStrings * length);
+
+    std::vector<char> chars(nStrings * (length + 1));
+    std::vector<HashKey_Str> keys(nStrings);
+    u32 seed = length;
+    for (u32 i = 0; i < nStrings; ++i) {
+        char* str = &chars[i * (length + 1)];
+        for (u32 j = 0; j < length; ++j)
+            str[j] = (char)('a' + Random(seed) % 26);
+        str[length] = '\0';
+        keys[i].str = str;
+    }
+
+    u32 hash = 0;
+    BenchmarkTimer timer;
+    for (u32 pass = 0; pass < nPasses; ++pass) {
+        for (u32 i = 0; i < nStrings; ++i)
+            hash ^= keys[i].GetHashValue();
+    }
+    double seconds = timer.Seconds();
+    BenchmarkUse(&hash);
+
+    char name[64];
+    snprintf(name, sizeof name, "Murmur32 %u-char strings", length);
+    BenchmarkReport(name, (double)nPasses * nStrings * length, seconds);
+}
+
+// -----------------------------------------------------------------------------
+// IDLookupTable
+// -----------------------------------------------------------------------------
+
+// The GpuDevice tables use 16 bits of inner ID, which allows too few adds for
+// the churn benchmark, so this has 64-bit IDs.
+typedef IDLookupTable<BenchValue, u64, 24, 40> BenchIDTable;
+
+static void BenchmarkIDLookupTable(u32 size)
+{
+    BenchIDTable table;
+    std::vector<u64> ids(size);
+    for (u32 i = 0; i < size; ++i) {
+        ids[i] = table.Add();
+        MakeBenchValue(i, &table.Lookup(ids[i]));
+    }
+
+    std::vector<u32> slots(OPS_PER_MEASUREMENT);
+    u32 seed = size;
+    for (u32 i = 0; i < OPS_PER_MEASUREMENT; ++i)
+        slots[i] = Random(seed) % size;
+
+    char sizeName[16];
+    FormatSize(sizeName, sizeof sizeName, size);
+    char name[64];
+
+    // Each operation removes a random object and adds a new one, which reuses
+    // its slot.
+    BenchmarkTimer timer;
+    for (u32 i = 0; i < OPS_PER_MEASUREMENT; ++i) {
+        u32 slot = slots[i];
+        table.Remove(ids[slot]);
+        ids[slot] = table.Add();
+        MakeBenchValue(i, &table.Lookup(ids[slot]));
+    }
+    double seconds = timer.Seconds();
+    snprintf(name, sizeof name, "IDLookupTable %s add/remove churn", sizeName);
+    BenchmarkReportOps(name, OPS_PER_MEASUREMENT, seconds);
+
+    u32 sum = 0;
+    timer.Reset();
+    for (u32 i = 0; i < OPS_PER_MEASUREMENT; ++i) {
+        u64 id = ids[slots[i]];
+        if (table.Has(id))
+            sum += table.Lookup(id).payload[0];
+    }
+    seconds = timer.Seconds();
+    BenchmarkUse(&sum);
+    snprintf(name, sizeof name, "IDLookupTable %s lookup", sizeName);
+    BenchmarkReportOps(name, OPS_PER_MEASUREMENT, seconds);
+}
+
+// -----------------------------------------------------------------------------
+// Intrusive lists and arrays
+// -----------------------------------------------------------------------------
+
+struct ListBenchNode {
+    LIST_LINK(ListBenchNode) linkSequential;
+    LIST_LINK(ListBenchNode) linkShuffled;
+    u32 value;
+};
+
+static void BenchmarkListTraversal(u32 size)
+{
+    // Sums the values of the same nodes by array index, and through lists that
+    // link them in address order and in a random order. The random order is
+    // that of a list whose nodes were allocated at different times, or that
+    // has been reordered.
+    ListBenchNode* nodes = new ListBenchNode[size];
+    LIST_DECLARE(ListBenchNode, linkSequential) sequentialList;
+    LIST_DECLARE(ListBenchNode, linkShuffled) shuffledList;
+
+    std::vector<u32> order(size);
+    for (u32 i = 0; i < size; ++i) {
+        nodes[i].value = i;
+        sequentialList.InsertTail(&nodes[i]);
+        order[i] = i;
+    }
+    Shuffle(order, size);
+    for (u32 i = 0; i < size; ++i)
+        shuffledList.InsertTail(&nodes[order[i]]);
+
+    u32 reps = Reps(size) * 16;
+    double nOps = (double)size * reps;
+    char sizeName[16];
+    FormatSize(sizeName, sizeof sizeName, size);
+    char name[64];
+
+    u32 sum = 0;
+    BenchmarkTimer timer;
+    for (u32 rep = 0; rep < reps; ++rep) {
+        for (u32 i = 0; i < size; ++i)
+            sum += nodes[i].value;
+    }
+    double seconds = timer.Seconds();
+    snprintf(name, sizeof name, "array %s traverse", sizeName);
+    BenchmarkReportOps(name, nOps, seconds);
+
+    timer.Reset();
+    for (u32 rep = 0; rep < reps; ++rep) {
+        for (ListBenchNode* node = sequentialList.Head(); node; node = sequentialList.Next(node))
+            sum += node->value;
+    }
+    seconds = timer.Seconds();
+    snprintf(name, sizeof name, "list %s traverse (address order)", sizeName);
+    BenchmarkReportOps(name, nOps, seconds);
+
+    timer.Reset();
+    for (u32 rep = 0; rep < reps; ++rep) {
+        for (ListBenchNode* node = shuffledList.Head(); node; node = shuffledList.Next(node))
+            sum += node->value;
+    }
+    seconds = timer.Seconds();
+    snprintf(name, sizeof name, "list %s traverse (random order)", sizeName);
+    BenchmarkReportOps(name, nOps, seconds);
+    BenchmarkUse(&sum);
+
+    // The nodes unlink themselves from the lists.
+    delete[] nodes;
+}
+
+void RunContainerBenchmarks()
+{
+    int nCapacities = (int)(sizeof s_hashCapacities / sizeof s_hashCapacities[0]);
+    int nLoadPercents = (int)(sizeof s_hashLoadPercents / sizeof s_hashLoadPercents[0]);
+    for (int i = 0; i < nCapacities; ++i) {
+        for (int j = 0; j < nLoadPercents; ++j) {
+            BenchmarkHashTable<THashAdapter>(s_hashCapacities[i], s_hashLoadPercents[j]);
+            BenchmarkHashTable<UnorderedMapAdapter>(s_hashCapacities[i], s_hashLoadPercents[j]);
+        }
+    }
+
+    int nStringLengths = (int)(sizeof s_stringLengths / sizeof s_stringLengths[0]);
+    for (int i = 0; i < nStringLengths; ++i)
+        BenchmarkStringHash(s_stringLengths[i]);
+
+    int nIDTableSizes = (int)(sizeof s_idTableSizes / sizeof s_idTableSizes[0]);
+    for (int i = 0; i < nIDTableSizes; ++i)
+        BenchmarkIDLookupTable(s_idTableSizes[i]);
+
+    int nListSizes = (int)(sizeof s_listSizes / sizeof s_listSizes[0]);
+    for (int i = 0; i < nListSizes; ++i)
+        BenchmarkListTraversal(s_listSizes[i]);
+}
@@ -0,0 +1,242 @@
+#include "Benchmarks/Frame/FrameAssets.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Core/Endian.h"
+#include "Core/Macros.h"
+#include "Core/Path.h"
+#include "Core/Str.h"
+#include "Core/Types.h"
+
+#include "Model/ModelShared.h"
+
+#define FOURCC(a, b, c, d) (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+const unsigned MAX_PATH_CHARS = 1024;
+
+// The shaders loaded by Scene and its ModelScene and RenderTargetDisplay.
+static const char* const s_shaderPaths[] = {
+    "Shaders/Model_MTL.shd",
+    "Shaders/Skybox_MTL.shd",
+    "Shaders/ModelArray_MTL.shd",
+    "Shaders/SkyboxArray_MTL.shd",
+    "Shaders/BlitRT_MTL.shd",
+};
+
+static const char* const s_modelPaths[FRAME_ASSET_MODEL_COUNT] = {
+    "Models\\Sphere0.mdl",
+    "Models\\Sphere1.mdl",
+    "Models\\Sphere2.mdl",
+    "Models\\Sphere3.mdl",
+};
+
+static const char* const s_subdirectories[] = {
+    "Shaders",
+    "Models",
+};
+
+const char* FrameAssetModelPath(int i)
+{
+    ASSERT(i >= 0 && i < FRAME_ASSET_MODEL_COUNT);
+    return s_modelPaths[i];
+}
+
+// The asset files are little-endian.
+static void Append32(std::vector<u8>& data, u32 value)
+{
+    value = EndianSwapLE32(value);
+    data.insert(data.end(), (const u8*)&value, (const u8*)&value + 4);
+}
+
+static void Append64(std::vector<u8>& data, u64 value)
+{
+    value = EndianSwapLE64(value);
+    data.insert(data.end(), (const u8*)&value, (const u8*)&value + 8);
+}
+
+static void AppendFloat(std::vector<u8>& data, float value)
+{
+    value = EndianSwapLEFloat32(value);
+    data.insert(data.end(), (const u8*)&value, (const u8*)&value + 4);
+}
+
+static void AppendBytes(std::vector<u8>& data, const char* bytes, size_t length)
+{
+    data.insert(data.end(), (const u8*)bytes, (const u8*)bytes + length);
+}
+
+// Converts the path to the directory's OS path, with forward-slashes.
+static void FullPath(char* dst, unsigned dstChars, const char* dir, const char* path)
+{
+    StrCopy(dst, dstChars, dir);
+    PathAppendPath(dst, dstChars, path, '/');
+    for (char* p = dst; *p; ++p) {
+        if (*p == '\\')
+            *p = '/';
+    }
+}
+
+static void WriteFile(const char* dir, const char* path, const std::vector<u8>& data)
+{
+    char fullPath[MAX_PATH_CHARS];
+    FullPath(fullPath, sizeof fullPath, dir, path);
+
+    FILE* file = fopen(fullPath, "wb");
+    if (!file)
+        FATAL("Couldn't create %s", fullPath);
+    if (fwrite(&data[0], 1, data.size(), file) != data.size())
+        FATAL("Couldn't write %s", fullPath);
+    fclose(file);
+}
+
+// A shader file (see GpuShaderLoad) with one permutation, which is used for
+// every combination of pipeline state flags.
+static void WriteShader(const char* dir, const char* path)
+{
+    const char vsCode[] = "vertex";
+    const char psCode[] = "fragment";
+    const u32 permutationHeaderSize = 24;
+
+    std::vector<u8> data;
+    Append32(data, FOURCC('S', 'H', 'D', 'R'));
+    Append32(data, 1);
+    Append32(data, FOURCC('M', 'E', 'T', 'L'));
+    Append32(data, 1);
+
+    Append64(data, 0);
+    Append32(data, sizeof vsCode);
+    Append32(data, sizeof psCode);
+    Append32(data, permutationHeaderSize + sizeof vsCode + sizeof psCode);
+    Append32(data, 0);
+    AppendBytes(data, vsCode, sizeof vsCode);
+    AppendBytes(data, psCode, sizeof psCode);
+
+    WriteFile(dir, path, data);
+}
+
+// A unit UV sphere, as a .mdl file with one untextured submesh and the .mdg
+// file of its geometry (see ModelShared).
+static void WriteSphere(const char* dir, const char* path, u32 nSegments)
+{
+    const float PI = 3.14159265f;
+    u32 nRings = nSegments / 2;
+    u32 nVertices = (nRings + 1) * (nSegments + 1);
+    u32 nIndices = nRings * nSegments * 6;
+    const u32 mdgHeaderSize = 28;
+    const u32 vertexSize = sizeof(ModelShared::Vertex);
+
+    std::vector<u8> mdg;
+    AppendBytes(mdg, "MDLG", 4);
+    Append32(mdg, nVertices);
+    Append32(mdg, mdgHeaderSize);
+    Append32(mdg, nIndices);
+    Append32(mdg, mdgHeaderSize + nVertices * vertexSize);
+    Append32(mdg, 0);
+    Append32(mdg, mdgHeaderSize + nVertices * vertexSize + nIndices * 4);
+
+    for (u32 ring = 0; ring <= nRings; ++ring) {
+        float v = (float)ring / (float)nRings;
+        float sinTheta = sinf(v * PI);
+        float cosTheta = cosf(v * PI);
+        for (u32 segment = 0; segment <= nSegments; ++segment) {
+            float u = (float)segment / (float)nSegments;
+            float x = sinTheta * cosf(u * 2.0f * PI);
+            float y = sinTheta * sinf(u * 2.0f * PI);
+            float z = cosTheta;
+            for (int i = 0; i < 2; ++i) {
+                AppendFloat(mdg, x);
+                AppendFloat(mdg, y);
+                AppendFloat(mdg, z);
+            }
+            AppendFloat(mdg, u);
+            AppendFloat(mdg, v);
+        }
+    }
+
+    for (u32 ring = 0; ring < nRings; ++ring) {
+        for (u32 segment = 0; segment < nSegments; ++segment) {
+            u32 a = ring * (nSegments + 1) + segment;
+            u32 b = a + nSegments + 1;
+            Append32(mdg, a);
+            Append32(mdg, b);
+            Append32(mdg, a + 1);
+            Append32(mdg, a + 1);
+            Append32(mdg, b);
+            Append32(mdg, b + 1);
+        }
+    }
+
+    std::vector<u8> mdl;
+    AppendBytes(mdl, "MODL", 4);
+    Append32(mdl, 1);
+    Append32(mdl, 1);
+    Append32(mdl, sizeof(MDLHeader));
+    Append32(mdl, 0);
+    Append32(mdl, nIndices);
+    Append64(mdl, MDL_NO_TEXTURE);
+
+    char mdgPath[MAX_PATH_CHARS];
+    PathReplaceExtension(mdgPath, sizeof mdgPath, path, ".mdg");
+
+    WriteFile(dir, path, mdl);
+    WriteFile(dir, mdgPath, mdg);
+}
+
+void WriteFrameAssets(char* dir, unsigned dirChars)
+{
+    const char* tmpDir = getenv("TMPDIR");
+    if (!tmpDir || !*tmpDir)
+        tmpDir = "/tmp";
+    StrCopy(dir, dirChars, tmpDir);
+    PathAppendPath(dir, dirChars, "FrameBenchmark.XXXXXX", '/');
+    if (!mkdtemp(dir))
+        FATAL("Couldn't create a temporary directory in %s", tmpDir);
+
+    int nSubdirectories = (int)(sizeof s_subdirectories / sizeof s_subdirectories[0]);
+    for (int i = 0; i < nSubdirectories; ++i) {
+        char path[MAX_PATH_CHARS];
+        FullPath(path, sizeof path, dir, s_subdirectories[i]);
+        if (mkdir(path, 0700) != 0)
+            FATAL("Couldn't create %s", path);
+    }
+
+    int nShaders = (int)(sizeof s_shaderPaths / sizeof s_shaderPaths[0]);
+    for (int i = 0; i < nShaders; ++i)
+        WriteShader(dir, s_shaderPaths[i]);
+
+    for (int i = 0; i < FRAME_ASSET_MODEL_COUNT; ++i)
+        WriteSphere(dir, s_modelPaths[i], 8u << i);
+}
+
+void DeleteFrameAssets(const char* dir)
+{
+    char path[MAX_PATH_CHARS];
+
+    int nShaders = (int)(sizeof s_shaderPaths / sizeof s_shaderPaths[0]);
+    for (int i = 0; i < nShaders; ++i) {
+        FullPath(path, sizeof path, dir, s_shaderPaths[i]);
+        unlink(path);
+    }
+
+    for (int i = 0; i < FRAME_ASSET_MODEL_COUNT; ++i) {
+        char mdgPath[MAX_PATH_CHARS];
+        PathReplaceExtension(mdgPath, sizeof mdgPath, s_modelPaths[i], ".mdg");
+        FullPath(path, sizeof path, dir, s_modelPaths[i]);
+        unlink(path);
+        FullPath(path, sizeof path, dir, mdgPath);
+        unlink(path);
+    }
+
+    int nSubdirectories = (int)(sizeof s_subdirectories / sizeof s_subdirectories[0]);
+    for (int i = 0; i < nSubdirectories; ++i) {
+        FullPath(path, sizeof path, dir, s_subdirectories[i]);
+        rmdir(path);
+    }
+    rmdir(dir);
+}
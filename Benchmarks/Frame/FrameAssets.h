@@ -0,0 +1,23 @@
+#ifndef BENCHMARKS_FRAME_FRAMEASSETS_H
+#define BENCHMARKS_FRAME_FRAMEASSETS_H
+
+// The number of different models that WriteFrameAssets() generates. They're
+// spheres of increasing detail, so that the render queue has several models to
+// sort and batch.
+const int FRAME_ASSET_MODEL_COUNT = 4;
+
+// The path (relative to the asset directory) of generated model i.
+const char* FrameAssetModelPath(int i);
+
+// Writes the assets that a Scene needs on the Null GpuDevice into a new
+// temporary directory, so that the benchmark runs without the compiled assets
+// of the demo. The shaders contain a single permutation with placeholder code,
+// which the Null GpuDevice doesn't look at, and the models have no textures.
+// Writes the path of the directory, to be used as the base path of a
+// FileLoader, to dir.
+void WriteFrameAssets(char* dir, unsigned dirChars);
+
+// Deletes the directory created by WriteFrameAssets() and its contents.
+void DeleteFrameAssets(const char* dir);
+
+#endif // BENCHMARKS_FRAME_FRAMEASSETS_H
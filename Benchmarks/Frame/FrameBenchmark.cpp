@@ -0,0 +1,456 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "Benchmarks/Frame/FrameAssets.h"
+
+#include "Core/FileLoader.h"
+#include "Core/TaskPool.h"
+
+#include "GpuDevice/GpuDevice.h"
+#include "GpuDevice/GpuSamplerCache.h"
+#include "GpuDevice/GpuTraceReplay.h"
+
+#include "Math/Matrix44.h"
+#include "Math/Vector3.h"
+
+#include "Model/ModelInstance.h"
+
+#include "Scene/Scene.h"
+
+#include "Shader/ShaderAsset.h"
+
+#include "Texture/TextureAsset.h"
+
+// Renders a generated scene of model instances on the Null GpuDevice for a
+// fixed number of frames, and writes the CPU frame times as JSON. It runs
+// without a window or any compiled assets, so that it can run on build servers.
+//
+// With --replay, it replays a trace recorded with GpuDevice::TraceCaptureBegin()
+// (for example by running GfxDemo with GFXDEMO_TRACE_CAPTURE set) instead, and
+// times the replay of each frame.
+
+const int DEFAULT_INSTANCES = 10000;
+const int DEFAULT_FRAMES = 300;
+// The first frames load the assets and fill the caches, so they aren't
+// included in the results.
+const int WARMUP_FRAMES = 30;
+
+const float INSTANCE_SPACING = 4.0f;
+
+enum FrameStage {
+    STAGE_SCENE_BEGIN,
+    STAGE_UPDATE,
+    STAGE_RENDER,
+    STAGE_PRESENT,
+
+    STAGE_COUNT
+};
+
+static const char* const s_stageNames[STAGE_COUNT] = {
+    "sceneBegin",
+    "update",
+    "render",
+    "present",
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point start, Clock::time_point end)
+{
+    std::chrono::duration<double, std::milli> ms = end - start;
+    return ms.count();
+}
+
+struct FrameBenchmarkResults {
+    // Per measured frame.
+    std::vector<double> frameMs;
+    std::vector<double> stageMs[STAGE_COUNT];
+    std::vector<double> gpuWaitMs;
+
+    // The time to create the scene, or to load the trace.
+    double setupMs;
+    GpuFrameStats lastFrameStats;
+    u64 gpuPeakBytes;
+};
+
+static GpuDevice* CreateGpuDevice()
+{
+    GpuDeviceFormat deviceFormat;
+    deviceFormat.pixelColorFormat = GPU_PIXEL_COLOR_FORMAT_RGBA8888;
+    deviceFormat.pixelDepthFormat = GPU_PIXEL_DEPTH_FORMAT_FLOAT32;
+    deviceFormat.resolutionX = 1920;
+    deviceFormat.resolutionY = 1080;
+    deviceFormat.flags = 0;
+    return GpuDevice::Create(deviceFormat, NULL);
+}
+
+class FrameBenchmark {
+public:
+    FrameBenchmark(const char* assetDir, int nInstances);
+    ~FrameBenchmark();
+
+    void Frame(FrameBenchmarkResults* results);
+private:
+    FrameBenchmark(const FrameBenchmark&);
+    FrameBenchmark& operator=(const FrameBenchmark&);
+
+    void UpdateInstances();
+    void UpdateCamera();
+
+    std::unique_ptr<GpuDevice, void (*)(GpuDevice*)> m_gpuDevice;
+    GpuSamplerCache m_samplerCache;
+    FileLoader m_fileLoader;
+    ShaderCache m_shaderCache;
+    TextureCache m_textureCache;
+    TaskPool m_taskPool;
+    Scene m_scene;
+
+    std::vector<ModelInstance*> m_instances;
+    int m_gridSize;
+    float m_angle;
+};
+
+FrameBenchmark::FrameBenchmark(const char* assetDir, int nInstances)
+    : m_gpuDevice(CreateGpuDevice(), &GpuDevice::Destroy)
+    , m_samplerCache(*m_gpuDevice)
+    , m_fileLoader(assetDir)
+    , m_shaderCache(*m_gpuDevice, m_fileLoader)
+    , m_textureCache(*m_gpuDevice, m_fileLoader)
+    , m_taskPool()
+    , m_scene(*m_gpuDevice, m_fileLoader, m_samplerCache, m_shaderCache,
+              m_textureCache, m_taskPool)
+    , m_instances()
+    , m_gridSize(1)
+    , m_angle(0.0f)
+{
+    while (m_gridSize * m_gridSize < nInstances)
+        ++m_gridSize;
+
+    m_instances.reserve(nInstances);
+    for (int i = 0; i < nInstances; ++i) {
+        const char* path = FrameAssetModelPath(i % FRAME_ASSET_MODEL_COUNT);
+        m_instances.push_back(m_scene.AddModelInstance(path));
+    }
+    UpdateInstances();
+}
+
+FrameBenchmark::~FrameBenchmark()
+{}
+
+// Places the instances on a square grid centered on the origin, each spinning
+// about its own vertical axis.
+void FrameBenchmark::UpdateInstances()
+{
+    const Vector3 specularColor(0.3f, 0.3f, 0.3f);
+    const float glossiness = 50.0f;
+    float offset = 0.5f * INSTANCE_SPACING * (float)(m_gridSize - 1);
+
+    for (size_t i = 0; i < m_instances.size(); ++i) {
+        float x = INSTANCE_SPACING * (float)(i % m_gridSize) - offset;
+        float y = INSTANCE_SPACING * (float)(i / m_gridSize) - offset;
+        float angle = m_angle + (float)i;
+        float sinAngle = sinf(angle);
+        float cosAngle = cosf(angle);
+        Matrix44 matrix(cosAngle, -sinAngle, 0.0f, x,
+                        sinAngle,  cosAngle, 0.0f, y,
+                        0.0f,      0.0f,     1.0f, 0.0f,
+                        0.0f,      0.0f,     0.0f, 1.0f);
+
+        Vector3 diffuseColor((float)(i % 7) / 6.0f, 0.5f, (float)(i % 5) / 4.0f);
+        m_instances[i]->Update(matrix, diffuseColor, specularColor, glossiness);
+    }
+}
+
+// Circles the camera around the grid, looking down at its center, so that the
+// set of visible instances changes from frame to frame.
+void FrameBenchmark::UpdateCamera()
+{
+    float extent = INSTANCE_SPACING * (float)m_gridSize;
+    float radius = 0.5f * extent + 10.0f;
+    Vector3 position(radius * cosf(0.5f * m_angle),
+                     radius * sinf(0.5f * m_angle),
+                     0.25f * extent + 5.0f);
+    Vector3 target(0.0f, 0.0f, 0.0f);
+
+    SceneUpdateInfo updateInfo;
+    updateInfo.cameraPos = position;
+    updateInfo.forward = Normalize(target - position);
+    updateInfo.right = Normalize(Cross(updateInfo.forward, Vector3(0.0f, 0.0f, 1.0f)));
+    updateInfo.up = Cross(updateInfo.right, updateInfo.forward);
+    updateInfo.zNear = 0.1f;
+    updateInfo.zFar = 2.0f * radius + extent;
+    updateInfo.fovY = 1.0f;
+    m_scene.Update(updateInfo);
+}
+
+// Runs one frame in the same order as Application::Frame(), and adds its
+// timings to the results.
+void FrameBenchmark::Frame(FrameBenchmarkResults* results)
+{
+    Clock::time_point times[STAGE_COUNT + 1];
+
+    times[STAGE_SCENE_BEGIN] = Clock::now();
+    m_gpuDevice->SceneBegin();
+
+    times[STAGE_UPDATE] = Clock::now();
+    m_samplerCache.CallCallbacks();
+    m_textureCache.UpdateAsyncLoads();
+    m_angle += 0.01f;
+    UpdateInstances();
+    UpdateCamera();
+
+    times[STAGE_RENDER] = Clock::now();
+    GpuViewport viewport;
+    viewport.x = 0;
+    viewport.y = 0;
+    viewport.width = m_gpuDevice->GetFormat().resolutionX;
+    viewport.height = m_gpuDevice->GetFormat().resolutionY;
+    viewport.zNear = 0.0f;
+    viewport.zFar = 1.0f;
+    m_scene.Render(viewport);
+
+    times[STAGE_PRESENT] = Clock::now();
+    m_textureCache.UpdateStreaming();
+    m_gpuDevice->ScenePresent();
+
+    times[STAGE_COUNT] = Clock::now();
+
+    const GpuFramePacingStats& pacingStats = m_gpuDevice->GetFramePacingStats();
+    double frameMs = Milliseconds(times[0], times[STAGE_COUNT]);
+    m_scene.GetDynamicResolution().Update((float)frameMs - pacingStats.cpuWaitMs,
+                                          pacingStats.gpuMs);
+
+    if (!results)
+        return;
+    results->frameMs.push_back(frameMs);
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        results->stageMs[i].push_back(Milliseconds(times[i], times[i + 1]));
+    results->gpuWaitMs.push_back(pacingStats.cpuWaitMs);
+    results->lastFrameStats = m_gpuDevice->GetFrameStats();
+    results->gpuPeakBytes = m_gpuDevice->GetMemoryStats().peakTotalBytes;
+}
+
+// The peak resident set size of the process, in bytes.
+static u64 PeakResidentBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (u64)usage.ru_maxrss;
+#else
+    return (u64)usage.ru_maxrss * 1024;
+#endif
+}
+
+// Uses the nearest-rank method, on a sorted copy of the samples.
+static void WriteTimingStats(FILE* file, const char* name,
+                             const std::vector<double>& samples, bool last)
+{
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (size_t i = 0; i < sorted.size(); ++i)
+        sum += sorted[i];
+    double mean = sum / (double)sorted.size();
+    double p50 = sorted[(size_t)ceil(0.50 * (double)sorted.size()) - 1];
+    double p99 = sorted[(size_t)ceil(0.99 * (double)sorted.size()) - 1];
+
+    fprintf(file,
+            "    \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+            name, mean, p50, p99, sorted.back(), last ? "" : ",");
+}
+
+static void WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* c = str; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Writes the trace path in place of the instance count if tracePath is given.
+// Replayed frames aren't split into stages, so stageMs is only written for the
+// generated scene.
+static void WriteResults(FILE* file, const char* tracePath, int nInstances,
+                         int nFrames, const FrameBenchmarkResults& results)
+{
+    const GpuFrameStats& stats = results.lastFrameStats;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"backend\": \"null\",\n");
+    if (tracePath) {
+        fprintf(file, "  \"trace\": ");
+        WriteJsonString(file, tracePath);
+        fprintf(file, ",\n");
+    } else {
+        fprintf(file, "  \"instances\": %d,\n", nInstances);
+    }
+    fprintf(file, "  \"frames\": %d,\n", nFrames);
+    fprintf(file, "  \"warmupFrames\": %d,\n", WARMUP_FRAMES);
+    fprintf(file, "  \"setupMs\": %.4f,\n", results.setupMs);
+    fprintf(file, "  \"cpuFrameMs\": {\n");
+    WriteTimingStats(file, "total", results.frameMs, false);
+    WriteTimingStats(file, "gpuWait", results.gpuWaitMs, true);
+    fprintf(file, "  },\n");
+    if (!tracePath) {
+        fprintf(file, "  \"stageMs\": {\n");
+        for (int i = 0; i < STAGE_COUNT; ++i)
+            WriteTimingStats(file, s_stageNames[i], results.stageMs[i], i == STAGE_COUNT - 1);
+        fprintf(file, "  },\n");
+    }
+    fprintf(file, "  \"memory\": {\n");
+    fprintf(file, "    \"peakResidentBytes\": %llu,\n",
+            (unsigned long long)PeakResidentBytes());
+    fprintf(file, "    \"gpuPeakBytes\": %llu,\n",
+            (unsigned long long)results.gpuPeakBytes);
+    fprintf(file, "    \"uploadHeapBytesUsed\": %llu\n",
+            (unsigned long long)stats.uploadHeapBytesUsed);
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"lastFrame\": {\n");
+    fprintf(file, "    \"draws\": %llu,\n", (unsigned long long)stats.nDraws);
+    fprintf(file, "    \"primitives\": %llu,\n",
+            (unsigned long long)(stats.nIndexedPrimitives + stats.nNonIndexedPrimitives));
+    fprintf(file, "    \"pipelineStateBinds\": %llu,\n",
+            (unsigned long long)stats.nPipelineStateBinds);
+    fprintf(file, "    \"bufferBinds\": %llu,\n", (unsigned long long)stats.nBufferBinds);
+    fprintf(file, "    \"textureBinds\": %llu\n", (unsigned long long)stats.nTextureBinds);
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+            "Usage: FrameBenchmark [instances] [frames] [output.json]\n"
+            "       FrameBenchmark --replay trace [frames] [output.json]\n");
+}
+
+static bool WriteResultsFile(const char* outputPath, const char* tracePath,
+                             int nInstances, int nFrames,
+                             const FrameBenchmarkResults& results)
+{
+    FILE* file = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!file) {
+        fprintf(stderr, "Couldn't open %s\n", outputPath);
+        return false;
+    }
+    WriteResults(file, tracePath, nInstances, nFrames, results);
+    if (file != stdout)
+        fclose(file);
+    return true;
+}
+
+// Replays the next frame of the trace, going back to the start of the trace
+// when it reaches the end. The first frame after that includes the creation
+// of the trace's resources, as it did in the recording.
+static bool ReplayTraceFrame(GpuTraceReplay* replay, TaskPool* taskPool)
+{
+    if (replay->ReplayFrame(taskPool))
+        return true;
+    replay->Rewind();
+    return replay->ReplayFrame(taskPool);
+}
+
+static int RunReplay(const char* tracePath, int nFrames, const char* outputPath)
+{
+    FrameBenchmarkResults results;
+    results.setupMs = 0.0;
+    results.gpuPeakBytes = 0;
+    memset(&results.lastFrameStats, 0, sizeof results.lastFrameStats);
+    results.frameMs.reserve(nFrames);
+    results.gpuWaitMs.reserve(nFrames);
+
+    {
+        std::unique_ptr<GpuDevice, void (*)(GpuDevice*)>
+            gpuDevice(CreateGpuDevice(), &GpuDevice::Destroy);
+        TaskPool taskPool;
+        GpuTraceReplay replay(*gpuDevice);
+
+        Clock::time_point setupStart = Clock::now();
+        if (!replay.Load(tracePath)) {
+            fprintf(stderr, "Couldn't load the trace %s\n", tracePath);
+            return 1;
+        }
+        results.setupMs = Milliseconds(setupStart, Clock::now());
+
+        for (int i = 0; i < WARMUP_FRAMES + nFrames; ++i) {
+            Clock::time_point start = Clock::now();
+            if (!ReplayTraceFrame(&replay, &taskPool)) {
+                fprintf(stderr, "The trace %s has no complete frames\n", tracePath);
+                return 1;
+            }
+            Clock::time_point end = Clock::now();
+            if (i < WARMUP_FRAMES)
+                continue;
+
+            results.frameMs.push_back(Milliseconds(start, end));
+            results.gpuWaitMs.push_back(gpuDevice->GetFramePacingStats().cpuWaitMs);
+            results.lastFrameStats = gpuDevice->GetFrameStats();
+            results.gpuPeakBytes = gpuDevice->GetMemoryStats().peakTotalBytes;
+        }
+    }
+
+    return WriteResultsFile(outputPath, tracePath, 0, nFrames, results) ? 0 : 1;
+}
+
+// Usage: FrameBenchmark [instances] [frames] [output.json]
+//        FrameBenchmark --replay trace [frames] [output.json]
+// Writes the results to the output file, or to stdout if none is given.
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0) {
+        const char* tracePath = (argc > 2) ? argv[2] : NULL;
+        int nFrames = (argc > 3) ? atoi(argv[3]) : DEFAULT_FRAMES;
+        const char* outputPath = (argc > 4) ? argv[4] : NULL;
+        if (!tracePath || nFrames <= 0) {
+            PrintUsage();
+            return 1;
+        }
+        return RunReplay(tracePath, nFrames, outputPath);
+    }
+
+    int nInstances = (argc > 1) ? atoi(argv[1]) : DEFAULT_INSTANCES;
+    int nFrames = (argc > 2) ? atoi(argv[2]) : DEFAULT_FRAMES;
+    const char* outputPath = (argc > 3) ? argv[3] : NULL;
+    if (nInstances <= 0 || nFrames <= 0) {
+        PrintUsage();
+        return 1;
+    }
+
+    char assetDir[1024];
+    WriteFrameAssets(assetDir, sizeof assetDir);
+
+    FrameBenchmarkResults results;
+    results.setupMs = 0.0;
+    results.gpuPeakBytes = 0;
+    memset(&results.lastFrameStats, 0, sizeof results.lastFrameStats);
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        results.stageMs[i].reserve(nFrames);
+
+    {
+        Clock::time_point setupStart = Clock::now();
+        FrameBenchmark benchmark(assetDir, nInstances);
+        results.setupMs = Milliseconds(setupStart, Clock::now());
+
+        for (int i = 0; i < WARMUP_FRAMES; ++i)
+            benchmark.Frame(NULL);
+        for (int i = 0; i < nFrames; ++i)
+            benchmark.Frame(&results);
+    }
+
+    DeleteFrameAssets(assetDir);
+
+    return WriteResultsFile(outputPath, NULL, nInstances, nFrames, results) ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Benchmarks/Benchmark.h"
+
+struct BenchmarkSuite {
+    const char* name;
+    void (*run)();
+};
+
+static const BenchmarkSuite s_suites[] = {
+    { "texture", &RunTextureCodecBenchmarks },
+    { "containers", &RunContainerBenchmarks },
+};
+
+static volatile const void* s_sink;
+
+static bool s_csv = false;
+static const char* s_suiteName = "";
+
+void BenchmarkReport(const char* name, double bytes, double seconds)
+{
+    if (s_csv) {
+        printf("%s,%s,%.6f,%.3f,MB/s\n",
+               s_suiteName, name, seconds * 1000.0, bytes / seconds / 1e6);
+    } else {
+        printf("%-40s %10.3f ms %10.1f MB/s\n",
+               name, seconds * 1000.0, bytes / seconds / 1e6);
+    }
+}
+
+void BenchmarkReportOps(const char* name, double nOps, double seconds)
+{
+    if (s_csv) {
+        printf("%s,%s,%.6f,%.3f,ns/op\n",
+               s_suiteName, name, seconds * 1000.0, seconds * 1e9 / nOps);
+    } else {
+        printf("%-40s %10.3f ms %10.2f ns/op\n",
+               name, seconds * 1000.0, seconds * 1e9 / nOps);
+    }
+}
+
+void BenchmarkReportValue(const char* name, double value, const char* unit)
+{
+    if (s_csv)
+        printf("%s,%s,,%.3f,%s\n", s_suiteName, name, value, unit);
+    else
+        printf("%-40s %10.2f %s\n", name, value, unit);
+}
+
+void BenchmarkUse(const void* data)
+{
+    s_sink = data;
+}
+
+static const int N_SUITES = (int)(sizeof s_suites / sizeof s_suites[0]);
+
+static bool IsSuiteName(const char* name)
+{
+    for (int i = 0; i < N_SUITES; ++i) {
+        if (strcmp(name, s_suites[i].name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: Benchmarks [--csv] [suite...]\nSuites:");
+    for (int i = 0; i < N_SUITES; ++i)
+        fprintf(stderr, " %s", s_suites[i].name);
+    fprintf(stderr, "\n");
+}
+
+// Usage: Benchmarks [--csv] [suite...]
+// Runs the named suites, or all of them if none are given. With --csv, the
+// results are written as CSV rows of suite, name, time (ms), value and unit.
+// An unknown suite name is an error, so that a misspelt suite in a script
+// doesn't silently run nothing.
+int main(int argc, char** argv)
+{
+    int nSuiteArgs = 0;
+    for (int j = 1; j < argc; ++j) {
+        if (strcmp(argv[j], "--csv") == 0) {
+            s_csv = true;
+        } else if (IsSuiteName(argv[j])) {
+            ++nSuiteArgs;
+        } else {
+            fprintf(stderr, "Unknown benchmark suite: %s\n", argv[j]);
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (s_csv)
+        printf("suite,name,ms,value,unit\n");
+
+    for (int i = 0; i < N_SUITES; ++i) {
+        bool run = (nSuiteArgs == 0);
+        for (int j = 1; j < argc; ++j) {
+            if (strcmp(argv[j], s_suites[i].name) == 0)
+                run = true;
+        }
+        if (run) {
+            s_suiteName = s_suites[i].name;
+            if (!s_csv)
+                printf("== %s\n", s_suites[i].name);
+            s_suites[i].run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Benchmarks/Benchmark.h"
+#include "Texture/DXTCodec.h"
+
+const unsigned IMAGE_SIZE = 1024;
+const int ITERATIONS = 10;
+
+// Fills the image with smooth gradients plus a little noise, which is closer
+// to real texture content than pure noise. The alpha is a horizontal ramp.
+static void GenerateImage(std::vector<u32>& texels)
+{
+    texels.resize(IMAGE_SIZE * IMAGE_SIZE);
+    u32 seed = 12345;
+    for (unsigned y = 0; y < IMAGE_SIZE; ++y) {
+        for (unsigned x = 0; x < IMAGE_SIZE; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            u32 noise = (seed >> 24) & 0xF;
+            u32 r = ((x * 255 / IMAGE_SIZE) + noise) & 0xFF;
+            u32 g = ((y * 255 / IMAGE_SIZE) + noise) & 0xFF;
+            u32 b = (((x + y) * 127 / IMAGE_SIZE) + noise) & 0xFF;
+            u32 a = x * 255 / IMAGE_SIZE;
+            texels[y * IMAGE_SIZE + x] = b | (g << 8) | (r << 16) | (a << 24);
+        }
+    }
+}
+
+static double RootMeanSquareError(const std::vector<u32>& a, const std::vector<u32>& b)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int c = 0; c < 32; c += 8) {
+            double d = (double)((a[i] >> c) & 0xFF) - (double)((b[i] >> c) & 0xFF);
+            sum += d * d;
+        }
+    }
+    return sqrt(sum / (double)(a.size() * 4));
+}
+
+static void BenchmarkFormat(DDSTextureFormat format, const char* formatName,
+                            const std::vector<u32>& image)
+{
+    std::vector<u8> blocks(DXTImageSize(format, IMAGE_SIZE, IMAGE_SIZE));
+    std::vector<u32> decoded(image.size());
+    double bytes = (double)image.size() * sizeof(u32) * ITERATIONS;
+    char name[64];
+
+    BenchmarkTimer timer;
+    for (int i = 0; i < ITERATIONS; ++i)
+        DXTCompressImage(format, &image[0], IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE, &blocks[0]);
+    double seconds = timer.Seconds();
+    BenchmarkUse(&blocks[0]);
+    snprintf(name, sizeof name, "%s compress", formatName);
+    BenchmarkReport(name, bytes, seconds);
+
+    timer.Reset();
+    for (int i = 0; i < ITERATIONS; ++i)
+        DXTDecompressImage(format, &blocks[0], IMAGE_SIZE, IMAGE_SIZE, &decoded[0], IMAGE_SIZE);
+    seconds = timer.Seconds();
+    BenchmarkUse(&decoded[0]);
+    snprintf(name, sizeof name, "%s decompress", formatName);
+    BenchmarkReport(name, bytes, seconds);
+
+    snprintf(name, sizeof name, "%s round-trip RMSE", formatName);
+    BenchmarkReportValue(name, RootMeanSquareError(image, decoded), "RMSE");
+    double ratio = (double)(image.size() * sizeof(u32)) / (double)blocks.size();
+    snprintf(name, sizeof name, "%s compression ratio", formatName);
+    BenchmarkReportValue(name, ratio, "x");
+}
+
+void RunTextureCodecBenchmarks()
+{
+    std::vector<u32> image;
+    GenerateImage(image);
+
+    // DXT1 would encode the left half of the image as transparent, so it's
+    // benchmarked on an opaque copy.
+    std::vector<u32> opaque(image);
+    for (size_t i = 0; i < opaque.size(); ++i)
+        opaque[i] |= 0xFF000000;
+
+    BenchmarkFormat(DDSTEXFORMAT_DXT1, "DXT1", opaque);
+    BenchmarkFormat(DDSTEXFORMAT_DXT3, "DXT3", image);
+    BenchmarkFormat(DDSTEXFORMAT_DXT5, "DXT5", image);
+}
@@ -8,6 +8,8 @@ struct ProjectedVertex {
     float3 normal;
     float2 uv;
     float3 dirToViewer;
+    float4 diffuseColor [[flat]];
+    float4 specularColorAndGlossiness [[flat]];
 };
 
 float3 BRDF(
@@ -24,16 +26,20 @@ float3 BRDF(
 // -----------------------------------------------------------------------------
 vertex ProjectedVertex VertexMain(
     MDLVertex                 vert         [[stage_in]],
+    uint                      instanceID   [[instance_id]],
     constant MDLSceneData&    sceneData    [[buffer(0)]],
-    constant MDLInstanceData& instanceData [[buffer(1)]]
+    constant MDLInstanceData* instances    [[buffer(13)]]
 )
 {
+    constant MDLInstanceData& instanceData = instances[instanceID];
     float4 worldPos = instanceData.worldTransform * float4(vert.position, 1);
     ProjectedVertex outVert;
     outVert.position = sceneData.viewProjTransform * worldPos;
     outVert.normal = instanceData.normalTransform * vert.normal;
     outVert.uv = vert.uv;
     outVert.dirToViewer = sceneData.cameraPos.xyz - worldPos.xyz;
+    outVert.diffuseColor = instanceData.diffuseColor;
+    outVert.specularColorAndGlossiness = instanceData.specularColorAndGlossiness;
     return outVert;
 }
 
@@ -43,7 +49,6 @@ vertex ProjectedVertex VertexMain(
 fragment float4 PixelMain(
     ProjectedVertex           input        [[stage_in]],
     constant MDLSceneData&    sceneData    [[buffer(0)]],
-    constant MDLInstanceData& instanceData [[buffer(1)]],
     sampler                   theSampler   [[sampler(0)]],
     texture2d<float>          diffuseTex   [[texture(0)]]
 )
@@ -52,11 +57,11 @@ fragment float4 PixelMain(
     float3 l = sceneData.dirToLight.xyz;
     float3 v = normalize(input.dirToViewer);
 
-    float3 cDiff = instanceData.diffuseColor.rgb;
+    float3 cDiff = input.diffuseColor.rgb;
     cDiff *= diffuseTex.sample(theSampler, input.uv).rgb;
 
-    float3 cSpec = instanceData.specularColorAndGlossiness.rgb;
-    float glossiness = instanceData.specularColorAndGlossiness.a;
+    float3 cSpec = input.specularColorAndGlossiness.rgb;
+    float glossiness = input.specularColorAndGlossiness.a;
     float3 EL_over_pi = sceneData.irradiance_over_pi.xyz;
 
     float cosTheta = saturate(dot(n, l));
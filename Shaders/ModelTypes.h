@@ -19,4 +19,7 @@ struct MDLInstanceData {
     float3x3 normalTransform;
     float4   diffuseColor;
     float4   specularColorAndGlossiness;
+    // The slice of the diffuse texture, for ModelArray.metal.
+    uint     textureSlice;
+    uint     padding[3];
 };
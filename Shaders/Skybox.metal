@@ -6,6 +6,7 @@ using namespace metal;
 struct ProjectedVertex {
     float4 position [[position]];
     float2 uv;
+    float4 diffuseColor [[flat]];
 };
 
 // -----------------------------------------------------------------------------
@@ -13,10 +14,13 @@ struct ProjectedVertex {
 // -----------------------------------------------------------------------------
 vertex ProjectedVertex VertexMain(
     MDLVertex                 vert         [[stage_in]],
+    uint                      instanceID   [[instance_id]],
     constant MDLSceneData&    sceneData    [[buffer(0)]],
-    constant MDLInstanceData& instanceData [[buffer(1)]]
+    constant MDLInstanceData* instances    [[buffer(13)]]
 )
 {
+    constant MDLInstanceData& instanceData = instances[instanceID];
+
     // Ensure that the skybox is always centered at the origin.
     float4x4 vpTransform = sceneData.viewProjTransform;
     vpTransform[3] = float4(0, 0, 0, 1);
@@ -30,6 +34,7 @@ vertex ProjectedVertex VertexMain(
     outVert.position.z = outVert.position.w;
 
     outVert.uv = vert.uv;
+    outVert.diffuseColor = instanceData.diffuseColor;
 
     return outVert;
 }
@@ -40,12 +45,11 @@ vertex ProjectedVertex VertexMain(
 fragment float4 PixelMain(
     ProjectedVertex           input        [[stage_in]],
     constant MDLSceneData&    sceneData    [[buffer(0)]],
-    constant MDLInstanceData& instanceData [[buffer(1)]],
     sampler                   theSampler   [[sampler(0)]],
     texture2d<float>          diffuseTex   [[texture(0)]]
 )
 {
-    float3 cDiff = instanceData.diffuseColor.rgb;
+    float3 cDiff = input.diffuseColor.rgb;
     cDiff *= diffuseTex.sample(theSampler, input.uv).rgb;
 
     return float4(cDiff, 1);
@@ -0,0 +1,58 @@
+#include <metal_stdlib>
+#include "ModelTypes.h"
+
+using namespace metal;
+
+struct ProjectedVertex {
+    float4 position [[position]];
+    float2 uv;
+    float4 diffuseColor [[flat]];
+    uint   textureSlice [[flat]];
+};
+
+// -----------------------------------------------------------------------------
+// Vertex shader
+// -----------------------------------------------------------------------------
+vertex ProjectedVertex VertexMain(
+    MDLVertex                 vert         [[stage_in]],
+    uint                      instanceID   [[instance_id]],
+    constant MDLSceneData&    sceneData    [[buffer(0)]],
+    constant MDLInstanceData* instances    [[buffer(13)]]
+)
+{
+    constant MDLInstanceData& instanceData = instances[instanceID];
+
+    // Ensure that the skybox is always centered at the origin.
+    float4x4 vpTransform = sceneData.viewProjTransform;
+    vpTransform[3] = float4(0, 0, 0, 1);
+
+    float4 worldPos = instanceData.worldTransform * float4(vert.position, 1);
+
+    ProjectedVertex outVert;
+    outVert.position = vpTransform * worldPos;
+
+    // Ensure that the skybox is always at the far plane.
+    outVert.position.z = outVert.position.w;
+
+    outVert.uv = vert.uv;
+    outVert.diffuseColor = instanceData.diffuseColor;
+    outVert.textureSlice = instanceData.textureSlice;
+
+    return outVert;
+}
+
+// -----------------------------------------------------------------------------
+// Pixel shader
+// -----------------------------------------------------------------------------
+fragment float4 PixelMain(
+    ProjectedVertex           input        [[stage_in]],
+    constant MDLSceneData&    sceneData    [[buffer(0)]],
+    sampler                   theSampler   [[sampler(0)]],
+    texture2d_array<float>    diffuseTex   [[texture(0)]]
+)
+{
+    float3 cDiff = input.diffuseColor.rgb;
+    cDiff *= diffuseTex.sample(theSampler, input.uv, input.textureSlice).rgb;
+
+    return float4(cDiff, 1);
+}
@@ -1,10 +1,13 @@
 #include "Application.h"
 
+#include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <math.h>
+#include <chrono>
 
 #include "Core/Path.h"
+#include "Core/Profiler.h"
 
 #include "Math/Vector3.h"
 
@@ -55,7 +58,22 @@ GpuDevice* Application::CreateGpuDevice(OsWindow& window)
     deviceFormat.resolutionX = 2560;
     deviceFormat.resolutionY = 1440;
     deviceFormat.flags = GpuDeviceFormat::FLAG_SCALE_RES_WITH_WINDOW_SIZE;
-    return GpuDevice::Create(deviceFormat, window.GetNSView());
+#ifdef __APPLE__
+    void* view = window.GetNSView();
+#else
+    // The headless window has no view, so only the Null and Soft devices can
+    // run without one.
+    void* view = NULL;
+#endif
+    GpuDevice* device = GpuDevice::Create(deviceFormat, view);
+
+    // Capture starts before any resources are created, so that the trace can
+    // be replayed on its own.
+    const char* tracePath = getenv("GFXDEMO_TRACE_CAPTURE");
+    if (tracePath && !device->TraceCaptureBegin(tracePath))
+        fprintf(stderr, "Couldn't open trace file %s\n", tracePath);
+
+    return device;
 }
 
 Application::Application()
@@ -68,7 +86,9 @@ Application::Application()
     , m_shaderCache(*m_gpuDevice, *m_fileLoader)
     , m_textureCache(*m_gpuDevice, *m_fileLoader)
 
-    , m_scene(*m_gpuDevice, *m_fileLoader, m_samplerCache, m_shaderCache, m_textureCache)
+    , m_taskPool()
+    , m_scene(*m_gpuDevice, *m_fileLoader, m_samplerCache, m_shaderCache,
+              m_textureCache, m_taskPool)
     , m_camera()
     , m_teapot(NULL)
     , m_floor(NULL)
@@ -94,6 +114,8 @@ Application::Application()
 
     m_camera.SetPositionAndTarget(Vector3(0.0f, -3.87f, 2.5f), Vector3(0.0f, -3.0f, 2.0f));
 
+    PROFILE_THREAD_NAME("Main");
+
     m_window->RegisterEvent(OSEVENT_PAINT, OnPaint, (void*)this);
     m_window->RegisterEvent(OSEVENT_WINDOW_RESIZE, OnWindowResize, (void*)m_gpuDevice.get());
     m_window->RegisterEvent(OSEVENT_KEY_DOWN, &Application::OnKeyDown, (void*)this);
@@ -108,13 +130,52 @@ Application::Application()
 Application::~Application()
 {}
 
+#ifdef PROFILER_ENABLED
+// If GFXDEMO_PROFILE_CAPTURE is set, the profile of the frames given by
+// GFXDEMO_PROFILE_FRAMES ("first,count", by default the first 60 frames) is
+// written to the file that it names.
+void Application::ExportProfileCapture()
+{
+    const char* path = getenv("GFXDEMO_PROFILE_CAPTURE");
+    if (!path)
+        return;
+
+    unsigned long long firstFrame = 1;
+    unsigned long long nFrames = 60;
+    const char* frames = getenv("GFXDEMO_PROFILE_FRAMES");
+    if (frames && sscanf(frames, "%llu,%llu", &firstFrame, &nFrames) != 2) {
+        fprintf(stderr, "GFXDEMO_PROFILE_FRAMES should be \"first,count\"\n");
+        return;
+    }
+    if (firstFrame == 0 || nFrames == 0)
+        return;
+
+    // Called before the frame begins, so the previous frame is the last one
+    // that's complete.
+    u64 lastFrame = firstFrame + nFrames - 1;
+    if (Profiler::GetFrame() != lastFrame)
+        return;
+    if (!Profiler::ExportChromeTrace(path, firstFrame, lastFrame))
+        fprintf(stderr, "Couldn't write profile to %s\n", path);
+}
+#endif
+
 void Application::Frame()
 {
+#ifdef PROFILER_ENABLED
+    ExportProfileCapture();
+#endif
+    PROFILE_BEGIN_FRAME();
+    PROFILE_ZONE("Application::Frame");
+
+    std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+
     m_netClient.Update();
 
     m_camera.Update(1.0f / 60.0f);
 
     m_samplerCache.CallCallbacks();
+    m_textureCache.UpdateAsyncLoads();
 
     m_angle += 0.01f;
     float sinAngle = sinf(m_angle);
@@ -137,7 +198,12 @@ void Application::Frame()
     viewport.zNear = 0.0f;
     viewport.zFar = 1.0f;
 
-    m_gpuDevice->SceneBegin();
+    {
+        // Includes the time spent waiting for the GPU to finish an earlier
+        // frame.
+        PROFILE_ZONE("GpuDevice::SceneBegin");
+        m_gpuDevice->SceneBegin();
+    }
 
     SceneUpdateInfo updateInfo;
     updateInfo.cameraPos = m_camera.Position();
@@ -152,7 +218,18 @@ void Application::Frame()
 
     m_shaderCache.UpdateRefreshSystem();
     m_textureCache.UpdateRefreshSystem();
-    m_gpuDevice->ScenePresent();
+    m_textureCache.UpdateStreaming();
+    {
+        PROFILE_ZONE("GpuDevice::ScenePresent");
+        m_gpuDevice->ScenePresent();
+    }
+
+    // The time that the CPU spent waiting for the GPU isn't CPU work.
+    const GpuFramePacingStats& pacingStats = m_gpuDevice->GetFramePacingStats();
+    std::chrono::duration<float, std::milli> frameTime
+        = std::chrono::steady_clock::now() - frameStart;
+    float cpuMs = frameTime.count() - pacingStats.cpuWaitMs;
+    m_scene.GetDynamicResolution().Update(cpuMs, pacingStats.gpuMs);
 }
 
 void Application::OnKeyDown(const OsEvent& event, void* userdata)
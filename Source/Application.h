@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "Core/FileLoader.h"
+#include "Core/TaskPool.h"
 
 #include "GpuDevice/GpuDevice.h"
 #include "GpuDevice/GpuSamplerCache.h"
@@ -42,6 +43,9 @@ private:
     static void OnMouseDragged(const OsEvent& event, void* userdata);
 
     void RefreshModelShader();
+#ifdef PROFILER_ENABLED
+    static void ExportProfileCapture();
+#endif
 
     std::unique_ptr<OsWindow, void (*)(OsWindow*)> m_window;
     std::unique_ptr<GpuDevice, void (*)(GpuDevice*)> m_gpuDevice;
@@ -52,6 +56,7 @@ private:
     ShaderCache m_shaderCache;
     TextureCache m_textureCache;
 
+    TaskPool m_taskPool;
     Scene m_scene;
     Camera m_camera;
     ModelInstance* m_teapot;
@@ -4,11 +4,19 @@
 #include <vector>
 #include <stdlib.h>
 
+// Update() refreshes each queued asset, and the next Update() finalizes it
+// with the value that the refresh replaced. The asset stays marked as
+// refreshed in between, so that its users can notice the refresh during the
+// frame. The GPU may still be using the old value when it's finalized, so
+// the finalize function should release GPU objects with the DestroyDeferred()
+// functions of GpuDevice.
 template<class T, class TValue>
 class AssetRefreshQueue {
 public:
     typedef TValue (*PFnRefresh)(T* asset, void* userdata);
-    typedef void (*PFnFinalize)(T* asset, TValue oldValue, void* userdata);
+    // Returns false if the old value is still in use, in which case it's
+    // finalized by a later Update() instead.
+    typedef bool (*PFnFinalize)(T* asset, TValue oldValue, void* userdata);
 
     AssetRefreshQueue(PFnRefresh refresh, PFnFinalize finalize, void* userdata)
         : m_refresh(refresh)
@@ -41,9 +49,12 @@ public:
         for (size_t i = 0; i < m_refreshList.size(); ) {
             RefreshInfo& info = m_refreshList[i];
             if (info.old != TValue()) {
-                m_finalize(info.asset, info.old, m_userdata);
-                m_refreshList[i] = m_refreshList.back();
-                m_refreshList.pop_back();
+                if (m_finalize(info.asset, info.old, m_userdata)) {
+                    m_refreshList[i] = m_refreshList.back();
+                    m_refreshList.pop_back();
+                } else {
+                    ++i;
+                }
             } else {
                 info.old = m_refresh(info.asset, m_userdata);
                 ++i;
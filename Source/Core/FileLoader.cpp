@@ -1,5 +1,6 @@
 #include "Core/FileLoader.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "Core/Str.h"
 #include "Core/Macros.h"
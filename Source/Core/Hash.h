@@ -2,6 +2,7 @@
 #define CORE_HASH_H
 
 #include <algorithm> // for std::swap
+#include <new> // for placement new
 #include <stdlib.h> // for malloc
 #include <string.h> // for memset
 #include "Core/Types.h" // for u32
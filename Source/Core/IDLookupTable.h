@@ -132,7 +132,7 @@ public:
     {
         ASSERT(m_nextInnerID < INNER_ID_MASK);
         ID theID = 0;
-        theID |= (m_nextInnerID++) << NumIndexBits;
+        theID |= (ID)(m_nextInnerID++) << NumIndexBits;
         if (m_freeList == UINT_MAX) {
             ASSERT((ID)m_objects.size() < INDEX_MASK);
             theID |= (ID)m_objects.size();
@@ -0,0 +1,108 @@
+#include "Core/JobQueue.h"
+#include <algorithm>
+#include "Core/Macros.h"
+
+JobQueue::JobQueue(int nThreads, JobFunc func, void* userdata)
+    : m_func(func)
+    , m_userdata(userdata)
+    , m_mutex()
+    , m_jobQueued()
+    , m_jobFinished()
+    , m_queue()
+    , m_running()
+    , m_quit(false)
+    , m_threads()
+{
+    ASSERT(nThreads > 0);
+    ASSERT(func != NULL);
+
+    // Started last, once the members that they use have been constructed.
+    for (int i = 0; i < nThreads; ++i)
+        m_threads.push_back(std::thread(&JobQueue::WorkerMain, this));
+}
+
+JobQueue::~JobQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ASSERT(m_queue.empty() && m_running.empty());
+        m_quit = true;
+    }
+    m_jobQueued.notify_all();
+    for (size_t i = 0; i < m_threads.size(); ++i)
+        m_threads[i].join();
+}
+
+void JobQueue::Enqueue(void* job)
+{
+    ASSERT(job != NULL);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(job);
+    }
+    m_jobQueued.notify_one();
+}
+
+bool JobQueue::IsQueuedOrRunning(void* job) const
+{
+    return std::find(m_queue.begin(), m_queue.end(), job) != m_queue.end()
+        || std::find(m_running.begin(), m_running.end(), job) != m_running.end();
+}
+
+bool JobQueue::IsDone(void* job) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !IsQueuedOrRunning(job);
+}
+
+void JobQueue::Finish(void* job)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::deque<void*>::iterator it = std::find(m_queue.begin(), m_queue.end(), job);
+        if (it == m_queue.end()) {
+            while (std::find(m_running.begin(), m_running.end(), job) != m_running.end())
+                m_jobFinished.wait(lock);
+            return;
+        }
+        m_queue.erase(it);
+    }
+    m_func(job, m_userdata);
+}
+
+void JobQueue::Cancel(void* job)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::deque<void*>::iterator it = std::find(m_queue.begin(), m_queue.end(), job);
+    if (it != m_queue.end()) {
+        m_queue.erase(it);
+        return;
+    }
+    while (std::find(m_running.begin(), m_running.end(), job) != m_running.end())
+        m_jobFinished.wait(lock);
+}
+
+void JobQueue::WorkerMain()
+{
+    for (;;) {
+        void* job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_queue.empty() && !m_quit)
+                m_jobQueued.wait(lock);
+            if (m_queue.empty())
+                return;
+            job = m_queue.front();
+            m_queue.pop_front();
+            m_running.push_back(job);
+        }
+
+        m_func(job, m_userdata);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running.erase(std::find(m_running.begin(), m_running.end(), job));
+        }
+        m_jobFinished.notify_all();
+    }
+}
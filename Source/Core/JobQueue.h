@@ -0,0 +1,79 @@
+/******************************************************************************
+ *
+ *   JobQueue.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   WHAT IT IS
+ *
+ *   A fixed-size pool of worker threads that runs jobs in the background,
+ *   in the order that they're queued. Unlike TaskPool, the calling thread
+ *   doesn't wait for the jobs, so it's suited to long-running work such as
+ *   compiling pipeline states or loading files.
+ *
+ *   HOW TO USE IT
+ *
+ *   A job is an object owned by the caller, which holds everything that the
+ *   job function needs and receives its results. The job function runs on a
+ *   worker thread, so it must not touch any state that the calling thread
+ *   uses without synchronization. Once IsDone() has returned true for a job,
+ *   the results that the job function wrote to it are visible to the calling
+ *   thread.
+ *
+ *   A job must be cancelled with Cancel() or completed with Finish() before
+ *   it's deleted, unless IsDone() has returned true for it. The methods must
+ *   all be called from the same thread.
+ *
+ ***/
+
+#ifndef CORE_JOBQUEUE_H
+#define CORE_JOBQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Core/Types.h"
+
+class JobQueue {
+public:
+    typedef void (*JobFunc)(void* job, void* userdata);
+
+    JobQueue(int nThreads, JobFunc func, void* userdata);
+    // Every job must have been cancelled or completed.
+    ~JobQueue();
+
+    void Enqueue(void* job);
+    bool IsDone(void* job) const;
+    // Runs the job on the calling thread if it hasn't started running, or
+    // otherwise waits for it to finish.
+    void Finish(void* job);
+    // Removes the job from the queue if it hasn't started running, or
+    // otherwise waits for it to finish.
+    void Cancel(void* job);
+
+private:
+    JobQueue(const JobQueue&);
+    JobQueue& operator=(const JobQueue&);
+
+    bool IsQueuedOrRunning(void* job) const;
+    void WorkerMain();
+
+    JobFunc m_func;
+    void* m_userdata;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobQueued;
+    std::condition_variable m_jobFinished;
+    // These are protected by m_mutex.
+    std::deque<void*> m_queue;
+    std::vector<void*> m_running;
+    bool m_quit;
+
+    std::vector<std::thread> m_threads;
+};
+
+#endif // CORE_JOBQUEUE_H
@@ -2,6 +2,9 @@
 
 #ifdef __APPLE__
 #  include <CoreFoundation/CoreFoundation.h>
+#elif defined(__linux__)
+#  include <string.h>
+#  include <unistd.h>
 #else
 #  error Path module not implemented for this OS
 #endif
@@ -18,6 +21,14 @@ void PathGetProgramDirectory(char* dst, unsigned dstChars)
     if (!CFURLGetFileSystemRepresentation(url2, true, (UInt8*)dst, dstChars))
         FATAL("CFURLGetFileSystemRepresentation");
     CFRelease(url2);
+#elif defined(__linux__)
+    ssize_t len = readlink("/proc/self/exe", dst, dstChars);
+    if (len < 0 || (unsigned)len >= dstChars)
+        FATAL("readlink /proc/self/exe");
+    dst[len] = '\0';
+    char* slash = strrchr(dst, '/');
+    if (slash)
+        *slash = '\0';
 #endif
 }
 
@@ -0,0 +1,321 @@
+#ifdef PROFILER_ENABLED
+
+#include "Core/Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "Core/Macros.h"
+
+STATIC_ASSERT((Profiler::MAX_THREAD_ZONES & (Profiler::MAX_THREAD_ZONES - 1)) == 0,
+              "MAX_THREAD_ZONES must be a power of two");
+
+namespace {
+
+struct Zone {
+    const char* name;
+    u64 begin;
+    u64 end;
+    u32 depth;
+};
+
+// The zones recorded by a thread, in the order that they ended. Only the
+// owning thread writes to the buffer. It publishes each zone by incrementing
+// the write count, so a reader can copy the zones before the count it read,
+// then discard those that the writer overwrote while it was copying.
+struct ThreadBuffer {
+    const char* name;
+    u32 index;
+    u32 depth;
+    std::atomic<u64> nWritten;
+    Zone zones[Profiler::MAX_THREAD_ZONES];
+};
+
+struct ProfilerState {
+    ProfilerState()
+        : mutex()
+        , threads()
+        , nFrames(0)
+    {}
+
+    ~ProfilerState()
+    {
+        for (size_t i = 0; i < threads.size(); ++i)
+            delete threads[i];
+    }
+
+    // Protects threads and the thread names. The buffers outlive their
+    // threads, so that their zones can still be exported.
+    std::mutex mutex;
+    std::vector<ThreadBuffer*> threads;
+
+    // Written by the main thread only.
+    u64 frameBegins[Profiler::MAX_FRAMES];
+    std::atomic<u64> nFrames;
+};
+
+} // namespace
+
+static ProfilerState s_state;
+static thread_local ThreadBuffer* s_threadBuffer = NULL;
+
+static ThreadBuffer* GetThreadBuffer()
+{
+    if (!s_threadBuffer) {
+        ThreadBuffer* buffer = new ThreadBuffer;
+        buffer->name = NULL;
+        buffer->depth = 0;
+        buffer->nWritten = 0;
+
+        std::lock_guard<std::mutex> lock(s_state.mutex);
+        buffer->index = (u32)s_state.threads.size();
+        s_state.threads.push_back(buffer);
+        s_threadBuffer = buffer;
+    }
+    return s_threadBuffer;
+}
+
+// Copies the zones that are still in a thread's buffer.
+static void CopyZones(const ThreadBuffer& buffer, std::vector<Zone>& zones)
+{
+    const u64 capacity = Profiler::MAX_THREAD_ZONES;
+
+    u64 end = buffer.nWritten.load(std::memory_order_acquire);
+    u64 begin = end > capacity ? end - capacity : 0;
+    size_t first = zones.size();
+    for (u64 i = begin; i < end; ++i)
+        zones.push_back(buffer.zones[i & (capacity - 1)]);
+
+    // The writer may also be in the middle of writing the zone after newEnd.
+    u64 newEnd = buffer.nWritten.load(std::memory_order_acquire) + 1;
+    u64 nOverwritten = newEnd > begin + capacity ? newEnd - (begin + capacity) : 0;
+    if (nOverwritten > end - begin)
+        nOverwritten = end - begin;
+    zones.erase(zones.begin() + first, zones.begin() + first + (size_t)nOverwritten);
+}
+
+// Returns the time range of frames [firstFrame, lastFrame], if the profiler
+// still remembers them.
+static bool GetFrameRange(u64 firstFrame, u64 lastFrame, u64* begin, u64* end)
+{
+    u64 nFrames = s_state.nFrames.load(std::memory_order_acquire);
+    if (firstFrame == 0 || firstFrame > lastFrame || lastFrame > nFrames)
+        return false;
+    if (nFrames - firstFrame >= Profiler::MAX_FRAMES)
+        return false;
+
+    *begin = s_state.frameBegins[(firstFrame - 1) % Profiler::MAX_FRAMES];
+    if (lastFrame < nFrames)
+        *end = s_state.frameBegins[lastFrame % Profiler::MAX_FRAMES];
+    else
+        *end = Profiler::Now();
+    return true;
+}
+
+static bool ZoneBefore(const Zone& a, const Zone& b)
+{
+    if (a.begin != b.begin)
+        return a.begin < b.begin;
+    return a.depth < b.depth;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    ThreadBuffer* buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(s_state.mutex);
+    buffer->name = name;
+}
+
+void Profiler::BeginFrame()
+{
+    u64 frame = s_state.nFrames.load(std::memory_order_relaxed);
+    s_state.frameBegins[frame % MAX_FRAMES] = Now();
+    s_state.nFrames.store(frame + 1, std::memory_order_release);
+}
+
+u64 Profiler::GetFrame()
+{
+    return s_state.nFrames.load(std::memory_order_acquire);
+}
+
+u64 Profiler::Now()
+{
+    std::chrono::nanoseconds time
+        = std::chrono::steady_clock::now().time_since_epoch();
+    return (u64)time.count();
+}
+
+u32 Profiler::EnterZone()
+{
+    return GetThreadBuffer()->depth++;
+}
+
+void Profiler::ExitZone(const char* name, u64 begin, u32 depth)
+{
+    u64 end = Now();
+
+    ThreadBuffer* buffer = s_threadBuffer;
+    --buffer->depth;
+
+    u64 index = buffer->nWritten.load(std::memory_order_relaxed);
+    Zone& zone = buffer->zones[index & (MAX_THREAD_ZONES - 1)];
+    zone.name = name;
+    zone.begin = begin;
+    zone.end = end;
+    zone.depth = depth;
+    buffer->nWritten.store(index + 1, std::memory_order_release);
+}
+
+static void WriteJSONString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* c = str; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        if ((unsigned char)*c >= 0x20)
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+bool Profiler::ExportChromeTrace(const char* path, u64 firstFrame, u64 lastFrame)
+{
+    u64 rangeBegin, rangeEnd;
+    if (!GetFrameRange(firstFrame, lastFrame, &rangeBegin, &rangeEnd))
+        return false;
+
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    // Times are in microseconds from the start of the first frame.
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (u64 frame = firstFrame; frame <= lastFrame; ++frame) {
+        u64 time = s_state.frameBegins[(frame - 1) % MAX_FRAMES];
+        fprintf(file,
+                "{\"name\":\"Frame %llu\",\"ph\":\"i\",\"s\":\"g\","
+                "\"pid\":1,\"tid\":0,\"ts\":%.3f},\n",
+                (unsigned long long)frame,
+                (double)(time - rangeBegin) / 1000.0);
+    }
+
+    std::lock_guard<std::mutex> lock(s_state.mutex);
+    std::vector<Zone> zones;
+    for (size_t i = 0; i < s_state.threads.size(); ++i) {
+        const ThreadBuffer& buffer = *s_state.threads[i];
+
+        fprintf(file,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":",
+                buffer.index);
+        if (buffer.name) {
+            WriteJSONString(file, buffer.name);
+        } else {
+            fprintf(file, "\"Thread %u\"", buffer.index);
+        }
+        fprintf(file, "}},\n");
+
+        zones.clear();
+        CopyZones(buffer, zones);
+        for (size_t j = 0; j < zones.size(); ++j) {
+            const Zone& zone = zones[j];
+            if (zone.begin < rangeBegin || zone.begin >= rangeEnd)
+                continue;
+            fprintf(file, "{\"name\":");
+            WriteJSONString(file, zone.name);
+            fprintf(file,
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+                    buffer.index,
+                    (double)(zone.begin - rangeBegin) / 1000.0,
+                    (double)(zone.end - zone.begin) / 1000.0);
+        }
+    }
+
+    // The events end with a comma, so finish with a metadata event.
+    fprintf(file,
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"args\":{\"name\":\"GfxDemo\"}}\n]}\n");
+
+    bool ok = (ferror(file) == 0);
+    if (fclose(file) != 0)
+        ok = false;
+    return ok;
+}
+
+static bool SummaryBefore(const ProfilerZoneSummary& a, const ProfilerZoneSummary& b)
+{
+    return a.totalMs > b.totalMs;
+}
+
+int Profiler::GetFrameSummary(u64 frame, ProfilerZoneSummary* zones, int maxZones)
+{
+    ASSERT(zones != NULL || maxZones == 0);
+
+    u64 rangeBegin, rangeEnd;
+    if (frame >= GetFrame() || !GetFrameRange(frame, frame, &rangeBegin, &rangeEnd))
+        return 0;
+
+    std::vector<ProfilerZoneSummary> summaries;
+    std::vector<Zone> threadZones;
+    std::vector<size_t> parents;
+    std::vector<float> selfMs;
+    {
+        std::lock_guard<std::mutex> lock(s_state.mutex);
+        for (size_t i = 0; i < s_state.threads.size(); ++i) {
+            threadZones.clear();
+            CopyZones(*s_state.threads[i], threadZones);
+
+            // The zones are recorded as they end, so sort them into the order
+            // that they began, which puts each zone after its parent.
+            std::sort(threadZones.begin(), threadZones.end(), &ZoneBefore);
+
+            selfMs.resize(threadZones.size());
+            for (size_t j = 0; j < threadZones.size(); ++j)
+                selfMs[j] = (float)(threadZones[j].end - threadZones[j].begin) / 1e6f;
+
+            // The open zones enclosing the current one.
+            parents.clear();
+            for (size_t j = 0; j < threadZones.size(); ++j) {
+                const Zone& zone = threadZones[j];
+                while (!parents.empty() &&
+                       threadZones[parents.back()].depth >= zone.depth)
+                    parents.pop_back();
+                if (!parents.empty())
+                    selfMs[parents.back()] -= (float)(zone.end - zone.begin) / 1e6f;
+                parents.push_back(j);
+            }
+
+            for (size_t j = 0; j < threadZones.size(); ++j) {
+                const Zone& zone = threadZones[j];
+                if (zone.begin < rangeBegin || zone.begin >= rangeEnd)
+                    continue;
+
+                size_t k = 0;
+                while (k < summaries.size() && strcmp(summaries[k].name, zone.name) != 0)
+                    ++k;
+                if (k == summaries.size()) {
+                    ProfilerZoneSummary summary = {zone.name, 0, 0.0f, 0.0f};
+                    summaries.push_back(summary);
+                }
+                ++summaries[k].count;
+                summaries[k].totalMs += (float)(zone.end - zone.begin) / 1e6f;
+                summaries[k].selfMs += selfMs[j];
+            }
+        }
+    }
+
+    std::sort(summaries.begin(), summaries.end(), &SummaryBefore);
+
+    int nZones = std::min(maxZones, (int)summaries.size());
+    for (int i = 0; i < nZones; ++i)
+        zones[i] = summaries[i];
+    return nZones;
+}
+
+#endif // PROFILER_ENABLED
@@ -0,0 +1,124 @@
+/******************************************************************************
+ *
+ *   Profiler.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   WHAT IT IS
+ *
+ *   A hierarchical CPU profiler. Code is instrumented with scoped zones,
+ *   which are timed and recorded into a buffer owned by the thread that runs
+ *   them, so recording a zone takes no locks. The zones of recent frames can
+ *   be exported as a Chrome trace (which Perfetto also opens), or summarized
+ *   to find the zones that took the most time.
+ *
+ *   The profiler only exists if PROFILER_ENABLED is defined, which the Debug
+ *   and Profile configurations do. Otherwise the macros expand to nothing,
+ *   and code that calls Profiler directly must be conditional on it.
+ *
+ *   HOW TO USE IT
+ *
+ *   Put PROFILE_ZONE("Name") at the start of a scope to time the rest of the
+ *   scope. Zones nest. The name must be a string literal, since it's kept
+ *   until the zone is exported.
+ *
+ *   The main thread calls PROFILE_BEGIN_FRAME() at the start of each frame.
+ *   The zones of a frame are those that began on any thread between the
+ *   start of the frame and the start of the next one. Each thread keeps
+ *   about the last MAX_THREAD_ZONES zones, and the profiler the start times
+ *   of the last MAX_FRAMES frames, so only recent frames can be exported.
+ *
+ *   PROFILE_THREAD_NAME("Name") names the calling thread in exported traces.
+ *
+ ***/
+
+#ifndef CORE_PROFILER_H
+#define CORE_PROFILER_H
+
+#ifdef PROFILER_ENABLED
+
+#include "Core/Types.h"
+
+struct ProfilerZoneSummary {
+    const char* name;
+    // The number of times the zone ran in the frame, on any thread.
+    u32 count;
+    // The total time that the zone ran, including and excluding the zones
+    // nested in it.
+    float totalMs;
+    float selfMs;
+};
+
+class Profiler {
+public:
+    static const u32 MAX_THREAD_ZONES = 1 << 16;
+    static const u32 MAX_FRAMES = 1024;
+
+    static void SetThreadName(const char* name);
+
+    // Starts a new frame. Must be called from the main thread.
+    static void BeginFrame();
+    // Returns the number of the current frame, starting at 1. Zero before the
+    // first frame.
+    static u64 GetFrame();
+
+    // Writes the zones of frames [firstFrame, lastFrame] to a Chrome trace
+    // JSON file. Returns false if the file can't be written, or if any of the
+    // frames has been forgotten or hasn't started yet.
+    static bool ExportChromeTrace(const char* path, u64 firstFrame, u64 lastFrame);
+
+    // Fills zones with the summaries of up to maxZones zones of a frame that
+    // has ended, from the one that took the most total time. Zones with the
+    // same name are combined. Returns the number of summaries written.
+    static int GetFrameSummary(u64 frame, ProfilerZoneSummary* zones, int maxZones);
+
+    // Used by ProfilerZone.
+    static u64 Now();
+    static u32 EnterZone();
+    static void ExitZone(const char* name, u64 begin, u32 depth);
+
+private:
+    Profiler();
+};
+
+class ProfilerZone {
+public:
+    explicit ProfilerZone(const char* name)
+        : m_name(name)
+        , m_depth(Profiler::EnterZone())
+        , m_begin(Profiler::Now())
+    {}
+
+    ~ProfilerZone()
+    {
+        Profiler::ExitZone(m_name, m_begin, m_depth);
+    }
+
+private:
+    ProfilerZone(const ProfilerZone&);
+    ProfilerZone& operator=(const ProfilerZone&);
+
+    const char* m_name;
+    u32 m_depth;
+    u64 m_begin;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_ZONE(name) \
+    ProfilerZone PROFILE_CONCAT(profilerZone_, __LINE__)(name)
+#define PROFILE_BEGIN_FRAME() Profiler::BeginFrame()
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_THREAD_NAME(name)
+
+#endif // PROFILER_ENABLED
+
+#endif // CORE_PROFILER_H
@@ -0,0 +1,89 @@
+/******************************************************************************
+ *
+ *   RadixSort.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   WHAT IT IS
+ *
+ *   A least-significant-digit radix sort for arrays of items that carry a
+ *   64-bit sort key. The sort is stable and runs in O(n) time.
+ *
+ *   The key is processed as eight 8-bit digits. The histograms for all eight
+ *   digits are built in a single pass over the input, and the scatter passes
+ *   then only touch the source array, the destination array and a 1 KB
+ *   histogram, which keeps the working set small. A pass is skipped entirely
+ *   when every item has the same value for that digit; sort keys typically
+ *   leave whole fields constant within a frame, so several passes are
+ *   usually skipped.
+ *
+ *   HOW TO USE IT
+ *
+ *   The item type T must be copyable with memcpy and must have a public u64
+ *   member named 'key'. The caller supplies a scratch array holding at least
+ *   'count' items. On return, 'items' is sorted in ascending key order; the
+ *   contents of 'scratch' are unspecified.
+ *
+ ***/
+
+#ifndef CORE_RADIXSORT_H
+#define CORE_RADIXSORT_H
+
+#include <stddef.h>
+#include <string.h>
+#include "Core/Types.h"
+#include "Core/Macros.h"
+
+template<class T>
+void RadixSort64(T* items, T* scratch, size_t count)
+{
+    if (count < 2)
+        return;
+
+    ASSERT(count <= 0xFFFFFFFF);
+
+    u32 histograms[8][256];
+    memset(histograms, 0, sizeof histograms);
+
+    for (size_t i = 0; i < count; ++i) {
+        u64 key = items[i].key;
+        for (int digit = 0; digit < 8; ++digit)
+            ++histograms[digit][(key >> (digit * 8)) & 0xFF];
+    }
+
+    T* src = items;
+    T* dst = scratch;
+
+    for (int digit = 0; digit < 8; ++digit) {
+        u32* histogram = histograms[digit];
+        const int shift = digit * 8;
+
+        // All the keys have the same value for this digit.
+        if (histogram[(src[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        // Convert the counts into starting offsets.
+        u32 sum = 0;
+        for (int i = 0; i < 256; ++i) {
+            u32 c = histogram[i];
+            histogram[i] = sum;
+            sum += c;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const T& item = src[i];
+            dst[histogram[(item.key >> shift) & 0xFF]++] = item;
+        }
+
+        T* temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    if (src != items)
+        memcpy(items, src, count * sizeof(T));
+}
+
+#endif // CORE_RADIXSORT_H
@@ -0,0 +1,126 @@
+#include "Core/TaskPool.h"
+#include "Core/Macros.h"
+#include "Core/Profiler.h"
+
+TaskPool::TaskPool(int nWorkerThreads)
+    : m_threads()
+    , m_mutex()
+    , m_workAvailable()
+    , m_workerIdle()
+    , m_func(NULL)
+    , m_userdata(NULL)
+    , m_count(0)
+    , m_generation(0)
+    , m_nBusyWorkers(0)
+    , m_quit(false)
+    , m_nextIndex(0)
+{
+    if (nWorkerThreads < 0) {
+        nWorkerThreads = (int)std::thread::hardware_concurrency() - 1;
+        if (nWorkerThreads < 0)
+            nWorkerThreads = 0;
+    }
+
+    m_threads.reserve(nWorkerThreads);
+    for (int i = 0; i < nWorkerThreads; ++i)
+        m_threads.push_back(std::thread(&TaskPool::WorkerMain, this));
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_workAvailable.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+        m_threads[i].join();
+}
+
+int TaskPool::GetNumThreads() const
+{
+    return (int)m_threads.size() + 1;
+}
+
+void TaskPool::ParallelFor(int count, TaskFunc func, void* userdata)
+{
+    ASSERT(func != NULL);
+    ASSERT(count >= 0);
+
+    if (m_threads.empty() || count <= 1) {
+        for (int i = 0; i < count; ++i)
+            func(i, userdata);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // A worker that woke up late for the previous loop may still be
+        // looking at the task state, so wait for it before replacing it.
+        while (m_nBusyWorkers != 0)
+            m_workerIdle.wait(lock);
+
+        m_func = func;
+        m_userdata = userdata;
+        m_count = count;
+        m_nextIndex = 0;
+        ++m_generation;
+    }
+    m_workAvailable.notify_all();
+
+    RunTasks(count, func, userdata);
+
+    // Every index has now been claimed; wait for the workers to finish the
+    // tasks that they claimed.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_nBusyWorkers != 0)
+        m_workerIdle.wait(lock);
+}
+
+void TaskPool::RunTasks(int count, TaskFunc func, void* userdata)
+{
+    PROFILE_ZONE("TaskPool::RunTasks");
+
+    for (;;) {
+        int index = m_nextIndex.fetch_add(1);
+        if (index >= count)
+            break;
+        func(index, userdata);
+    }
+}
+
+void TaskPool::WorkerMain(TaskPool* pool)
+{
+    PROFILE_THREAD_NAME("TaskPool worker");
+
+    u32 generation = 0;
+
+    for (;;) {
+        TaskFunc func;
+        void* userdata;
+        int count;
+        {
+            std::unique_lock<std::mutex> lock(pool->m_mutex);
+            while (!pool->m_quit && pool->m_generation == generation)
+                pool->m_workAvailable.wait(lock);
+            if (pool->m_quit)
+                return;
+
+            generation = pool->m_generation;
+            func = pool->m_func;
+            userdata = pool->m_userdata;
+            count = pool->m_count;
+            ++pool->m_nBusyWorkers;
+        }
+
+        pool->RunTasks(count, func, userdata);
+
+        {
+            std::lock_guard<std::mutex> lock(pool->m_mutex);
+            --pool->m_nBusyWorkers;
+        }
+        pool->m_workerIdle.notify_all();
+    }
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ *
+ *   TaskPool.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   WHAT IT IS
+ *
+ *   A fixed-size pool of worker threads that runs data-parallel loops.
+ *
+ *   HOW TO USE IT
+ *
+ *   Call ParallelFor() with the number of tasks, a function and a userdata
+ *   pointer. The function is called once for each index in [0, count), in an
+ *   unspecified order and on an unspecified thread. The calling thread also
+ *   runs tasks, and ParallelFor() only returns once every task has finished.
+ *
+ *   ParallelFor() must not be called from inside a task, nor from more than
+ *   one thread at a time.
+ *
+ ***/
+
+#ifndef CORE_TASKPOOL_H
+#define CORE_TASKPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Core/Types.h"
+
+class TaskPool {
+public:
+    typedef void (*TaskFunc)(int index, void* userdata);
+
+    // If nWorkerThreads is negative, one worker thread is created for each
+    // hardware thread other than the calling thread.
+    explicit TaskPool(int nWorkerThreads = -1);
+    ~TaskPool();
+
+    // Returns the number of threads that run tasks, including the thread that
+    // calls ParallelFor().
+    int GetNumThreads() const;
+
+    void ParallelFor(int count, TaskFunc func, void* userdata);
+
+private:
+    TaskPool(const TaskPool&);
+    TaskPool& operator=(const TaskPool&);
+
+    static void WorkerMain(TaskPool* pool);
+    void RunTasks(int count, TaskFunc func, void* userdata);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workerIdle;
+
+    // These are protected by m_mutex.
+    TaskFunc m_func;
+    void* m_userdata;
+    int m_count;
+    u32 m_generation;
+    int m_nBusyWorkers;
+    bool m_quit;
+
+    std::atomic<int> m_nextIndex;
+};
+
+#endif // CORE_TASKPOOL_H
@@ -0,0 +1,180 @@
+/******************************************************************************
+ *
+ *   GpuCommandList.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuCommandList is a plain CPU-side stream of encoder commands. Backends
+ *   without a native command encoder record draw items into it, and
+ *   GpuDevice::DrawParallel() records each chunk into a separate list and
+ *   appends the lists in order at submit time.
+ *
+ *   Resources are referred to by their raw lookup table indices, exactly as
+ *   in GpuDrawItem.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUCOMMANDLIST_H
+#define GPUDEVICE_GPUCOMMANDLIST_H
+
+#include <string.h>
+#include <vector>
+#include "Core/Types.h"
+#include "Core/Macros.h"
+#include "GpuDevice/GpuDevice.h"
+
+enum GpuCommandType {
+    GPU_CMD_SET_PIPELINE_STATE,
+    GPU_CMD_SET_DEPTH_STENCIL_STATE,
+    GPU_CMD_SET_RASTER_STATE,
+    GPU_CMD_SET_VERTEX_BUFFER,
+    GPU_CMD_SET_CBUFFER,
+    GPU_CMD_SET_TEXTURE,
+    GPU_CMD_SET_SAMPLER,
+    GPU_CMD_DRAW,
+    GPU_CMD_DRAW_INDEXED,
+};
+
+struct GpuCommand {
+    // Layout of the fields for each command type:
+    //   SET_PIPELINE_STATE: index = pipeline state
+    //   SET_DEPTH_STENCIL_STATE: args[0] = depth-stencil key
+    //   SET_RASTER_STATE: args[0] = raster state key
+    //   SET_VERTEX_BUFFER, SET_CBUFFER: slot, index = buffer, args[0] = offset
+    //   SET_TEXTURE, SET_SAMPLER: slot, index = texture or sampler
+    //   DRAW: slot = primitive type, args[0] = first, args[1] = count,
+    //         args[3] = instance count
+    //   DRAW_INDEXED: slot = primitive type | (index type << 4),
+    //                 index = index buffer, args[0] = first,
+    //                 args[1] = count, args[2] = index buffer offset,
+    //                 args[3] = instance count, args[4] = base vertex,
+    //                 args[5] = base instance
+    //
+    // Indirect draw items are expanded into one DRAW_INDEXED per record.
+    u8 type;
+    u8 slot;
+    u16 index;
+    u32 args[6];
+};
+
+class GpuCommandList {
+public:
+    GpuCommandList()
+        : m_commands()
+    {}
+
+    void Clear()
+    {
+        m_commands.clear();
+    }
+
+    bool IsEmpty() const
+    {
+        return m_commands.empty();
+    }
+
+    size_t NumCommands() const
+    {
+        return m_commands.size();
+    }
+
+    const GpuCommand* Commands() const
+    {
+        return m_commands.empty() ? NULL : &m_commands[0];
+    }
+
+    void SetPipelineState(u16 index)
+    {
+        Push(GPU_CMD_SET_PIPELINE_STATE, 0, index);
+    }
+
+    void SetDepthStencilState(u32 key)
+    {
+        Push(GPU_CMD_SET_DEPTH_STENCIL_STATE, 0, 0).args[0] = key;
+    }
+
+    void SetRasterState(u32 key)
+    {
+        Push(GPU_CMD_SET_RASTER_STATE, 0, 0).args[0] = key;
+    }
+
+    void SetVertexBuffer(int slot, u16 index, u32 offset)
+    {
+        Push(GPU_CMD_SET_VERTEX_BUFFER, slot, index).args[0] = offset;
+    }
+
+    void SetCBuffer(int slot, u16 index, u32 offset)
+    {
+        Push(GPU_CMD_SET_CBUFFER, slot, index).args[0] = offset;
+    }
+
+    void SetTexture(int slot, u16 index)
+    {
+        Push(GPU_CMD_SET_TEXTURE, slot, index);
+    }
+
+    void SetSampler(int slot, u16 index)
+    {
+        Push(GPU_CMD_SET_SAMPLER, slot, index);
+    }
+
+    void Draw(GpuPrimitiveType primType, u32 first, u32 count, u32 instanceCount)
+    {
+        GpuCommand& cmd = Push(GPU_CMD_DRAW, primType, 0);
+        cmd.args[0] = first;
+        cmd.args[1] = count;
+        cmd.args[3] = instanceCount;
+    }
+
+    void DrawIndexed(GpuPrimitiveType primType,
+                     GpuIndexType indexType,
+                     u16 indexBuffer,
+                     u32 first,
+                     u32 count,
+                     u32 indexBufferOffset,
+                     u32 instanceCount,
+                     i32 baseVertex,
+                     u32 baseInstance)
+    {
+        GpuCommand& cmd = Push(GPU_CMD_DRAW_INDEXED,
+                               primType | (indexType << 4),
+                               indexBuffer);
+        cmd.args[0] = first;
+        cmd.args[1] = count;
+        cmd.args[2] = indexBufferOffset;
+        cmd.args[3] = instanceCount;
+        cmd.args[4] = (u32)baseVertex;
+        cmd.args[5] = baseInstance;
+    }
+
+    // Appends the commands of another list to the end of this one.
+    void Append(const GpuCommandList& other)
+    {
+        m_commands.insert(m_commands.end(),
+                          other.m_commands.begin(),
+                          other.m_commands.end());
+    }
+
+private:
+    // Appends a command with all of its arguments set to zero.
+    GpuCommand& Push(GpuCommandType type, int slot, u16 index)
+    {
+        ASSERT(0 <= slot && slot <= 0xFF);
+        GpuCommand cmd;
+        cmd.type = (u8)type;
+        cmd.slot = (u8)slot;
+        cmd.index = index;
+        memset(cmd.args, 0, sizeof cmd.args);
+        m_commands.push_back(cmd);
+        return m_commands.back();
+    }
+
+    std::vector<GpuCommand> m_commands;
+};
+
+#endif // GPUDEVICE_GPUCOMMANDLIST_H
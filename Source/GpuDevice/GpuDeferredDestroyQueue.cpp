@@ -0,0 +1,75 @@
+#include "GpuDevice/GpuDeferredDestroyQueue.h"
+#include "Core/Macros.h"
+
+GpuDeferredDestroyQueue::GpuDeferredDestroyQueue()
+    : m_entries()
+{}
+
+GpuDeferredDestroyQueue::~GpuDeferredDestroyQueue()
+{
+    ASSERT(m_entries.empty());
+}
+
+void GpuDeferredDestroyQueue::PushShaderProgram(GpuShaderProgramID shaderProgramID,
+                                                u64 lastFrame)
+{
+    Push(RESOURCE_SHADER_PROGRAM, shaderProgramID, lastFrame);
+}
+
+void GpuDeferredDestroyQueue::PushBuffer(GpuBufferID bufferID, u64 lastFrame)
+{
+    Push(RESOURCE_BUFFER, bufferID, lastFrame);
+}
+
+void GpuDeferredDestroyQueue::PushTexture(GpuTextureID textureID, u64 lastFrame)
+{
+    Push(RESOURCE_TEXTURE, textureID, lastFrame);
+}
+
+void GpuDeferredDestroyQueue::Push(ResourceType type, u32 id, u64 lastFrame)
+{
+    ASSERT(m_entries.empty() || m_entries.back().lastFrame <= lastFrame);
+
+    Entry entry;
+    entry.type = type;
+    entry.id = id;
+    entry.lastFrame = lastFrame;
+    m_entries.push_back(entry);
+}
+
+void GpuDeferredDestroyQueue::DestroyCompleted(GpuDevice& device,
+                                               u64 completedFrame)
+{
+    size_t nDestroyed = 0;
+    while (nDestroyed < m_entries.size()
+           && m_entries[nDestroyed].lastFrame <= completedFrame) {
+        Destroy(device, m_entries[nDestroyed]);
+        ++nDestroyed;
+    }
+    m_entries.erase(m_entries.begin(), m_entries.begin() + nDestroyed);
+}
+
+void GpuDeferredDestroyQueue::DestroyAll(GpuDevice& device)
+{
+    for (size_t i = 0; i < m_entries.size(); ++i)
+        Destroy(device, m_entries[i]);
+    m_entries.clear();
+}
+
+void GpuDeferredDestroyQueue::Destroy(GpuDevice& device, const Entry& entry)
+{
+    switch (entry.type) {
+        case RESOURCE_SHADER_PROGRAM:
+            device.ShaderProgramDestroy(GpuShaderProgramID(entry.id));
+            break;
+        case RESOURCE_BUFFER:
+            device.BufferDestroy(GpuBufferID(entry.id));
+            break;
+        case RESOURCE_TEXTURE:
+            device.TextureDestroy(GpuTextureID(entry.id));
+            break;
+        default:
+            ASSERT(!"Unknown resource type");
+            break;
+    }
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+ *
+ *   GpuDeferredDestroyQueue.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuDeferredDestroyQueue holds the resources passed to the
+ *   DestroyDeferred() functions of GpuDevice, each with the last frame that
+ *   may use it. The GpuDevice forwarders call DestroyCompleted() from
+ *   SceneBegin(), once the frame pacer has waited for the GPU, and
+ *   DestroyAll() when the device is destroyed.
+ *
+ *   The resources are destroyed through the public GpuDevice functions, so
+ *   that a trace capture records the destruction at the point where it
+ *   actually happens.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUDEFERREDDESTROYQUEUE_H
+#define GPUDEVICE_GPUDEFERREDDESTROYQUEUE_H
+
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuDeferredDestroyQueue {
+public:
+    GpuDeferredDestroyQueue();
+    // The queue must be empty.
+    ~GpuDeferredDestroyQueue();
+
+    void PushShaderProgram(GpuShaderProgramID shaderProgramID, u64 lastFrame);
+    void PushBuffer(GpuBufferID bufferID, u64 lastFrame);
+    void PushTexture(GpuTextureID textureID, u64 lastFrame);
+
+    // Destroys the resources whose last frame is at most completedFrame.
+    void DestroyCompleted(GpuDevice& device, u64 completedFrame);
+    void DestroyAll(GpuDevice& device);
+
+private:
+    GpuDeferredDestroyQueue(const GpuDeferredDestroyQueue&);
+    GpuDeferredDestroyQueue& operator=(const GpuDeferredDestroyQueue&);
+
+    enum ResourceType {
+        RESOURCE_SHADER_PROGRAM,
+        RESOURCE_BUFFER,
+        RESOURCE_TEXTURE,
+    };
+
+    struct Entry {
+        ResourceType type;
+        u32 id;
+        u64 lastFrame;
+    };
+
+    void Push(ResourceType type, u32 id, u64 lastFrame);
+    static void Destroy(GpuDevice& device, const Entry& entry);
+
+    // In the order of the calls, so the last frames are non-decreasing.
+    std::vector<Entry> m_entries;
+};
+
+#endif // GPUDEVICE_GPUDEFERREDDESTROYQUEUE_H
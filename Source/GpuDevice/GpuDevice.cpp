@@ -38,3 +38,63 @@ GpuRenderPassDesc::GpuRenderPassDesc()
     , depthStencilLoadAction(DEFAULT_LOAD_ACTION)
     , depthStencilStoreAction(DEFAULT_STORE_ACTION)
 {}
+
+u32 GpuStateFilterStats::TotalBindsIssued() const
+{
+    u32 total = 0;
+    for (int i = 0; i < GPU_STATE_TYPE_COUNT; ++i)
+        total += bindsIssued[i];
+    return total;
+}
+
+u32 GpuStateFilterStats::TotalBindsSkipped() const
+{
+    u32 total = 0;
+    for (int i = 0; i < GPU_STATE_TYPE_COUNT; ++i)
+        total += bindsSkipped[i];
+    return total;
+}
+
+GpuSimulatedGpuCost::GpuSimulatedGpuCost()
+    : perFrame(0.0f)
+    , perStateBind(0.0f)
+    , perDraw(0.0f)
+    , perPrimitive(0.0f)
+    , perPixel(0.0f)
+    , perPipelineCompile(0.0f)
+{}
+
+u64 GpuDevice::TextureSizeInBytes(GpuTextureType type,
+                                  GpuPixelFormat pixelFormat,
+                                  int width,
+                                  int height,
+                                  int depthOrArrayLength,
+                                  int nMipmapLevels)
+{
+    // Compressed formats are stored as 4x4 blocks, so sizes are computed in
+    // units of blocks, which are single pixels for the uncompressed formats.
+    int blockSize = 1;
+    u64 bytesPerBlock = 4;
+    switch (pixelFormat) {
+        case GPU_PIXEL_FORMAT_DXT1: blockSize = 4; bytesPerBlock = 8; break;
+        case GPU_PIXEL_FORMAT_DXT3: blockSize = 4; bytesPerBlock = 16; break;
+        case GPU_PIXEL_FORMAT_DXT5: blockSize = 4; bytesPerBlock = 16; break;
+        default: break;
+    }
+
+    bool is3D = (type == GPU_TEXTURE_3D);
+    u64 nSlices = (type == GPU_TEXTURE_CUBE) ? 6 : 1;
+    if (!is3D)
+        nSlices *= (u64)depthOrArrayLength;
+
+    u64 size = 0;
+    for (int i = 0; i < nMipmapLevels; ++i) {
+        int w = width >> i;
+        int h = height >> i;
+        int d = is3D ? (depthOrArrayLength >> i) : 1;
+        u64 blocksWide = (u64)((w > 0 ? w : 1) + blockSize - 1) / blockSize;
+        u64 blocksHigh = (u64)((h > 0 ? h : 1) + blockSize - 1) / blockSize;
+        size += blocksWide * blocksHigh * (u64)(d > 0 ? d : 1) * bytesPerBlock;
+    }
+    return size * nSlices;
+}
@@ -21,12 +21,18 @@
 #include "Core/Types.h"
 #include "Math/Matrix44.h"
 
+class TaskPool;
+
 // -----------------------------------------------------------------------------
 // Constants
 // -----------------------------------------------------------------------------
 
 const unsigned GPU_MAX_CBUFFERS = 14;
 
+// Draw items with an instance buffer bind it to this cbuffer slot (in both the
+// vertex and pixel shaders), so they may not use the slot for a cbuffer.
+const unsigned GPU_INSTANCE_BUFFER_SLOT = GPU_MAX_CBUFFERS - 1;
+
 // -----------------------------------------------------------------------------
 // Miscellaneous types
 // -----------------------------------------------------------------------------
@@ -116,11 +122,16 @@ DECLARE_PRIMITIVE_WRAPPER(u32, GpuPipelineStateID);
 DECLARE_PRIMITIVE_WRAPPER(u32, GpuRenderPassID);
 DECLARE_PRIMITIVE_WRAPPER(u32, GpuTextureID);
 DECLARE_PRIMITIVE_WRAPPER(u32, GpuSamplerID);
+DECLARE_PRIMITIVE_WRAPPER(u32, GpuTimerQueryID);
 
 enum GpuBufferType {
     GPU_BUFFER_TYPE_VERTEX,
     GPU_BUFFER_TYPE_INDEX,
     GPU_BUFFER_TYPE_CONSTANT,
+
+    // Holds an array of GpuDrawArgs records for indirect draw items (see
+    // GpuDrawItemWriter::SetDrawCallIndexedIndirect()).
+    GPU_BUFFER_TYPE_INDIRECT,
 };
 
 enum GpuBufferAccessMode {
@@ -129,8 +140,8 @@ enum GpuBufferAccessMode {
     // to update the values of a static buffer.
     GPU_BUFFER_ACCESS_STATIC,
 
-    // Intended for buffers that are updated on the majority of frames, and
-    // the maximum number of updates per frame is small and finite.
+    // Intended for buffers that are updated on the majority of frames. Data in
+    // these buffers persist until the buffer is next updated.
     GPU_BUFFER_ACCESS_DYNAMIC,
 
     // Designed for buffers that are updated an unbounded number of times on
@@ -138,9 +149,8 @@ enum GpuBufferAccessMode {
     // an >error< to try to draw from a stream-mode buffer in a frame in which
     // it has not been updated.
     //
-    // These may only be used for buffers whose size is >small<, for example
-    // in the hundreds of kilobytes range. If a larger dynamic buffer is
-    // required, use the GPU_BUFFER_ACCESS_DYNAMIC mode.
+    // The data of stream-mode and dynamic-mode buffers are suballocated from
+    // an upload heap that grows to fit each frame (see GpuUploadHeapStats).
     //
     // Another benefit of this access mode is that -- unlike the other modes --
     // stream-mode buffers may be resized. This is done via the
@@ -309,6 +319,231 @@ struct GpuDeviceFormat {
     u32 flags;
 };
 
+// The arguments of a single draw issued by an indirect draw item. The layout
+// matches MTLDrawIndexedPrimitivesIndirectArguments, so that a buffer of these
+// records can be consumed directly by the GPU.
+struct GpuDrawArgs {
+    u32 count;
+    u32 instanceCount;
+    u32 first;
+    i32 baseVertex;
+    u32 baseInstance;
+};
+
+// -----------------------------------------------------------------------------
+// Statistics
+// -----------------------------------------------------------------------------
+
+enum GpuStateType {
+    GPU_STATE_PIPELINE,
+    GPU_STATE_DEPTH_STENCIL,
+    GPU_STATE_RASTER,
+    GPU_STATE_VERTEX_BUFFER,
+    GPU_STATE_CBUFFER,
+    GPU_STATE_TEXTURE,
+    GPU_STATE_SAMPLER,
+
+    GPU_STATE_TYPE_COUNT,
+};
+
+// Counts of the state bindings made by GpuDevice::Draw(). A binding is
+// skipped when the draw item requests the state that is already bound.
+struct GpuStateFilterStats {
+    u32 TotalBindsIssued() const;
+    u32 TotalBindsSkipped() const;
+
+    u32 bindsIssued[GPU_STATE_TYPE_COUNT];
+    u32 bindsSkipped[GPU_STATE_TYPE_COUNT];
+};
+
+// Counts of the draw items submitted by GpuDevice::Draw(), and of the draws
+// that they expand into. An indirect draw item expands into one draw for each
+// of its GpuDrawArgs records; any other draw item is a single draw.
+struct GpuDrawStats {
+    u32 nDrawItems;
+    u32 nIndirectDrawItems;
+    u32 nDraws;
+    // Draw items whose pipeline state object was still compiling (see
+    // PipelineStateCreateAsync()). They're drawn with the fallback object if
+    // it's ready, and are otherwise skipped and not counted in nDrawItems.
+    u32 nFallbackDrawItems;
+    u32 nSkippedDrawItems;
+    // The primitives drawn by the draws, over all their instances. On Metal,
+    // the GPU reads the arguments of indirect draws, so their primitives
+    // aren't counted.
+    u64 nIndexedPrimitives;
+    u64 nNonIndexedPrimitives;
+};
+
+// The kinds of state object that are shared between all the create calls with
+// identical descriptions. A create call that matches an existing object
+// returns its ID and adds a reference to it, and the object is only destroyed
+// when every reference has been destroyed.
+enum GpuStateObjectType {
+    GPU_STATE_OBJECT_SAMPLER,
+    GPU_STATE_OBJECT_INPUT_LAYOUT,
+    GPU_STATE_OBJECT_PIPELINE_STATE,
+    GPU_STATE_OBJECT_RENDER_PASS,
+
+    GPU_STATE_OBJECT_TYPE_COUNT,
+};
+
+// Statistics of the state object caches since the device was created.
+struct GpuStateObjectCacheStats {
+    // Create calls that returned an existing object.
+    u32 hits[GPU_STATE_OBJECT_TYPE_COUNT];
+    // Create calls that created a new object.
+    u32 misses[GPU_STATE_OBJECT_TYPE_COUNT];
+    // The number of distinct objects that currently exist.
+    u32 nObjects[GPU_STATE_OBJECT_TYPE_COUNT];
+};
+
+// Frame pacing statistics for the most recently presented frame.
+struct GpuFramePacingStats {
+    // The number of submitted frames that the GPU hadn't finished executing
+    // when the frame was presented, including the frame itself.
+    u32 nFramesInFlight;
+    // The time that the CPU spent blocked waiting for the GPU during the frame,
+    // in SceneBegin() and WaitForFrame().
+    float cpuWaitMs;
+    // The time that the GPU spent executing the most recently completed frame,
+    // which is usually a frame or more behind the presented one. Zero until a
+    // frame has completed.
+    float gpuMs;
+};
+
+// Usage of the upload heap, from which the data of stream-mode buffers and the
+// updates of dynamic-mode buffers are suballocated. Each frame allocates
+// linearly, so the bytes that it uses are its high-water mark.
+struct GpuUploadHeapStats {
+    // The bytes allocated by the most recently presented frame, including
+    // alignment padding.
+    u32 frameBytesUsed;
+    // The largest value of frameBytesUsed over all frames so far.
+    u32 peakFrameBytesUsed;
+    // The pages that the heap currently owns, whether in use or free.
+    u32 nPages;
+    u32 nPageBytes;
+    // The largest value of nPageBytes so far.
+    u32 peakPageBytes;
+};
+
+// The categories of GPU memory tracked by GpuMemoryStats.
+enum GpuMemoryCategory {
+    // Static-mode buffers.
+    GPU_MEMORY_BUFFERS,
+    // Textures created without GPU_TEXTURE_FLAG_RENDER_TARGET.
+    GPU_MEMORY_TEXTURES,
+    // Textures created with GPU_TEXTURE_FLAG_RENDER_TARGET. The backbuffers
+    // and depth buffers that the device creates for its format aren't
+    // included.
+    GPU_MEMORY_RENDER_TARGETS,
+    // The pages of the upload heap (see GpuUploadHeapStats), which hold the
+    // contents of stream-mode buffers and every copy of a dynamic-mode
+    // buffer that a frame in flight may still read.
+    GPU_MEMORY_UPLOAD_HEAP,
+
+    GPU_MEMORY_CATEGORY_COUNT,
+};
+
+// The estimated memory used by the resources that currently exist. Texture
+// sizes are computed by GpuDevice::TextureSizeInBytes(), so they include the
+// mipmap chain but not any padding added by the driver. On the Null and Soft
+// backends, the sizes are those that the resources would have on a GPU.
+struct GpuMemoryStats {
+    u32 nAllocations[GPU_MEMORY_CATEGORY_COUNT];
+    u64 bytes[GPU_MEMORY_CATEGORY_COUNT];
+    // The largest value of bytes[i] so far.
+    u64 peakBytes[GPU_MEMORY_CATEGORY_COUNT];
+    // The sum of bytes[] over all the categories.
+    u64 totalBytes;
+    // The largest value of totalBytes so far.
+    u64 peakTotalBytes;
+};
+
+// The kinds of resource counted by GpuFrameStats.
+enum GpuResourceType {
+    GPU_RESOURCE_SHADER_PROGRAM,
+    GPU_RESOURCE_BUFFER,
+    GPU_RESOURCE_TEXTURE,
+    GPU_RESOURCE_SAMPLER,
+    GPU_RESOURCE_INPUT_LAYOUT,
+    GPU_RESOURCE_PIPELINE_STATE,
+    GPU_RESOURCE_RENDER_PASS,
+
+    GPU_RESOURCE_TYPE_COUNT,
+};
+
+// Counters of the work done in the most recently presented frame, i.e. since
+// the previous call to ScenePresent(). They gather the draw, bind and upload
+// heap statistics above along with the data uploaded and the resources
+// created, so that a change in any of them shows up in one place. Every
+// backend keeps them, and they only cost an increment or two per call.
+struct GpuFrameStats {
+    // See GpuDrawStats.
+    u32 nDraws;
+    u64 nIndexedPrimitives;
+    u64 nNonIndexedPrimitives;
+    // The binds that were issued rather than skipped (see GpuStateFilterStats).
+    // Buffer binds include vertex, instance and constant buffers.
+    u32 nPipelineStateBinds;
+    u32 nBufferBinds;
+    u32 nTextureBinds;
+    u32 nSamplerBinds;
+    // The size of each buffer mapped by BufferMap().
+    u64 bufferMapBytes;
+    // The size of each region uploaded by TextureUpload() and
+    // TextureUploadSlice(), in the texture's pixel format.
+    u64 textureUploadBytes;
+    // The resources that were created and destroyed. Create calls that return
+    // a shared state object, and destroy calls that don't release its last
+    // reference, aren't counted.
+    u32 nCreated[GPU_RESOURCE_TYPE_COUNT];
+    u32 nDestroyed[GPU_RESOURCE_TYPE_COUNT];
+    // The bytes of the upload heap used by the frame's stream-mode buffers and
+    // dynamic-mode buffer updates, and the size of the heap's pages (see
+    // GpuUploadHeapStats).
+    u32 uploadHeapBytesUsed;
+    u32 uploadHeapPageBytes;
+};
+
+// Called by ScenePresent() for each frame that ends with the total memory
+// over the budget (see GpuDevice::SetMemoryBudget()).
+typedef void (*GpuMemoryBudgetCallback)(const GpuMemoryStats& stats,
+                                        u64 budget,
+                                        void* userdata);
+
+// -----------------------------------------------------------------------------
+// Frame pacing
+// -----------------------------------------------------------------------------
+
+// The upper limit on the number of frames that the CPU may queue ahead of the
+// GPU. Per-frame resources such as dynamic buffers are allocated once for
+// each of these frames, regardless of the current limit.
+const int GPU_MAX_FRAMES_IN_FLIGHT = 3;
+
+const int GPU_DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+// The cost model used by backends without a GPU to simulate how long the GPU
+// takes to execute each frame, and how long the driver takes to compile
+// pipeline state objects. All costs are in microseconds.
+struct GpuSimulatedGpuCost {
+    GpuSimulatedGpuCost();
+
+    float perFrame;
+    float perStateBind;
+    float perDraw;
+    // Charged for each primitive of each instance that a draw renders.
+    float perPrimitive;
+    // Charged for each pixel of the viewport of each Draw() or DrawParallel()
+    // call, as if the call's draws covered the viewport once.
+    float perPixel;
+    // Charged for each pipeline state object that's created, on the calling
+    // thread by PipelineStateCreate() and on a worker thread by
+    // PipelineStateCreateAsync().
+    float perPipelineCompile;
+};
+
 // -----------------------------------------------------------------------------
 // The GpuDevice cross-platform API
 // -----------------------------------------------------------------------------
@@ -330,9 +565,8 @@ public:
 
     // Buffers
     bool BufferExists(GpuBufferID bufferID) const;
-    // N.B. The maxUpdatesPerFrame parameter only applies for buffers with the
-    // access mode GPU_BUFFER_ACCESS_DYNAMIC. For other access modes, the value
-    // of the parameter has no meaning.
+    // N.B. The maxUpdatesPerFrame parameter is no longer used, as updates of
+    // dynamic-mode buffers are suballocated from the upload heap.
     GpuBufferID BufferCreate(GpuBufferType type,
                              GpuBufferAccessMode accessMode,
                              const void* data,
@@ -350,6 +584,15 @@ public:
     void* BufferMap(GpuBufferID bufferID);
     void BufferUnmap(GpuBufferID bufferID);
 
+    // Use on GPU_BUFFER_ACCESS_STATIC buffers only. Copies size bytes of data
+    // to the buffer, starting at the given byte offset. The copy is ordered
+    // before the draw calls of the current frame, so the region being written
+    // must not be read by any frame that is still in flight.
+    void BufferUpload(GpuBufferID bufferID,
+                      unsigned offset,
+                      const void* data,
+                      unsigned size);
+
     // Textures
     bool TextureExists(GpuTextureID textureID) const;
     GpuTextureID TextureCreate(GpuTextureType type,
@@ -365,6 +608,29 @@ public:
                        int mipmapLevel,
                        int stride,
                        const void* bytes);
+    // Uploads to one slice of an array, cube or 3D texture. For cube textures,
+    // the slice is the face (times 6 for cube arrays); for 3D textures, it's
+    // the depth. TextureUpload() uploads to slice 0.
+    void TextureUploadSlice(GpuTextureID textureID,
+                            int slice,
+                            const GpuRegion& region,
+                            int mipmapLevel,
+                            int stride,
+                            const void* bytes);
+    // Returns the number of bytes used by a texture with the given parameters.
+    // Each mipmap level is at least one pixel (or one 4x4 block, for the
+    // compressed formats) in each dimension.
+    static u64 TextureSizeInBytes(GpuTextureType type,
+                                  GpuPixelFormat pixelFormat,
+                                  int width,
+                                  int height,
+                                  int depthOrArrayLength,
+                                  int nMipmapLevels);
+
+    // Samplers, input layouts, pipeline state objects and render passes are
+    // shared between create calls with identical descriptions, and are
+    // reference counted (see GpuStateObjectType). Each create call must be
+    // matched by a destroy call.
 
     // Samplers
     bool SamplerExists(GpuSamplerID samplerID) const;
@@ -382,6 +648,16 @@ public:
     // Pipeline state objects
     bool PipelineStateExists(GpuPipelineStateID pipelineStateID) const;
     GpuPipelineStateID PipelineStateCreate(const GpuPipelineStateDesc& state);
+    // Creates a pipeline state object that's compiled on a worker thread, and
+    // returns its ID straight away. Until the object is ready, draw items that
+    // use it are drawn with the fallback object instead, or are skipped if the
+    // fallback is 0, has been destroyed or isn't ready either. If an object
+    // with the same description already exists, it's returned and the fallback
+    // is ignored. Backends whose pipeline state objects are cheap to create
+    // may return an object that's already ready.
+    GpuPipelineStateID PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                GpuPipelineStateID fallback);
+    bool PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const;
     void PipelineStateDestroy(GpuPipelineStateID pipelineStateID);
 
     // Render passes
@@ -403,10 +679,108 @@ public:
               GpuRenderPassID renderPass,
               const GpuViewport& viewport);
 
+    // Submits an array of draw items in the same way as Draw(), but splits
+    // the array into contiguous chunks that are encoded in parallel on the
+    // threads of the given task pool. The chunks are submitted in array
+    // order, so the result is identical to calling Draw(). Arrays that are
+    // too small to benefit are encoded on the calling thread.
+    void DrawParallel(const GpuDrawItem* const* items,
+                      int nItems,
+                      GpuRenderPassID renderPass,
+                      const GpuViewport& viewport,
+                      TaskPool& taskPool);
+
+    // Timer queries
+    // A timer query measures the GPU time between a begin and an end marker
+    // in the current frame. The markers are ordered with the Draw() and
+    // DrawParallel() calls of the frame, so a query measures whole calls,
+    // i.e. whole render passes. A query can be measured at most once per
+    // frame. Its result is resolved once the GPU has finished the frame, so
+    // it's only available a few frames later.
+    //
+    // The Null backend computes the times from the simulated GPU cost (see
+    // GpuSimulatedGpuCost), and the Soft backend measures the time spent
+    // rendering. On Metal, the results are zero if the GPU can't sample
+    // timestamps.
+    bool TimerQueryExists(GpuTimerQueryID queryID) const;
+    GpuTimerQueryID TimerQueryCreate();
+    void TimerQueryDestroy(GpuTimerQueryID queryID);
+    void TimerQueryBegin(GpuTimerQueryID queryID);
+    void TimerQueryEnd(GpuTimerQueryID queryID);
+    // Returns false if no measurement of the query has been resolved yet.
+    // Otherwise returns the most recent one, in milliseconds, and the number
+    // of the frame in which it was made, if frame isn't NULL.
+    bool TimerQueryGetResult(GpuTimerQueryID queryID,
+                             float* milliseconds,
+                             u64* frame) const;
+
     // Scene begin/end functions
+    // SceneBegin() blocks until the number of frames in flight is below the
+    // limit set with SetMaxFramesInFlight().
     void SceneBegin();
     void ScenePresent();
 
+    // Frame pacing
+    // Frames are numbered from 1 in the order that they're presented, and the
+    // number of a frame serves as a fence: the GPU has finished executing the
+    // frame once GetCompletedFrame() returns a value greater than or equal to
+    // its number.
+    void SetMaxFramesInFlight(int nFrames); // 1 to GPU_MAX_FRAMES_IN_FLIGHT
+    int GetMaxFramesInFlight() const;
+    u64 GetSubmittedFrame() const;
+    u64 GetCompletedFrame() const;
+    // Blocks until the GPU has finished executing the given frame.
+    void WaitForFrame(u64 frame);
+
+    // Deferred destruction
+    // Destroys the resource once the GPU has finished the frame that's being
+    // built (GetSubmittedFrame() + 1), so it can be called in the middle of a
+    // frame that uses the resource. The resource mustn't be used by later
+    // frames, and any draw items that refer to it must be unregistered
+    // before the next SceneBegin(). The destruction happens in the first
+    // SceneBegin() after the GPU has finished the frame, or in Destroy().
+    void ShaderProgramDestroyDeferred(GpuShaderProgramID shaderProgramID);
+    void BufferDestroyDeferred(GpuBufferID bufferID);
+    void TextureDestroyDeferred(GpuTextureID textureID);
+    // Only has an effect on backends without a GPU (i.e. the Null backend).
+    void SetSimulatedGpuCost(const GpuSimulatedGpuCost& cost);
+
+    // Returns the frame pacing statistics for the most recently presented
+    // frame.
+    const GpuFramePacingStats& GetFramePacingStats() const;
+
+    // Returns the state filtering statistics for the most recently presented
+    // frame.
+    const GpuStateFilterStats& GetStateFilterStats() const;
+
+    // Returns the draw statistics for the most recently presented frame.
+    const GpuDrawStats& GetDrawStats() const;
+
+    // Returns the counters of the most recently presented frame.
+    const GpuFrameStats& GetFrameStats() const;
+
+    const GpuUploadHeapStats& GetUploadHeapStats() const;
+
+    const GpuStateObjectCacheStats& GetStateObjectCacheStats() const;
+
+    const GpuMemoryStats& GetMemoryStats() const;
+    // Sets the memory budget, in bytes, and the callback to call when the
+    // total memory is over it at the end of a frame. The callback may destroy
+    // resources. A budget of zero means there's no budget.
+    void SetMemoryBudget(u64 budget,
+                         GpuMemoryBudgetCallback callback,
+                         void* userdata);
+
+    // Records every subsequent GpuDevice call into a binary trace file at the
+    // given path, until TraceCaptureEnd() is called. The trace can be replayed
+    // into any backend with GpuTraceReplay. Calls on resources created before
+    // the capture began aren't recorded, so to capture a replayable trace,
+    // begin the capture before creating any resources. Returns false if the
+    // file can't be opened.
+    bool TraceCaptureBegin(const char* path);
+    void TraceCaptureEnd();
+    bool IsTraceCapturing() const;
+
 #ifdef GPUDEVICE_DEBUG_MODE
     // Notifies the GpuDevice of the creation of a new GpuDrawItem.
     // This is called automatically by GpuDrawItemWriter, so typically clients
@@ -9,10 +9,22 @@
 #import <Metal/Metal.h>
 
 #include "Core/IDLookupTable.h"
+#include "Core/JobQueue.h"
 #include "Core/Macros.h"
+#include "Core/TaskPool.h"
+#include "GpuDevice/GpuDeferredDestroyQueue.h"
+#include "GpuDevice/GpuDrawChunks.h"
 #include "GpuDevice/GpuDrawItem.h"
+#include "GpuDevice/GpuFrameCounters.h"
+#include "GpuDevice/GpuFramePacer.h"
+#include "GpuDevice/GpuMemoryTracker.h"
 #include "GpuDevice/GpuShaderLoad.h"
 #include "GpuDevice/GpuShaderPermutations.h"
+#include "GpuDevice/GpuStateCache.h"
+#include "GpuDevice/GpuStateObjectCache.h"
+#include "GpuDevice/GpuTimerQueries.h"
+#include "GpuDevice/GpuTraceWriter.h"
+#include "GpuDevice/GpuUploadHeap.h"
 
 #define FOURCC(a, b, c, d) (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
 
@@ -20,9 +32,9 @@
 // Constants
 // -----------------------------------------------------------------------------
 
-const u32 STREAM_RING_BUF_SIZE = 2 * 1024 * 1024; // 2 MB
+const u32 UPLOAD_HEAP_PAGE_SIZE = 2 * 1024 * 1024; // 2 MB
 
-// All streaming-mode and dynamic-mode buffers have their size rounded up to a
+// The data of all streaming-mode and dynamic-mode buffers are aligned to a
 // multiple of this number of bytes.
 // Note: As per the MTLRenderCommandEncoder documentation, only a 16 byte
 // alignment is required. However, we use a 64 byte alignment as this is
@@ -33,8 +45,7 @@ const u32 BUF_ALIGNMENT = 64;
 // specified by the MTLRenderCommandEncoder documentation.
 const u32 CONSTANT_BUF_ALIGNMENT = 256;
 
-// We use double-buffering, so there are always two frames in-flight.
-const int FRAMES_IN_FLIGHT = 2;
+const int PIPELINE_COMPILER_THREADS = 2;
 
 // -----------------------------------------------------------------------------
 // Lookup tables for miscellaneous types
@@ -114,6 +125,7 @@ static const u32 s_bufferAlignments[] = {
     BUF_ALIGNMENT, // GPU_BUFFER_TYPE_VERTEX
     BUF_ALIGNMENT, // GPU_BUFFER_TYPE_INDEX
     CONSTANT_BUF_ALIGNMENT, // GPU_BUFFER_TYPE_CONSTANT
+    BUF_ALIGNMENT, // GPU_BUFFER_TYPE_INDIRECT
 };
 
 // -----------------------------------------------------------------------------
@@ -230,14 +242,12 @@ public:
     void BufferDestroy(GpuBufferID bufferID);
     void BufferStreamResize(GpuBufferID bufferID, unsigned newSize);
 
-private:
-    void* DynamicBufferMap(GpuBufferID bufferID);
-    void DynamicBufferUnmap(GpuBufferID bufferID);
-    void* StreamBufferMap(GpuBufferID bufferID);
-    void StreamBufferUnmap(GpuBufferID bufferID);
-public:
     void* BufferMap(GpuBufferID bufferID);
     void BufferUnmap(GpuBufferID bufferID);
+    void BufferUpload(GpuBufferID bufferID,
+                      unsigned offset,
+                      const void* data,
+                      unsigned size);
 
     // Textures
     bool TextureExists(GpuTextureID textureID) const;
@@ -250,6 +260,7 @@ public:
                                int nMipmapLevels);
     void TextureDestroy(GpuTextureID textureID);
     void TextureUpload(GpuTextureID textureID,
+                       int slice,
                        const GpuRegion& region,
                        int mipmapLevel,
                        int stride,
@@ -271,9 +282,24 @@ public:
     // Pipeline state objects
     bool PipelineStateExists(GpuPipelineStateID pipelineStateID) const;
     GpuPipelineStateID PipelineStateCreate(const GpuPipelineStateDesc& state);
+    GpuPipelineStateID PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                GpuPipelineStateID fallback);
+    bool PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const;
 private:
-    id<MTLRenderPipelineState> CreateMTLRenderPipelineState(const GpuPipelineStateDesc& state);
+    struct PipelineStateObj;
+    GpuPipelineStateID CreatePipelineStateObj(const GpuPipelineStateDesc& state,
+                                              bool async,
+                                              GpuPipelineStateID fallback);
+    MTLRenderPipelineDescriptor* CreateMTLRenderPipelineDescriptor(const GpuPipelineStateDesc& state);
+    static id<MTLRenderPipelineState> CompileMTLRenderPipelineState(id<MTLDevice> device,
+                                                                    MTLRenderPipelineDescriptor* desc);
     id<MTLDepthStencilState> CreateMTLDepthStencilState(const GpuPipelineStateDesc& state);
+    static void CompilePipelineState(void* job, void* userdata);
+    void FinishPipelineCompile(PipelineStateObj& obj);
+    void CancelPipelineCompile(PipelineStateObj& obj);
+    void UpdatePipelineCompiles();
+    void CancelPipelineCompiles();
+    bool ResolvePipelineState(u16* pipelineStateIdx, GpuStateCache& stateCache) const;
 public:
     void PipelineStateDestroy(GpuPipelineStateID pipelineStateID);
 
@@ -284,18 +310,56 @@ public:
 
     // Submit an array of draw items
 private:
+    MTLRenderPassDescriptor* PrepareRenderPass(GpuRenderPassID passID);
     id<MTLRenderCommandEncoder> PreDraw(GpuRenderPassID passID, const GpuViewport& viewport);
     void PostDraw(id<MTLRenderCommandEncoder> encoder);
+    void EncodeDrawItems(id<MTLRenderCommandEncoder> encoder,
+                         const GpuDrawItem* const* items,
+                         int nItems,
+                         GpuStateCache& stateCache);
+    static void EncodeDrawChunk(int index, void* userdata);
 public:
     void Draw(const GpuDrawItem* const* items,
               int nItems,
               GpuRenderPassID renderPass,
               const GpuViewport& viewport);
+    void DrawParallel(const GpuDrawItem* const* items,
+                      int nItems,
+                      GpuRenderPassID renderPass,
+                      const GpuViewport& viewport,
+                      TaskPool& taskPool);
 
     // Scene begin/end functions
     void SceneBegin();
     void ScenePresent();
 
+    // Timer queries
+    GpuTimerQueries& GetTimerQueries();
+    const GpuTimerQueries& GetTimerQueries() const;
+    void TimerQueryMark(u32 timestamp);
+
+    // Frame pacing
+    GpuFramePacer& GetFramePacer();
+    const GpuFramePacer& GetFramePacer() const;
+
+    // Memory accounting
+    GpuMemoryTracker& GetMemoryTracker();
+    const GpuMemoryTracker& GetMemoryTracker() const;
+
+    // Deferred destruction
+    GpuDeferredDestroyQueue& GetDeferredDestroyQueue();
+
+    // Statistics
+    const GpuStateFilterStats& GetStateFilterStats() const;
+    const GpuDrawStats& GetDrawStats() const;
+    const GpuFrameStats& GetFrameStats() const;
+    const GpuUploadHeapStats& GetUploadHeapStats() const;
+    const GpuStateObjectCacheStats& GetStateObjectCacheStats() const;
+
+    // Trace capture
+    GpuTraceWriter& GetTraceWriter();
+    const GpuTraceWriter& GetTraceWriter() const;
+
 #ifdef GPUDEVICE_DEBUG_MODE
     void DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increment);
     void RegisterDrawItem(const GpuDrawItem* item);
@@ -371,9 +435,21 @@ private:
         id<MTLBuffer> buffer;
         GpuBufferType type;
         GpuBufferAccessMode accessMode;
-        int maxUpdatesPerFrame;
         u32 size;
         u32 bufOffset;
+        // Stream-mode and dynamic-mode buffers only. The buffer is the page
+        // of the upload heap that holds the allocation. For dynamic-mode
+        // buffers, it's a persistent allocation that's freed by the next
+        // update.
+        GpuUploadAllocation allocation;
+    };
+
+    // The compilation of a pipeline state object created by
+    // PipelineStateCreateAsync(), which runs on a worker thread.
+    struct PipelineCompileJob {
+        id<MTLDevice> device;
+        MTLRenderPipelineDescriptor* descriptor;
+        id<MTLRenderPipelineState> state;
     };
 
     struct PipelineStateObj {
@@ -382,11 +458,19 @@ private:
         u32 dbg_shaderProgram;
         u32 dbg_inputLayout;
 #endif
+        // nil until the object has finished compiling, if it was created by
+        // PipelineStateCreateAsync().
         id<MTLRenderPipelineState> state;
         id<MTLDepthStencilState> depthStencilState;
         MTLTriangleFillMode triangleFillMode;
         MTLCullMode cullMode;
         MTLWinding frontFaceWinding;
+        u32 depthStencilKey;
+        u32 rasterStateKey;
+
+        // Non-NULL until the object has finished compiling.
+        PipelineCompileJob* compileJob;
+        u32 fallback;
     };
 
     struct RenderPassObj {
@@ -406,6 +490,9 @@ private:
         int dbg_refCount;
 #endif
         id<MTLTexture> texture;
+        u64 size;
+        GpuMemoryCategory memoryCategory;
+        GpuPixelFormat pixelFormat;
     };
 
     struct Sampler {
@@ -415,29 +502,50 @@ private:
         id<MTLSamplerState> samplerState;
     };
 
+    struct DrawChunk {
+        GpuDeviceMetal* device;
+        id<MTLRenderCommandEncoder> encoder;
+        const GpuDrawItem* const* items;
+        int nItems;
+        GpuStateCache stateCache;
+    };
+
     void CreateOrDestroyDepthBuffers();
+    void CreateTimestampSampleBuffer();
+    void CalibrateTimestamps();
     CAMetalLayer* GetCAMetalLayer() const;
 
+    // Allocates new memory from the upload heap for a stream-mode or
+    // dynamic-mode buffer, and returns a pointer to it.
+    void* UploadBufferAllocate(Buffer& buffer);
+
+    static void* CreateUploadPage(u32 size, void** cpuAddress, void* userdata);
+    static void DestroyUploadPage(void* page, u32 size, void* userdata);
+
     GpuDeviceFormat m_deviceFormat;
     NSView* m_view;
     CGSize m_viewSize;
     int m_frameNumber;
-    int m_doubleBufferIndex;
+    // The index of the per-frame resources used by the current frame.
+    int m_frameSlot;
 
     id<MTLDevice> m_device;
     id<MTLCommandQueue> m_commandQueue;
 
-    id<MTLTexture> m_depthBufs[2];
+    id<MTLTexture> m_depthBufs[GPU_MAX_FRAMES_IN_FLIGHT];
     id<MTLCommandBuffer> m_commandBuffer;
-    id<MTLCommandBuffer> m_prevCommandBuffer;
 
     id<CAMetalDrawable> m_currentDrawable;
 
-    // We always keep two copies of each buffer -- one for each frame.
-    // Hence the size of this vector is always even.
-    std::vector<id<MTLBuffer> > m_streamRingBufs;
-    u32 m_streamBufCursor;
-    int m_streamBufIndex;
+    // Declared before the upload heap, whose pages it tracks.
+    GpuMemoryTracker m_memoryTracker;
+    GpuUploadHeap m_uploadHeap;
+    GpuStateObjectCache m_stateObjectCache;
+
+    JobQueue m_pipelineCompiler;
+    // The pipeline state objects created by PipelineStateCreateAsync() that
+    // may still be compiling. The objects may have been destroyed since.
+    std::vector<GpuPipelineStateID> m_compilingPipelineStates;
 
     GpuShaderPermutations<PermutationApiData> m_permutations;
     IDLookupTable<ShaderProgram, GpuShaderProgramID::Type, 16, 16> m_shaderProgramTable;
@@ -448,6 +556,29 @@ private:
     IDLookupTable<Texture, GpuTextureID::Type, 16, 16> m_textureTable;
     IDLookupTable<Sampler, GpuSamplerID::Type, 16, 16> m_samplerTable;
 
+    GpuStateCache m_stateCache;
+    GpuStateFilterStats m_stateFilterStats;
+    GpuDrawStats m_drawStats;
+    GpuFrameCounters m_frameCounters;
+
+    GpuTraceWriter m_traceWriter;
+
+    GpuFramePacer m_framePacer;
+    GpuDeferredDestroyQueue m_deferredDestroyQueue;
+
+    // Timer query markers sample the GPU timestamp counter into this buffer,
+    // which has MAX_TIMESTAMPS_PER_FRAME samples for each frame slot. It's nil
+    // if the device can't sample counters between passes, in which case every
+    // query measures zero. GPU timestamps are converted to nanoseconds with
+    // the ratio measured by CalibrateTimestamps().
+    id<MTLCounterSampleBuffer> m_timestampSampleBuffer;
+    MTLTimestamp m_calibrationCpuTime;
+    MTLTimestamp m_calibrationGpuTime;
+    double m_gpuTimestampToNs;
+    GpuTimerQueries m_timerQueries;
+
+    std::vector<DrawChunk> m_drawChunks;
+
     int m_dbg_shaderCount;
     int m_dbg_bufferCount;
     int m_dbg_textureCount;
@@ -457,23 +588,6 @@ private:
     int m_dbg_inputLayoutCount;
 };
 
-// -----------------------------------------------------------------------------
-// Static functions used throughout the code
-// -----------------------------------------------------------------------------
-
-static id<MTLBuffer> CreateStreamRingBuffer(id<MTLDevice> device)
-{
-    MTLResourceOptions options = MTLResourceStorageModeShared
-        | MTLResourceCPUCacheModeWriteCombined;
-    return [device newBufferWithLength:STREAM_RING_BUF_SIZE options:options];
-}
-
-static u32 RoundUp(u32 numToRound, u32 multiple)
-{
-    ASSERT(multiple != 0);
-    return ((numToRound + multiple - 1) / multiple) * multiple;
-}
-
 // -----------------------------------------------------------------------------
 // GpuDeviceMetal implementation
 // -----------------------------------------------------------------------------
@@ -483,20 +597,24 @@ GpuDeviceMetal::GpuDeviceMetal(const GpuDeviceFormat& format, void* osViewHandle
     , m_view((NSView*)osViewHandle)
     , m_viewSize([m_view bounds].size)
     , m_frameNumber(0)
-    , m_doubleBufferIndex(0)
+    , m_frameSlot(0)
 
     , m_device(nil)
     , m_commandQueue(nil)
 
     , m_depthBufs()
     , m_commandBuffer(nil)
-    , m_prevCommandBuffer(nil)
 
     , m_currentDrawable(nil)
 
-    , m_streamRingBufs()
-    , m_streamBufCursor(0)
-    , m_streamBufIndex()
+    , m_memoryTracker()
+    , m_uploadHeap(UPLOAD_HEAP_PAGE_SIZE, &CreateUploadPage, &DestroyUploadPage, this)
+    , m_stateObjectCache()
+
+    , m_pipelineCompiler(PIPELINE_COMPILER_THREADS,
+                         &GpuDeviceMetal::CompilePipelineState,
+                         NULL)
+    , m_compilingPipelineStates()
 
     , m_permutations()
     , m_shaderProgramTable()
@@ -505,6 +623,20 @@ GpuDeviceMetal::GpuDeviceMetal(const GpuDeviceFormat& format, void* osViewHandle
     , m_renderPassTable()
     , m_inputLayoutTable()
 
+    , m_stateCache()
+    , m_stateFilterStats(m_stateCache.GetStats())
+    , m_drawStats(m_stateCache.GetDrawStats())
+    , m_frameCounters()
+    , m_traceWriter()
+    , m_framePacer()
+    , m_deferredDestroyQueue()
+    , m_timestampSampleBuffer(nil)
+    , m_calibrationCpuTime(0)
+    , m_calibrationGpuTime(0)
+    , m_gpuTimestampToNs(1.0)
+    , m_timerQueries()
+    , m_drawChunks()
+
     , m_dbg_shaderCount(0)
     , m_dbg_bufferCount(0)
     , m_dbg_textureCount(0)
@@ -513,7 +645,8 @@ GpuDeviceMetal::GpuDeviceMetal(const GpuDeviceFormat& format, void* osViewHandle
     , m_dbg_renderPassCount(0)
     , m_dbg_inputLayoutCount(0)
 {
-    m_depthBufs[0] = m_depthBufs[1] = nil;
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i)
+        m_depthBufs[i] = nil;
 
     if (![[m_view layer] isKindOfClass:[CAMetalLayer class]])
         FATAL("GpuDeviceMetal: View needs to have a CAMetalLayer");
@@ -525,26 +658,24 @@ GpuDeviceMetal::GpuDeviceMetal(const GpuDeviceFormat& format, void* osViewHandle
     CreateOrDestroyDepthBuffers();
 
     m_commandQueue = [m_device newCommandQueue];
+    CreateTimestampSampleBuffer();
 
     m_commandBuffer = [[m_commandQueue commandBuffer] retain];
-
-    // Initialize with two ring buffers for streaming,
-    // i.e. one for each in-flight frame.
-    m_streamRingBufs.push_back(CreateStreamRingBuffer(m_device));
-    m_streamRingBufs.push_back(CreateStreamRingBuffer(m_device));
 }
 
 GpuDeviceMetal::~GpuDeviceMetal()
 {
-    for (size_t i = 0; i < m_streamRingBufs.size(); ++i) {
-        [m_streamRingBufs[i] release];
-    }
+    // The completion handlers of the frames in flight refer to the frame
+    // pacer, and the GPU may still be using the resources.
+    m_framePacer.WaitForFrame(m_framePacer.GetSubmittedFrame());
+
+    CancelPipelineCompiles();
 
     [m_commandBuffer release];
-    [m_prevCommandBuffer release];
+    [m_timestampSampleBuffer release];
 
-    [m_depthBufs[0] release];
-    [m_depthBufs[1] release];
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i)
+        [m_depthBufs[i] release];
 
     [m_commandQueue release];
     [m_device release];
@@ -589,9 +720,10 @@ GpuDeviceMetal::~GpuDeviceMetal()
 void GpuDeviceMetal::CreateOrDestroyDepthBuffers()
 {
     // Release the current depth buffers.
-    [m_depthBufs[0] release];
-    [m_depthBufs[1] release];
-    m_depthBufs[0] = m_depthBufs[1] = nil;
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+        [m_depthBufs[i] release];
+        m_depthBufs[i] = nil;
+    }
 
     // If the client didn't request a depth buffer, then we are done.
     if (m_deviceFormat.pixelDepthFormat == GPU_PIXEL_DEPTH_FORMAT_NONE)
@@ -607,8 +739,8 @@ void GpuDeviceMetal::CreateOrDestroyDepthBuffers()
     desc.storageMode = MTLStorageModePrivate;
     desc.usage |= MTLTextureUsageRenderTarget;
 
-    m_depthBufs[0] = [m_device newTextureWithDescriptor:desc];
-    m_depthBufs[1] = [m_device newTextureWithDescriptor:desc];
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i)
+        m_depthBufs[i] = [m_device newTextureWithDescriptor:desc];
 }
 
 CAMetalLayer* GpuDeviceMetal::GetCAMetalLayer() const
@@ -616,6 +748,24 @@ CAMetalLayer* GpuDeviceMetal::GetCAMetalLayer() const
     return (CAMetalLayer*)[m_view layer];
 }
 
+void* GpuDeviceMetal::CreateUploadPage(u32 size, void** cpuAddress, void* userdata)
+{
+    GpuDeviceMetal* device = (GpuDeviceMetal*)userdata;
+    MTLResourceOptions options = MTLResourceStorageModeShared
+        | MTLResourceCPUCacheModeWriteCombined;
+    id<MTLBuffer> page = [device->m_device newBufferWithLength:size options:options];
+    *cpuAddress = [page contents];
+    device->m_memoryTracker.Add(GPU_MEMORY_UPLOAD_HEAP, size);
+    return (void*)page;
+}
+
+void GpuDeviceMetal::DestroyUploadPage(void* page, u32 size, void* userdata)
+{
+    GpuDeviceMetal* device = (GpuDeviceMetal*)userdata;
+    device->m_memoryTracker.Remove(GPU_MEMORY_UPLOAD_HEAP, size);
+    [(id<MTLBuffer>)page release];
+}
+
 void GpuDeviceMetal::SetFormat(const GpuDeviceFormat& format)
 {
     m_deviceFormat = format;
@@ -666,6 +816,7 @@ GpuShaderProgramID GpuDeviceMetal::ShaderProgramCreate(const char* data, size_t
         m_permutations
     );
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_SHADER_PROGRAM);
     ++m_dbg_shaderCount;
 
     return shaderProgramID;
@@ -685,8 +836,10 @@ void GpuDeviceMetal::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
 
     m_permutations.ReleaseChain(program.idxFirstPermutation);
 
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_SHADER_PROGRAM, shaderProgramID);
     m_shaderProgramTable.Remove(shaderProgramID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_SHADER_PROGRAM);
     --m_dbg_shaderCount;
 }
 
@@ -730,52 +883,12 @@ static id<MTLBuffer> CreateStaticBuffer(id<MTLDevice> device,
     return result;
 }
 
-// TODO: it could be worth using MTLResourceStorageModeManaged instead
-// of the 'shared' mode in some cases for dynamic buffers.
-// Investigate in which situations this could be beneficial.
-static id<MTLBuffer> CreateDynamicBuffer(id<MTLDevice> device,
-                                         GpuBufferType type,
-                                         int maxUpdatesPerFrame,
-                                         const void* data, unsigned size)
-{
-    MTLResourceOptions options =
-        MTLResourceStorageModeShared | MTLResourceCPUCacheModeWriteCombined;
-
-    u32 roundedSize = RoundUp(size, s_bufferAlignments[type]);
-    u32 padding = roundedSize - size;
-
-    int numCopies = FRAMES_IN_FLIGHT * maxUpdatesPerFrame;
-    NSUInteger physicalLength = size + (numCopies - 1) * roundedSize;
-
-    id<MTLBuffer> buffer = [device newBufferWithLength:physicalLength
-                                               options:options];
-
-    if (data != NULL) {
-        u8* contents = (u8*)[buffer contents];
-        for (int i = 0; i < numCopies - 1; ++i) {
-            memcpy(contents, data, size);
-            memset(contents + size, 0, padding);
-            contents += roundedSize;
-        }
-        memcpy(contents, data, size);
-    }
-
-    return buffer;
-}
-
 GpuBufferID GpuDeviceMetal::BufferCreate(GpuBufferType type,
                                          GpuBufferAccessMode accessMode,
                                          const void* data,
                                          unsigned size,
                                          int maxUpdatesPerFrame)
 {
-    ASSERT((accessMode != GPU_BUFFER_ACCESS_STREAM ||
-           size <= STREAM_RING_BUF_SIZE)
-           && "Maximum size of stream-mode buffer exceeded");
-    ASSERT((accessMode != GPU_BUFFER_ACCESS_DYNAMIC ||
-            maxUpdatesPerFrame > 0)
-           && "Must have maxUpdatesPerFrame > 0 for dynamic-mode buffer");
-
     GpuBufferID bufferID(m_bufferTable.Add());
     Buffer& buffer = m_bufferTable.Lookup(bufferID);
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -785,7 +898,6 @@ GpuBufferID GpuDeviceMetal::BufferCreate(GpuBufferType type,
     buffer.type = type;
     buffer.accessMode = accessMode;
     buffer.buffer = nil;
-    buffer.maxUpdatesPerFrame = maxUpdatesPerFrame;
     buffer.size = size;
     buffer.bufOffset = 0;
 
@@ -793,18 +905,22 @@ GpuBufferID GpuDeviceMetal::BufferCreate(GpuBufferType type,
         case GPU_BUFFER_ACCESS_STATIC:
             buffer.buffer = CreateStaticBuffer(m_device, m_commandBuffer,
                                                data, size);
+            m_memoryTracker.Add(GPU_MEMORY_BUFFERS, size);
             break;
-        case GPU_BUFFER_ACCESS_DYNAMIC:
-            buffer.buffer = CreateDynamicBuffer(m_device, type,
-                                                maxUpdatesPerFrame, data, size);
+        case GPU_BUFFER_ACCESS_DYNAMIC: {
+            void* contents = UploadBufferAllocate(buffer);
+            if (data != NULL)
+                memcpy(contents, data, size);
             break;
+        }
         case GPU_BUFFER_ACCESS_STREAM:
-            break; // Don't need to do anything here.
+            break; // Allocated when the buffer is mapped.
         default:
             ASSERT(!"Unknown GpuBufferAccessMode");
             break;
     }
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_BUFFER);
     ++m_dbg_bufferCount;
 
     return bufferID;
@@ -831,106 +947,36 @@ void GpuDeviceMetal::BufferDestroy(GpuBufferID bufferID)
     }
 #endif
 
+    if (buffer.accessMode == GPU_BUFFER_ACCESS_STATIC)
+        m_memoryTracker.Remove(GPU_MEMORY_BUFFERS, buffer.size);
+    if (buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC)
+        m_uploadHeap.FreePersistent(buffer.allocation);
     [buffer.buffer release];
 
     m_bufferTable.Remove(bufferID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_BUFFER);
     --m_dbg_bufferCount;
 }
 
-void* GpuDeviceMetal::DynamicBufferMap(GpuBufferID bufferID)
-{
-    ASSERT(BufferExists(bufferID));
-    Buffer& buffer = m_bufferTable.Lookup(bufferID);
-    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC);
-
-    u32 roundedSize = RoundUp(buffer.size, s_bufferAlignments[buffer.type]);
-
-    int numCopies = FRAMES_IN_FLIGHT * buffer.maxUpdatesPerFrame;
-    u32 physicalLength = buffer.size + (numCopies - 1) * roundedSize;
-
-    buffer.bufOffset += roundedSize;
-    if (buffer.bufOffset >= physicalLength)
-        buffer.bufOffset = 0;
-
-    void* result = (u8*)[buffer.buffer contents] + buffer.bufOffset;
-    return result;
-}
-
-void GpuDeviceMetal::DynamicBufferUnmap(GpuBufferID bufferID)
-{
-    ASSERT(BufferExists(bufferID));
-    Buffer& buffer = m_bufferTable.Lookup(bufferID);
-    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC);
-
-    u32 roundedSize = RoundUp(buffer.size, s_bufferAlignments[buffer.type]);
-    u32 padding = roundedSize - buffer.size;
-
-    int numCopies = FRAMES_IN_FLIGHT * buffer.maxUpdatesPerFrame;
-    u32 physicalLength = buffer.size + (numCopies - 1) * roundedSize;
-
-    if (buffer.bufOffset + buffer.size < physicalLength) {
-        // Write data to the 'padding' region of the buffer (used for alignment).
-        // Writing the whole range of the buffer data may have performance
-        // benefits if write combining is used.
-        void* ptr = (u8*)[buffer.buffer contents] + buffer.bufOffset + buffer.size;
-        memset(ptr, 0, padding);
-    }
-}
-
-void* GpuDeviceMetal::StreamBufferMap(GpuBufferID bufferID)
+void* GpuDeviceMetal::UploadBufferAllocate(Buffer& buffer)
 {
-    ASSERT(BufferExists(bufferID));
-    Buffer& buffer = m_bufferTable.Lookup(bufferID);
-    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
-
-    // Check: we should always have an even number of ring buffers.
-    ASSERT(m_streamRingBufs.size() % 2 == 0);
-    int numRingBuffersPerFrame = (int)(m_streamRingBufs.size() / 2);
-
-    // Round up the size so that subsequent offsets are aligned to a multiple
-    // of the appropriate value.
-    u32 roundedSize = RoundUp(buffer.size, s_bufferAlignments[buffer.type]);
-
-    // Can the incoming batch fit in the current ring buffer?
-    if (m_streamBufCursor + roundedSize > STREAM_RING_BUF_SIZE) {
-        // Move to a new ring buffer and reset the cursor.
-        ++m_streamBufIndex;
-        m_streamBufCursor = 0;
-
-        if (m_streamBufIndex == numRingBuffersPerFrame) {
-            // Need to allocate a new ring buffer.
-            // Actually, we allocate two ring buffers, one for each in-flight
-            // frame.
-            m_streamRingBufs.insert(m_streamRingBufs.begin() + numRingBuffersPerFrame,
-                                    CreateStreamRingBuffer(m_device));
-            m_streamRingBufs.push_back(CreateStreamRingBuffer(m_device));
-
-            // Update the count.
-            ++numRingBuffersPerFrame;
-        }
+    void* contents;
+    if (buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC) {
+        contents = m_uploadHeap.AllocatePersistent(buffer.size,
+                                                   s_bufferAlignments[buffer.type],
+                                                   &buffer.allocation);
+    } else {
+        contents = m_uploadHeap.Allocate(buffer.size,
+                                         s_bufferAlignments[buffer.type],
+                                         &buffer.allocation);
     }
 
-    int ringBufArrayIndex = numRingBuffersPerFrame * m_doubleBufferIndex
-        + m_streamBufIndex;
-    id<MTLBuffer> ringBuf = m_streamRingBufs[ringBufArrayIndex];
-
-    void* result = (u8*)[ringBuf contents] + m_streamBufCursor;
-
     [buffer.buffer release];
-    buffer.buffer = [ringBuf retain];
-    buffer.bufOffset = m_streamBufCursor;
-    m_streamBufCursor += roundedSize;
-
-    return result;
-}
+    buffer.buffer = [(id<MTLBuffer>)m_uploadHeap.GetPage(buffer.allocation) retain];
+    buffer.bufOffset = buffer.allocation.offset;
 
-void GpuDeviceMetal::StreamBufferUnmap(GpuBufferID bufferID)
-{
-    ASSERT(BufferExists(bufferID));
-    Buffer& buffer = m_bufferTable.Lookup(bufferID);
-    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
-    // We don't actually need to do anything here.
+    return contents;
 }
 
 void* GpuDeviceMetal::BufferMap(GpuBufferID bufferID)
@@ -939,11 +985,13 @@ void* GpuDeviceMetal::BufferMap(GpuBufferID bufferID)
     Buffer& buffer = m_bufferTable.Lookup(bufferID);
     ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC ||
            buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
+
+    // Draw items encoded earlier in the frame keep reading the previous
+    // allocation.
     if (buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC)
-        return DynamicBufferMap(bufferID);
-    else if (buffer.accessMode == GPU_BUFFER_ACCESS_STREAM)
-        return StreamBufferMap(bufferID);
-    return NULL;
+        m_uploadHeap.FreePersistent(buffer.allocation);
+    m_frameCounters.CountBufferMap(buffer.size);
+    return UploadBufferAllocate(buffer);
 }
 
 void GpuDeviceMetal::BufferUnmap(GpuBufferID bufferID)
@@ -952,10 +1000,37 @@ void GpuDeviceMetal::BufferUnmap(GpuBufferID bufferID)
     Buffer& buffer = m_bufferTable.Lookup(bufferID);
     ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC ||
            buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
-    if (buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC)
-        DynamicBufferUnmap(bufferID);
-    else if (buffer.accessMode == GPU_BUFFER_ACCESS_STREAM)
-        StreamBufferUnmap(bufferID);
+    // We don't actually need to do anything here.
+}
+
+void GpuDeviceMetal::BufferUpload(GpuBufferID bufferID,
+                                  unsigned offset,
+                                  const void* data,
+                                  unsigned size)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STATIC);
+    ASSERT((u64)offset + size <= buffer.size);
+    // Blits between buffers must be 4-byte aligned on macOS.
+    ASSERT((offset % 4) == 0 && (size % 4) == 0);
+
+    if (size == 0)
+        return;
+
+    // Stage the data in the upload heap. It's a per-frame allocation, so it
+    // is recycled once the current frame has completed.
+    GpuUploadAllocation staging;
+    void* contents = m_uploadHeap.Allocate(size, 4, &staging);
+    memcpy(contents, data, size);
+
+    id<MTLBlitCommandEncoder> encoder = [m_commandBuffer blitCommandEncoder];
+    [encoder copyFromBuffer:(id<MTLBuffer>)m_uploadHeap.GetPage(staging)
+               sourceOffset:staging.offset
+                   toBuffer:buffer.buffer
+          destinationOffset:offset
+                       size:size];
+    [encoder endEncoding];
 }
 
 bool GpuDeviceMetal::TextureExists(GpuTextureID textureID) const
@@ -1007,7 +1082,15 @@ GpuTextureID GpuDeviceMetal::TextureCreate(GpuTextureType type,
     }
 
     tex.texture = [m_device newTextureWithDescriptor:desc];
+    tex.size = GpuDevice::TextureSizeInBytes(type, pixelFormat, width, height,
+                                             depthOrArrayLength, nMipmapLevels);
+    tex.memoryCategory = (flags & GPU_TEXTURE_FLAG_RENDER_TARGET)
+        ? GPU_MEMORY_RENDER_TARGETS : GPU_MEMORY_TEXTURES;
+    tex.pixelFormat = pixelFormat;
+
+    m_memoryTracker.Add(tex.memoryCategory, tex.size);
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_TEXTURE);
     ++m_dbg_textureCount;
 
     return textureID;
@@ -1027,12 +1110,17 @@ void GpuDeviceMetal::TextureDestroy(GpuTextureID textureID)
 
     [tex.texture release];
 
+    m_memoryTracker.Remove(tex.memoryCategory, tex.size);
+
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_TEXTURE, textureID);
     m_textureTable.Remove(textureID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_TEXTURE);
     --m_dbg_textureCount;
 }
 
 void GpuDeviceMetal::TextureUpload(GpuTextureID textureID,
+                                   int slice,
                                    const GpuRegion& region,
                                    int mipmapLevel,
                                    int stride,
@@ -1040,19 +1128,26 @@ void GpuDeviceMetal::TextureUpload(GpuTextureID textureID,
 {
     ASSERT(TextureExists(textureID));
     Texture& tex = m_textureTable.Lookup(textureID);
+    ASSERT(slice >= 0);
+
+    // The slices of a 3D texture are addressed by depth rather than by slice.
+    bool is3D = [tex.texture textureType] == MTLTextureType3D;
 
     MTLRegion mtlRegion;
     mtlRegion.origin.x = region.x;
     mtlRegion.origin.y = region.y;
-    mtlRegion.origin.z = 0;
+    mtlRegion.origin.z = is3D ? slice : 0;
     mtlRegion.size.width = region.width;
     mtlRegion.size.height = region.height;
     mtlRegion.size.depth = 1;
 
     [tex.texture replaceRegion:mtlRegion
                    mipmapLevel:mipmapLevel
+                         slice:is3D ? 0 : slice
                      withBytes:bytes
-                   bytesPerRow:stride];
+                   bytesPerRow:stride
+                 bytesPerImage:0];
+    m_frameCounters.CountTextureUpload(tex.pixelFormat, region);
 }
 
 bool GpuDeviceMetal::SamplerExists(GpuSamplerID samplerID) const
@@ -1064,6 +1159,10 @@ GpuSamplerID GpuDeviceMetal::SamplerCreate(const GpuSamplerDesc& desc)
 {
     ASSERT(1 <= desc.maxAnisotropy && desc.maxAnisotropy <= 16);
 
+    GpuStateObjectKey key(desc);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuSamplerID(existingID);
+
     GpuSamplerID samplerID(m_samplerTable.Add());
     Sampler& sampler = m_samplerTable.Lookup(samplerID);
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -1085,14 +1184,20 @@ GpuSamplerID GpuDeviceMetal::SamplerCreate(const GpuSamplerDesc& desc)
 
     sampler.samplerState = [m_device newSamplerStateWithDescriptor:mtlDesc];
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_SAMPLER);
     ++m_dbg_samplerCount;
 
+    m_stateObjectCache.Insert(key, samplerID);
+
     return samplerID;
 }
 
 void GpuDeviceMetal::SamplerDestroy(GpuSamplerID samplerID)
 {
     ASSERT(SamplerExists(samplerID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_SAMPLER, samplerID))
+        return;
+
     Sampler& sampler = m_samplerTable.Lookup(samplerID);
 
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -1106,6 +1211,7 @@ void GpuDeviceMetal::SamplerDestroy(GpuSamplerID samplerID)
 
     m_samplerTable.Remove(samplerID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_SAMPLER);
     --m_dbg_samplerCount;
 }
 
@@ -1119,6 +1225,10 @@ GpuInputLayoutID GpuDeviceMetal::InputLayoutCreate(int nVertexAttribs,
                                                    int nVertexBuffers,
                                                    const unsigned* strides)
 {
+    GpuStateObjectKey key(nVertexAttribs, attribs, nVertexBuffers, strides);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuInputLayoutID(existingID);
+
     GpuInputLayoutID inputLayoutID(m_inputLayoutTable.Add());
     InputLayout& layout = m_inputLayoutTable.Lookup(inputLayoutID);
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -1145,14 +1255,20 @@ GpuInputLayoutID GpuDeviceMetal::InputLayoutCreate(int nVertexAttribs,
                           atIndexedSubscript:(GPU_MAX_CBUFFERS + i)];
     }
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_INPUT_LAYOUT);
     ++m_dbg_inputLayoutCount;
 
+    m_stateObjectCache.Insert(key, inputLayoutID);
+
     return inputLayoutID;
 }
 
 void GpuDeviceMetal::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
 {
     ASSERT(InputLayoutExists(inputLayoutID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_INPUT_LAYOUT, inputLayoutID))
+        return;
+
     InputLayout& layout = m_inputLayoutTable.Lookup(inputLayoutID);
 
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -1163,8 +1279,10 @@ void GpuDeviceMetal::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
     [layout.descriptor release];
 #endif
 
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_INPUT_LAYOUT, inputLayoutID);
     m_inputLayoutTable.Remove(inputLayoutID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_INPUT_LAYOUT);
     --m_dbg_inputLayoutCount;
 }
 
@@ -1174,10 +1292,31 @@ bool GpuDeviceMetal::PipelineStateExists(GpuPipelineStateID pipelineStateID) con
 }
 
 GpuPipelineStateID GpuDeviceMetal::PipelineStateCreate(const GpuPipelineStateDesc& state)
+{
+    return CreatePipelineStateObj(state, false, GpuPipelineStateID(0));
+}
+
+GpuPipelineStateID GpuDeviceMetal::PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                            GpuPipelineStateID fallback)
+{
+    return CreatePipelineStateObj(state, true, fallback);
+}
+
+GpuPipelineStateID GpuDeviceMetal::CreatePipelineStateObj(const GpuPipelineStateDesc& state,
+                                                          bool async,
+                                                          GpuPipelineStateID fallback)
 {
     ASSERT(ShaderProgramExists(state.shaderProgram));
     ASSERT(InputLayoutExists(state.inputLayout));
 
+    GpuStateObjectKey key(state);
+    if (u32 existingID = m_stateObjectCache.Acquire(key)) {
+        PipelineStateObj& existing = m_pipelineStateTable.Lookup(existingID);
+        if (!async && existing.compileJob)
+            FinishPipelineCompile(existing);
+        return GpuPipelineStateID(existingID);
+    }
+
     GpuPipelineStateID pipelineStateID(m_pipelineStateTable.Add());
     PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -1188,18 +1327,39 @@ GpuPipelineStateID GpuDeviceMetal::PipelineStateCreate(const GpuPipelineStateDes
     ++m_inputLayoutTable.Lookup(state.inputLayout).dbg_refCount;
 #endif
 
-    obj.state = CreateMTLRenderPipelineState(state);
+    // The descriptor refers to the shader program and input layout, so it's
+    // built here. Only the compilation of the shaders runs on a worker thread.
+    MTLRenderPipelineDescriptor* desc = CreateMTLRenderPipelineDescriptor(state);
+    obj.state = nil;
+    obj.compileJob = NULL;
+    obj.fallback = fallback;
+    if (async) {
+        obj.compileJob = new PipelineCompileJob;
+        obj.compileJob->device = m_device;
+        obj.compileJob->descriptor = [desc retain];
+        obj.compileJob->state = nil;
+        m_pipelineCompiler.Enqueue(obj.compileJob);
+        m_compilingPipelineStates.push_back(pipelineStateID);
+    } else {
+        obj.state = CompileMTLRenderPipelineState(m_device, desc);
+    }
+
     obj.depthStencilState = CreateMTLDepthStencilState(state);
     obj.triangleFillMode = s_metalFillModes[state.fillMode];
     obj.cullMode = s_metalCullModes[state.cullMode];
     obj.frontFaceWinding = s_metalWindingOrders[state.frontFaceWinding];
+    obj.depthStencilKey = GpuStateCache::DepthStencilKey(state);
+    obj.rasterStateKey = GpuStateCache::RasterStateKey(state);
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_PIPELINE_STATE);
     ++m_dbg_psoCount;
 
+    m_stateObjectCache.Insert(key, pipelineStateID);
+
     return pipelineStateID;
 }
 
-id<MTLRenderPipelineState> GpuDeviceMetal::CreateMTLRenderPipelineState(const GpuPipelineStateDesc& state)
+MTLRenderPipelineDescriptor* GpuDeviceMetal::CreateMTLRenderPipelineDescriptor(const GpuPipelineStateDesc& state)
 {
     ShaderProgram& shaderProgram = m_shaderProgramTable.Lookup(state.shaderProgram);
     u32 idxPermutation = m_permutations.FindPermutationForStates(
@@ -1233,9 +1393,15 @@ id<MTLRenderPipelineState> GpuDeviceMetal::CreateMTLRenderPipelineState(const Gp
 
     desc.depthAttachmentPixelFormat = s_metalDepthPixelFormats[m_deviceFormat.pixelDepthFormat];
 
+    return desc;
+}
+
+id<MTLRenderPipelineState> GpuDeviceMetal::CompileMTLRenderPipelineState(id<MTLDevice> device,
+                                                                         MTLRenderPipelineDescriptor* desc)
+{
     NSError* error;
     id<MTLRenderPipelineState> result;
-    result = [m_device newRenderPipelineStateWithDescriptor:desc error:&error];
+    result = [device newRenderPipelineStateWithDescriptor:desc error:&error];
     if (error) {
         FATAL("GpuDeviceMetal: Failed to create pipeline object: %s",
               error.localizedDescription.UTF8String);
@@ -1252,9 +1418,95 @@ id<MTLDepthStencilState> GpuDeviceMetal::CreateMTLDepthStencilState(const GpuPip
     return [m_device newDepthStencilStateWithDescriptor:desc];
 }
 
+void GpuDeviceMetal::CompilePipelineState(void* job, void* userdata)
+{
+    PipelineCompileJob* compileJob = (PipelineCompileJob*)job;
+    @autoreleasepool {
+        compileJob->state = CompileMTLRenderPipelineState(compileJob->device,
+                                                          compileJob->descriptor);
+    }
+}
+
+void GpuDeviceMetal::FinishPipelineCompile(PipelineStateObj& obj)
+{
+    m_pipelineCompiler.Finish(obj.compileJob);
+    obj.state = obj.compileJob->state;
+    [obj.compileJob->descriptor release];
+    delete obj.compileJob;
+    obj.compileJob = NULL;
+}
+
+void GpuDeviceMetal::CancelPipelineCompile(PipelineStateObj& obj)
+{
+    m_pipelineCompiler.Cancel(obj.compileJob);
+    [obj.compileJob->state release];
+    [obj.compileJob->descriptor release];
+    delete obj.compileJob;
+    obj.compileJob = NULL;
+}
+
+void GpuDeviceMetal::UpdatePipelineCompiles()
+{
+    size_t nRemaining = 0;
+    for (size_t i = 0; i < m_compilingPipelineStates.size(); ++i) {
+        GpuPipelineStateID pipelineStateID = m_compilingPipelineStates[i];
+        if (!m_pipelineStateTable.Has(pipelineStateID))
+            continue;
+        PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
+        if (!obj.compileJob)
+            continue;
+        if (m_pipelineCompiler.IsDone(obj.compileJob)) {
+            FinishPipelineCompile(obj);
+            continue;
+        }
+        m_compilingPipelineStates[nRemaining] = pipelineStateID;
+        ++nRemaining;
+    }
+    m_compilingPipelineStates.resize(nRemaining);
+}
+
+void GpuDeviceMetal::CancelPipelineCompiles()
+{
+    for (size_t i = 0; i < m_compilingPipelineStates.size(); ++i) {
+        GpuPipelineStateID pipelineStateID = m_compilingPipelineStates[i];
+        if (!m_pipelineStateTable.Has(pipelineStateID))
+            continue;
+        PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
+        if (obj.compileJob)
+            CancelPipelineCompile(obj);
+    }
+    m_compilingPipelineStates.clear();
+}
+
+bool GpuDeviceMetal::PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const
+{
+    ASSERT(PipelineStateExists(pipelineStateID));
+    // Compiled objects only become ready at the start of a frame, so that
+    // they're either ready or not for the whole frame.
+    return m_pipelineStateTable.Lookup(pipelineStateID).compileJob == NULL;
+}
+
+bool GpuDeviceMetal::ResolvePipelineState(u16* pipelineStateIdx,
+                                          GpuStateCache& stateCache) const
+{
+    const PipelineStateObj& obj = m_pipelineStateTable.LookupRaw(*pipelineStateIdx);
+    if (!obj.compileJob)
+        return true;
+
+    bool hasFallback = m_pipelineStateTable.Has(obj.fallback)
+        && !m_pipelineStateTable.Lookup(obj.fallback).compileJob;
+    stateCache.CountPendingDrawItem(!hasFallback);
+    if (hasFallback)
+        *pipelineStateIdx = (u16)(obj.fallback & 0xFFFF);
+    return hasFallback;
+}
+
 void GpuDeviceMetal::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
 {
     ASSERT(PipelineStateExists(pipelineStateID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_PIPELINE_STATE, pipelineStateID))
+        return;
+
     PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
 
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -1266,10 +1518,13 @@ void GpuDeviceMetal::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
     --m_inputLayoutTable.Lookup(obj.dbg_inputLayout).dbg_refCount;
 #endif
 
+    if (obj.compileJob)
+        CancelPipelineCompile(obj);
     [obj.state release];
     [obj.depthStencilState release];
     m_pipelineStateTable.Remove(pipelineStateID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_PIPELINE_STATE);
     --m_dbg_psoCount;
 }
 
@@ -1310,6 +1565,10 @@ GpuRenderPassID GpuDeviceMetal::RenderPassCreate(const GpuRenderPassDesc& pass)
 {
     ASSERT(pass.numRenderTargets >= 0);
 
+    GpuStateObjectKey key(pass);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuRenderPassID(existingID);
+
     GpuRenderPassID renderPassID(m_renderPassTable.Add());
     RenderPassObj& obj = m_renderPassTable.Lookup(renderPassID);
     obj.usesRenderTarget = false;
@@ -1359,18 +1618,25 @@ GpuRenderPassID GpuDeviceMetal::RenderPassCreate(const GpuRenderPassDesc& pass)
 
     obj.descriptor.depthAttachment = depthDesc;
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_RENDER_PASS);
     ++m_dbg_renderPassCount;
 
+    m_stateObjectCache.Insert(key, renderPassID);
+
     return renderPassID;
 }
 
 void GpuDeviceMetal::RenderPassDestroy(GpuRenderPassID renderPassID)
 {
     ASSERT(RenderPassExists(renderPassID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_RENDER_PASS, renderPassID))
+        return;
+
     RenderPassObj& obj = m_renderPassTable.Lookup(renderPassID);
     [obj.descriptor release];
     m_renderPassTable.Remove(renderPassID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_RENDER_PASS);
     --m_dbg_renderPassCount;
 }
 
@@ -1386,8 +1652,7 @@ static MTLViewport GetMTLViewport(const GpuViewport& viewport)
     return res;
 }
 
-id<MTLRenderCommandEncoder> GpuDeviceMetal::PreDraw(GpuRenderPassID passID,
-                                                    const GpuViewport& viewport)
+MTLRenderPassDescriptor* GpuDeviceMetal::PrepareRenderPass(GpuRenderPassID passID)
 {
     RenderPassObj& pass = m_renderPassTable.Lookup(passID);
 
@@ -1399,14 +1664,22 @@ id<MTLRenderCommandEncoder> GpuDeviceMetal::PreDraw(GpuRenderPassID passID,
         ASSERT(colorDesc.texture.width == m_deviceFormat.resolutionX);
         ASSERT(colorDesc.texture.height == m_deviceFormat.resolutionY);
 
-        id<MTLTexture> depthBuf = m_depthBufs[m_doubleBufferIndex];
+        id<MTLTexture> depthBuf = m_depthBufs[m_frameSlot];
         pass.descriptor.depthAttachment.texture = depthBuf;
         ASSERT(depthBuf.width == m_deviceFormat.resolutionX);
         ASSERT(depthBuf.height == m_deviceFormat.resolutionY);
     }
 
+    return pass.descriptor;
+}
+
+id<MTLRenderCommandEncoder> GpuDeviceMetal::PreDraw(GpuRenderPassID passID,
+                                                    const GpuViewport& viewport)
+{
+    MTLRenderPassDescriptor* descriptor = PrepareRenderPass(passID);
+
     id<MTLRenderCommandEncoder> encoder;
-    encoder = [m_commandBuffer renderCommandEncoderWithDescriptor:pass.descriptor];
+    encoder = [m_commandBuffer renderCommandEncoderWithDescriptor:descriptor];
     [encoder setViewport:GetMTLViewport(viewport)];
     return encoder;
 }
@@ -1416,28 +1689,31 @@ void GpuDeviceMetal::PostDraw(id<MTLRenderCommandEncoder> encoder)
     [encoder endEncoding];
 }
 
-void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
-                          int nItems,
-                          GpuRenderPassID renderPass,
-                          const GpuViewport& viewport)
+void GpuDeviceMetal::EncodeDrawItems(id<MTLRenderCommandEncoder> encoder,
+                                     const GpuDrawItem* const* items,
+                                     int nItems,
+                                     GpuStateCache& stateCache)
 {
-    ASSERT(items != NULL);
-    ASSERT(RenderPassExists(renderPass));
-
-    id<MTLRenderCommandEncoder> encoder = PreDraw(renderPass, viewport);
-
     for (int drawItemIndex = 0; drawItemIndex < nItems; ++drawItemIndex) {
         const GpuDrawItem* item = items[drawItemIndex];
         ASSERT(item != NULL);
 
         // Set the pipeline state
+        u16 pipelineStateIdx = item->pipelineStateIdx;
+        if (!ResolvePipelineState(&pipelineStateIdx, stateCache))
+            continue;
+
         PipelineStateObj& pipelineState
-            = m_pipelineStateTable.LookupRaw(item->pipelineStateIdx);
-        [encoder setRenderPipelineState:pipelineState.state];
-        [encoder setDepthStencilState:pipelineState.depthStencilState];
-        [encoder setTriangleFillMode:pipelineState.triangleFillMode];
-        [encoder setCullMode:pipelineState.cullMode];
-        [encoder setFrontFacingWinding:pipelineState.frontFaceWinding];
+            = m_pipelineStateTable.LookupRaw(pipelineStateIdx);
+        if (stateCache.SetPipelineState(pipelineStateIdx))
+            [encoder setRenderPipelineState:pipelineState.state];
+        if (stateCache.SetDepthStencilState(pipelineState.depthStencilKey))
+            [encoder setDepthStencilState:pipelineState.depthStencilState];
+        if (stateCache.SetRasterState(pipelineState.rasterStateKey)) {
+            [encoder setTriangleFillMode:pipelineState.triangleFillMode];
+            [encoder setCullMode:pipelineState.cullMode];
+            [encoder setFrontFacingWinding:pipelineState.frontFaceWinding];
+        }
 
         // Set vertex buffers
         const u32* vertexBufferOffsets = item->VertexBufferOffsets();
@@ -1445,6 +1721,8 @@ void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
         for (int i = 0; i < item->nVertexBuffers; ++i) {
             Buffer& buf = m_bufferTable.LookupRaw(vertexBuffers[i]);
             u32 totalOffset = vertexBufferOffsets[i] + buf.bufOffset;
+            if (!stateCache.SetVertexBuffer(i, vertexBuffers[i], totalOffset))
+                continue;
             [encoder setVertexBuffer:buf.buffer
                               offset:totalOffset
                              atIndex:(GPU_MAX_CBUFFERS + i)];
@@ -1454,6 +1732,8 @@ void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
         const u16* cbuffers = item->CBuffers();
         for (int i = 0; i < item->nCBuffers; ++i) {
             Buffer& buf = m_bufferTable.LookupRaw(cbuffers[i]);
+            if (!stateCache.SetCBuffer(i, cbuffers[i], buf.bufOffset))
+                continue;
             [encoder setVertexBuffer:buf.buffer
                               offset:buf.bufOffset
                              atIndex:i];
@@ -1462,9 +1742,27 @@ void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
                                atIndex:i];
         }
 
+        // Set the instance buffer
+        if (item->HasInstanceBuffer()) {
+            Buffer& buf = m_bufferTable.LookupRaw(item->instanceBufferIdx);
+            u32 totalOffset = item->instanceBufferOffset + buf.bufOffset;
+            if (stateCache.SetCBuffer(GPU_INSTANCE_BUFFER_SLOT,
+                                      item->instanceBufferIdx,
+                                      totalOffset)) {
+                [encoder setVertexBuffer:buf.buffer
+                                  offset:totalOffset
+                                 atIndex:GPU_INSTANCE_BUFFER_SLOT];
+                [encoder setFragmentBuffer:buf.buffer
+                                    offset:totalOffset
+                                   atIndex:GPU_INSTANCE_BUFFER_SLOT];
+            }
+        }
+
         // Set textures
         const u16* textures = item->Textures();
         for (int i = 0; i < item->nTextures; ++i) {
+            if (!stateCache.SetTexture(i, textures[i]))
+                continue;
             id<MTLTexture> tex = m_textureTable.LookupRaw(textures[i]).texture;
             [encoder setVertexTexture:tex atIndex:i];
             [encoder setFragmentTexture:tex atIndex:i];
@@ -1473,6 +1771,8 @@ void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
         // Set samplers
         const u16* samplers = item->Samplers();
         for (int i = 0; i < item->nSamplers; ++i) {
+            if (!stateCache.SetSampler(i, samplers[i]))
+                continue;
             id<MTLSamplerState> sampler = m_samplerTable.LookupRaw(samplers[i]).samplerState;
             [encoder setVertexSamplerState:sampler atIndex:i];
             [encoder setFragmentSamplerState:sampler atIndex:i];
@@ -1480,7 +1780,22 @@ void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
 
         // Submit the draw call
         MTLPrimitiveType primType = s_metalPrimitiveTypes[item->GetPrimitiveType()];
-        if (item->IsIndexed()) {
+        if (item->IsIndirect()) {
+            GpuIndexType gpuIndexType = item->GetIndexType();
+            id<MTLBuffer> indexBuf = m_bufferTable.LookupRaw(item->indexBufferIdx).buffer;
+            Buffer& argsBuf = m_bufferTable.LookupRaw(item->drawArgsBufferIdx);
+            NSUInteger argsOffset = argsBuf.bufOffset + item->first;
+            for (u32 i = 0; i < item->count; ++i) {
+                [encoder drawIndexedPrimitives:primType
+                                     indexType:s_metalIndexTypes[gpuIndexType]
+                                   indexBuffer:indexBuf
+                             indexBufferOffset:item->indexBufferOffset
+                                indirectBuffer:argsBuf.buffer
+                          indirectBufferOffset:argsOffset];
+                argsOffset += sizeof(GpuDrawArgs);
+            }
+            stateCache.CountDrawItem(true, item->count);
+        } else if (item->IsIndexed()) {
             GpuIndexType gpuIndexType = item->GetIndexType();
             id<MTLBuffer> indexBuf = m_bufferTable.LookupRaw(item->indexBufferIdx).buffer;
             NSUInteger indexBufOffset = item->indexBufferOffset;
@@ -1489,48 +1804,305 @@ void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
                                 indexCount:item->count
                                  indexType:s_metalIndexTypes[gpuIndexType]
                                indexBuffer:indexBuf
-                         indexBufferOffset:indexBufOffset];
+                         indexBufferOffset:indexBufOffset
+                             instanceCount:item->instanceCount
+                                baseVertex:item->baseVertex
+                              baseInstance:0];
+            stateCache.CountDrawItem(false, 1);
+            stateCache.CountPrimitives(true, item->GetPrimitiveType(),
+                                       item->count, item->instanceCount);
         } else {
             [encoder drawPrimitives:primType
                         vertexStart:item->first
-                        vertexCount:item->count];
+                        vertexCount:item->count
+                      instanceCount:item->instanceCount];
+            stateCache.CountDrawItem(false, 1);
+            stateCache.CountPrimitives(false, item->GetPrimitiveType(),
+                                       item->count, item->instanceCount);
         }
     }
+}
+
+void GpuDeviceMetal::EncodeDrawChunk(int index, void* userdata)
+{
+    @autoreleasepool {
+        DrawChunk& chunk = ((DrawChunk*)userdata)[index];
+        chunk.device->EncodeDrawItems(chunk.encoder,
+                                      chunk.items,
+                                      chunk.nItems,
+                                      chunk.stateCache);
+        [chunk.encoder endEncoding];
+    }
+}
+
+void GpuDeviceMetal::Draw(const GpuDrawItem* const* items,
+                          int nItems,
+                          GpuRenderPassID renderPass,
+                          const GpuViewport& viewport)
+{
+    ASSERT(items != NULL);
+    ASSERT(RenderPassExists(renderPass));
+
+    id<MTLRenderCommandEncoder> encoder = PreDraw(renderPass, viewport);
+
+    // Nothing is bound on a freshly created encoder.
+    m_stateCache.Reset();
+
+    EncodeDrawItems(encoder, items, nItems, m_stateCache);
 
     PostDraw(encoder);
 }
 
+void GpuDeviceMetal::DrawParallel(const GpuDrawItem* const* items,
+                                  int nItems,
+                                  GpuRenderPassID renderPass,
+                                  const GpuViewport& viewport,
+                                  TaskPool& taskPool)
+{
+    int nChunks = GpuDrawChunks::Count(nItems, taskPool.GetNumThreads());
+    if (nChunks == 1) {
+        Draw(items, nItems, renderPass, viewport);
+        return;
+    }
+
+    ASSERT(items != NULL);
+    ASSERT(RenderPassExists(renderPass));
+
+    MTLRenderPassDescriptor* descriptor = PrepareRenderPass(renderPass);
+    id<MTLParallelRenderCommandEncoder> parallelEncoder;
+    parallelEncoder = [m_commandBuffer parallelRenderCommandEncoderWithDescriptor:descriptor];
+
+    // The sub-encoders execute on the GPU in the order in which they were
+    // created, so create them all up front on this thread.
+    MTLViewport mtlViewport = GetMTLViewport(viewport);
+    m_drawChunks.resize(nChunks);
+    for (int i = 0; i < nChunks; ++i) {
+        int first, count;
+        GpuDrawChunks::Range(i, nChunks, nItems, &first, &count);
+
+        DrawChunk& chunk = m_drawChunks[i];
+        chunk.device = this;
+        chunk.encoder = [parallelEncoder renderCommandEncoder];
+        chunk.items = items + first;
+        chunk.nItems = count;
+        chunk.stateCache.Reset();
+        chunk.stateCache.ResetStats();
+        [chunk.encoder setViewport:mtlViewport];
+    }
+
+    taskPool.ParallelFor(nChunks, &GpuDeviceMetal::EncodeDrawChunk, &m_drawChunks[0]);
+
+    for (int i = 0; i < nChunks; ++i) {
+        m_stateCache.MergeStats(m_drawChunks[i].stateCache);
+        m_drawChunks[i].encoder = nil;
+    }
+
+    [parallelEncoder endEncoding];
+}
+
 void GpuDeviceMetal::SceneBegin()
 {
+    // Wait for the GPU to finish with the per-frame resources of the slot
+    // that this frame uses.
+    u64 frame = m_framePacer.BeginFrame();
+    m_uploadHeap.Reclaim(m_framePacer.GetCompletedFrame());
+    m_timerQueries.Resolve(m_framePacer.GetCompletedFrame());
+    UpdatePipelineCompiles();
+    CalibrateTimestamps();
+
     @autoreleasepool {
         [m_currentDrawable release];
         m_currentDrawable = [[GetCAMetalLayer() nextDrawable] retain];
         ASSERT(m_currentDrawable);
 
-        // Switch to the other frame buffer.
-        m_doubleBufferIndex ^= 1;
-
-        // Reset the stream buffer index.
-        m_streamBufIndex = 0;
-        m_streamBufCursor = 0;
+        // Switch to the frame's resources.
+        m_frameSlot = GpuFramePacer::FrameSlot(frame);
     }
 }
 
 void GpuDeviceMetal::ScenePresent()
 {
+    m_uploadHeap.EndFrame();
+    u64 frame = m_framePacer.Submit();
+    GpuFramePacer* framePacer = &m_framePacer;
+
+    // The frame's timestamps are resolved by the completion handler, before
+    // the frame is completed, so that they're ready when SceneBegin() calls
+    // GpuTimerQueries::Resolve().
+    id<MTLCounterSampleBuffer> sampleBuffer = m_timestampSampleBuffer;
+    u32 nTimestamps = sampleBuffer ? m_timerQueries.GetTimestampCount(frame) : 0;
+    u64* timestamps = nTimestamps ? m_timerQueries.GetTimestamps(frame) : NULL;
+    NSRange sampleRange = NSMakeRange(m_frameSlot * GpuTimerQueries::MAX_TIMESTAMPS_PER_FRAME,
+                                      nTimestamps);
+    double gpuTimestampToNs = m_gpuTimestampToNs;
+
+    [m_commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> commandBuffer) {
+        if (nTimestamps != 0) {
+            NSData* data = [sampleBuffer resolveCounterRange:sampleRange];
+            const MTLCounterResultTimestamp* results
+                = data ? (const MTLCounterResultTimestamp*)[data bytes] : NULL;
+            for (u32 i = 0; i < nTimestamps; ++i) {
+                if (!results || results[i].timestamp == MTLCounterErrorValue)
+                    timestamps[i] = 0;
+                else
+                    timestamps[i] = (u64)((double)results[i].timestamp * gpuTimestampToNs);
+            }
+        }
+        double gpuMs = (commandBuffer.GPUEndTime - commandBuffer.GPUStartTime) * 1000.0;
+        framePacer->Complete(frame, gpuMs);
+    }];
+
     [m_commandBuffer presentDrawable:m_currentDrawable];
     [m_commandBuffer commit];
-
-    [m_prevCommandBuffer waitUntilCompleted];
-    [m_prevCommandBuffer release];
-
-    m_prevCommandBuffer = m_commandBuffer;
+    [m_commandBuffer release];
 
     m_commandBuffer = [[m_commandQueue commandBuffer] retain];
 
+    m_stateFilterStats = m_stateCache.GetStats();
+    m_drawStats = m_stateCache.GetDrawStats();
+    m_stateCache.ResetStats();
+    m_frameCounters.EndFrame(m_stateFilterStats, m_drawStats, m_uploadHeap.GetStats());
+
     ++m_frameNumber;
 }
 
+void GpuDeviceMetal::CreateTimestampSampleBuffer()
+{
+    if (![m_device supportsCounterSampling:MTLCounterSamplingPointAtStageBoundary])
+        return;
+
+    id<MTLCounterSet> timestampSet = nil;
+    for (id<MTLCounterSet> counterSet in m_device.counterSets) {
+        if ([counterSet.name isEqualToString:MTLCommonCounterSetTimestamp]) {
+            timestampSet = counterSet;
+            break;
+        }
+    }
+    if (!timestampSet)
+        return;
+
+    MTLCounterSampleBufferDescriptor* desc = [[MTLCounterSampleBufferDescriptor alloc] init];
+    desc.counterSet = timestampSet;
+    desc.storageMode = MTLStorageModeShared;
+    desc.sampleCount = GPU_MAX_FRAMES_IN_FLIGHT * GpuTimerQueries::MAX_TIMESTAMPS_PER_FRAME;
+
+    NSError* error = nil;
+    m_timestampSampleBuffer = [m_device newCounterSampleBufferWithDescriptor:desc error:&error];
+    [desc release];
+
+    [m_device sampleTimestamps:&m_calibrationCpuTime gpuTimestamp:&m_calibrationGpuTime];
+}
+
+void GpuDeviceMetal::CalibrateTimestamps()
+{
+    if (!m_timestampSampleBuffer)
+        return;
+
+    // The CPU timestamps are in nanoseconds, but the GPU timestamps are in a
+    // device-specific unit, so measure the ratio between them since the last
+    // calibration.
+    MTLTimestamp cpuTime, gpuTime;
+    [m_device sampleTimestamps:&cpuTime gpuTimestamp:&gpuTime];
+    if (cpuTime > m_calibrationCpuTime && gpuTime > m_calibrationGpuTime) {
+        m_gpuTimestampToNs = (double)(cpuTime - m_calibrationCpuTime)
+                           / (double)(gpuTime - m_calibrationGpuTime);
+    }
+    m_calibrationCpuTime = cpuTime;
+    m_calibrationGpuTime = gpuTime;
+}
+
+GpuTimerQueries& GpuDeviceMetal::GetTimerQueries()
+{
+    return m_timerQueries;
+}
+
+const GpuTimerQueries& GpuDeviceMetal::GetTimerQueries() const
+{
+    return m_timerQueries;
+}
+
+void GpuDeviceMetal::TimerQueryMark(u32 timestamp)
+{
+    if (timestamp == GpuTimerQueries::NO_TIMESTAMP || !m_timestampSampleBuffer)
+        return;
+
+    // Sample the timestamp with an empty blit pass, which orders it between
+    // the passes encoded before and after it.
+    @autoreleasepool {
+        MTLBlitPassDescriptor* descriptor = [MTLBlitPassDescriptor blitPassDescriptor];
+        MTLBlitPassSampleBufferAttachmentDescriptor* attachment
+            = descriptor.sampleBufferAttachments[0];
+        attachment.sampleBuffer = m_timestampSampleBuffer;
+        attachment.startOfEncoderSampleIndex
+            = m_frameSlot * GpuTimerQueries::MAX_TIMESTAMPS_PER_FRAME + timestamp;
+        attachment.endOfEncoderSampleIndex = MTLCounterDontSample;
+
+        id<MTLBlitCommandEncoder> encoder
+            = [m_commandBuffer blitCommandEncoderWithDescriptor:descriptor];
+        [encoder endEncoding];
+    }
+}
+
+GpuFramePacer& GpuDeviceMetal::GetFramePacer()
+{
+    return m_framePacer;
+}
+
+const GpuFramePacer& GpuDeviceMetal::GetFramePacer() const
+{
+    return m_framePacer;
+}
+
+GpuMemoryTracker& GpuDeviceMetal::GetMemoryTracker()
+{
+    return m_memoryTracker;
+}
+
+const GpuMemoryTracker& GpuDeviceMetal::GetMemoryTracker() const
+{
+    return m_memoryTracker;
+}
+
+GpuDeferredDestroyQueue& GpuDeviceMetal::GetDeferredDestroyQueue()
+{
+    return m_deferredDestroyQueue;
+}
+
+const GpuStateFilterStats& GpuDeviceMetal::GetStateFilterStats() const
+{
+    return m_stateFilterStats;
+}
+
+const GpuDrawStats& GpuDeviceMetal::GetDrawStats() const
+{
+    return m_drawStats;
+}
+
+const GpuFrameStats& GpuDeviceMetal::GetFrameStats() const
+{
+    return m_frameCounters.GetStats();
+}
+
+const GpuUploadHeapStats& GpuDeviceMetal::GetUploadHeapStats() const
+{
+    return m_uploadHeap.GetStats();
+}
+
+const GpuStateObjectCacheStats& GpuDeviceMetal::GetStateObjectCacheStats() const
+{
+    return m_stateObjectCache.GetStats();
+}
+
+GpuTraceWriter& GpuDeviceMetal::GetTraceWriter()
+{
+    return m_traceWriter;
+}
+
+const GpuTraceWriter& GpuDeviceMetal::GetTraceWriter() const
+{
+    return m_traceWriter;
+}
+
 #ifdef GPUDEVICE_DEBUG_MODE
 void GpuDeviceMetal::DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increment)
 {
@@ -1539,6 +2111,12 @@ void GpuDeviceMetal::DrawItem_UpdateRefCounts(const GpuDrawItem* item, int incre
     if (item->IsIndexed())
         m_bufferTable.LookupRaw(item->indexBufferIdx).dbg_refCount += increment;
 
+    if (item->HasInstanceBuffer())
+        m_bufferTable.LookupRaw(item->instanceBufferIdx).dbg_refCount += increment;
+
+    if (item->IsIndirect())
+        m_bufferTable.LookupRaw(item->drawArgsBufferIdx).dbg_refCount += increment;
+
     u16* vertexBuffers = item->VertexBuffers();
     for (int i = 0; i < item->nVertexBuffers; ++i) {
         m_bufferTable.LookupRaw(vertexBuffers[i]).dbg_refCount += increment;
@@ -1575,28 +2153,54 @@ static const GpuDeviceMetal* Cast(const GpuDevice* dev) { return (const GpuDevic
 static GpuDeviceMetal* Cast(GpuDevice* dev) { return (GpuDeviceMetal*)dev; }
 static GpuDevice* Cast(GpuDeviceMetal* dev) { return (GpuDevice*)dev; }
 
+// Passes a call that has just been forwarded to the backend on to the trace
+// writer, if a trace is being captured.
+#define TRACE_CALL(device, call) \
+    do { \
+        GpuTraceWriter& writer = Cast(device)->GetTraceWriter(); \
+        if (writer.IsRecording()) \
+            writer.call; \
+    } while (0)
+
 GpuDevice* GpuDevice::Create(const GpuDeviceFormat& format, void* osViewHandle)
 { return Cast(new GpuDeviceMetal(format, osViewHandle)); }
 
-void GpuDevice::Destroy(GpuDevice* dev) { delete Cast(dev); }
+void GpuDevice::Destroy(GpuDevice* dev)
+{
+    Cast(dev)->GetDeferredDestroyQueue().DestroyAll(*dev);
+    delete Cast(dev);
+}
 
 void GpuDevice::SetFormat(const GpuDeviceFormat& format)
-{ Cast(this)->SetFormat(format); }
+{
+    Cast(this)->SetFormat(format);
+    TRACE_CALL(this, SetFormat(format));
+}
 
 const GpuDeviceFormat& GpuDevice::GetFormat() const
 { return Cast(this)->GetFormat(); }
 
 void GpuDevice::OnWindowResized()
-{ Cast(this)->OnWindowResized(); }
+{
+    Cast(this)->OnWindowResized();
+    TRACE_CALL(this, OnWindowResized());
+}
 
 bool GpuDevice::ShaderProgramExists(GpuShaderProgramID shaderProgramID) const
 { return Cast(this)->ShaderProgramExists(shaderProgramID); }
 
 GpuShaderProgramID GpuDevice::ShaderProgramCreate(const char* data, size_t length)
-{ return Cast(this)->ShaderProgramCreate(data, length); }
+{
+    GpuShaderProgramID shaderProgramID = Cast(this)->ShaderProgramCreate(data, length);
+    TRACE_CALL(this, ShaderProgramCreate(shaderProgramID, data, length));
+    return shaderProgramID;
+}
 
 void GpuDevice::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
-{ Cast(this)->ShaderProgramDestroy(shaderProgramID); }
+{
+    Cast(this)->ShaderProgramDestroy(shaderProgramID);
+    TRACE_CALL(this, ShaderProgramDestroy(shaderProgramID));
+}
 
 bool GpuDevice::BufferExists(GpuBufferID bufferID) const
 { return Cast(this)->BufferExists(bufferID); }
@@ -1606,19 +2210,52 @@ GpuBufferID GpuDevice::BufferCreate(GpuBufferType type,
                                     const void* data,
                                     unsigned size,
                                     int maxUpdatesPerFrame)
-{ return Cast(this)->BufferCreate(type, accessMode, data, size, maxUpdatesPerFrame); }
+{
+    GpuBufferID bufferID = Cast(this)->BufferCreate(
+        type,
+        accessMode,
+        data,
+        size,
+        maxUpdatesPerFrame
+    );
+    TRACE_CALL(this, BufferCreate(bufferID, type, accessMode, data, size, maxUpdatesPerFrame));
+    return bufferID;
+}
 
 void GpuDevice::BufferDestroy(GpuBufferID bufferID)
-{ Cast(this)->BufferDestroy(bufferID); }
+{
+    Cast(this)->BufferDestroy(bufferID);
+    TRACE_CALL(this, BufferDestroy(bufferID));
+}
 
 void GpuDevice::BufferStreamResize(GpuBufferID bufferID, unsigned newSize)
-{ Cast(this)->BufferStreamResize(bufferID, newSize); }
+{
+    Cast(this)->BufferStreamResize(bufferID, newSize);
+    TRACE_CALL(this, BufferStreamResize(bufferID, newSize));
+}
 
 void* GpuDevice::BufferMap(GpuBufferID bufferID)
-{ return Cast(this)->BufferMap(bufferID); }
+{
+    void* memory = Cast(this)->BufferMap(bufferID);
+    TRACE_CALL(this, BufferMap(bufferID, memory));
+    return memory;
+}
 
 void GpuDevice::BufferUnmap(GpuBufferID bufferID)
-{ Cast(this)->BufferUnmap(bufferID); }
+{
+    // Record the contents before the backend can reuse the mapped memory.
+    TRACE_CALL(this, BufferUnmap(bufferID));
+    Cast(this)->BufferUnmap(bufferID);
+}
+
+void GpuDevice::BufferUpload(GpuBufferID bufferID,
+                             unsigned offset,
+                             const void* data,
+                             unsigned size)
+{
+    Cast(this)->BufferUpload(bufferID, offset, data, size);
+    TRACE_CALL(this, BufferUpload(bufferID, offset, data, size));
+}
 
 bool GpuDevice::TextureExists(GpuTextureID textureID) const
 { return Cast(this)->TextureExists(textureID); }
@@ -1631,7 +2268,7 @@ GpuTextureID GpuDevice::TextureCreate(GpuTextureType type,
                                       int depthOrArrayLength,
                                       int nMipmapLevels)
 {
-    return Cast(this)->TextureCreate(
+    GpuTextureID textureID = Cast(this)->TextureCreate(
         type,
         pixelFormat,
         flags,
@@ -1640,26 +2277,53 @@ GpuTextureID GpuDevice::TextureCreate(GpuTextureType type,
         depthOrArrayLength,
         nMipmapLevels
     );
+    TRACE_CALL(this, TextureCreate(textureID, type, pixelFormat, flags, width, height,
+                              depthOrArrayLength, nMipmapLevels));
+    return textureID;
 }
 
 void GpuDevice::TextureDestroy(GpuTextureID textureID)
-{ return Cast(this)->TextureDestroy(textureID); }
+{
+    Cast(this)->TextureDestroy(textureID);
+    TRACE_CALL(this, TextureDestroy(textureID));
+}
 
 void GpuDevice::TextureUpload(GpuTextureID textureID,
                               const GpuRegion& region,
                               int mipmapLevel,
                               int stride,
                               const void* bytes)
-{ Cast(this)->TextureUpload(textureID, region, mipmapLevel, stride, bytes); }
+{
+    Cast(this)->TextureUpload(textureID, 0, region, mipmapLevel, stride, bytes);
+    TRACE_CALL(this, TextureUpload(textureID, 0, region, mipmapLevel, stride, bytes));
+}
+
+void GpuDevice::TextureUploadSlice(GpuTextureID textureID,
+                                   int slice,
+                                   const GpuRegion& region,
+                                   int mipmapLevel,
+                                   int stride,
+                                   const void* bytes)
+{
+    Cast(this)->TextureUpload(textureID, slice, region, mipmapLevel, stride, bytes);
+    TRACE_CALL(this, TextureUpload(textureID, slice, region, mipmapLevel, stride, bytes));
+}
 
 bool GpuDevice::SamplerExists(GpuSamplerID samplerID) const
 { return Cast(this)->SamplerExists(samplerID); }
 
 GpuSamplerID GpuDevice::SamplerCreate(const GpuSamplerDesc& desc)
-{ return Cast(this)->SamplerCreate(desc); }
+{
+    GpuSamplerID samplerID = Cast(this)->SamplerCreate(desc);
+    TRACE_CALL(this, SamplerCreate(samplerID, desc));
+    return samplerID;
+}
 
 void GpuDevice::SamplerDestroy(GpuSamplerID samplerID)
-{ Cast(this)->SamplerDestroy(samplerID); }
+{
+    Cast(this)->SamplerDestroy(samplerID);
+    TRACE_CALL(this, SamplerDestroy(samplerID));
+}
 
 bool GpuDevice::InputLayoutExists(GpuInputLayoutID inputLayoutID) const
 { return Cast(this)->InputLayoutExists(inputLayoutID); }
@@ -1668,40 +2332,213 @@ GpuInputLayoutID GpuDevice::InputLayoutCreate(int nVertexAttribs,
                                               const GpuVertexAttribute* attribs,
                                               int nVertexBuffers,
                                               const unsigned* strides)
-{ return Cast(this)->InputLayoutCreate(nVertexAttribs, attribs, nVertexBuffers, strides); }
+{
+    GpuInputLayoutID inputLayoutID = Cast(this)->InputLayoutCreate(
+        nVertexAttribs,
+        attribs,
+        nVertexBuffers,
+        strides
+    );
+    TRACE_CALL(this, InputLayoutCreate(inputLayoutID, nVertexAttribs, attribs,
+                                  nVertexBuffers, strides));
+    return inputLayoutID;
+}
 
 void GpuDevice::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
-{ Cast(this)->InputLayoutDestroy(inputLayoutID); }
+{
+    Cast(this)->InputLayoutDestroy(inputLayoutID);
+    TRACE_CALL(this, InputLayoutDestroy(inputLayoutID));
+}
 
 bool GpuDevice::PipelineStateExists(GpuPipelineStateID pipelineStateID) const
 { return Cast(this)->PipelineStateExists(pipelineStateID); }
 
 GpuPipelineStateID GpuDevice::PipelineStateCreate(const GpuPipelineStateDesc& state)
-{ return Cast(this)->PipelineStateCreate(state); }
+{
+    GpuPipelineStateID pipelineStateID = Cast(this)->PipelineStateCreate(state);
+    TRACE_CALL(this, PipelineStateCreate(pipelineStateID, state));
+    return pipelineStateID;
+}
+
+GpuPipelineStateID GpuDevice::PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                       GpuPipelineStateID fallback)
+{
+    GpuPipelineStateID pipelineStateID
+        = Cast(this)->PipelineStateCreateAsync(state, fallback);
+    // Recorded as a synchronous create, as the replay can't reproduce the
+    // timing of the compilation anyway.
+    TRACE_CALL(this, PipelineStateCreate(pipelineStateID, state));
+    return pipelineStateID;
+}
+
+bool GpuDevice::PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const
+{ return Cast(this)->PipelineStateIsReady(pipelineStateID); }
 
 void GpuDevice::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
-{ Cast(this)->PipelineStateDestroy(pipelineStateID); }
+{
+    Cast(this)->PipelineStateDestroy(pipelineStateID);
+    TRACE_CALL(this, PipelineStateDestroy(pipelineStateID));
+}
 
 bool GpuDevice::RenderPassExists(GpuRenderPassID renderPassID) const
 { return Cast(this)->RenderPassExists(renderPassID); }
 
 GpuRenderPassID GpuDevice::RenderPassCreate(const GpuRenderPassDesc& pass)
-{ return Cast(this)->RenderPassCreate(pass); }
+{
+    GpuRenderPassID renderPassID = Cast(this)->RenderPassCreate(pass);
+    TRACE_CALL(this, RenderPassCreate(renderPassID, pass));
+    return renderPassID;
+}
 
 void GpuDevice::RenderPassDestroy(GpuRenderPassID renderPassID)
-{ Cast(this)->RenderPassDestroy(renderPassID); }
+{
+    Cast(this)->RenderPassDestroy(renderPassID);
+    TRACE_CALL(this, RenderPassDestroy(renderPassID));
+}
 
 void GpuDevice::Draw(const GpuDrawItem* const* items,
                      int nItems,
                      GpuRenderPassID renderPass,
                      const GpuViewport& viewport)
-{ Cast(this)->Draw(items, nItems, renderPass, viewport); }
+{
+    Cast(this)->Draw(items, nItems, renderPass, viewport);
+    TRACE_CALL(this, Draw(items, nItems, renderPass, viewport, false));
+}
+
+void GpuDevice::DrawParallel(const GpuDrawItem* const* items,
+                             int nItems,
+                             GpuRenderPassID renderPass,
+                             const GpuViewport& viewport,
+                             TaskPool& taskPool)
+{
+    Cast(this)->DrawParallel(items, nItems, renderPass, viewport, taskPool);
+    TRACE_CALL(this, Draw(items, nItems, renderPass, viewport, true));
+}
 
 void GpuDevice::SceneBegin()
-{ Cast(this)->SceneBegin(); }
+{
+    Cast(this)->SceneBegin();
+    TRACE_CALL(this, SceneBegin());
+    Cast(this)->GetDeferredDestroyQueue().DestroyCompleted(*this,
+                                                           GetCompletedFrame());
+}
 
 void GpuDevice::ScenePresent()
-{ Cast(this)->ScenePresent(); }
+{
+    Cast(this)->ScenePresent();
+    TRACE_CALL(this, ScenePresent());
+    // After the frame is recorded, since the callback may destroy resources.
+    Cast(this)->GetMemoryTracker().CheckBudget();
+}
+
+bool GpuDevice::TimerQueryExists(GpuTimerQueryID queryID) const
+{ return Cast(this)->GetTimerQueries().Exists(queryID); }
+
+GpuTimerQueryID GpuDevice::TimerQueryCreate()
+{
+    GpuTimerQueryID queryID = Cast(this)->GetTimerQueries().Create();
+    TRACE_CALL(this, TimerQueryCreate(queryID));
+    return queryID;
+}
+
+void GpuDevice::TimerQueryDestroy(GpuTimerQueryID queryID)
+{
+    Cast(this)->GetTimerQueries().Destroy(queryID);
+    TRACE_CALL(this, TimerQueryDestroy(queryID));
+}
+
+void GpuDevice::TimerQueryBegin(GpuTimerQueryID queryID)
+{
+    u64 frame = GetSubmittedFrame() + 1;
+    Cast(this)->TimerQueryMark(Cast(this)->GetTimerQueries().Begin(queryID, frame));
+    TRACE_CALL(this, TimerQueryBegin(queryID));
+}
+
+void GpuDevice::TimerQueryEnd(GpuTimerQueryID queryID)
+{
+    u64 frame = GetSubmittedFrame() + 1;
+    Cast(this)->TimerQueryMark(Cast(this)->GetTimerQueries().End(queryID, frame));
+    TRACE_CALL(this, TimerQueryEnd(queryID));
+}
+
+bool GpuDevice::TimerQueryGetResult(GpuTimerQueryID queryID,
+                                    float* milliseconds,
+                                    u64* frame) const
+{ return Cast(this)->GetTimerQueries().GetResult(queryID, milliseconds, frame); }
+
+void GpuDevice::SetMaxFramesInFlight(int nFrames)
+{ Cast(this)->GetFramePacer().SetMaxFramesInFlight(nFrames); }
+
+int GpuDevice::GetMaxFramesInFlight() const
+{ return Cast(this)->GetFramePacer().GetMaxFramesInFlight(); }
+
+u64 GpuDevice::GetSubmittedFrame() const
+{ return Cast(this)->GetFramePacer().GetSubmittedFrame(); }
+
+u64 GpuDevice::GetCompletedFrame() const
+{ return Cast(this)->GetFramePacer().GetCompletedFrame(); }
+
+void GpuDevice::WaitForFrame(u64 frame)
+{ Cast(this)->GetFramePacer().WaitForFrame(frame); }
+
+void GpuDevice::ShaderProgramDestroyDeferred(GpuShaderProgramID shaderProgramID)
+{
+    ASSERT(ShaderProgramExists(shaderProgramID));
+    Cast(this)->GetDeferredDestroyQueue().PushShaderProgram(
+        shaderProgramID, GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::BufferDestroyDeferred(GpuBufferID bufferID)
+{
+    ASSERT(BufferExists(bufferID));
+    Cast(this)->GetDeferredDestroyQueue().PushBuffer(bufferID,
+                                                     GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::TextureDestroyDeferred(GpuTextureID textureID)
+{
+    ASSERT(TextureExists(textureID));
+    Cast(this)->GetDeferredDestroyQueue().PushTexture(textureID,
+                                                      GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::SetSimulatedGpuCost(const GpuSimulatedGpuCost& cost)
+{}
+
+const GpuFramePacingStats& GpuDevice::GetFramePacingStats() const
+{ return Cast(this)->GetFramePacer().GetStats(); }
+
+const GpuStateFilterStats& GpuDevice::GetStateFilterStats() const
+{ return Cast(this)->GetStateFilterStats(); }
+
+const GpuDrawStats& GpuDevice::GetDrawStats() const
+{ return Cast(this)->GetDrawStats(); }
+
+const GpuFrameStats& GpuDevice::GetFrameStats() const
+{ return Cast(this)->GetFrameStats(); }
+
+const GpuUploadHeapStats& GpuDevice::GetUploadHeapStats() const
+{ return Cast(this)->GetUploadHeapStats(); }
+
+const GpuStateObjectCacheStats& GpuDevice::GetStateObjectCacheStats() const
+{ return Cast(this)->GetStateObjectCacheStats(); }
+
+const GpuMemoryStats& GpuDevice::GetMemoryStats() const
+{ return Cast(this)->GetMemoryTracker().GetStats(); }
+
+void GpuDevice::SetMemoryBudget(u64 budget,
+                                GpuMemoryBudgetCallback callback,
+                                void* userdata)
+{ Cast(this)->GetMemoryTracker().SetBudget(budget, callback, userdata); }
+
+bool GpuDevice::TraceCaptureBegin(const char* path)
+{ return Cast(this)->GetTraceWriter().Begin(path); }
+
+void GpuDevice::TraceCaptureEnd()
+{ Cast(this)->GetTraceWriter().End(); }
+
+bool GpuDevice::IsTraceCapturing() const
+{ return Cast(this)->GetTraceWriter().IsRecording(); }
 
 #ifdef GPUDEVICE_DEBUG_MODE
 void GpuDevice::RegisterDrawItem(const GpuDrawItem* item)
@@ -3,12 +3,29 @@
 #include "GpuDevice/GpuDevice.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
 
 #include "Core/IDLookupTable.h"
+#include "Core/JobQueue.h"
 #include "Core/Macros.h"
+#include "Core/TaskPool.h"
+#include "GpuDevice/GpuCommandList.h"
+#include "GpuDevice/GpuDeferredDestroyQueue.h"
+#include "GpuDevice/GpuDrawChunks.h"
 #include "GpuDevice/GpuDrawItem.h"
+#include "GpuDevice/GpuFrameCounters.h"
+#include "GpuDevice/GpuFramePacer.h"
+#include "GpuDevice/GpuMemoryTracker.h"
 #include "GpuDevice/GpuShaderLoad.h"
 #include "GpuDevice/GpuShaderPermutations.h"
+#include "GpuDevice/GpuSimulatedGpu.h"
+#include "GpuDevice/GpuTimerQueries.h"
+#include "GpuDevice/GpuStateCache.h"
+#include "GpuDevice/GpuStateObjectCache.h"
+#include "GpuDevice/GpuTraceWriter.h"
+#include "GpuDevice/GpuUploadHeap.h"
 
 #define FOURCC(a, b, c, d) (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
 
@@ -16,7 +33,12 @@
 // Constants
 // -----------------------------------------------------------------------------
 
-const u32 STREAM_RING_BUF_SIZE = 2 * 1024 * 1024; // 2 MB
+const u32 UPLOAD_HEAP_PAGE_SIZE = 2 * 1024 * 1024; // 2 MB
+
+// Alignment of the data of stream-mode and dynamic-mode buffers.
+const u32 UPLOAD_ALIGNMENT = 16;
+
+const int PIPELINE_COMPILER_THREADS = 2;
 
 // -----------------------------------------------------------------------------
 // Lookup tables for textures
@@ -62,6 +84,10 @@ public:
 
     void* BufferMap(GpuBufferID bufferID);
     void BufferUnmap(GpuBufferID bufferID);
+    void BufferUpload(GpuBufferID bufferID,
+                      unsigned offset,
+                      const void* data,
+                      unsigned size);
 
     // Textures
     bool TextureExists(GpuTextureID textureID) const;
@@ -74,6 +100,7 @@ public:
                                int nMipmapLevels);
     void TextureDestroy(GpuTextureID textureID);
     void TextureUpload(GpuTextureID textureID,
+                       int slice,
                        const GpuRegion& region,
                        int mipmapLevel,
                        int stride,
@@ -95,7 +122,21 @@ public:
     // Pipeline state objects
     bool PipelineStateExists(GpuPipelineStateID pipelineStateID) const;
     GpuPipelineStateID PipelineStateCreate(const GpuPipelineStateDesc& state);
+    GpuPipelineStateID PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                GpuPipelineStateID fallback);
+    bool PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const;
     void PipelineStateDestroy(GpuPipelineStateID pipelineStateID);
+private:
+    struct PipelineStateObj;
+    GpuPipelineStateID CreatePipelineStateObj(const GpuPipelineStateDesc& state,
+                                              bool async,
+                                              GpuPipelineStateID fallback);
+    static void CompilePipelineState(void* job, void* userdata);
+    void FinishPipelineCompile(PipelineStateObj& obj);
+    void UpdatePipelineCompiles();
+    void CancelPipelineCompiles();
+    bool ResolvePipelineState(u16* pipelineStateIdx, GpuStateCache& stateCache) const;
+public:
 
     // Render passes
     bool RenderPassExists(GpuRenderPassID renderPassID) const;
@@ -103,15 +144,58 @@ public:
     void RenderPassDestroy(GpuRenderPassID renderPassID);
 
     // Submit an array of draw items
+private:
+    void RecordDrawItems(const GpuDrawItem* const* items,
+                         int nItems,
+                         GpuStateCache& stateCache,
+                         GpuCommandList& commands);
+    void RecordIndirectDraws(const GpuDrawItem* item,
+                             GpuStateCache& stateCache,
+                             GpuCommandList& commands);
+    static void RecordDrawChunk(int index, void* userdata);
+public:
     void Draw(const GpuDrawItem* const* items,
               int nItems,
               GpuRenderPassID renderPass,
               const GpuViewport& viewport);
+    void DrawParallel(const GpuDrawItem* const* items,
+                      int nItems,
+                      GpuRenderPassID renderPass,
+                      const GpuViewport& viewport,
+                      TaskPool& taskPool);
 
     // Scene begin/end functions
     void SceneBegin();
     void ScenePresent();
 
+    // Timer queries
+    GpuTimerQueries& GetTimerQueries();
+    const GpuTimerQueries& GetTimerQueries() const;
+    void TimerQueryMark(u32 timestamp);
+
+    // Frame pacing
+    GpuFramePacer& GetFramePacer();
+    const GpuFramePacer& GetFramePacer() const;
+    void SetSimulatedGpuCost(const GpuSimulatedGpuCost& cost);
+
+    // Memory accounting
+    GpuMemoryTracker& GetMemoryTracker();
+    const GpuMemoryTracker& GetMemoryTracker() const;
+
+    // Deferred destruction
+    GpuDeferredDestroyQueue& GetDeferredDestroyQueue();
+
+    // Statistics
+    const GpuStateFilterStats& GetStateFilterStats() const;
+    const GpuDrawStats& GetDrawStats() const;
+    const GpuFrameStats& GetFrameStats() const;
+    const GpuUploadHeapStats& GetUploadHeapStats() const;
+    const GpuStateObjectCacheStats& GetStateObjectCacheStats() const;
+
+    // Trace capture
+    GpuTraceWriter& GetTraceWriter();
+    const GpuTraceWriter& GetTraceWriter() const;
+
 #ifdef GPUDEVICE_DEBUG_MODE
     void DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increment);
     void RegisterDrawItem(const GpuDrawItem* item);
@@ -162,10 +246,20 @@ private:
         // TODO: Could be worth compressing the size of this struct a bit more
         GpuBufferType type;
         GpuBufferAccessMode accessMode;
-        int maxUpdatesPerFrame;
         u32 size;
         u32 bufOffset;
+        // Static-mode buffers own their memory. The memory of the other
+        // modes is allocated from the upload heap by each update. For
+        // dynamic-mode buffers, it's a persistent allocation that's freed by
+        // the next update.
         void* memory;
+        GpuUploadAllocation allocation;
+    };
+
+    // The Null backend has nothing to compile, so the compilation of a pipeline
+    // state object just takes the simulated compile time.
+    struct PipelineCompileJob {
+        float microseconds;
     };
 
     struct PipelineStateObj {
@@ -174,6 +268,13 @@ private:
         u32 dbg_shaderProgram;
         u32 dbg_inputLayout;
 #endif
+        u32 depthStencilKey;
+        u32 rasterStateKey;
+
+        // Non-NULL until the object has finished compiling, if it was created
+        // by PipelineStateCreateAsync().
+        PipelineCompileJob* compileJob;
+        u32 fallback;
     };
 
     struct RenderPassObj {
@@ -187,6 +288,10 @@ private:
     };
 
     struct Texture {
+        // The memory that the texture would use on a GPU.
+        u64 size;
+        GpuMemoryCategory memoryCategory;
+        GpuPixelFormat pixelFormat;
 #ifdef GPUDEVICE_DEBUG_MODE
         int dbg_refCount;
 #endif
@@ -198,6 +303,14 @@ private:
 #endif
     };
 
+    struct DrawChunk {
+        GpuDeviceNull* device;
+        const GpuDrawItem* const* items;
+        int nItems;
+        GpuStateCache stateCache;
+        GpuCommandList commands;
+    };
+
     GpuDeviceFormat m_deviceFormat;
 
     int m_frameNumber;
@@ -211,6 +324,37 @@ private:
     IDLookupTable<Texture, GpuTextureID::Type, 16, 16> m_textureTable;
     IDLookupTable<Sampler, GpuSamplerID::Type, 16, 16> m_samplerTable;
 
+    GpuStateCache m_stateCache;
+    GpuStateFilterStats m_stateFilterStats;
+    GpuDrawStats m_drawStats;
+    GpuFrameCounters m_frameCounters;
+    GpuMemoryTracker m_memoryTracker;
+
+    GpuTraceWriter m_traceWriter;
+
+    GpuFramePacer m_framePacer;
+    GpuDeferredDestroyQueue m_deferredDestroyQueue;
+    GpuUploadHeap m_uploadHeap;
+    GpuStateObjectCache m_stateObjectCache;
+    GpuSimulatedGpu m_simulatedGpu;
+
+    JobQueue m_pipelineCompiler;
+    // The pipeline state objects created by PipelineStateCreateAsync() that
+    // may still be compiling. The objects may have been destroyed since.
+    std::vector<GpuPipelineStateID> m_compilingPipelineStates;
+
+    // The commands submitted so far in the current frame. The chunks recorded
+    // by DrawParallel() are appended to this in order.
+    GpuCommandList m_submittedCommands;
+    std::vector<DrawChunk> m_drawChunks;
+
+    // The simulated GPU time of the current frame so far, in microseconds,
+    // which includes the first m_nCostedCommands commands. It's updated at
+    // each timer query marker and when the frame is presented.
+    double m_frameCost;
+    size_t m_nCostedCommands;
+    GpuTimerQueries m_timerQueries;
+
     int m_dbg_shaderCount;
     int m_dbg_bufferCount;
     int m_dbg_textureCount;
@@ -224,6 +368,20 @@ private:
 // GpuDeviceNull implementation
 // -----------------------------------------------------------------------------
 
+// The userdata is the device's GpuMemoryTracker.
+static void* CreateUploadPage(u32 size, void** cpuAddress, void* userdata)
+{
+    ((GpuMemoryTracker*)userdata)->Add(GPU_MEMORY_UPLOAD_HEAP, size);
+    *cpuAddress = malloc(size);
+    return *cpuAddress;
+}
+
+static void DestroyUploadPage(void* page, u32 size, void* userdata)
+{
+    ((GpuMemoryTracker*)userdata)->Remove(GPU_MEMORY_UPLOAD_HEAP, size);
+    free(page);
+}
+
 GpuDeviceNull::GpuDeviceNull(const GpuDeviceFormat& format, void* osViewHandle)
     : m_deviceFormat(format)
     , m_frameNumber(0)
@@ -235,6 +393,28 @@ GpuDeviceNull::GpuDeviceNull(const GpuDeviceFormat& format, void* osViewHandle)
     , m_renderPassTable()
     , m_inputLayoutTable()
 
+    , m_stateCache()
+    , m_stateFilterStats(m_stateCache.GetStats())
+    , m_drawStats(m_stateCache.GetDrawStats())
+    , m_frameCounters()
+    , m_memoryTracker()
+    , m_traceWriter()
+    , m_framePacer()
+    , m_deferredDestroyQueue()
+    , m_uploadHeap(UPLOAD_HEAP_PAGE_SIZE, &CreateUploadPage, &DestroyUploadPage,
+                   &m_memoryTracker)
+    , m_stateObjectCache()
+    , m_simulatedGpu(m_framePacer)
+    , m_pipelineCompiler(PIPELINE_COMPILER_THREADS,
+                         &GpuDeviceNull::CompilePipelineState,
+                         NULL)
+    , m_compilingPipelineStates()
+    , m_submittedCommands()
+    , m_drawChunks()
+    , m_frameCost(0.0)
+    , m_nCostedCommands(0)
+    , m_timerQueries()
+
     , m_dbg_shaderCount(0)
     , m_dbg_bufferCount(0)
     , m_dbg_textureCount(0)
@@ -246,6 +426,8 @@ GpuDeviceNull::GpuDeviceNull(const GpuDeviceFormat& format, void* osViewHandle)
 
 GpuDeviceNull::~GpuDeviceNull()
 {
+    CancelPipelineCompiles();
+
     if (m_dbg_shaderCount != 0) {
         fprintf(stderr,
                 "GpuDeviceNull: warning - %d shader(s) not destroyed\n",
@@ -318,6 +500,7 @@ GpuShaderProgramID GpuDeviceNull::ShaderProgramCreate(const char* data, size_t l
         m_permutations
     );
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_SHADER_PROGRAM);
     ++m_dbg_shaderCount;
 
     return shaderProgramID;
@@ -337,8 +520,10 @@ void GpuDeviceNull::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
 
     m_permutations.ReleaseChain(program.idxFirstPermutation);
 
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_SHADER_PROGRAM, shaderProgramID);
     m_shaderProgramTable.Remove(shaderProgramID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_SHADER_PROGRAM);
     --m_dbg_shaderCount;
 }
 
@@ -353,13 +538,6 @@ GpuBufferID GpuDeviceNull::BufferCreate(GpuBufferType type,
                                          unsigned size,
                                          int maxUpdatesPerFrame)
 {
-    ASSERT((accessMode != GPU_BUFFER_ACCESS_STREAM ||
-           size <= STREAM_RING_BUF_SIZE)
-           && "Maximum size of stream-mode buffer exceeded");
-    ASSERT((accessMode != GPU_BUFFER_ACCESS_DYNAMIC ||
-            maxUpdatesPerFrame > 0)
-           && "Must have maxUpdatesPerFrame > 0 for dynamic-mode buffer");
-
     GpuBufferID bufferID(m_bufferTable.Add());
     Buffer& buffer = m_bufferTable.Lookup(bufferID);
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -368,11 +546,30 @@ GpuBufferID GpuDeviceNull::BufferCreate(GpuBufferType type,
 
     buffer.type = type;
     buffer.accessMode = accessMode;
-    buffer.maxUpdatesPerFrame = maxUpdatesPerFrame;
     buffer.size = size;
     buffer.bufOffset = 0;
-    buffer.memory = malloc(size);
+    buffer.memory = NULL;
+
+    switch (accessMode) {
+        case GPU_BUFFER_ACCESS_STATIC:
+            buffer.memory = malloc(size);
+            m_memoryTracker.Add(GPU_MEMORY_BUFFERS, size);
+            break;
+        case GPU_BUFFER_ACCESS_DYNAMIC:
+            buffer.memory = m_uploadHeap.AllocatePersistent(size, UPLOAD_ALIGNMENT,
+                                                            &buffer.allocation);
+            buffer.bufOffset = buffer.allocation.offset;
+            break;
+        case GPU_BUFFER_ACCESS_STREAM:
+            break; // Allocated when the buffer is mapped.
+        default:
+            ASSERT(!"Unknown GpuBufferAccessMode");
+            break;
+    }
+    if (data && buffer.memory)
+        memcpy(buffer.memory, data, size);
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_BUFFER);
     ++m_dbg_bufferCount;
 
     return bufferID;
@@ -385,8 +582,6 @@ void GpuDeviceNull::BufferStreamResize(GpuBufferID bufferID, unsigned newSize)
     ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
 
     buffer.size = newSize;
-    free(buffer.memory);
-    buffer.memory = malloc(newSize);
 }
 
 void GpuDeviceNull::BufferDestroy(GpuBufferID bufferID)
@@ -401,10 +596,21 @@ void GpuDeviceNull::BufferDestroy(GpuBufferID bufferID)
     }
 #endif
 
-    free(buffer.memory);
+    switch (buffer.accessMode) {
+        case GPU_BUFFER_ACCESS_STATIC:
+            free(buffer.memory);
+            m_memoryTracker.Remove(GPU_MEMORY_BUFFERS, buffer.size);
+            break;
+        case GPU_BUFFER_ACCESS_DYNAMIC:
+            m_uploadHeap.FreePersistent(buffer.allocation);
+            break;
+        default:
+            break;
+    }
 
     m_bufferTable.Remove(bufferID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_BUFFER);
     --m_dbg_bufferCount;
 }
 
@@ -414,6 +620,19 @@ void* GpuDeviceNull::BufferMap(GpuBufferID bufferID)
     Buffer& buffer = m_bufferTable.Lookup(bufferID);
     ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC ||
            buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
+
+    // Draw items recorded earlier in the frame keep reading the previous
+    // contents.
+    if (buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC) {
+        m_uploadHeap.FreePersistent(buffer.allocation);
+        buffer.memory = m_uploadHeap.AllocatePersistent(buffer.size, UPLOAD_ALIGNMENT,
+                                                        &buffer.allocation);
+    } else {
+        buffer.memory = m_uploadHeap.Allocate(buffer.size, UPLOAD_ALIGNMENT,
+                                              &buffer.allocation);
+    }
+    buffer.bufOffset = buffer.allocation.offset;
+    m_frameCounters.CountBufferMap(buffer.size);
     return buffer.memory;
 }
 
@@ -425,6 +644,19 @@ void GpuDeviceNull::BufferUnmap(GpuBufferID bufferID)
            buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
 }
 
+void GpuDeviceNull::BufferUpload(GpuBufferID bufferID,
+                                 unsigned offset,
+                                 const void* data,
+                                 unsigned size)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STATIC);
+    ASSERT((u64)offset + size <= buffer.size);
+
+    memcpy((u8*)buffer.memory + offset, data, size);
+}
+
 bool GpuDeviceNull::TextureExists(GpuTextureID textureID) const
 {
     return m_textureTable.Has(textureID);
@@ -449,10 +681,18 @@ GpuTextureID GpuDeviceNull::TextureCreate(GpuTextureType type,
 
     GpuTextureID textureID(m_textureTable.Add());
     Texture& tex = m_textureTable.Lookup(textureID);
+    tex.size = GpuDevice::TextureSizeInBytes(type, pixelFormat, width, height,
+                                             depthOrArrayLength, nMipmapLevels);
+    tex.memoryCategory = (flags & GPU_TEXTURE_FLAG_RENDER_TARGET)
+        ? GPU_MEMORY_RENDER_TARGETS : GPU_MEMORY_TEXTURES;
+    tex.pixelFormat = pixelFormat;
 #ifdef GPUDEVICE_DEBUG_MODE
     tex.dbg_refCount = 0;
 #endif
 
+    m_memoryTracker.Add(tex.memoryCategory, tex.size);
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_TEXTURE);
     ++m_dbg_textureCount;
 
     return textureID;
@@ -470,18 +710,26 @@ void GpuDeviceNull::TextureDestroy(GpuTextureID textureID)
     }
 #endif
 
+    m_memoryTracker.Remove(tex.memoryCategory, tex.size);
+
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_TEXTURE, textureID);
     m_textureTable.Remove(textureID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_TEXTURE);
     --m_dbg_textureCount;
 }
 
 void GpuDeviceNull::TextureUpload(GpuTextureID textureID,
+                                   int slice,
                                    const GpuRegion& region,
                                    int mipmapLevel,
                                    int stride,
                                    const void* bytes)
 {
     ASSERT(TextureExists(textureID));
+    ASSERT(slice >= 0);
+    const Texture& tex = m_textureTable.Lookup(textureID);
+    m_frameCounters.CountTextureUpload(tex.pixelFormat, region);
 }
 
 bool GpuDeviceNull::SamplerExists(GpuSamplerID samplerID) const
@@ -493,20 +741,30 @@ GpuSamplerID GpuDeviceNull::SamplerCreate(const GpuSamplerDesc& desc)
 {
     ASSERT(1 <= desc.maxAnisotropy && desc.maxAnisotropy <= 16);
 
+    GpuStateObjectKey key(desc);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuSamplerID(existingID);
+
     GpuSamplerID samplerID(m_samplerTable.Add());
     Sampler& sampler = m_samplerTable.Lookup(samplerID);
 #ifdef GPUDEVICE_DEBUG_MODE
     sampler.dbg_refCount = 0;
 #endif
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_SAMPLER);
     ++m_dbg_samplerCount;
 
+    m_stateObjectCache.Insert(key, samplerID);
+
     return samplerID;
 }
 
 void GpuDeviceNull::SamplerDestroy(GpuSamplerID samplerID)
 {
     ASSERT(SamplerExists(samplerID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_SAMPLER, samplerID))
+        return;
+
     Sampler& sampler = m_samplerTable.Lookup(samplerID);
 
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -518,6 +776,7 @@ void GpuDeviceNull::SamplerDestroy(GpuSamplerID samplerID)
 
     m_samplerTable.Remove(samplerID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_SAMPLER);
     --m_dbg_samplerCount;
 }
 
@@ -531,20 +790,30 @@ GpuInputLayoutID GpuDeviceNull::InputLayoutCreate(int nVertexAttribs,
                                                    int nVertexBuffers,
                                                    const unsigned* strides)
 {
+    GpuStateObjectKey key(nVertexAttribs, attribs, nVertexBuffers, strides);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuInputLayoutID(existingID);
+
     GpuInputLayoutID inputLayoutID(m_inputLayoutTable.Add());
     InputLayout& layout = m_inputLayoutTable.Lookup(inputLayoutID);
 #ifdef GPUDEVICE_DEBUG_MODE
     layout.dbg_refCount = 0;
 #endif
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_INPUT_LAYOUT);
     ++m_dbg_inputLayoutCount;
 
+    m_stateObjectCache.Insert(key, inputLayoutID);
+
     return inputLayoutID;
 }
 
 void GpuDeviceNull::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
 {
     ASSERT(InputLayoutExists(inputLayoutID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_INPUT_LAYOUT, inputLayoutID))
+        return;
+
     InputLayout& layout = m_inputLayoutTable.Lookup(inputLayoutID);
 
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -554,8 +823,10 @@ void GpuDeviceNull::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
     }
 #endif
 
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_INPUT_LAYOUT, inputLayoutID);
     m_inputLayoutTable.Remove(inputLayoutID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_INPUT_LAYOUT);
     --m_dbg_inputLayoutCount;
 }
 
@@ -564,11 +835,38 @@ bool GpuDeviceNull::PipelineStateExists(GpuPipelineStateID pipelineStateID) cons
     return m_pipelineStateTable.Has(pipelineStateID);
 }
 
+static void SimulatePipelineCompile(float microseconds)
+{
+    if (microseconds > 0.0f)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(microseconds));
+}
+
 GpuPipelineStateID GpuDeviceNull::PipelineStateCreate(const GpuPipelineStateDesc& state)
+{
+    return CreatePipelineStateObj(state, false, GpuPipelineStateID(0));
+}
+
+GpuPipelineStateID GpuDeviceNull::PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                           GpuPipelineStateID fallback)
+{
+    return CreatePipelineStateObj(state, true, fallback);
+}
+
+GpuPipelineStateID GpuDeviceNull::CreatePipelineStateObj(const GpuPipelineStateDesc& state,
+                                                         bool async,
+                                                         GpuPipelineStateID fallback)
 {
     ASSERT(ShaderProgramExists(state.shaderProgram));
     ASSERT(InputLayoutExists(state.inputLayout));
 
+    GpuStateObjectKey key(state);
+    if (u32 existingID = m_stateObjectCache.Acquire(key)) {
+        PipelineStateObj& existing = m_pipelineStateTable.Lookup(existingID);
+        if (!async && existing.compileJob)
+            FinishPipelineCompile(existing);
+        return GpuPipelineStateID(existingID);
+    }
+
     GpuPipelineStateID pipelineStateID(m_pipelineStateTable.Add());
     PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -579,14 +877,106 @@ GpuPipelineStateID GpuDeviceNull::PipelineStateCreate(const GpuPipelineStateDesc
     ++m_inputLayoutTable.Lookup(state.inputLayout).dbg_refCount;
 #endif
 
+    obj.depthStencilKey = GpuStateCache::DepthStencilKey(state);
+    obj.rasterStateKey = GpuStateCache::RasterStateKey(state);
+    obj.compileJob = NULL;
+    obj.fallback = fallback;
+
+    float compileTime = m_simulatedGpu.GetCost().perPipelineCompile;
+    if (async) {
+        obj.compileJob = new PipelineCompileJob;
+        obj.compileJob->microseconds = compileTime;
+        m_pipelineCompiler.Enqueue(obj.compileJob);
+        m_compilingPipelineStates.push_back(pipelineStateID);
+    } else {
+        SimulatePipelineCompile(compileTime);
+    }
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_PIPELINE_STATE);
     ++m_dbg_psoCount;
 
+    m_stateObjectCache.Insert(key, pipelineStateID);
+
     return pipelineStateID;
 }
 
+void GpuDeviceNull::CompilePipelineState(void* job, void* userdata)
+{
+    SimulatePipelineCompile(((PipelineCompileJob*)job)->microseconds);
+}
+
+void GpuDeviceNull::FinishPipelineCompile(PipelineStateObj& obj)
+{
+    m_pipelineCompiler.Finish(obj.compileJob);
+    delete obj.compileJob;
+    obj.compileJob = NULL;
+}
+
+void GpuDeviceNull::UpdatePipelineCompiles()
+{
+    size_t nRemaining = 0;
+    for (size_t i = 0; i < m_compilingPipelineStates.size(); ++i) {
+        GpuPipelineStateID pipelineStateID = m_compilingPipelineStates[i];
+        if (!m_pipelineStateTable.Has(pipelineStateID))
+            continue;
+        PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
+        if (!obj.compileJob)
+            continue;
+        if (m_pipelineCompiler.IsDone(obj.compileJob)) {
+            FinishPipelineCompile(obj);
+            continue;
+        }
+        m_compilingPipelineStates[nRemaining] = pipelineStateID;
+        ++nRemaining;
+    }
+    m_compilingPipelineStates.resize(nRemaining);
+}
+
+void GpuDeviceNull::CancelPipelineCompiles()
+{
+    for (size_t i = 0; i < m_compilingPipelineStates.size(); ++i) {
+        GpuPipelineStateID pipelineStateID = m_compilingPipelineStates[i];
+        if (!m_pipelineStateTable.Has(pipelineStateID))
+            continue;
+        PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
+        if (obj.compileJob) {
+            m_pipelineCompiler.Cancel(obj.compileJob);
+            delete obj.compileJob;
+            obj.compileJob = NULL;
+        }
+    }
+    m_compilingPipelineStates.clear();
+}
+
+bool GpuDeviceNull::PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const
+{
+    ASSERT(PipelineStateExists(pipelineStateID));
+    // Compiled objects only become ready at the start of a frame, so that
+    // they're either ready or not for the whole frame.
+    return m_pipelineStateTable.Lookup(pipelineStateID).compileJob == NULL;
+}
+
+bool GpuDeviceNull::ResolvePipelineState(u16* pipelineStateIdx,
+                                         GpuStateCache& stateCache) const
+{
+    const PipelineStateObj& obj = m_pipelineStateTable.LookupRaw(*pipelineStateIdx);
+    if (!obj.compileJob)
+        return true;
+
+    bool hasFallback = m_pipelineStateTable.Has(obj.fallback)
+        && !m_pipelineStateTable.Lookup(obj.fallback).compileJob;
+    stateCache.CountPendingDrawItem(!hasFallback);
+    if (hasFallback)
+        *pipelineStateIdx = (u16)(obj.fallback & 0xFFFF);
+    return hasFallback;
+}
+
 void GpuDeviceNull::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
 {
     ASSERT(PipelineStateExists(pipelineStateID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_PIPELINE_STATE, pipelineStateID))
+        return;
+
     PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
 
 #ifdef GPUDEVICE_DEBUG_MODE
@@ -598,8 +988,13 @@ void GpuDeviceNull::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
     --m_inputLayoutTable.Lookup(obj.dbg_inputLayout).dbg_refCount;
 #endif
 
+    if (obj.compileJob) {
+        m_pipelineCompiler.Cancel(obj.compileJob);
+        delete obj.compileJob;
+    }
     m_pipelineStateTable.Remove(pipelineStateID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_PIPELINE_STATE);
     --m_dbg_psoCount;
 }
 
@@ -612,6 +1007,10 @@ GpuRenderPassID GpuDeviceNull::RenderPassCreate(const GpuRenderPassDesc& pass)
 {
     ASSERT(pass.numRenderTargets >= 0);
 
+    GpuStateObjectKey key(pass);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuRenderPassID(existingID);
+
     GpuRenderPassID renderPassID(m_renderPassTable.Add());
     RenderPassObj& obj = m_renderPassTable.Lookup(renderPassID);
     obj.usesRenderTarget = false;
@@ -624,19 +1023,175 @@ GpuRenderPassID GpuDeviceNull::RenderPassCreate(const GpuRenderPassDesc& pass)
         }
     }
 
+    m_frameCounters.CountCreate(GPU_RESOURCE_RENDER_PASS);
     ++m_dbg_renderPassCount;
 
+    m_stateObjectCache.Insert(key, renderPassID);
+
     return renderPassID;
 }
 
 void GpuDeviceNull::RenderPassDestroy(GpuRenderPassID renderPassID)
 {
     ASSERT(RenderPassExists(renderPassID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_RENDER_PASS, renderPassID))
+        return;
+
     m_renderPassTable.Remove(renderPassID);
 
+    m_frameCounters.CountDestroy(GPU_RESOURCE_RENDER_PASS);
     --m_dbg_renderPassCount;
 }
 
+void GpuDeviceNull::RecordDrawItems(const GpuDrawItem* const* items,
+                                    int nItems,
+                                    GpuStateCache& stateCache,
+                                    GpuCommandList& commands)
+{
+    for (int drawItemIndex = 0; drawItemIndex < nItems; ++drawItemIndex) {
+        const GpuDrawItem* item = items[drawItemIndex];
+        ASSERT(item != NULL);
+
+        u16 pipelineStateIdx = item->pipelineStateIdx;
+        if (!ResolvePipelineState(&pipelineStateIdx, stateCache))
+            continue;
+
+        const PipelineStateObj& pipelineState
+            = m_pipelineStateTable.LookupRaw(pipelineStateIdx);
+        if (stateCache.SetPipelineState(pipelineStateIdx))
+            commands.SetPipelineState(pipelineStateIdx);
+        if (stateCache.SetDepthStencilState(pipelineState.depthStencilKey))
+            commands.SetDepthStencilState(pipelineState.depthStencilKey);
+        if (stateCache.SetRasterState(pipelineState.rasterStateKey))
+            commands.SetRasterState(pipelineState.rasterStateKey);
+
+        const u32* vertexBufferOffsets = item->VertexBufferOffsets();
+        const u16* vertexBuffers = item->VertexBuffers();
+        for (int i = 0; i < item->nVertexBuffers; ++i) {
+            const Buffer& buf = m_bufferTable.LookupRaw(vertexBuffers[i]);
+            u32 totalOffset = vertexBufferOffsets[i] + buf.bufOffset;
+            if (stateCache.SetVertexBuffer(i, vertexBuffers[i], totalOffset))
+                commands.SetVertexBuffer(i, vertexBuffers[i], totalOffset);
+        }
+
+        const u16* cbuffers = item->CBuffers();
+        for (int i = 0; i < item->nCBuffers; ++i) {
+            const Buffer& buf = m_bufferTable.LookupRaw(cbuffers[i]);
+            if (stateCache.SetCBuffer(i, cbuffers[i], buf.bufOffset))
+                commands.SetCBuffer(i, cbuffers[i], buf.bufOffset);
+        }
+
+        if (item->HasInstanceBuffer()) {
+            const Buffer& buf = m_bufferTable.LookupRaw(item->instanceBufferIdx);
+            u32 totalOffset = item->instanceBufferOffset + buf.bufOffset;
+            if (stateCache.SetCBuffer(GPU_INSTANCE_BUFFER_SLOT,
+                                      item->instanceBufferIdx,
+                                      totalOffset)) {
+                commands.SetCBuffer(GPU_INSTANCE_BUFFER_SLOT,
+                                    item->instanceBufferIdx,
+                                    totalOffset);
+            }
+        }
+
+        const u16* textures = item->Textures();
+        for (int i = 0; i < item->nTextures; ++i) {
+            if (stateCache.SetTexture(i, textures[i]))
+                commands.SetTexture(i, textures[i]);
+        }
+
+        const u16* samplers = item->Samplers();
+        for (int i = 0; i < item->nSamplers; ++i) {
+            if (stateCache.SetSampler(i, samplers[i]))
+                commands.SetSampler(i, samplers[i]);
+        }
+
+        if (item->IsIndirect()) {
+            RecordIndirectDraws(item, stateCache, commands);
+            stateCache.CountDrawItem(true, item->count);
+        } else if (item->IsIndexed()) {
+            commands.DrawIndexed(
+                item->GetPrimitiveType(),
+                item->GetIndexType(),
+                item->indexBufferIdx,
+                item->first,
+                item->count,
+                item->indexBufferOffset,
+                item->instanceCount,
+                item->baseVertex,
+                0 // baseInstance
+            );
+            stateCache.CountDrawItem(false, 1);
+            stateCache.CountPrimitives(true, item->GetPrimitiveType(),
+                                       item->count, item->instanceCount);
+        } else {
+            commands.Draw(item->GetPrimitiveType(),
+                          item->first,
+                          item->count,
+                          item->instanceCount);
+            stateCache.CountDrawItem(false, 1);
+            stateCache.CountPrimitives(false, item->GetPrimitiveType(),
+                                       item->count, item->instanceCount);
+        }
+    }
+}
+
+void GpuDeviceNull::RecordIndirectDraws(const GpuDrawItem* item,
+                                        GpuStateCache& stateCache,
+                                        GpuCommandList& commands)
+{
+    // There's no GPU to read the draw arguments, so validate each record the
+    // way a GPU would consume it and expand it into a separate draw.
+    const Buffer& argsBuf = m_bufferTable.LookupRaw(item->drawArgsBufferIdx);
+    if (argsBuf.type != GPU_BUFFER_TYPE_INDIRECT)
+        FATAL("Indirect draw item reads its draw arguments from a buffer "
+              "that isn't of type GPU_BUFFER_TYPE_INDIRECT");
+    u64 argsEnd = (u64)item->first + (u64)item->count * sizeof(GpuDrawArgs);
+    if (argsEnd > argsBuf.size)
+        FATAL("Indirect draw item reads %u draw argument records at offset %u, "
+              "past the end of a %u byte buffer",
+              item->count, item->first, argsBuf.size);
+
+    const Buffer& indexBuf = m_bufferTable.LookupRaw(item->indexBufferIdx);
+    u32 indexSize = (item->GetIndexType() == GPU_INDEX_U32) ? 4 : 2;
+    u32 nIndices = 0;
+    if (item->indexBufferOffset < indexBuf.size)
+        nIndices = (indexBuf.size - item->indexBufferOffset) / indexSize;
+
+    const u8* argsMemory = (const u8*)argsBuf.memory + item->first;
+    for (u32 i = 0; i < item->count; ++i) {
+        GpuDrawArgs args;
+        memcpy(&args, argsMemory + i * sizeof(GpuDrawArgs), sizeof args);
+
+        if ((u64)args.first + args.count > nIndices)
+            FATAL("Draw argument record %u reads indices [%u, %u), but the "
+                  "index buffer only has %u indices",
+                  i, args.first, args.first + args.count, nIndices);
+
+        commands.DrawIndexed(
+            item->GetPrimitiveType(),
+            item->GetIndexType(),
+            item->indexBufferIdx,
+            args.first,
+            args.count,
+            item->indexBufferOffset,
+            args.instanceCount,
+            args.baseVertex,
+            args.baseInstance
+        );
+        stateCache.CountPrimitives(true, item->GetPrimitiveType(),
+                                   args.count, args.instanceCount);
+    }
+}
+
+void GpuDeviceNull::RecordDrawChunk(int index, void* userdata)
+{
+    DrawChunk& chunk = ((DrawChunk*)userdata)[index];
+    chunk.device->RecordDrawItems(chunk.items,
+                                  chunk.nItems,
+                                  chunk.stateCache,
+                                  chunk.commands);
+}
+
 void GpuDeviceNull::Draw(const GpuDrawItem* const* items,
                           int nItems,
                           GpuRenderPassID renderPass,
@@ -645,21 +1200,172 @@ void GpuDeviceNull::Draw(const GpuDrawItem* const* items,
     ASSERT(items != NULL);
     ASSERT(RenderPassExists(renderPass));
 
-    for (int drawItemIndex = 0; drawItemIndex < nItems; ++drawItemIndex) {
-        const GpuDrawItem* item = items[drawItemIndex];
-        ASSERT(item != NULL);
+    // Each call to Draw() corresponds to a new encoder in the other backends,
+    // so nothing is bound at the start.
+    m_stateCache.Reset();
+
+    RecordDrawItems(items, nItems, m_stateCache, m_submittedCommands);
+    m_frameCost += GpuSimulatedGpu::ViewportCost(m_simulatedGpu.GetCost(), viewport);
+}
+
+void GpuDeviceNull::DrawParallel(const GpuDrawItem* const* items,
+                                  int nItems,
+                                  GpuRenderPassID renderPass,
+                                  const GpuViewport& viewport,
+                                  TaskPool& taskPool)
+{
+    int nChunks = GpuDrawChunks::Count(nItems, taskPool.GetNumThreads());
+    if (nChunks == 1) {
+        Draw(items, nItems, renderPass, viewport);
+        return;
     }
+
+    ASSERT(items != NULL);
+    ASSERT(RenderPassExists(renderPass));
+
+    m_drawChunks.resize(nChunks);
+    for (int i = 0; i < nChunks; ++i) {
+        int first, count;
+        GpuDrawChunks::Range(i, nChunks, nItems, &first, &count);
+
+        DrawChunk& chunk = m_drawChunks[i];
+        chunk.device = this;
+        chunk.items = items + first;
+        chunk.nItems = count;
+        chunk.stateCache.Reset();
+        chunk.stateCache.ResetStats();
+        chunk.commands.Clear();
+    }
+
+    taskPool.ParallelFor(nChunks, &GpuDeviceNull::RecordDrawChunk, &m_drawChunks[0]);
+
+    // Stitch the chunks together in order.
+    for (int i = 0; i < nChunks; ++i) {
+        m_submittedCommands.Append(m_drawChunks[i].commands);
+        m_stateCache.MergeStats(m_drawChunks[i].stateCache);
+    }
+    m_frameCost += GpuSimulatedGpu::ViewportCost(m_simulatedGpu.GetCost(), viewport);
 }
 
 void GpuDeviceNull::SceneBegin()
 {
+    m_framePacer.BeginFrame();
+    m_uploadHeap.Reclaim(m_framePacer.GetCompletedFrame());
+    m_submittedCommands.Clear();
+    m_frameCost = 0.0;
+    m_nCostedCommands = 0;
+    m_timerQueries.Resolve(m_framePacer.GetCompletedFrame());
+    UpdatePipelineCompiles();
 }
 
 void GpuDeviceNull::ScenePresent()
 {
+    m_stateFilterStats = m_stateCache.GetStats();
+    m_drawStats = m_stateCache.GetDrawStats();
+    m_stateCache.ResetStats();
+
+    m_frameCost += GpuSimulatedGpu::CommandsCost(m_simulatedGpu.GetCost(),
+                                                 m_submittedCommands,
+                                                 m_nCostedCommands);
+    m_nCostedCommands = m_submittedCommands.NumCommands();
+    m_uploadHeap.EndFrame();
+    m_frameCounters.EndFrame(m_stateFilterStats, m_drawStats, m_uploadHeap.GetStats());
+    m_simulatedGpu.SubmitFrame(m_framePacer.Submit(), m_frameCost);
+
     ++m_frameNumber;
 }
 
+GpuTimerQueries& GpuDeviceNull::GetTimerQueries()
+{
+    return m_timerQueries;
+}
+
+const GpuTimerQueries& GpuDeviceNull::GetTimerQueries() const
+{
+    return m_timerQueries;
+}
+
+void GpuDeviceNull::TimerQueryMark(u32 timestamp)
+{
+    if (timestamp == GpuTimerQueries::NO_TIMESTAMP)
+        return;
+
+    // The time of the marker is the simulated time of the commands before it,
+    // relative to the start of the frame.
+    m_frameCost += GpuSimulatedGpu::CommandsCost(m_simulatedGpu.GetCost(),
+                                                 m_submittedCommands,
+                                                 m_nCostedCommands);
+    m_nCostedCommands = m_submittedCommands.NumCommands();
+
+    u64 frame = m_framePacer.GetSubmittedFrame() + 1;
+    m_timerQueries.GetTimestamps(frame)[timestamp] = (u64)(m_frameCost * 1000.0);
+}
+
+GpuFramePacer& GpuDeviceNull::GetFramePacer()
+{
+    return m_framePacer;
+}
+
+const GpuFramePacer& GpuDeviceNull::GetFramePacer() const
+{
+    return m_framePacer;
+}
+
+GpuMemoryTracker& GpuDeviceNull::GetMemoryTracker()
+{
+    return m_memoryTracker;
+}
+
+const GpuMemoryTracker& GpuDeviceNull::GetMemoryTracker() const
+{
+    return m_memoryTracker;
+}
+
+GpuDeferredDestroyQueue& GpuDeviceNull::GetDeferredDestroyQueue()
+{
+    return m_deferredDestroyQueue;
+}
+
+void GpuDeviceNull::SetSimulatedGpuCost(const GpuSimulatedGpuCost& cost)
+{
+    m_simulatedGpu.SetCost(cost);
+}
+
+const GpuStateFilterStats& GpuDeviceNull::GetStateFilterStats() const
+{
+    return m_stateFilterStats;
+}
+
+const GpuDrawStats& GpuDeviceNull::GetDrawStats() const
+{
+    return m_drawStats;
+}
+
+const GpuFrameStats& GpuDeviceNull::GetFrameStats() const
+{
+    return m_frameCounters.GetStats();
+}
+
+const GpuUploadHeapStats& GpuDeviceNull::GetUploadHeapStats() const
+{
+    return m_uploadHeap.GetStats();
+}
+
+const GpuStateObjectCacheStats& GpuDeviceNull::GetStateObjectCacheStats() const
+{
+    return m_stateObjectCache.GetStats();
+}
+
+GpuTraceWriter& GpuDeviceNull::GetTraceWriter()
+{
+    return m_traceWriter;
+}
+
+const GpuTraceWriter& GpuDeviceNull::GetTraceWriter() const
+{
+    return m_traceWriter;
+}
+
 #ifdef GPUDEVICE_DEBUG_MODE
 void GpuDeviceNull::DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increment)
 {
@@ -668,6 +1374,12 @@ void GpuDeviceNull::DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increm
     if (item->IsIndexed())
         m_bufferTable.LookupRaw(item->indexBufferIdx).dbg_refCount += increment;
 
+    if (item->HasInstanceBuffer())
+        m_bufferTable.LookupRaw(item->instanceBufferIdx).dbg_refCount += increment;
+
+    if (item->IsIndirect())
+        m_bufferTable.LookupRaw(item->drawArgsBufferIdx).dbg_refCount += increment;
+
     u16* vertexBuffers = item->VertexBuffers();
     for (int i = 0; i < item->nVertexBuffers; ++i) {
         m_bufferTable.LookupRaw(vertexBuffers[i]).dbg_refCount += increment;
@@ -704,28 +1416,54 @@ static const GpuDeviceNull* Cast(const GpuDevice* dev) { return (const GpuDevice
 static GpuDeviceNull* Cast(GpuDevice* dev) { return (GpuDeviceNull*)dev; }
 static GpuDevice* Cast(GpuDeviceNull* dev) { return (GpuDevice*)dev; }
 
+// Passes a call that has just been forwarded to the backend on to the trace
+// writer, if a trace is being captured.
+#define TRACE_CALL(device, call) \
+    do { \
+        GpuTraceWriter& writer = Cast(device)->GetTraceWriter(); \
+        if (writer.IsRecording()) \
+            writer.call; \
+    } while (0)
+
 GpuDevice* GpuDevice::Create(const GpuDeviceFormat& format, void* osViewHandle)
 { return Cast(new GpuDeviceNull(format, osViewHandle)); }
 
-void GpuDevice::Destroy(GpuDevice* dev) { delete Cast(dev); }
+void GpuDevice::Destroy(GpuDevice* dev)
+{
+    Cast(dev)->GetDeferredDestroyQueue().DestroyAll(*dev);
+    delete Cast(dev);
+}
 
 void GpuDevice::SetFormat(const GpuDeviceFormat& format)
-{ Cast(this)->SetFormat(format); }
+{
+    Cast(this)->SetFormat(format);
+    TRACE_CALL(this, SetFormat(format));
+}
 
 const GpuDeviceFormat& GpuDevice::GetFormat() const
 { return Cast(this)->GetFormat(); }
 
 void GpuDevice::OnWindowResized()
-{ Cast(this)->OnWindowResized(); }
+{
+    Cast(this)->OnWindowResized();
+    TRACE_CALL(this, OnWindowResized());
+}
 
 bool GpuDevice::ShaderProgramExists(GpuShaderProgramID shaderProgramID) const
 { return Cast(this)->ShaderProgramExists(shaderProgramID); }
 
 GpuShaderProgramID GpuDevice::ShaderProgramCreate(const char* data, size_t length)
-{ return Cast(this)->ShaderProgramCreate(data, length); }
+{
+    GpuShaderProgramID shaderProgramID = Cast(this)->ShaderProgramCreate(data, length);
+    TRACE_CALL(this, ShaderProgramCreate(shaderProgramID, data, length));
+    return shaderProgramID;
+}
 
 void GpuDevice::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
-{ Cast(this)->ShaderProgramDestroy(shaderProgramID); }
+{
+    Cast(this)->ShaderProgramDestroy(shaderProgramID);
+    TRACE_CALL(this, ShaderProgramDestroy(shaderProgramID));
+}
 
 bool GpuDevice::BufferExists(GpuBufferID bufferID) const
 { return Cast(this)->BufferExists(bufferID); }
@@ -735,19 +1473,52 @@ GpuBufferID GpuDevice::BufferCreate(GpuBufferType type,
                                     const void* data,
                                     unsigned size,
                                     int maxUpdatesPerFrame)
-{ return Cast(this)->BufferCreate(type, accessMode, data, size, maxUpdatesPerFrame); }
+{
+    GpuBufferID bufferID = Cast(this)->BufferCreate(
+        type,
+        accessMode,
+        data,
+        size,
+        maxUpdatesPerFrame
+    );
+    TRACE_CALL(this, BufferCreate(bufferID, type, accessMode, data, size, maxUpdatesPerFrame));
+    return bufferID;
+}
 
 void GpuDevice::BufferDestroy(GpuBufferID bufferID)
-{ Cast(this)->BufferDestroy(bufferID); }
+{
+    Cast(this)->BufferDestroy(bufferID);
+    TRACE_CALL(this, BufferDestroy(bufferID));
+}
 
 void GpuDevice::BufferStreamResize(GpuBufferID bufferID, unsigned newSize)
-{ Cast(this)->BufferStreamResize(bufferID, newSize); }
+{
+    Cast(this)->BufferStreamResize(bufferID, newSize);
+    TRACE_CALL(this, BufferStreamResize(bufferID, newSize));
+}
 
 void* GpuDevice::BufferMap(GpuBufferID bufferID)
-{ return Cast(this)->BufferMap(bufferID); }
+{
+    void* memory = Cast(this)->BufferMap(bufferID);
+    TRACE_CALL(this, BufferMap(bufferID, memory));
+    return memory;
+}
 
 void GpuDevice::BufferUnmap(GpuBufferID bufferID)
-{ Cast(this)->BufferUnmap(bufferID); }
+{
+    // Record the contents before the backend can reuse the mapped memory.
+    TRACE_CALL(this, BufferUnmap(bufferID));
+    Cast(this)->BufferUnmap(bufferID);
+}
+
+void GpuDevice::BufferUpload(GpuBufferID bufferID,
+                             unsigned offset,
+                             const void* data,
+                             unsigned size)
+{
+    Cast(this)->BufferUpload(bufferID, offset, data, size);
+    TRACE_CALL(this, BufferUpload(bufferID, offset, data, size));
+}
 
 bool GpuDevice::TextureExists(GpuTextureID textureID) const
 { return Cast(this)->TextureExists(textureID); }
@@ -760,7 +1531,7 @@ GpuTextureID GpuDevice::TextureCreate(GpuTextureType type,
                                       int depthOrArrayLength,
                                       int nMipmapLevels)
 {
-    return Cast(this)->TextureCreate(
+    GpuTextureID textureID = Cast(this)->TextureCreate(
         type,
         pixelFormat,
         flags,
@@ -769,26 +1540,53 @@ GpuTextureID GpuDevice::TextureCreate(GpuTextureType type,
         depthOrArrayLength,
         nMipmapLevels
     );
+    TRACE_CALL(this, TextureCreate(textureID, type, pixelFormat, flags, width, height,
+                              depthOrArrayLength, nMipmapLevels));
+    return textureID;
 }
 
 void GpuDevice::TextureDestroy(GpuTextureID textureID)
-{ return Cast(this)->TextureDestroy(textureID); }
+{
+    Cast(this)->TextureDestroy(textureID);
+    TRACE_CALL(this, TextureDestroy(textureID));
+}
 
 void GpuDevice::TextureUpload(GpuTextureID textureID,
                               const GpuRegion& region,
                               int mipmapLevel,
                               int stride,
                               const void* bytes)
-{ Cast(this)->TextureUpload(textureID, region, mipmapLevel, stride, bytes); }
+{
+    Cast(this)->TextureUpload(textureID, 0, region, mipmapLevel, stride, bytes);
+    TRACE_CALL(this, TextureUpload(textureID, 0, region, mipmapLevel, stride, bytes));
+}
+
+void GpuDevice::TextureUploadSlice(GpuTextureID textureID,
+                                   int slice,
+                                   const GpuRegion& region,
+                                   int mipmapLevel,
+                                   int stride,
+                                   const void* bytes)
+{
+    Cast(this)->TextureUpload(textureID, slice, region, mipmapLevel, stride, bytes);
+    TRACE_CALL(this, TextureUpload(textureID, slice, region, mipmapLevel, stride, bytes));
+}
 
 bool GpuDevice::SamplerExists(GpuSamplerID samplerID) const
 { return Cast(this)->SamplerExists(samplerID); }
 
 GpuSamplerID GpuDevice::SamplerCreate(const GpuSamplerDesc& desc)
-{ return Cast(this)->SamplerCreate(desc); }
+{
+    GpuSamplerID samplerID = Cast(this)->SamplerCreate(desc);
+    TRACE_CALL(this, SamplerCreate(samplerID, desc));
+    return samplerID;
+}
 
 void GpuDevice::SamplerDestroy(GpuSamplerID samplerID)
-{ Cast(this)->SamplerDestroy(samplerID); }
+{
+    Cast(this)->SamplerDestroy(samplerID);
+    TRACE_CALL(this, SamplerDestroy(samplerID));
+}
 
 bool GpuDevice::InputLayoutExists(GpuInputLayoutID inputLayoutID) const
 { return Cast(this)->InputLayoutExists(inputLayoutID); }
@@ -797,40 +1595,213 @@ GpuInputLayoutID GpuDevice::InputLayoutCreate(int nVertexAttribs,
                                               const GpuVertexAttribute* attribs,
                                               int nVertexBuffers,
                                               const unsigned* strides)
-{ return Cast(this)->InputLayoutCreate(nVertexAttribs, attribs, nVertexBuffers, strides); }
+{
+    GpuInputLayoutID inputLayoutID = Cast(this)->InputLayoutCreate(
+        nVertexAttribs,
+        attribs,
+        nVertexBuffers,
+        strides
+    );
+    TRACE_CALL(this, InputLayoutCreate(inputLayoutID, nVertexAttribs, attribs,
+                                  nVertexBuffers, strides));
+    return inputLayoutID;
+}
 
 void GpuDevice::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
-{ Cast(this)->InputLayoutDestroy(inputLayoutID); }
+{
+    Cast(this)->InputLayoutDestroy(inputLayoutID);
+    TRACE_CALL(this, InputLayoutDestroy(inputLayoutID));
+}
 
 bool GpuDevice::PipelineStateExists(GpuPipelineStateID pipelineStateID) const
 { return Cast(this)->PipelineStateExists(pipelineStateID); }
 
 GpuPipelineStateID GpuDevice::PipelineStateCreate(const GpuPipelineStateDesc& state)
-{ return Cast(this)->PipelineStateCreate(state); }
+{
+    GpuPipelineStateID pipelineStateID = Cast(this)->PipelineStateCreate(state);
+    TRACE_CALL(this, PipelineStateCreate(pipelineStateID, state));
+    return pipelineStateID;
+}
+
+GpuPipelineStateID GpuDevice::PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                       GpuPipelineStateID fallback)
+{
+    GpuPipelineStateID pipelineStateID
+        = Cast(this)->PipelineStateCreateAsync(state, fallback);
+    // Recorded as a synchronous create, as the replay can't reproduce the
+    // timing of the compilation anyway.
+    TRACE_CALL(this, PipelineStateCreate(pipelineStateID, state));
+    return pipelineStateID;
+}
+
+bool GpuDevice::PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const
+{ return Cast(this)->PipelineStateIsReady(pipelineStateID); }
 
 void GpuDevice::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
-{ Cast(this)->PipelineStateDestroy(pipelineStateID); }
+{
+    Cast(this)->PipelineStateDestroy(pipelineStateID);
+    TRACE_CALL(this, PipelineStateDestroy(pipelineStateID));
+}
 
 bool GpuDevice::RenderPassExists(GpuRenderPassID renderPassID) const
 { return Cast(this)->RenderPassExists(renderPassID); }
 
 GpuRenderPassID GpuDevice::RenderPassCreate(const GpuRenderPassDesc& pass)
-{ return Cast(this)->RenderPassCreate(pass); }
+{
+    GpuRenderPassID renderPassID = Cast(this)->RenderPassCreate(pass);
+    TRACE_CALL(this, RenderPassCreate(renderPassID, pass));
+    return renderPassID;
+}
 
 void GpuDevice::RenderPassDestroy(GpuRenderPassID renderPassID)
-{ Cast(this)->RenderPassDestroy(renderPassID); }
+{
+    Cast(this)->RenderPassDestroy(renderPassID);
+    TRACE_CALL(this, RenderPassDestroy(renderPassID));
+}
 
 void GpuDevice::Draw(const GpuDrawItem* const* items,
                      int nItems,
                      GpuRenderPassID renderPass,
                      const GpuViewport& viewport)
-{ Cast(this)->Draw(items, nItems, renderPass, viewport); }
+{
+    Cast(this)->Draw(items, nItems, renderPass, viewport);
+    TRACE_CALL(this, Draw(items, nItems, renderPass, viewport, false));
+}
+
+void GpuDevice::DrawParallel(const GpuDrawItem* const* items,
+                             int nItems,
+                             GpuRenderPassID renderPass,
+                             const GpuViewport& viewport,
+                             TaskPool& taskPool)
+{
+    Cast(this)->DrawParallel(items, nItems, renderPass, viewport, taskPool);
+    TRACE_CALL(this, Draw(items, nItems, renderPass, viewport, true));
+}
 
 void GpuDevice::SceneBegin()
-{ Cast(this)->SceneBegin(); }
+{
+    Cast(this)->SceneBegin();
+    TRACE_CALL(this, SceneBegin());
+    Cast(this)->GetDeferredDestroyQueue().DestroyCompleted(*this,
+                                                           GetCompletedFrame());
+}
 
 void GpuDevice::ScenePresent()
-{ Cast(this)->ScenePresent(); }
+{
+    Cast(this)->ScenePresent();
+    TRACE_CALL(this, ScenePresent());
+    // After the frame is recorded, since the callback may destroy resources.
+    Cast(this)->GetMemoryTracker().CheckBudget();
+}
+
+bool GpuDevice::TimerQueryExists(GpuTimerQueryID queryID) const
+{ return Cast(this)->GetTimerQueries().Exists(queryID); }
+
+GpuTimerQueryID GpuDevice::TimerQueryCreate()
+{
+    GpuTimerQueryID queryID = Cast(this)->GetTimerQueries().Create();
+    TRACE_CALL(this, TimerQueryCreate(queryID));
+    return queryID;
+}
+
+void GpuDevice::TimerQueryDestroy(GpuTimerQueryID queryID)
+{
+    Cast(this)->GetTimerQueries().Destroy(queryID);
+    TRACE_CALL(this, TimerQueryDestroy(queryID));
+}
+
+void GpuDevice::TimerQueryBegin(GpuTimerQueryID queryID)
+{
+    u64 frame = GetSubmittedFrame() + 1;
+    Cast(this)->TimerQueryMark(Cast(this)->GetTimerQueries().Begin(queryID, frame));
+    TRACE_CALL(this, TimerQueryBegin(queryID));
+}
+
+void GpuDevice::TimerQueryEnd(GpuTimerQueryID queryID)
+{
+    u64 frame = GetSubmittedFrame() + 1;
+    Cast(this)->TimerQueryMark(Cast(this)->GetTimerQueries().End(queryID, frame));
+    TRACE_CALL(this, TimerQueryEnd(queryID));
+}
+
+bool GpuDevice::TimerQueryGetResult(GpuTimerQueryID queryID,
+                                    float* milliseconds,
+                                    u64* frame) const
+{ return Cast(this)->GetTimerQueries().GetResult(queryID, milliseconds, frame); }
+
+void GpuDevice::SetMaxFramesInFlight(int nFrames)
+{ Cast(this)->GetFramePacer().SetMaxFramesInFlight(nFrames); }
+
+int GpuDevice::GetMaxFramesInFlight() const
+{ return Cast(this)->GetFramePacer().GetMaxFramesInFlight(); }
+
+u64 GpuDevice::GetSubmittedFrame() const
+{ return Cast(this)->GetFramePacer().GetSubmittedFrame(); }
+
+u64 GpuDevice::GetCompletedFrame() const
+{ return Cast(this)->GetFramePacer().GetCompletedFrame(); }
+
+void GpuDevice::WaitForFrame(u64 frame)
+{ Cast(this)->GetFramePacer().WaitForFrame(frame); }
+
+void GpuDevice::ShaderProgramDestroyDeferred(GpuShaderProgramID shaderProgramID)
+{
+    ASSERT(ShaderProgramExists(shaderProgramID));
+    Cast(this)->GetDeferredDestroyQueue().PushShaderProgram(
+        shaderProgramID, GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::BufferDestroyDeferred(GpuBufferID bufferID)
+{
+    ASSERT(BufferExists(bufferID));
+    Cast(this)->GetDeferredDestroyQueue().PushBuffer(bufferID,
+                                                     GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::TextureDestroyDeferred(GpuTextureID textureID)
+{
+    ASSERT(TextureExists(textureID));
+    Cast(this)->GetDeferredDestroyQueue().PushTexture(textureID,
+                                                      GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::SetSimulatedGpuCost(const GpuSimulatedGpuCost& cost)
+{ Cast(this)->SetSimulatedGpuCost(cost); }
+
+const GpuFramePacingStats& GpuDevice::GetFramePacingStats() const
+{ return Cast(this)->GetFramePacer().GetStats(); }
+
+const GpuStateFilterStats& GpuDevice::GetStateFilterStats() const
+{ return Cast(this)->GetStateFilterStats(); }
+
+const GpuDrawStats& GpuDevice::GetDrawStats() const
+{ return Cast(this)->GetDrawStats(); }
+
+const GpuFrameStats& GpuDevice::GetFrameStats() const
+{ return Cast(this)->GetFrameStats(); }
+
+const GpuUploadHeapStats& GpuDevice::GetUploadHeapStats() const
+{ return Cast(this)->GetUploadHeapStats(); }
+
+const GpuStateObjectCacheStats& GpuDevice::GetStateObjectCacheStats() const
+{ return Cast(this)->GetStateObjectCacheStats(); }
+
+const GpuMemoryStats& GpuDevice::GetMemoryStats() const
+{ return Cast(this)->GetMemoryTracker().GetStats(); }
+
+void GpuDevice::SetMemoryBudget(u64 budget,
+                                GpuMemoryBudgetCallback callback,
+                                void* userdata)
+{ Cast(this)->GetMemoryTracker().SetBudget(budget, callback, userdata); }
+
+bool GpuDevice::TraceCaptureBegin(const char* path)
+{ return Cast(this)->GetTraceWriter().Begin(path); }
+
+void GpuDevice::TraceCaptureEnd()
+{ Cast(this)->GetTraceWriter().End(); }
+
+bool GpuDevice::IsTraceCapturing() const
+{ return Cast(this)->GetTraceWriter().IsRecording(); }
 
 #ifdef GPUDEVICE_DEBUG_MODE
 void GpuDevice::RegisterDrawItem(const GpuDrawItem* item)
@@ -0,0 +1,2126 @@
+#ifdef GPUDEVICE_API_SOFT
+
+#include "GpuDevice/GpuDevice.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "Core/IDLookupTable.h"
+#include "Core/Macros.h"
+#include "Core/TaskPool.h"
+#include "GpuDevice/GpuDeferredDestroyQueue.h"
+#include "GpuDevice/GpuDrawChunks.h"
+#include "GpuDevice/GpuDrawItem.h"
+#include "GpuDevice/GpuFrameCounters.h"
+#include "GpuDevice/GpuFramePacer.h"
+#include "GpuDevice/GpuMemoryTracker.h"
+#include "GpuDevice/GpuShaderLoad.h"
+#include "GpuDevice/GpuShaderPermutations.h"
+#include "GpuDevice/GpuSoftRaster.h"
+#include "GpuDevice/GpuSoftShaders.h"
+#include "GpuDevice/GpuSoftTexture.h"
+#include "GpuDevice/GpuStateCache.h"
+#include "GpuDevice/GpuStateObjectCache.h"
+#include "GpuDevice/GpuTimerQueries.h"
+#include "GpuDevice/GpuTraceWriter.h"
+#include "GpuDevice/GpuUploadHeap.h"
+
+#define FOURCC(a, b, c, d) (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+// -----------------------------------------------------------------------------
+// Constants
+// -----------------------------------------------------------------------------
+
+const u32 UPLOAD_HEAP_PAGE_SIZE = 2 * 1024 * 1024; // 2 MB
+
+// Alignment of the data of stream-mode and dynamic-mode buffers.
+const u32 UPLOAD_ALIGNMENT = 16;
+
+// The number of entries in the post-transform vertex cache. Must be a power
+// of two.
+const u32 VERTEX_CACHE_SIZE = 32;
+
+// -----------------------------------------------------------------------------
+// Lookup tables for textures
+// -----------------------------------------------------------------------------
+
+static const bool s_textureTypeIsArray[] = {
+    false, // GPU_TEXTURE_1D
+    true, // GPU_TEXTURE_1D_ARRAY
+    false, // GPU_TEXTURE_2D
+    true, // GPU_TEXTURE_2D_ARRAY
+    false, // GPU_TEXTURE_CUBE
+    false, // GPU_TEXTURE_3D
+};
+
+// -----------------------------------------------------------------------------
+// Lookup tables for vertex formats
+// -----------------------------------------------------------------------------
+
+static const u32 s_vertexAttribSizes[] = {
+    4, // GPU_VERTEX_ATTRIB_HALF2
+    6, // GPU_VERTEX_ATTRIB_HALF3
+    8, // GPU_VERTEX_ATTRIB_HALF4
+    4, // GPU_VERTEX_ATTRIB_FLOAT
+    8, // GPU_VERTEX_ATTRIB_FLOAT2
+    12, // GPU_VERTEX_ATTRIB_FLOAT3
+    16, // GPU_VERTEX_ATTRIB_FLOAT4
+    4, // GPU_VERTEX_ATTRIB_UBYTE4_NORMALIZED
+};
+
+// -----------------------------------------------------------------------------
+// GpuDeviceSoft class declaration
+// -----------------------------------------------------------------------------
+
+class GpuDeviceSoft {
+public:
+    GpuDeviceSoft(const GpuDeviceFormat& format, void* osViewHandle);
+    ~GpuDeviceSoft();
+
+    // Device format
+    void SetFormat(const GpuDeviceFormat& format);
+    const GpuDeviceFormat& GetFormat() const;
+    void OnWindowResized();
+
+    // Shaders
+    bool ShaderProgramExists(GpuShaderProgramID shaderProgramID) const;
+    GpuShaderProgramID ShaderProgramCreate(const char* data, size_t length);
+    void ShaderProgramDestroy(GpuShaderProgramID shaderProgramID);
+
+    // Buffers
+    bool BufferExists(GpuBufferID bufferID) const;
+    GpuBufferID BufferCreate(GpuBufferType type,
+                             GpuBufferAccessMode accessMode,
+                             const void* data,
+                             unsigned size,
+                             int maxUpdatesPerFrame);
+    void BufferDestroy(GpuBufferID bufferID);
+    void BufferStreamResize(GpuBufferID bufferID, unsigned newSize);
+
+    void* BufferMap(GpuBufferID bufferID);
+    void BufferUnmap(GpuBufferID bufferID);
+    void BufferUpload(GpuBufferID bufferID,
+                      unsigned offset,
+                      const void* data,
+                      unsigned size);
+
+    // Textures
+    bool TextureExists(GpuTextureID textureID) const;
+    GpuTextureID TextureCreate(GpuTextureType type,
+                               GpuPixelFormat pixelFormat,
+                               u32 flags,
+                               int width,
+                               int height,
+                               int depthOrArrayLength,
+                               int nMipmapLevels);
+    void TextureDestroy(GpuTextureID textureID);
+    void TextureUpload(GpuTextureID textureID,
+                       int slice,
+                       const GpuRegion& region,
+                       int mipmapLevel,
+                       int stride,
+                       const void* bytes);
+
+    // Samplers
+    bool SamplerExists(GpuSamplerID samplerID) const;
+    GpuSamplerID SamplerCreate(const GpuSamplerDesc& desc);
+    void SamplerDestroy(GpuSamplerID samplerID);
+
+    // Input layouts
+    bool InputLayoutExists(GpuInputLayoutID inputLayoutID) const;
+    GpuInputLayoutID InputLayoutCreate(int nVertexAttribs,
+                                       const GpuVertexAttribute* attribs,
+                                       int nVertexBuffers,
+                                       const unsigned* strides);
+    void InputLayoutDestroy(GpuInputLayoutID inputLayoutID);
+
+    // Pipeline state objects
+    bool PipelineStateExists(GpuPipelineStateID pipelineStateID) const;
+    GpuPipelineStateID PipelineStateCreate(const GpuPipelineStateDesc& state);
+    GpuPipelineStateID PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                GpuPipelineStateID fallback);
+    bool PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const;
+    void PipelineStateDestroy(GpuPipelineStateID pipelineStateID);
+
+    // Render passes
+    bool RenderPassExists(GpuRenderPassID renderPassID) const;
+    GpuRenderPassID RenderPassCreate(const GpuRenderPassDesc& pass);
+    void RenderPassDestroy(GpuRenderPassID renderPassID);
+
+    // Submit an array of draw items
+private:
+    struct DrawSetup;
+
+    void PrepareTarget(GpuRenderPassID renderPass, const GpuViewport& viewport);
+    void ProcessDrawItems(const GpuDrawItem* const* items,
+                          int nItems,
+                          GpuStateCache& stateCache,
+                          GpuSoftBinner& binner);
+    void ProcessIndirectDraws(const GpuDrawItem* item,
+                              const DrawSetup& setup,
+                              GpuStateCache& stateCache,
+                              GpuSoftBinner& binner);
+    void ProcessPrimitives(const DrawSetup& setup,
+                           u32 first,
+                           u32 count,
+                           u32 instanceCount,
+                           i32 baseVertex,
+                           u32 baseInstance,
+                           GpuSoftBinner& binner);
+    static void ProcessDrawChunk(int index, void* userdata);
+    static void RasterizeTile(int index, void* userdata);
+    void Render(const GpuDrawItem* const* items,
+                int nItems,
+                GpuRenderPassID renderPass,
+                const GpuViewport& viewport,
+                int nChunks,
+                TaskPool& taskPool);
+public:
+    void Draw(const GpuDrawItem* const* items,
+              int nItems,
+              GpuRenderPassID renderPass,
+              const GpuViewport& viewport);
+    void DrawParallel(const GpuDrawItem* const* items,
+                      int nItems,
+                      GpuRenderPassID renderPass,
+                      const GpuViewport& viewport,
+                      TaskPool& taskPool);
+
+    // Scene begin/end functions
+    void SceneBegin();
+    void ScenePresent();
+
+    // Timer queries
+    GpuTimerQueries& GetTimerQueries();
+    const GpuTimerQueries& GetTimerQueries() const;
+    void TimerQueryMark(u32 timestamp);
+
+    // Frame pacing
+    GpuFramePacer& GetFramePacer();
+    const GpuFramePacer& GetFramePacer() const;
+
+    // Memory accounting
+    GpuMemoryTracker& GetMemoryTracker();
+    const GpuMemoryTracker& GetMemoryTracker() const;
+
+    // Deferred destruction
+    GpuDeferredDestroyQueue& GetDeferredDestroyQueue();
+
+    // Statistics
+    const GpuStateFilterStats& GetStateFilterStats() const;
+    const GpuDrawStats& GetDrawStats() const;
+    const GpuFrameStats& GetFrameStats() const;
+    const GpuUploadHeapStats& GetUploadHeapStats() const;
+    const GpuStateObjectCacheStats& GetStateObjectCacheStats() const;
+
+    // Trace capture
+    GpuTraceWriter& GetTraceWriter();
+    const GpuTraceWriter& GetTraceWriter() const;
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    void DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increment);
+    void RegisterDrawItem(const GpuDrawItem* item);
+    void UnregisterDrawItem(const GpuDrawItem* item);
+#endif
+
+private:
+    GpuDeviceSoft(const GpuDeviceSoft&);
+    GpuDeviceSoft& operator=(const GpuDeviceSoft&);
+
+    struct PermutationApiData {
+        PermutationApiData()
+            : m_shader(NULL)
+        {}
+
+        bool IsInUse() const
+        {
+            return m_shader != NULL;
+        }
+
+        void LoadVertexShader(GpuDevice& device, const char* code, int length)
+        {
+            m_shader = GpuSoftShaders::Find(code, length);
+            if (!m_shader)
+                FATAL("Unknown software shader '%.*s'", length, code);
+        }
+
+        void LoadPixelShader(GpuDevice& device, const char* code, int length)
+        {
+            // The vertex and pixel shaders of a permutation are always
+            // implemented by the same GpuSoftShader.
+            if (GpuSoftShaders::Find(code, length) != m_shader)
+                FATAL("Software shader '%.*s' doesn't match the vertex shader",
+                      length, code);
+        }
+
+        void Release()
+        {
+            m_shader = NULL;
+        }
+
+        const GpuSoftShader* m_shader;
+    };
+
+    struct ShaderProgram {
+#ifdef GPUDEVICE_DEBUG_MODE
+        int dbg_refCount;
+#endif
+        u32 idxFirstPermutation;
+    };
+
+    struct Buffer {
+#ifdef GPUDEVICE_DEBUG_MODE
+        int dbg_refCount;
+#endif
+        GpuBufferType type;
+        GpuBufferAccessMode accessMode;
+        u32 size;
+        // Static-mode buffers own their memory. The memory of the other
+        // modes is allocated from the upload heap by each update. For
+        // dynamic-mode buffers, it's a persistent allocation that's freed by
+        // the next update.
+        void* memory;
+        GpuUploadAllocation allocation;
+    };
+
+    struct InputLayout {
+#ifdef GPUDEVICE_DEBUG_MODE
+        int dbg_refCount;
+#endif
+        int nVertexAttribs;
+        GpuVertexAttribute attribs[GPU_SOFT_MAX_VERTEX_ATTRIBS];
+        int nVertexBuffers;
+        unsigned strides[GpuStateCache::MAX_VERTEX_BUFFERS];
+    };
+
+    struct PipelineStateObj {
+#ifdef GPUDEVICE_DEBUG_MODE
+        int dbg_refCount;
+        u32 dbg_shaderProgram;
+        u32 dbg_inputLayout;
+#endif
+        u32 depthStencilKey;
+        u32 rasterStateKey;
+
+        const GpuSoftShader* shader;
+        // A copy of the input layout, so that draws don't need to look it up.
+        InputLayout inputLayout;
+        GpuCompareFunction depthCompare;
+        bool depthWritesEnabled;
+        GpuCullMode cullMode;
+        GpuWindingOrder frontFaceWinding;
+        bool blendingEnabled;
+        GpuBlendFactor blendSrcFactor;
+        GpuBlendFactor blendDstFactor;
+    };
+
+    struct RenderPassObj {
+        bool usesRenderTarget;
+        u32 colorTarget;
+        u32 depthTarget;
+        bool clearColor;
+        u32 clearColorValue;
+        bool clearDepth;
+        float clearDepthValue;
+    };
+
+    struct Texture {
+#ifdef GPUDEVICE_DEBUG_MODE
+        int dbg_refCount;
+#endif
+        GpuSoftTexture soft;
+        u64 size;
+        GpuMemoryCategory memoryCategory;
+        GpuPixelFormat pixelFormat;
+    };
+
+    struct Sampler {
+#ifdef GPUDEVICE_DEBUG_MODE
+        int dbg_refCount;
+#endif
+        // Heap allocated, since GpuSamplerDesc isn't a POD type.
+        GpuSamplerDesc* desc;
+    };
+
+    // Everything needed to fetch and shade the vertices of a draw item.
+    struct DrawSetup {
+        const PipelineStateObj* pipelineState;
+        const GpuSoftResources* resources;
+        u32 drawState;
+        GpuPrimitiveType primitiveType;
+
+        const u8* vertexStreams[GpuStateCache::MAX_VERTEX_BUFFERS];
+        u32 vertexStreamSizes[GpuStateCache::MAX_VERTEX_BUFFERS];
+
+        // NULL for draw items that aren't indexed.
+        const u8* indices;
+        GpuIndexType indexType;
+        u32 nIndices;
+    };
+
+    struct DrawChunk {
+        GpuDeviceSoft* device;
+        const GpuDrawItem* const* items;
+        int nItems;
+        GpuStateCache stateCache;
+        GpuSoftBinner binner;
+    };
+
+    GpuDeviceFormat m_deviceFormat;
+
+    int m_frameNumber;
+    // The time spent rendering the current frame, which stands in for the
+    // GPU time.
+    double m_renderMs;
+
+    GpuShaderPermutations<PermutationApiData> m_permutations;
+    IDLookupTable<ShaderProgram, GpuShaderProgramID::Type, 16, 16> m_shaderProgramTable;
+    IDLookupTable<Buffer, GpuBufferID::Type, 16, 16> m_bufferTable;
+    IDLookupTable<PipelineStateObj, GpuPipelineStateID::Type, 16, 16> m_pipelineStateTable;
+    IDLookupTable<RenderPassObj, GpuRenderPassID::Type, 16, 16> m_renderPassTable;
+    IDLookupTable<InputLayout, GpuInputLayoutID::Type, 16, 16> m_inputLayoutTable;
+    IDLookupTable<Texture, GpuTextureID::Type, 16, 16> m_textureTable;
+    IDLookupTable<Sampler, GpuSamplerID::Type, 16, 16> m_samplerTable;
+
+    GpuStateCache m_stateCache;
+    GpuStateFilterStats m_stateFilterStats;
+    GpuDrawStats m_drawStats;
+    GpuFrameCounters m_frameCounters;
+    GpuMemoryTracker m_memoryTracker;
+
+    GpuTraceWriter m_traceWriter;
+
+    GpuFramePacer m_framePacer;
+    GpuTimerQueries m_timerQueries;
+    GpuDeferredDestroyQueue m_deferredDestroyQueue;
+    GpuUploadHeap m_uploadHeap;
+    GpuStateObjectCache m_stateObjectCache;
+
+    GpuSoftTexture m_backbuffer;
+    GpuSoftTexture m_depthBuffer;
+
+    // The target of the Draw() call in progress.
+    GpuSoftTarget m_target;
+    std::vector<DrawChunk> m_drawChunks;
+    std::vector<const GpuSoftBinner*> m_binners;
+
+    // Rasterizes the tiles of Draw() calls. DrawParallel() calls use the task
+    // pool that they are given instead.
+    TaskPool m_taskPool;
+
+    int m_dbg_shaderCount;
+    int m_dbg_bufferCount;
+    int m_dbg_textureCount;
+    int m_dbg_samplerCount;
+    int m_dbg_psoCount;
+    int m_dbg_renderPassCount;
+    int m_dbg_inputLayoutCount;
+};
+
+// -----------------------------------------------------------------------------
+// Helper functions
+// -----------------------------------------------------------------------------
+
+static void AllocateBackbuffers(const GpuDeviceFormat& format,
+                                GpuSoftTexture* backbuffer,
+                                GpuSoftTexture* depthBuffer)
+{
+    ASSERT(format.resolutionX > 0);
+    ASSERT(format.resolutionY > 0);
+
+    backbuffer->Allocate(GPU_PIXEL_FORMAT_BGRA8888,
+                         format.resolutionX,
+                         format.resolutionY,
+                         1,
+                         1);
+
+    depthBuffer->memory = NULL;
+    if (format.pixelDepthFormat != GPU_PIXEL_DEPTH_FORMAT_NONE) {
+        depthBuffer->Allocate(GPU_PIXEL_FORMAT_DEPTH_32,
+                              format.resolutionX,
+                              format.resolutionY,
+                              1,
+                              1);
+    }
+}
+
+static u32 PackClearColor(const GpuColor& color)
+{
+    float channels[4] = {color.b, color.g, color.r, color.a};
+    u32 packed = 0;
+    for (int i = 0; i < 4; ++i) {
+        float c = channels[i];
+        c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+        packed |= (u32)(c * 255.0f + 0.5f) << (8 * i);
+    }
+    return packed;
+}
+
+static float HalfToFloat(u16 h)
+{
+    u32 sign = (u32)(h & 0x8000) << 16;
+    u32 exponent = (h >> 10) & 0x1F;
+    u32 mantissa = h & 0x3FF;
+    u32 bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Denormal: renormalize the mantissa.
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+static void ReadVertexAttrib(GpuVertexAttribFormat format, const u8* src, float* dst)
+{
+    switch (format) {
+        case GPU_VERTEX_ATTRIB_HALF2:
+        case GPU_VERTEX_ATTRIB_HALF3:
+        case GPU_VERTEX_ATTRIB_HALF4: {
+            int n = 2 + (format - GPU_VERTEX_ATTRIB_HALF2);
+            for (int i = 0; i < n; ++i) {
+                u16 h;
+                memcpy(&h, src + 2 * i, sizeof h);
+                dst[i] = HalfToFloat(h);
+            }
+            break;
+        }
+        case GPU_VERTEX_ATTRIB_FLOAT:
+        case GPU_VERTEX_ATTRIB_FLOAT2:
+        case GPU_VERTEX_ATTRIB_FLOAT3:
+        case GPU_VERTEX_ATTRIB_FLOAT4:
+            memcpy(dst, src, s_vertexAttribSizes[format]);
+            break;
+        case GPU_VERTEX_ATTRIB_UBYTE4_NORMALIZED:
+            for (int i = 0; i < 4; ++i)
+                dst[i] = (float)src[i] * (1.0f / 255.0f);
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// GpuDeviceSoft implementation
+// -----------------------------------------------------------------------------
+
+// The userdata is the device's GpuMemoryTracker.
+static void* CreateUploadPage(u32 size, void** cpuAddress, void* userdata)
+{
+    ((GpuMemoryTracker*)userdata)->Add(GPU_MEMORY_UPLOAD_HEAP, size);
+    *cpuAddress = malloc(size);
+    return *cpuAddress;
+}
+
+static void DestroyUploadPage(void* page, u32 size, void* userdata)
+{
+    ((GpuMemoryTracker*)userdata)->Remove(GPU_MEMORY_UPLOAD_HEAP, size);
+    free(page);
+}
+
+GpuDeviceSoft::GpuDeviceSoft(const GpuDeviceFormat& format, void* osViewHandle)
+    : m_deviceFormat(format)
+    , m_frameNumber(0)
+    , m_renderMs(0.0)
+
+    , m_permutations()
+    , m_shaderProgramTable()
+    , m_bufferTable()
+    , m_pipelineStateTable()
+    , m_renderPassTable()
+    , m_inputLayoutTable()
+
+    , m_stateCache()
+    , m_stateFilterStats(m_stateCache.GetStats())
+    , m_drawStats(m_stateCache.GetDrawStats())
+    , m_frameCounters()
+    , m_memoryTracker()
+    , m_traceWriter()
+
+    , m_framePacer()
+    , m_timerQueries()
+    , m_deferredDestroyQueue()
+    , m_uploadHeap(UPLOAD_HEAP_PAGE_SIZE, &CreateUploadPage, &DestroyUploadPage,
+                   &m_memoryTracker)
+    , m_stateObjectCache()
+
+    , m_backbuffer()
+    , m_depthBuffer()
+    , m_target()
+    , m_drawChunks()
+    , m_binners()
+    , m_taskPool()
+
+    , m_dbg_shaderCount(0)
+    , m_dbg_bufferCount(0)
+    , m_dbg_textureCount(0)
+    , m_dbg_samplerCount(0)
+    , m_dbg_psoCount(0)
+    , m_dbg_renderPassCount(0)
+    , m_dbg_inputLayoutCount(0)
+{
+    AllocateBackbuffers(m_deviceFormat, &m_backbuffer, &m_depthBuffer);
+}
+
+GpuDeviceSoft::~GpuDeviceSoft()
+{
+    m_backbuffer.Free();
+    m_depthBuffer.Free();
+
+    if (m_dbg_shaderCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d shader(s) not destroyed\n",
+                m_dbg_shaderCount);
+    }
+    if (m_dbg_bufferCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d buffer(s) not destroyed\n",
+                m_dbg_bufferCount);
+    }
+    if (m_dbg_textureCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d textures(s) not destroyed\n",
+                m_dbg_textureCount);
+    }
+    if (m_dbg_samplerCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d sampler(s) not destroyed\n",
+                m_dbg_samplerCount);
+    }
+    if (m_dbg_psoCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d pipeline state object(s) "
+                "not destroyed\n", m_dbg_psoCount);
+    }
+    if (m_dbg_renderPassCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d render pass object(s) "
+                "not destroyed\n", m_dbg_renderPassCount);
+    }
+    if (m_dbg_inputLayoutCount != 0) {
+        fprintf(stderr,
+                "GpuDeviceSoft: warning - %d input layout(s) "
+                "not destroyed\n", m_dbg_inputLayoutCount);
+    }
+}
+
+void GpuDeviceSoft::SetFormat(const GpuDeviceFormat& format)
+{
+    m_deviceFormat = format;
+
+    m_backbuffer.Free();
+    m_depthBuffer.Free();
+    AllocateBackbuffers(m_deviceFormat, &m_backbuffer, &m_depthBuffer);
+}
+
+const GpuDeviceFormat& GpuDeviceSoft::GetFormat() const
+{
+    return m_deviceFormat;
+}
+
+void GpuDeviceSoft::OnWindowResized()
+{
+}
+
+bool GpuDeviceSoft::ShaderProgramExists(GpuShaderProgramID shaderProgramID) const
+{
+    return m_shaderProgramTable.Has(shaderProgramID);
+}
+
+GpuShaderProgramID GpuDeviceSoft::ShaderProgramCreate(const char* data, size_t length)
+{
+    GpuShaderProgramID shaderProgramID(m_shaderProgramTable.Add());
+    ShaderProgram& program = m_shaderProgramTable.Lookup(shaderProgramID);
+#ifdef GPUDEVICE_DEBUG_MODE
+    program.dbg_refCount = 0;
+#endif
+
+    program.idxFirstPermutation = GpuShaderLoad::LoadShader(
+        data,
+        (int)length,
+        FOURCC('S', 'O', 'F', 'T'),
+        *(GpuDevice*)this,
+        m_permutations
+    );
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_SHADER_PROGRAM);
+    ++m_dbg_shaderCount;
+
+    return shaderProgramID;
+}
+
+void GpuDeviceSoft::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
+{
+    ASSERT(ShaderProgramExists(shaderProgramID));
+    ShaderProgram& program = m_shaderProgramTable.Lookup(shaderProgramID);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    if (program.dbg_refCount != 0) {
+        FATAL("Can't destroy shader program as it still has %d pipeline state "
+              "object(s) referencing it", program.dbg_refCount);
+    }
+#endif
+
+    m_permutations.ReleaseChain(program.idxFirstPermutation);
+
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_SHADER_PROGRAM, shaderProgramID);
+    m_shaderProgramTable.Remove(shaderProgramID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_SHADER_PROGRAM);
+    --m_dbg_shaderCount;
+}
+
+bool GpuDeviceSoft::BufferExists(GpuBufferID bufferID) const
+{
+    return m_bufferTable.Has(bufferID);
+}
+
+GpuBufferID GpuDeviceSoft::BufferCreate(GpuBufferType type,
+                                         GpuBufferAccessMode accessMode,
+                                         const void* data,
+                                         unsigned size,
+                                         int maxUpdatesPerFrame)
+{
+    GpuBufferID bufferID(m_bufferTable.Add());
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+#ifdef GPUDEVICE_DEBUG_MODE
+    buffer.dbg_refCount = 0;
+#endif
+
+    buffer.type = type;
+    buffer.accessMode = accessMode;
+    buffer.size = size;
+    buffer.memory = NULL;
+
+    switch (accessMode) {
+        case GPU_BUFFER_ACCESS_STATIC:
+            buffer.memory = malloc(size);
+            m_memoryTracker.Add(GPU_MEMORY_BUFFERS, size);
+            break;
+        case GPU_BUFFER_ACCESS_DYNAMIC:
+            buffer.memory = m_uploadHeap.AllocatePersistent(size, UPLOAD_ALIGNMENT,
+                                                            &buffer.allocation);
+            break;
+        case GPU_BUFFER_ACCESS_STREAM:
+            break; // Allocated when the buffer is mapped.
+        default:
+            ASSERT(!"Unknown GpuBufferAccessMode");
+            break;
+    }
+    if (data && buffer.memory)
+        memcpy(buffer.memory, data, size);
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_BUFFER);
+    ++m_dbg_bufferCount;
+
+    return bufferID;
+}
+
+void GpuDeviceSoft::BufferStreamResize(GpuBufferID bufferID, unsigned newSize)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
+
+    buffer.size = newSize;
+}
+
+void GpuDeviceSoft::BufferDestroy(GpuBufferID bufferID)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    if (buffer.dbg_refCount != 0) {
+        FATAL("Can't destroy buffer as it still has %d draw "
+              "item(s) referencing it", buffer.dbg_refCount);
+    }
+#endif
+
+    switch (buffer.accessMode) {
+        case GPU_BUFFER_ACCESS_STATIC:
+            free(buffer.memory);
+            m_memoryTracker.Remove(GPU_MEMORY_BUFFERS, buffer.size);
+            break;
+        case GPU_BUFFER_ACCESS_DYNAMIC:
+            m_uploadHeap.FreePersistent(buffer.allocation);
+            break;
+        default:
+            break;
+    }
+
+    m_bufferTable.Remove(bufferID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_BUFFER);
+    --m_dbg_bufferCount;
+}
+
+void* GpuDeviceSoft::BufferMap(GpuBufferID bufferID)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC ||
+           buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
+
+    // Draw() has finished with the previous contents by the time it returns,
+    // but the data is allocated from the upload heap as in the other backends
+    // so that the heap statistics are comparable.
+    if (buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC) {
+        m_uploadHeap.FreePersistent(buffer.allocation);
+        buffer.memory = m_uploadHeap.AllocatePersistent(buffer.size, UPLOAD_ALIGNMENT,
+                                                        &buffer.allocation);
+    } else {
+        buffer.memory = m_uploadHeap.Allocate(buffer.size, UPLOAD_ALIGNMENT,
+                                              &buffer.allocation);
+    }
+    m_frameCounters.CountBufferMap(buffer.size);
+    return buffer.memory;
+}
+
+void GpuDeviceSoft::BufferUnmap(GpuBufferID bufferID)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_DYNAMIC ||
+           buffer.accessMode == GPU_BUFFER_ACCESS_STREAM);
+}
+
+void GpuDeviceSoft::BufferUpload(GpuBufferID bufferID,
+                                 unsigned offset,
+                                 const void* data,
+                                 unsigned size)
+{
+    ASSERT(BufferExists(bufferID));
+    Buffer& buffer = m_bufferTable.Lookup(bufferID);
+    ASSERT(buffer.accessMode == GPU_BUFFER_ACCESS_STATIC);
+    ASSERT((u64)offset + size <= buffer.size);
+
+    // Draw() has finished reading the buffer by the time it returns, so the
+    // data can be written in place.
+    memcpy((u8*)buffer.memory + offset, data, size);
+}
+
+bool GpuDeviceSoft::TextureExists(GpuTextureID textureID) const
+{
+    return m_textureTable.Has(textureID);
+}
+
+GpuTextureID GpuDeviceSoft::TextureCreate(GpuTextureType type,
+                                           GpuPixelFormat pixelFormat,
+                                           u32 flags,
+                                           int width,
+                                           int height,
+                                           int depthOrArrayLength,
+                                           int nMipmapLevels)
+{
+    ASSERT((s_textureTypeIsArray[type] ||
+            (type == GPU_TEXTURE_3D) ||
+            (depthOrArrayLength == 1)) &&
+           "A non-3D, non-array texture must have depthOrArrayLength == 1");
+    ASSERT(width > 0);
+    ASSERT(height > 0);
+    ASSERT(depthOrArrayLength > 0);
+    ASSERT(nMipmapLevels > 0);
+    ASSERT(!(flags & GPU_TEXTURE_FLAG_RENDER_TARGET) ||
+           pixelFormat == GPU_PIXEL_FORMAT_BGRA8888 ||
+           pixelFormat == GPU_PIXEL_FORMAT_DEPTH_32 ||
+           pixelFormat == GPU_PIXEL_FORMAT_DEPTH_24_STENCIL_8);
+
+    GpuTextureID textureID(m_textureTable.Add());
+    Texture& tex = m_textureTable.Lookup(textureID);
+#ifdef GPUDEVICE_DEBUG_MODE
+    tex.dbg_refCount = 0;
+#endif
+
+    tex.soft.Allocate(pixelFormat, width, height,
+                      s_textureTypeIsArray[type] ? depthOrArrayLength : 1,
+                      nMipmapLevels);
+    tex.size = GpuDevice::TextureSizeInBytes(type, pixelFormat, width, height,
+                                             depthOrArrayLength, nMipmapLevels);
+    tex.memoryCategory = (flags & GPU_TEXTURE_FLAG_RENDER_TARGET)
+        ? GPU_MEMORY_RENDER_TARGETS : GPU_MEMORY_TEXTURES;
+    tex.pixelFormat = pixelFormat;
+
+    m_memoryTracker.Add(tex.memoryCategory, tex.size);
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_TEXTURE);
+    ++m_dbg_textureCount;
+
+    return textureID;
+}
+
+void GpuDeviceSoft::TextureDestroy(GpuTextureID textureID)
+{
+    ASSERT(TextureExists(textureID));
+    Texture& tex = m_textureTable.Lookup(textureID);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    if (tex.dbg_refCount != 0) {
+        FATAL("Can't destroy texture as it still has %d draw "
+              "item(s) referencing it", tex.dbg_refCount);
+    }
+#endif
+
+    tex.soft.Free();
+
+    m_memoryTracker.Remove(tex.memoryCategory, tex.size);
+
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_TEXTURE, textureID);
+    m_textureTable.Remove(textureID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_TEXTURE);
+    --m_dbg_textureCount;
+}
+
+void GpuDeviceSoft::TextureUpload(GpuTextureID textureID,
+                                   int slice,
+                                   const GpuRegion& region,
+                                   int mipmapLevel,
+                                   int stride,
+                                   const void* bytes)
+{
+    ASSERT(TextureExists(textureID));
+    Texture& tex = m_textureTable.Lookup(textureID);
+    ASSERT(0 <= mipmapLevel && mipmapLevel < tex.soft.nMipmapLevels);
+    m_frameCounters.CountTextureUpload(tex.pixelFormat, region);
+
+    // The slices of cube and 3D textures other than the first aren't stored.
+    if (slice >= tex.soft.nSlices)
+        return;
+
+    tex.soft.Upload(slice, region, mipmapLevel, stride, bytes);
+}
+
+bool GpuDeviceSoft::SamplerExists(GpuSamplerID samplerID) const
+{
+    return m_samplerTable.Has(samplerID);
+}
+
+GpuSamplerID GpuDeviceSoft::SamplerCreate(const GpuSamplerDesc& desc)
+{
+    ASSERT(1 <= desc.maxAnisotropy && desc.maxAnisotropy <= 16);
+
+    GpuStateObjectKey key(desc);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuSamplerID(existingID);
+
+    GpuSamplerID samplerID(m_samplerTable.Add());
+    Sampler& sampler = m_samplerTable.Lookup(samplerID);
+#ifdef GPUDEVICE_DEBUG_MODE
+    sampler.dbg_refCount = 0;
+#endif
+
+    sampler.desc = new GpuSamplerDesc(desc);
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_SAMPLER);
+    ++m_dbg_samplerCount;
+
+    m_stateObjectCache.Insert(key, samplerID);
+
+    return samplerID;
+}
+
+void GpuDeviceSoft::SamplerDestroy(GpuSamplerID samplerID)
+{
+    ASSERT(SamplerExists(samplerID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_SAMPLER, samplerID))
+        return;
+
+    Sampler& sampler = m_samplerTable.Lookup(samplerID);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    if (sampler.dbg_refCount != 0) {
+        FATAL("Can't destroy sampler as it still has %d draw "
+              "item(s) referencing it", sampler.dbg_refCount);
+    }
+#endif
+
+    delete sampler.desc;
+
+    m_samplerTable.Remove(samplerID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_SAMPLER);
+    --m_dbg_samplerCount;
+}
+
+bool GpuDeviceSoft::InputLayoutExists(GpuInputLayoutID inputLayoutID) const
+{
+    return m_inputLayoutTable.Has(inputLayoutID);
+}
+
+GpuInputLayoutID GpuDeviceSoft::InputLayoutCreate(int nVertexAttribs,
+                                                   const GpuVertexAttribute* attribs,
+                                                   int nVertexBuffers,
+                                                   const unsigned* strides)
+{
+    ASSERT(0 <= nVertexAttribs && nVertexAttribs <= GPU_SOFT_MAX_VERTEX_ATTRIBS);
+    ASSERT(0 <= nVertexBuffers && nVertexBuffers <= GpuStateCache::MAX_VERTEX_BUFFERS);
+
+    GpuStateObjectKey key(nVertexAttribs, attribs, nVertexBuffers, strides);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuInputLayoutID(existingID);
+
+    GpuInputLayoutID inputLayoutID(m_inputLayoutTable.Add());
+    InputLayout& layout = m_inputLayoutTable.Lookup(inputLayoutID);
+#ifdef GPUDEVICE_DEBUG_MODE
+    layout.dbg_refCount = 0;
+#endif
+
+    layout.nVertexAttribs = nVertexAttribs;
+    for (int i = 0; i < nVertexAttribs; ++i) {
+        ASSERT(0 <= attribs[i].bufferSlot && attribs[i].bufferSlot < nVertexBuffers);
+        layout.attribs[i] = attribs[i];
+    }
+    layout.nVertexBuffers = nVertexBuffers;
+    for (int i = 0; i < nVertexBuffers; ++i)
+        layout.strides[i] = strides[i];
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_INPUT_LAYOUT);
+    ++m_dbg_inputLayoutCount;
+
+    m_stateObjectCache.Insert(key, inputLayoutID);
+
+    return inputLayoutID;
+}
+
+void GpuDeviceSoft::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
+{
+    ASSERT(InputLayoutExists(inputLayoutID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_INPUT_LAYOUT, inputLayoutID))
+        return;
+
+    InputLayout& layout = m_inputLayoutTable.Lookup(inputLayoutID);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    if (layout.dbg_refCount != 0) {
+        FATAL("Can't destroy input layout as it still has %d pipeline state "
+              "object(s) referencing it", layout.dbg_refCount);
+    }
+#endif
+
+    m_stateObjectCache.PurgeResource(GPU_RESOURCE_INPUT_LAYOUT, inputLayoutID);
+    m_inputLayoutTable.Remove(inputLayoutID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_INPUT_LAYOUT);
+    --m_dbg_inputLayoutCount;
+}
+
+bool GpuDeviceSoft::PipelineStateExists(GpuPipelineStateID pipelineStateID) const
+{
+    return m_pipelineStateTable.Has(pipelineStateID);
+}
+
+GpuPipelineStateID GpuDeviceSoft::PipelineStateCreate(const GpuPipelineStateDesc& state)
+{
+    ASSERT(ShaderProgramExists(state.shaderProgram));
+    ASSERT(InputLayoutExists(state.inputLayout));
+
+    GpuStateObjectKey key(state);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuPipelineStateID(existingID);
+
+    GpuPipelineStateID pipelineStateID(m_pipelineStateTable.Add());
+    PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
+#ifdef GPUDEVICE_DEBUG_MODE
+    obj.dbg_refCount = 0;
+    obj.dbg_shaderProgram = state.shaderProgram;
+    obj.dbg_inputLayout = state.inputLayout;
+    ++m_shaderProgramTable.Lookup(state.shaderProgram).dbg_refCount;
+    ++m_inputLayoutTable.Lookup(state.inputLayout).dbg_refCount;
+#endif
+
+    obj.depthStencilKey = GpuStateCache::DepthStencilKey(state);
+    obj.rasterStateKey = GpuStateCache::RasterStateKey(state);
+
+    const ShaderProgram& program = m_shaderProgramTable.Lookup(state.shaderProgram);
+    u32 idxPermutation = m_permutations.FindPermutationForStates(
+        program.idxFirstPermutation,
+        state.shaderStateBitfield
+    );
+    obj.shader = m_permutations.Lookup(idxPermutation).program.m_shader;
+
+    obj.inputLayout = m_inputLayoutTable.Lookup(state.inputLayout);
+    obj.depthCompare = state.depthCompare;
+    obj.depthWritesEnabled = state.depthWritesEnabled;
+    obj.cullMode = state.cullMode;
+    obj.frontFaceWinding = state.frontFaceWinding;
+    obj.blendingEnabled = state.blendingEnabled;
+    obj.blendSrcFactor = state.blendSrcFactor;
+    obj.blendDstFactor = state.blendDstFactor;
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_PIPELINE_STATE);
+    ++m_dbg_psoCount;
+
+    m_stateObjectCache.Insert(key, pipelineStateID);
+
+    return pipelineStateID;
+}
+
+GpuPipelineStateID GpuDeviceSoft::PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                           GpuPipelineStateID fallback)
+{
+    // Creating a pipeline state object only looks up the shader permutation,
+    // so there's nothing worth moving to another thread.
+    return PipelineStateCreate(state);
+}
+
+bool GpuDeviceSoft::PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const
+{
+    ASSERT(PipelineStateExists(pipelineStateID));
+    return true;
+}
+
+void GpuDeviceSoft::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
+{
+    ASSERT(PipelineStateExists(pipelineStateID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_PIPELINE_STATE, pipelineStateID))
+        return;
+
+    PipelineStateObj& obj = m_pipelineStateTable.Lookup(pipelineStateID);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    if (obj.dbg_refCount != 0) {
+        FATAL("Can't destroy pipeline state object as it still has %d draw "
+              "item(s) referencing it", obj.dbg_refCount);
+    }
+    --m_shaderProgramTable.Lookup(obj.dbg_shaderProgram).dbg_refCount;
+    --m_inputLayoutTable.Lookup(obj.dbg_inputLayout).dbg_refCount;
+#endif
+
+    m_pipelineStateTable.Remove(pipelineStateID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_PIPELINE_STATE);
+    --m_dbg_psoCount;
+}
+
+bool GpuDeviceSoft::RenderPassExists(GpuRenderPassID renderPassID) const
+{
+    return m_renderPassTable.Has(renderPassID);
+}
+
+GpuRenderPassID GpuDeviceSoft::RenderPassCreate(const GpuRenderPassDesc& pass)
+{
+    ASSERT(pass.numRenderTargets >= 0);
+    ASSERT(pass.numRenderTargets <= 1 &&
+           "The software backend only supports one render target");
+
+    GpuStateObjectKey key(pass);
+    if (u32 existingID = m_stateObjectCache.Acquire(key))
+        return GpuRenderPassID(existingID);
+
+    GpuRenderPassID renderPassID(m_renderPassTable.Add());
+    RenderPassObj& obj = m_renderPassTable.Lookup(renderPassID);
+    obj.usesRenderTarget = false;
+    obj.colorTarget = 0;
+
+    if (pass.numRenderTargets > 0) {
+        ASSERT(pass.renderTargets != NULL);
+        ASSERT(pass.renderTargets[0] != 0);
+        obj.usesRenderTarget = true;
+        obj.colorTarget = pass.renderTargets[0];
+    }
+
+    // Store actions are ignored, since the targets are in CPU memory.
+    GpuRenderLoadAction colorLoadAction = GpuRenderPassDesc::DEFAULT_LOAD_ACTION;
+    if (pass.colorLoadActions)
+        colorLoadAction = pass.colorLoadActions[0];
+    GpuColor clearColor = {0.0f, 0.0f, 0.0f, 0.0f};
+    if (pass.clearColors)
+        clearColor = pass.clearColors[0];
+    obj.clearColor = (colorLoadAction == GPU_RENDER_LOAD_ACTION_CLEAR);
+    obj.clearColorValue = PackClearColor(clearColor);
+
+    obj.depthTarget = pass.depthStencilTarget;
+    obj.clearDepth = (pass.depthStencilLoadAction == GPU_RENDER_LOAD_ACTION_CLEAR);
+    obj.clearDepthValue = pass.clearDepth;
+
+    m_frameCounters.CountCreate(GPU_RESOURCE_RENDER_PASS);
+    ++m_dbg_renderPassCount;
+
+    m_stateObjectCache.Insert(key, renderPassID);
+
+    return renderPassID;
+}
+
+void GpuDeviceSoft::RenderPassDestroy(GpuRenderPassID renderPassID)
+{
+    ASSERT(RenderPassExists(renderPassID));
+    if (!m_stateObjectCache.Release(GPU_STATE_OBJECT_RENDER_PASS, renderPassID))
+        return;
+
+    m_renderPassTable.Remove(renderPassID);
+
+    m_frameCounters.CountDestroy(GPU_RESOURCE_RENDER_PASS);
+    --m_dbg_renderPassCount;
+}
+
+void GpuDeviceSoft::PrepareTarget(GpuRenderPassID renderPass, const GpuViewport& viewport)
+{
+    const RenderPassObj& pass = m_renderPassTable.Lookup(renderPass);
+    GpuSoftTarget& target = m_target;
+
+    if (pass.usesRenderTarget) {
+        ASSERT(TextureExists(GpuTextureID(pass.colorTarget)));
+        target.color = &m_textureTable.Lookup(GpuTextureID(pass.colorTarget)).soft.mips[0];
+        target.depth = NULL;
+        if (pass.depthTarget != 0) {
+            ASSERT(TextureExists(GpuTextureID(pass.depthTarget)));
+            target.depth = &m_textureTable.Lookup(GpuTextureID(pass.depthTarget)).soft.mips[0];
+        }
+    } else {
+        target.color = &m_backbuffer.mips[0];
+        target.depth = m_depthBuffer.memory ? &m_depthBuffer.mips[0] : NULL;
+    }
+
+    int width = target.color->width;
+    int height = target.color->height;
+    if (target.depth) {
+        width = target.depth->width < width ? target.depth->width : width;
+        height = target.depth->height < height ? target.depth->height : height;
+    }
+
+    target.viewport = viewport;
+    target.scissorX0 = viewport.x < width ? viewport.x : width;
+    target.scissorY0 = viewport.y < height ? viewport.y : height;
+    target.scissorX1 = viewport.x + viewport.width < width
+                     ? viewport.x + viewport.width : width;
+    target.scissorY1 = viewport.y + viewport.height < height
+                     ? viewport.y + viewport.height : height;
+
+    target.nTilesX = (width + GPU_SOFT_TILE_SIZE - 1) / GPU_SOFT_TILE_SIZE;
+    target.nTilesY = (height + GPU_SOFT_TILE_SIZE - 1) / GPU_SOFT_TILE_SIZE;
+
+    target.clearColor = pass.clearColor;
+    target.clearColorValue = pass.clearColorValue;
+    target.clearDepth = pass.clearDepth;
+    target.clearDepthValue = pass.clearDepthValue;
+}
+
+void GpuDeviceSoft::ProcessDrawItems(const GpuDrawItem* const* items,
+                                     int nItems,
+                                     GpuStateCache& stateCache,
+                                     GpuSoftBinner& binner)
+{
+    for (int drawItemIndex = 0; drawItemIndex < nItems; ++drawItemIndex) {
+        const GpuDrawItem* item = items[drawItemIndex];
+        ASSERT(item != NULL);
+
+        // There's no state to bind, but the bindings are still counted so
+        // that the statistics match those of the other backends.
+        const PipelineStateObj& pipelineState
+            = m_pipelineStateTable.LookupRaw(item->pipelineStateIdx);
+        stateCache.SetPipelineState(item->pipelineStateIdx);
+        stateCache.SetDepthStencilState(pipelineState.depthStencilKey);
+        stateCache.SetRasterState(pipelineState.rasterStateKey);
+
+        DrawSetup setup;
+        GpuSoftResources resources;
+        memset(&resources, 0, sizeof resources);
+        setup.pipelineState = &pipelineState;
+        setup.resources = &resources;
+        setup.primitiveType = item->GetPrimitiveType();
+
+        ASSERT(item->nVertexBuffers <= GpuStateCache::MAX_VERTEX_BUFFERS);
+        const u32* vertexBufferOffsets = item->VertexBufferOffsets();
+        const u16* vertexBuffers = item->VertexBuffers();
+        for (int i = 0; i < item->nVertexBuffers; ++i) {
+            const Buffer& buf = m_bufferTable.LookupRaw(vertexBuffers[i]);
+            stateCache.SetVertexBuffer(i, vertexBuffers[i], vertexBufferOffsets[i]);
+            if (vertexBufferOffsets[i] > buf.size)
+                FATAL("Vertex buffer offset %u is past the end of a %u byte buffer",
+                      vertexBufferOffsets[i], buf.size);
+            setup.vertexStreams[i] = (const u8*)buf.memory + vertexBufferOffsets[i];
+            setup.vertexStreamSizes[i] = buf.size - vertexBufferOffsets[i];
+        }
+        for (int i = item->nVertexBuffers; i < GpuStateCache::MAX_VERTEX_BUFFERS; ++i) {
+            setup.vertexStreams[i] = NULL;
+            setup.vertexStreamSizes[i] = 0;
+        }
+
+        const u16* cbuffers = item->CBuffers();
+        for (int i = 0; i < item->nCBuffers; ++i) {
+            const Buffer& buf = m_bufferTable.LookupRaw(cbuffers[i]);
+            stateCache.SetCBuffer(i, cbuffers[i], 0);
+            resources.cbuffers[i] = (const u8*)buf.memory;
+        }
+
+        if (item->HasInstanceBuffer()) {
+            const Buffer& buf = m_bufferTable.LookupRaw(item->instanceBufferIdx);
+            stateCache.SetCBuffer(GPU_INSTANCE_BUFFER_SLOT,
+                                  item->instanceBufferIdx,
+                                  item->instanceBufferOffset);
+            resources.cbuffers[GPU_INSTANCE_BUFFER_SLOT]
+                = (const u8*)buf.memory + item->instanceBufferOffset;
+        }
+
+        ASSERT(item->nTextures <= GPU_SOFT_MAX_TEXTURES);
+        const u16* textures = item->Textures();
+        for (int i = 0; i < item->nTextures; ++i) {
+            stateCache.SetTexture(i, textures[i]);
+            resources.textures[i] = &m_textureTable.LookupRaw(textures[i]).soft;
+        }
+
+        ASSERT(item->nSamplers <= GPU_SOFT_MAX_SAMPLERS);
+        const u16* samplers = item->Samplers();
+        for (int i = 0; i < item->nSamplers; ++i) {
+            stateCache.SetSampler(i, samplers[i]);
+            resources.samplers[i] = m_samplerTable.LookupRaw(samplers[i]).desc;
+        }
+
+        GpuSoftDrawState drawState;
+        drawState.shader = pipelineState.shader;
+        drawState.resources = resources;
+        drawState.depthCompare = pipelineState.depthCompare;
+        drawState.depthWritesEnabled = pipelineState.depthWritesEnabled;
+        drawState.cullMode = pipelineState.cullMode;
+        drawState.frontFaceWinding = pipelineState.frontFaceWinding;
+        drawState.blendingEnabled = pipelineState.blendingEnabled;
+        drawState.blendSrcFactor = pipelineState.blendSrcFactor;
+        drawState.blendDstFactor = pipelineState.blendDstFactor;
+        setup.drawState = binner.AddDrawState(drawState);
+
+        setup.indices = NULL;
+        setup.indexType = item->GetIndexType();
+        setup.nIndices = 0;
+        if (item->IsIndexed()) {
+            const Buffer& indexBuf = m_bufferTable.LookupRaw(item->indexBufferIdx);
+            u32 indexSize = (setup.indexType == GPU_INDEX_U32) ? 4 : 2;
+            if (item->indexBufferOffset < indexBuf.size) {
+                setup.indices = (const u8*)indexBuf.memory + item->indexBufferOffset;
+                setup.nIndices = (indexBuf.size - item->indexBufferOffset) / indexSize;
+            } else {
+                setup.indices = (const u8*)indexBuf.memory;
+            }
+        }
+
+        if (item->IsIndirect()) {
+            ProcessIndirectDraws(item, setup, stateCache, binner);
+            stateCache.CountDrawItem(true, item->count);
+        } else {
+            if (item->IsIndexed() && (u64)item->first + item->count > setup.nIndices)
+                FATAL("Draw item reads indices [%u, %u), but the index buffer "
+                      "only has %u indices",
+                      item->first, item->first + item->count, setup.nIndices);
+            ProcessPrimitives(setup,
+                              item->first,
+                              item->count,
+                              item->instanceCount,
+                              item->baseVertex,
+                              0, // baseInstance
+                              binner);
+            stateCache.CountDrawItem(false, 1);
+            stateCache.CountPrimitives(item->IsIndexed(), setup.primitiveType,
+                                       item->count, item->instanceCount);
+        }
+    }
+}
+
+void GpuDeviceSoft::ProcessIndirectDraws(const GpuDrawItem* item,
+                                         const DrawSetup& setup,
+                                         GpuStateCache& stateCache,
+                                         GpuSoftBinner& binner)
+{
+    const Buffer& argsBuf = m_bufferTable.LookupRaw(item->drawArgsBufferIdx);
+    if (argsBuf.type != GPU_BUFFER_TYPE_INDIRECT)
+        FATAL("Indirect draw item reads its draw arguments from a buffer "
+              "that isn't of type GPU_BUFFER_TYPE_INDIRECT");
+    u64 argsEnd = (u64)item->first + (u64)item->count * sizeof(GpuDrawArgs);
+    if (argsEnd > argsBuf.size)
+        FATAL("Indirect draw item reads %u draw argument records at offset %u, "
+              "past the end of a %u byte buffer",
+              item->count, item->first, argsBuf.size);
+
+    const u8* argsMemory = (const u8*)argsBuf.memory + item->first;
+    for (u32 i = 0; i < item->count; ++i) {
+        GpuDrawArgs args;
+        memcpy(&args, argsMemory + i * sizeof(GpuDrawArgs), sizeof args);
+
+        if ((u64)args.first + args.count > setup.nIndices)
+            FATAL("Draw argument record %u reads indices [%u, %u), but the "
+                  "index buffer only has %u indices",
+                  i, args.first, args.first + args.count, setup.nIndices);
+
+        ProcessPrimitives(setup,
+                          args.first,
+                          args.count,
+                          args.instanceCount,
+                          args.baseVertex,
+                          args.baseInstance,
+                          binner);
+        stateCache.CountPrimitives(true, setup.primitiveType,
+                                   args.count, args.instanceCount);
+    }
+}
+
+void GpuDeviceSoft::ProcessPrimitives(const DrawSetup& setup,
+                                      u32 first,
+                                      u32 count,
+                                      u32 instanceCount,
+                                      i32 baseVertex,
+                                      u32 baseInstance,
+                                      GpuSoftBinner& binner)
+{
+    const InputLayout& layout = setup.pipelineState->inputLayout;
+    const GpuSoftShader& shader = *setup.pipelineState->shader;
+
+    u32 nTriangles = 0;
+    if (setup.primitiveType == GPU_PRIMITIVE_TRIANGLES)
+        nTriangles = count / 3;
+    else if (count >= 3)
+        nTriangles = count - 2;
+
+    struct CachedVertex {
+        u32 index;
+        GpuSoftVertex vertex;
+    };
+    CachedVertex cache[VERTEX_CACHE_SIZE];
+
+    GpuSoftVertexInput input;
+
+    for (u32 instance = 0; instance < instanceCount; ++instance) {
+        for (u32 i = 0; i < VERTEX_CACHE_SIZE; ++i)
+            cache[i].index = 0xFFFFFFFF;
+        input.instanceID = baseInstance + instance;
+
+        for (u32 tri = 0; tri < nTriangles; ++tri) {
+            u32 corners[3];
+            if (setup.primitiveType == GPU_PRIMITIVE_TRIANGLES) {
+                corners[0] = 3 * tri;
+                corners[1] = 3 * tri + 1;
+                corners[2] = 3 * tri + 2;
+            } else {
+                // Every other triangle of a strip has its winding reversed.
+                corners[0] = tri + (tri & 1);
+                corners[1] = tri + 1 - (tri & 1);
+                corners[2] = tri + 2;
+            }
+
+            // The vertices are copied out of the cache, since a later corner
+            // may evict an earlier one.
+            GpuSoftVertex vertices[3];
+            for (int c = 0; c < 3; ++c) {
+                u32 index = first + corners[c];
+                if (setup.indices) {
+                    if (setup.indexType == GPU_INDEX_U32) {
+                        u32 value;
+                        memcpy(&value, setup.indices + 4 * index, sizeof value);
+                        index = value;
+                    } else {
+                        u16 value;
+                        memcpy(&value, setup.indices + 2 * index, sizeof value);
+                        index = value;
+                    }
+                    index = (u32)((i32)index + baseVertex);
+                }
+
+                CachedVertex& entry = cache[index & (VERTEX_CACHE_SIZE - 1)];
+                if (entry.index != index) {
+                    for (int a = 0; a < layout.nVertexAttribs; ++a) {
+                        const GpuVertexAttribute& attrib = layout.attribs[a];
+                        int slot = attrib.bufferSlot;
+                        u64 offset = (u64)index * layout.strides[slot] + attrib.offset;
+                        if (offset + s_vertexAttribSizes[attrib.format]
+                            > setup.vertexStreamSizes[slot]) {
+                            FATAL("Vertex %u reads attribute %d past the end of "
+                                  "vertex buffer %d", index, a, slot);
+                        }
+                        float* dst = input.attribs[a];
+                        dst[0] = 0.0f;
+                        dst[1] = 0.0f;
+                        dst[2] = 0.0f;
+                        dst[3] = 1.0f;
+                        ReadVertexAttrib(attrib.format,
+                                         setup.vertexStreams[slot] + offset,
+                                         dst);
+                    }
+                    shader.vertexMain(*setup.resources, input, &entry.vertex);
+                    entry.index = index;
+                }
+                vertices[c] = entry.vertex;
+            }
+
+            binner.AddTriangle(setup.drawState, vertices[0], vertices[1], vertices[2]);
+        }
+    }
+}
+
+void GpuDeviceSoft::ProcessDrawChunk(int index, void* userdata)
+{
+    DrawChunk& chunk = ((DrawChunk*)userdata)[index];
+    chunk.device->ProcessDrawItems(chunk.items,
+                                   chunk.nItems,
+                                   chunk.stateCache,
+                                   chunk.binner);
+}
+
+void GpuDeviceSoft::RasterizeTile(int index, void* userdata)
+{
+    GpuDeviceSoft* device = (GpuDeviceSoft*)userdata;
+    GpuSoftRaster::DrawTile(index,
+                            device->m_target,
+                            &device->m_binners[0],
+                            (int)device->m_binners.size());
+}
+
+void GpuDeviceSoft::Render(const GpuDrawItem* const* items,
+                           int nItems,
+                           GpuRenderPassID renderPass,
+                           const GpuViewport& viewport,
+                           int nChunks,
+                           TaskPool& taskPool)
+{
+    ASSERT(items != NULL);
+    ASSERT(RenderPassExists(renderPass));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    PrepareTarget(renderPass, viewport);
+
+    // Geometry: each chunk shades and bins its draw items into its own
+    // binner.
+    if ((int)m_drawChunks.size() < nChunks)
+        m_drawChunks.resize(nChunks);
+    m_binners.resize(nChunks);
+    for (int i = 0; i < nChunks; ++i) {
+        int first, count;
+        GpuDrawChunks::Range(i, nChunks, nItems, &first, &count);
+
+        DrawChunk& chunk = m_drawChunks[i];
+        chunk.device = this;
+        chunk.items = items + first;
+        chunk.nItems = count;
+        chunk.stateCache.Reset();
+        chunk.stateCache.ResetStats();
+        chunk.binner.Begin(m_target);
+        m_binners[i] = &chunk.binner;
+    }
+
+    if (nChunks == 1)
+        ProcessDrawChunk(0, &m_drawChunks[0]);
+    else
+        taskPool.ParallelFor(nChunks, &GpuDeviceSoft::ProcessDrawChunk, &m_drawChunks[0]);
+
+    for (int i = 0; i < nChunks; ++i)
+        m_stateCache.MergeStats(m_drawChunks[i].stateCache);
+
+    // Rasterization: each tile draws the bins of every chunk in order.
+    int nTiles = m_target.nTilesX * m_target.nTilesY;
+    taskPool.ParallelFor(nTiles, &GpuDeviceSoft::RasterizeTile, this);
+
+    std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+    m_renderMs += elapsed.count();
+}
+
+void GpuDeviceSoft::Draw(const GpuDrawItem* const* items,
+                          int nItems,
+                          GpuRenderPassID renderPass,
+                          const GpuViewport& viewport)
+{
+    // Draw() shades the vertices on the calling thread, as the other
+    // backends encode on it, but the tiles are still rasterized in parallel.
+    Render(items, nItems, renderPass, viewport, 1, m_taskPool);
+}
+
+void GpuDeviceSoft::DrawParallel(const GpuDrawItem* const* items,
+                                  int nItems,
+                                  GpuRenderPassID renderPass,
+                                  const GpuViewport& viewport,
+                                  TaskPool& taskPool)
+{
+    int nChunks = GpuDrawChunks::Count(nItems, taskPool.GetNumThreads());
+    Render(items, nItems, renderPass, viewport, nChunks, taskPool);
+}
+
+void GpuDeviceSoft::SceneBegin()
+{
+    m_framePacer.BeginFrame();
+    m_uploadHeap.Reclaim(m_framePacer.GetCompletedFrame());
+    m_timerQueries.Resolve(m_framePacer.GetCompletedFrame());
+}
+
+void GpuDeviceSoft::ScenePresent()
+{
+    m_stateFilterStats = m_stateCache.GetStats();
+    m_drawStats = m_stateCache.GetDrawStats();
+    m_stateCache.ResetStats();
+
+    m_uploadHeap.EndFrame();
+    m_frameCounters.EndFrame(m_stateFilterStats, m_drawStats, m_uploadHeap.GetStats());
+    // Draw() renders synchronously, so the frame is complete as soon as it's
+    // submitted.
+    m_framePacer.Complete(m_framePacer.Submit(), m_renderMs);
+    m_renderMs = 0.0;
+
+    ++m_frameNumber;
+}
+
+GpuTimerQueries& GpuDeviceSoft::GetTimerQueries()
+{
+    return m_timerQueries;
+}
+
+const GpuTimerQueries& GpuDeviceSoft::GetTimerQueries() const
+{
+    return m_timerQueries;
+}
+
+void GpuDeviceSoft::TimerQueryMark(u32 timestamp)
+{
+    if (timestamp == GpuTimerQueries::NO_TIMESTAMP)
+        return;
+
+    // Draw() renders synchronously, so the time of the marker is the time
+    // spent rendering the frame so far, as for the frame's GPU time.
+    u64 frame = m_framePacer.GetSubmittedFrame() + 1;
+    m_timerQueries.GetTimestamps(frame)[timestamp] = (u64)(m_renderMs * 1e6);
+}
+
+GpuFramePacer& GpuDeviceSoft::GetFramePacer()
+{
+    return m_framePacer;
+}
+
+const GpuFramePacer& GpuDeviceSoft::GetFramePacer() const
+{
+    return m_framePacer;
+}
+
+GpuMemoryTracker& GpuDeviceSoft::GetMemoryTracker()
+{
+    return m_memoryTracker;
+}
+
+const GpuMemoryTracker& GpuDeviceSoft::GetMemoryTracker() const
+{
+    return m_memoryTracker;
+}
+
+GpuDeferredDestroyQueue& GpuDeviceSoft::GetDeferredDestroyQueue()
+{
+    return m_deferredDestroyQueue;
+}
+
+const GpuStateFilterStats& GpuDeviceSoft::GetStateFilterStats() const
+{
+    return m_stateFilterStats;
+}
+
+const GpuDrawStats& GpuDeviceSoft::GetDrawStats() const
+{
+    return m_drawStats;
+}
+
+const GpuFrameStats& GpuDeviceSoft::GetFrameStats() const
+{
+    return m_frameCounters.GetStats();
+}
+
+const GpuUploadHeapStats& GpuDeviceSoft::GetUploadHeapStats() const
+{
+    return m_uploadHeap.GetStats();
+}
+
+const GpuStateObjectCacheStats& GpuDeviceSoft::GetStateObjectCacheStats() const
+{
+    return m_stateObjectCache.GetStats();
+}
+
+GpuTraceWriter& GpuDeviceSoft::GetTraceWriter()
+{
+    return m_traceWriter;
+}
+
+const GpuTraceWriter& GpuDeviceSoft::GetTraceWriter() const
+{
+    return m_traceWriter;
+}
+
+#ifdef GPUDEVICE_DEBUG_MODE
+void GpuDeviceSoft::DrawItem_UpdateRefCounts(const GpuDrawItem* item, int increment)
+{
+    m_pipelineStateTable.LookupRaw(item->pipelineStateIdx).dbg_refCount += increment;
+
+    if (item->IsIndexed())
+        m_bufferTable.LookupRaw(item->indexBufferIdx).dbg_refCount += increment;
+
+    if (item->HasInstanceBuffer())
+        m_bufferTable.LookupRaw(item->instanceBufferIdx).dbg_refCount += increment;
+
+    if (item->IsIndirect())
+        m_bufferTable.LookupRaw(item->drawArgsBufferIdx).dbg_refCount += increment;
+
+    u16* vertexBuffers = item->VertexBuffers();
+    for (int i = 0; i < item->nVertexBuffers; ++i) {
+        m_bufferTable.LookupRaw(vertexBuffers[i]).dbg_refCount += increment;
+    }
+
+    u16* cbuffers = item->CBuffers();
+    for (int i = 0; i < item->nCBuffers; ++i) {
+        m_bufferTable.LookupRaw(cbuffers[i]).dbg_refCount += increment;
+    }
+
+    u16* textures = item->Textures();
+    for (int i = 0; i < item->nTextures; ++i) {
+        m_textureTable.LookupRaw(textures[i]).dbg_refCount += increment;
+    }
+
+    u16* samplers = item->Samplers();
+    for (int i = 0; i < item->nSamplers; ++i) {
+        m_samplerTable.LookupRaw(samplers[i]).dbg_refCount += increment;
+    }
+}
+
+void GpuDeviceSoft::RegisterDrawItem(const GpuDrawItem* item)
+{
+    DrawItem_UpdateRefCounts(item, 1);
+}
+
+void GpuDeviceSoft::UnregisterDrawItem(const GpuDrawItem* item)
+{
+    DrawItem_UpdateRefCounts(item, -1);
+}
+#endif // GPUDEVICE_DEBUG_MODE
+
+static const GpuDeviceSoft* Cast(const GpuDevice* dev) { return (const GpuDeviceSoft*)dev; }
+static GpuDeviceSoft* Cast(GpuDevice* dev) { return (GpuDeviceSoft*)dev; }
+static GpuDevice* Cast(GpuDeviceSoft* dev) { return (GpuDevice*)dev; }
+
+// Passes a call that has just been forwarded to the backend on to the trace
+// writer, if a trace is being captured.
+#define TRACE_CALL(device, call) \
+    do { \
+        GpuTraceWriter& writer = Cast(device)->GetTraceWriter(); \
+        if (writer.IsRecording()) \
+            writer.call; \
+    } while (0)
+
+GpuDevice* GpuDevice::Create(const GpuDeviceFormat& format, void* osViewHandle)
+{ return Cast(new GpuDeviceSoft(format, osViewHandle)); }
+
+void GpuDevice::Destroy(GpuDevice* dev)
+{
+    Cast(dev)->GetDeferredDestroyQueue().DestroyAll(*dev);
+    delete Cast(dev);
+}
+
+void GpuDevice::SetFormat(const GpuDeviceFormat& format)
+{
+    Cast(this)->SetFormat(format);
+    TRACE_CALL(this, SetFormat(format));
+}
+
+const GpuDeviceFormat& GpuDevice::GetFormat() const
+{ return Cast(this)->GetFormat(); }
+
+void GpuDevice::OnWindowResized()
+{
+    Cast(this)->OnWindowResized();
+    TRACE_CALL(this, OnWindowResized());
+}
+
+bool GpuDevice::ShaderProgramExists(GpuShaderProgramID shaderProgramID) const
+{ return Cast(this)->ShaderProgramExists(shaderProgramID); }
+
+GpuShaderProgramID GpuDevice::ShaderProgramCreate(const char* data, size_t length)
+{
+    GpuShaderProgramID shaderProgramID = Cast(this)->ShaderProgramCreate(data, length);
+    TRACE_CALL(this, ShaderProgramCreate(shaderProgramID, data, length));
+    return shaderProgramID;
+}
+
+void GpuDevice::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
+{
+    Cast(this)->ShaderProgramDestroy(shaderProgramID);
+    TRACE_CALL(this, ShaderProgramDestroy(shaderProgramID));
+}
+
+bool GpuDevice::BufferExists(GpuBufferID bufferID) const
+{ return Cast(this)->BufferExists(bufferID); }
+
+GpuBufferID GpuDevice::BufferCreate(GpuBufferType type,
+                                    GpuBufferAccessMode accessMode,
+                                    const void* data,
+                                    unsigned size,
+                                    int maxUpdatesPerFrame)
+{
+    GpuBufferID bufferID = Cast(this)->BufferCreate(
+        type,
+        accessMode,
+        data,
+        size,
+        maxUpdatesPerFrame
+    );
+    TRACE_CALL(this, BufferCreate(bufferID, type, accessMode, data, size, maxUpdatesPerFrame));
+    return bufferID;
+}
+
+void GpuDevice::BufferDestroy(GpuBufferID bufferID)
+{
+    Cast(this)->BufferDestroy(bufferID);
+    TRACE_CALL(this, BufferDestroy(bufferID));
+}
+
+void GpuDevice::BufferStreamResize(GpuBufferID bufferID, unsigned newSize)
+{
+    Cast(this)->BufferStreamResize(bufferID, newSize);
+    TRACE_CALL(this, BufferStreamResize(bufferID, newSize));
+}
+
+void* GpuDevice::BufferMap(GpuBufferID bufferID)
+{
+    void* memory = Cast(this)->BufferMap(bufferID);
+    TRACE_CALL(this, BufferMap(bufferID, memory));
+    return memory;
+}
+
+void GpuDevice::BufferUnmap(GpuBufferID bufferID)
+{
+    // Record the contents before the backend can reuse the mapped memory.
+    TRACE_CALL(this, BufferUnmap(bufferID));
+    Cast(this)->BufferUnmap(bufferID);
+}
+
+void GpuDevice::BufferUpload(GpuBufferID bufferID,
+                             unsigned offset,
+                             const void* data,
+                             unsigned size)
+{
+    Cast(this)->BufferUpload(bufferID, offset, data, size);
+    TRACE_CALL(this, BufferUpload(bufferID, offset, data, size));
+}
+
+bool GpuDevice::TextureExists(GpuTextureID textureID) const
+{ return Cast(this)->TextureExists(textureID); }
+
+GpuTextureID GpuDevice::TextureCreate(GpuTextureType type,
+                                      GpuPixelFormat pixelFormat,
+                                      u32 flags,
+                                      int width,
+                                      int height,
+                                      int depthOrArrayLength,
+                                      int nMipmapLevels)
+{
+    GpuTextureID textureID = Cast(this)->TextureCreate(
+        type,
+        pixelFormat,
+        flags,
+        width,
+        height,
+        depthOrArrayLength,
+        nMipmapLevels
+    );
+    TRACE_CALL(this, TextureCreate(textureID, type, pixelFormat, flags, width, height,
+                              depthOrArrayLength, nMipmapLevels));
+    return textureID;
+}
+
+void GpuDevice::TextureDestroy(GpuTextureID textureID)
+{
+    Cast(this)->TextureDestroy(textureID);
+    TRACE_CALL(this, TextureDestroy(textureID));
+}
+
+void GpuDevice::TextureUpload(GpuTextureID textureID,
+                              const GpuRegion& region,
+                              int mipmapLevel,
+                              int stride,
+                              const void* bytes)
+{
+    Cast(this)->TextureUpload(textureID, 0, region, mipmapLevel, stride, bytes);
+    TRACE_CALL(this, TextureUpload(textureID, 0, region, mipmapLevel, stride, bytes));
+}
+
+void GpuDevice::TextureUploadSlice(GpuTextureID textureID,
+                                   int slice,
+                                   const GpuRegion& region,
+                                   int mipmapLevel,
+                                   int stride,
+                                   const void* bytes)
+{
+    Cast(this)->TextureUpload(textureID, slice, region, mipmapLevel, stride, bytes);
+    TRACE_CALL(this, TextureUpload(textureID, slice, region, mipmapLevel, stride, bytes));
+}
+
+bool GpuDevice::SamplerExists(GpuSamplerID samplerID) const
+{ return Cast(this)->SamplerExists(samplerID); }
+
+GpuSamplerID GpuDevice::SamplerCreate(const GpuSamplerDesc& desc)
+{
+    GpuSamplerID samplerID = Cast(this)->SamplerCreate(desc);
+    TRACE_CALL(this, SamplerCreate(samplerID, desc));
+    return samplerID;
+}
+
+void GpuDevice::SamplerDestroy(GpuSamplerID samplerID)
+{
+    Cast(this)->SamplerDestroy(samplerID);
+    TRACE_CALL(this, SamplerDestroy(samplerID));
+}
+
+bool GpuDevice::InputLayoutExists(GpuInputLayoutID inputLayoutID) const
+{ return Cast(this)->InputLayoutExists(inputLayoutID); }
+
+GpuInputLayoutID GpuDevice::InputLayoutCreate(int nVertexAttribs,
+                                              const GpuVertexAttribute* attribs,
+                                              int nVertexBuffers,
+                                              const unsigned* strides)
+{
+    GpuInputLayoutID inputLayoutID = Cast(this)->InputLayoutCreate(
+        nVertexAttribs,
+        attribs,
+        nVertexBuffers,
+        strides
+    );
+    TRACE_CALL(this, InputLayoutCreate(inputLayoutID, nVertexAttribs, attribs,
+                                  nVertexBuffers, strides));
+    return inputLayoutID;
+}
+
+void GpuDevice::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
+{
+    Cast(this)->InputLayoutDestroy(inputLayoutID);
+    TRACE_CALL(this, InputLayoutDestroy(inputLayoutID));
+}
+
+bool GpuDevice::PipelineStateExists(GpuPipelineStateID pipelineStateID) const
+{ return Cast(this)->PipelineStateExists(pipelineStateID); }
+
+GpuPipelineStateID GpuDevice::PipelineStateCreate(const GpuPipelineStateDesc& state)
+{
+    GpuPipelineStateID pipelineStateID = Cast(this)->PipelineStateCreate(state);
+    TRACE_CALL(this, PipelineStateCreate(pipelineStateID, state));
+    return pipelineStateID;
+}
+
+GpuPipelineStateID GpuDevice::PipelineStateCreateAsync(const GpuPipelineStateDesc& state,
+                                                       GpuPipelineStateID fallback)
+{
+    GpuPipelineStateID pipelineStateID
+        = Cast(this)->PipelineStateCreateAsync(state, fallback);
+    // Recorded as a synchronous create, as the replay can't reproduce the
+    // timing of the compilation anyway.
+    TRACE_CALL(this, PipelineStateCreate(pipelineStateID, state));
+    return pipelineStateID;
+}
+
+bool GpuDevice::PipelineStateIsReady(GpuPipelineStateID pipelineStateID) const
+{ return Cast(this)->PipelineStateIsReady(pipelineStateID); }
+
+void GpuDevice::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
+{
+    Cast(this)->PipelineStateDestroy(pipelineStateID);
+    TRACE_CALL(this, PipelineStateDestroy(pipelineStateID));
+}
+
+bool GpuDevice::RenderPassExists(GpuRenderPassID renderPassID) const
+{ return Cast(this)->RenderPassExists(renderPassID); }
+
+GpuRenderPassID GpuDevice::RenderPassCreate(const GpuRenderPassDesc& pass)
+{
+    GpuRenderPassID renderPassID = Cast(this)->RenderPassCreate(pass);
+    TRACE_CALL(this, RenderPassCreate(renderPassID, pass));
+    return renderPassID;
+}
+
+void GpuDevice::RenderPassDestroy(GpuRenderPassID renderPassID)
+{
+    Cast(this)->RenderPassDestroy(renderPassID);
+    TRACE_CALL(this, RenderPassDestroy(renderPassID));
+}
+
+void GpuDevice::Draw(const GpuDrawItem* const* items,
+                     int nItems,
+                     GpuRenderPassID renderPass,
+                     const GpuViewport& viewport)
+{
+    Cast(this)->Draw(items, nItems, renderPass, viewport);
+    TRACE_CALL(this, Draw(items, nItems, renderPass, viewport, false));
+}
+
+void GpuDevice::DrawParallel(const GpuDrawItem* const* items,
+                             int nItems,
+                             GpuRenderPassID renderPass,
+                             const GpuViewport& viewport,
+                             TaskPool& taskPool)
+{
+    Cast(this)->DrawParallel(items, nItems, renderPass, viewport, taskPool);
+    TRACE_CALL(this, Draw(items, nItems, renderPass, viewport, true));
+}
+
+void GpuDevice::SceneBegin()
+{
+    Cast(this)->SceneBegin();
+    TRACE_CALL(this, SceneBegin());
+    Cast(this)->GetDeferredDestroyQueue().DestroyCompleted(*this,
+                                                           GetCompletedFrame());
+}
+
+void GpuDevice::ScenePresent()
+{
+    Cast(this)->ScenePresent();
+    TRACE_CALL(this, ScenePresent());
+    // After the frame is recorded, since the callback may destroy resources.
+    Cast(this)->GetMemoryTracker().CheckBudget();
+}
+
+bool GpuDevice::TimerQueryExists(GpuTimerQueryID queryID) const
+{ return Cast(this)->GetTimerQueries().Exists(queryID); }
+
+GpuTimerQueryID GpuDevice::TimerQueryCreate()
+{
+    GpuTimerQueryID queryID = Cast(this)->GetTimerQueries().Create();
+    TRACE_CALL(this, TimerQueryCreate(queryID));
+    return queryID;
+}
+
+void GpuDevice::TimerQueryDestroy(GpuTimerQueryID queryID)
+{
+    Cast(this)->GetTimerQueries().Destroy(queryID);
+    TRACE_CALL(this, TimerQueryDestroy(queryID));
+}
+
+void GpuDevice::TimerQueryBegin(GpuTimerQueryID queryID)
+{
+    u64 frame = GetSubmittedFrame() + 1;
+    Cast(this)->TimerQueryMark(Cast(this)->GetTimerQueries().Begin(queryID, frame));
+    TRACE_CALL(this, TimerQueryBegin(queryID));
+}
+
+void GpuDevice::TimerQueryEnd(GpuTimerQueryID queryID)
+{
+    u64 frame = GetSubmittedFrame() + 1;
+    Cast(this)->TimerQueryMark(Cast(this)->GetTimerQueries().End(queryID, frame));
+    TRACE_CALL(this, TimerQueryEnd(queryID));
+}
+
+bool GpuDevice::TimerQueryGetResult(GpuTimerQueryID queryID,
+                                    float* milliseconds,
+                                    u64* frame) const
+{ return Cast(this)->GetTimerQueries().GetResult(queryID, milliseconds, frame); }
+
+void GpuDevice::SetMaxFramesInFlight(int nFrames)
+{ Cast(this)->GetFramePacer().SetMaxFramesInFlight(nFrames); }
+
+int GpuDevice::GetMaxFramesInFlight() const
+{ return Cast(this)->GetFramePacer().GetMaxFramesInFlight(); }
+
+u64 GpuDevice::GetSubmittedFrame() const
+{ return Cast(this)->GetFramePacer().GetSubmittedFrame(); }
+
+u64 GpuDevice::GetCompletedFrame() const
+{ return Cast(this)->GetFramePacer().GetCompletedFrame(); }
+
+void GpuDevice::WaitForFrame(u64 frame)
+{ Cast(this)->GetFramePacer().WaitForFrame(frame); }
+
+void GpuDevice::ShaderProgramDestroyDeferred(GpuShaderProgramID shaderProgramID)
+{
+    ASSERT(ShaderProgramExists(shaderProgramID));
+    Cast(this)->GetDeferredDestroyQueue().PushShaderProgram(
+        shaderProgramID, GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::BufferDestroyDeferred(GpuBufferID bufferID)
+{
+    ASSERT(BufferExists(bufferID));
+    Cast(this)->GetDeferredDestroyQueue().PushBuffer(bufferID,
+                                                     GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::TextureDestroyDeferred(GpuTextureID textureID)
+{
+    ASSERT(TextureExists(textureID));
+    Cast(this)->GetDeferredDestroyQueue().PushTexture(textureID,
+                                                      GetSubmittedFrame() + 1);
+}
+
+void GpuDevice::SetSimulatedGpuCost(const GpuSimulatedGpuCost& cost)
+{}
+
+const GpuFramePacingStats& GpuDevice::GetFramePacingStats() const
+{ return Cast(this)->GetFramePacer().GetStats(); }
+
+const GpuStateFilterStats& GpuDevice::GetStateFilterStats() const
+{ return Cast(this)->GetStateFilterStats(); }
+
+const GpuDrawStats& GpuDevice::GetDrawStats() const
+{ return Cast(this)->GetDrawStats(); }
+
+const GpuFrameStats& GpuDevice::GetFrameStats() const
+{ return Cast(this)->GetFrameStats(); }
+
+const GpuUploadHeapStats& GpuDevice::GetUploadHeapStats() const
+{ return Cast(this)->GetUploadHeapStats(); }
+
+const GpuStateObjectCacheStats& GpuDevice::GetStateObjectCacheStats() const
+{ return Cast(this)->GetStateObjectCacheStats(); }
+
+const GpuMemoryStats& GpuDevice::GetMemoryStats() const
+{ return Cast(this)->GetMemoryTracker().GetStats(); }
+
+void GpuDevice::SetMemoryBudget(u64 budget,
+                                GpuMemoryBudgetCallback callback,
+                                void* userdata)
+{ Cast(this)->GetMemoryTracker().SetBudget(budget, callback, userdata); }
+
+bool GpuDevice::TraceCaptureBegin(const char* path)
+{ return Cast(this)->GetTraceWriter().Begin(path); }
+
+void GpuDevice::TraceCaptureEnd()
+{ Cast(this)->GetTraceWriter().End(); }
+
+bool GpuDevice::IsTraceCapturing() const
+{ return Cast(this)->GetTraceWriter().IsRecording(); }
+
+#ifdef GPUDEVICE_DEBUG_MODE
+void GpuDevice::RegisterDrawItem(const GpuDrawItem* item)
+{ Cast(this)->RegisterDrawItem(item); }
+
+void GpuDevice::UnregisterDrawItem(const GpuDrawItem* item)
+{ Cast(this)->UnregisterDrawItem(item); }
+#endif // GPUDEVICE_DEBUG_MODE
+
+Matrix44 GpuDevice::TransformCreateOrtho(float left, float right,
+                                         float bot, float top,
+                                         float near, float far)
+{
+    // Same clip space conventions as Metal: z is in [0, 1].
+    float tx = -(right + left) / (right - left);
+    float ty = -(top + bot) / (top - bot);
+    float tz = -(near) / (far - near);
+    return Matrix44(2.0f / (right - left), 0.0f, 0.0f, tx,
+                    0.0f, 2.0f / (top - bot), 0.0f, ty,
+                    0.0f, 0.0f, -1.0f / (far - near), tz,
+                    0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+Matrix44 GpuDevice::TransformCreatePerspective(float left, float right,
+                                               float bot, float top,
+                                               float near, float far)
+{
+    float A = (right + left) / (right - left);
+    float B = (top + bot) / (top - bot);
+    float C = -(far) / (far - near);
+    float D = -(far * near) / (far - near);
+    return Matrix44(2.0f * near / (right - left), 0.0f, A, 0.0f,
+                    0.0f, 2.0f * near / (top - bot), B, 0.0f,
+                    0.0f, 0.0f, C, D,
+                    0.0f, 0.0f, -1.0f, 0.0f);
+}
+
+#endif // GPUDEVICE_API_SOFT
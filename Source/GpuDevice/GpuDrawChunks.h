@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ *   GpuDrawChunks.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   Splits an array of draw items into contiguous chunks for
+ *   GpuDevice::DrawParallel(). Every backend uses the same split, so that the
+ *   chunking behaviour can be tested on the Null backend.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUDRAWCHUNKS_H
+#define GPUDEVICE_GPUDRAWCHUNKS_H
+
+#include "Core/Macros.h"
+
+namespace GpuDrawChunks {
+    // Below this many draw items per chunk, the cost of setting up an extra
+    // encoder outweighs the gain from encoding in parallel.
+    const int MIN_ITEMS_PER_CHUNK = 128;
+
+    // Returns the number of chunks to split nItems draw items into. A result
+    // of 1 means the items should be encoded on the calling thread.
+    inline int Count(int nItems, int nThreads)
+    {
+        ASSERT(nThreads >= 1);
+        int nChunks = nItems / MIN_ITEMS_PER_CHUNK;
+        if (nChunks > nThreads)
+            nChunks = nThreads;
+        if (nChunks < 1)
+            nChunks = 1;
+        return nChunks;
+    }
+
+    // Returns the range of draw items in the given chunk. The remainder is
+    // spread over the first chunks so that chunk sizes differ by at most one.
+    inline void Range(int chunk, int nChunks, int nItems, int* first, int* count)
+    {
+        ASSERT(0 <= chunk && chunk < nChunks);
+        int base = nItems / nChunks;
+        int remainder = nItems % nChunks;
+        *first = chunk * base + (chunk < remainder ? chunk : remainder);
+        *count = base + (chunk < remainder ? 1 : 0);
+    }
+}
+
+#endif // GPUDEVICE_GPUDRAWCHUNKS_H
@@ -14,6 +14,7 @@
 #ifndef GPUDEVICE_GPUDRAWITEM_H
 #define GPUDEVICE_GPUDRAWITEM_H
 
+#include <stddef.h>
 #include "Core/Types.h"
 #include "GpuDevice/GpuDevice.h"
 
@@ -37,6 +38,16 @@ struct GpuDrawItem {
         return (flags & 0x10) != 0;
     }
 
+    bool IsIndirect() const
+    {
+        return (flags & 0x20) != 0;
+    }
+
+    bool HasInstanceBuffer() const
+    {
+        return instanceBufferIdx != 0xFFFF;
+    }
+
     void SetPrimitiveType(GpuPrimitiveType type)
     {
         ASSERT((u32)type < (1 << NUM_PRIMITIVE_TYPE_BITS));
@@ -63,6 +74,11 @@ struct GpuDrawItem {
         flags |= 0x10;
     }
 
+    void EnableIndirect()
+    {
+        flags |= 0x20;
+    }
+
     u32* VertexBufferOffsets() const
     { return (u32*)(this + 1); }
 
@@ -78,10 +94,24 @@ struct GpuDrawItem {
     u16* Samplers() const
     { return (u16*)(Textures() + nTextures); }
 
+    // The size of the draw item, including the arrays following it.
+    size_t SizeInBytes() const
+    { return (size_t)((const u8*)(Samplers() + nSamplers) - (const u8*)this); }
+
     // Description of flags (16-bit):
     //   Bits 0-2 contain the primitive type.
     //   Bit 3 contains the index type (16 vs 32 bit)
     //   Bit 4 is 1 if indexed drawing is used, otherwise 0 for non-indexed.
+    //   Bit 5 is 1 if the draw arguments are read from drawArgsBufferIdx.
+    //
+    // For indirect draw items, first is the byte offset of the first
+    // GpuDrawArgs record in the draw arguments buffer and count is the number
+    // of records. instanceCount and baseVertex are unused, since each record
+    // has its own.
+    //
+    // baseVertex is added to each index of an indexed draw before the vertex
+    // buffers are read, so that the geometry of many meshes can share one
+    // vertex buffer.
 
     u16 pipelineStateIdx;
     u16 flags;
@@ -90,10 +120,15 @@ struct GpuDrawItem {
     u8 nCBuffers;
     u8 nTextures;
     u8 nSamplers;
+    u16 instanceBufferIdx;
+    u16 drawArgsBufferIdx;
     u16 _pad;
     u32 first;
     u32 count;
     u32 indexBufferOffset;
+    u32 instanceCount;
+    u32 instanceBufferOffset;
+    i32 baseVertex;
     // Following this are:
     //   (1) vertex buffers offsets: array of size nVertexBuffers of u32
     //   (2) vertex buffer indices: array of size nVertexBuffers of u16
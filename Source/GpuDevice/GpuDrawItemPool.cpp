@@ -1,5 +1,7 @@
 #include "GpuDevice/GpuDrawItemPool.h"
 
+#include <string.h>
+
 #include "Core/Macros.h"
 
 GpuDrawItemPool::GpuDrawItemPool(GpuDevice& device, const GpuDrawItemWriterDesc& desc)
@@ -127,10 +127,15 @@ void GpuDrawItemWriter::Begin(GpuDevice* device,
     m_drawItem->nCBuffers = (u8)desc.NumCBuffers();
     m_drawItem->nTextures = (u8)desc.NumTextures();
     m_drawItem->nSamplers = (u8)desc.NumSamplers();
+    m_drawItem->instanceBufferIdx = 0xFFFF;
+    m_drawItem->drawArgsBufferIdx = 0xFFFF;
     m_drawItem->_pad = 0;
     m_drawItem->first = 0;
     m_drawItem->count = 0;
     m_drawItem->indexBufferOffset = 0;
+    m_drawItem->instanceCount = 1;
+    m_drawItem->instanceBufferOffset = 0;
+    m_drawItem->baseVertex = 0;
 
     memset(m_drawItem->VertexBuffers(), 0xFF, desc.NumVertexBuffers() * sizeof(u16));
     memset(m_drawItem->CBuffers(), 0xFF, desc.NumCBuffers() * sizeof(u16));
@@ -152,6 +157,9 @@ GpuDrawItem* GpuDrawItemWriter::End()
     ASSERT((m_flags & FLAG_SETDRAWCALL) && "No draw call has been specified");
     ASSERT(!(m_flags & FLAG_INDEXED) || (m_drawItem->indexBufferIdx != 0xFFFF)
            && "Index buffer not specified for indexed draw call");
+    ASSERT(!m_drawItem->HasInstanceBuffer()
+           || (m_drawItem->nCBuffers <= GPU_INSTANCE_BUFFER_SLOT)
+           && "A cbuffer is set in the slot used by the instance buffer");
 
 #ifdef GPUDEVICE_DEBUG_MODE
     m_device->RegisterDrawItem(m_drawItem);
@@ -204,6 +212,24 @@ void GpuDrawItemWriter::SetSampler(int index, GpuSamplerID sampler)
     m_drawItem->Samplers()[index] = GetRawIndex(sampler);
 }
 
+void GpuDrawItemWriter::SetInstanceBuffer(GpuBufferID buffer, unsigned offset)
+{
+    ASSERT(m_device->BufferExists(buffer));
+    m_drawItem->instanceBufferIdx = GetRawIndex(buffer);
+    m_drawItem->instanceBufferOffset = (u32)offset;
+}
+
+void GpuDrawItemWriter::SetInstanceCount(int count)
+{
+    ASSERT(count >= 0);
+    m_drawItem->instanceCount = (u32)count;
+}
+
+void GpuDrawItemWriter::SetBaseVertex(int baseVertex)
+{
+    m_drawItem->baseVertex = (i32)baseVertex;
+}
+
 void GpuDrawItemWriter::SetDrawCall(GpuPrimitiveType primType, int first, int count)
 {
     ASSERT(first >= 0 && count >= 0);
@@ -235,3 +261,27 @@ void GpuDrawItemWriter::SetDrawCallIndexed(GpuPrimitiveType primType,
     m_flags |= FLAG_SETDRAWCALL;
     m_flags |= FLAG_INDEXED;
 }
+
+void GpuDrawItemWriter::SetDrawCallIndexedIndirect(GpuPrimitiveType primType,
+                                                   GpuBufferID argsBuffer,
+                                                   unsigned argsOffset,
+                                                   int nDraws,
+                                                   unsigned indexBufOffset,
+                                                   GpuIndexType indexType)
+{
+    ASSERT(m_device->BufferExists(argsBuffer));
+    ASSERT((argsOffset % 4) == 0 && nDraws >= 0);
+    ASSERT(!(m_flags & FLAG_SETDRAWCALL) && "Draw call already set");
+
+    m_drawItem->SetPrimitiveType(primType);
+    m_drawItem->SetIndexType(indexType);
+    m_drawItem->EnableIndexed();
+    m_drawItem->EnableIndirect();
+    m_drawItem->drawArgsBufferIdx = GetRawIndex(argsBuffer);
+    m_drawItem->first = (u32)argsOffset;
+    m_drawItem->count = (u32)nDraws;
+    m_drawItem->indexBufferOffset = indexBufOffset;
+
+    m_flags |= FLAG_SETDRAWCALL;
+    m_flags |= FLAG_INDEXED;
+}
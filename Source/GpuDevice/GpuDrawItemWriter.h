@@ -27,7 +27,7 @@ private:
 
 class GpuDrawItemSize {
 public:
-    static const int Base = 24;
+    static const int Base = 40;
     static const int VertexBuf = 6;
     static const int CBuf = 2;
     static const int Texture = 2;
@@ -57,6 +57,14 @@ public:
     void SetTexture(int index, GpuTextureID texture);
     void SetSampler(int index, GpuSamplerID sampler);
 
+    // The instance buffer is bound to the cbuffer slot GPU_INSTANCE_BUFFER_SLOT,
+    // starting at the given offset. Shaders index it by the instance ID.
+    void SetInstanceBuffer(GpuBufferID buffer, unsigned offset);
+    void SetInstanceCount(int count);
+    // Offsets the indices of an indexed (non-indirect) draw call by the given
+    // number of vertices.
+    void SetBaseVertex(int baseVertex);
+
     void SetDrawCall(GpuPrimitiveType primType, int first, int count);
     void SetDrawCallIndexed(GpuPrimitiveType primType,
                             int first,
@@ -64,6 +72,17 @@ public:
                             unsigned indexBufOffset,
                             GpuIndexType indexType);
 
+    // Issues nDraws indexed draws that share all the bindings of the draw
+    // item. The arguments of each draw are read from an array of GpuDrawArgs
+    // records in a GPU_BUFFER_TYPE_INDIRECT buffer, starting at argsOffset
+    // bytes (which must be a multiple of 4).
+    void SetDrawCallIndexedIndirect(GpuPrimitiveType primType,
+                                    GpuBufferID argsBuffer,
+                                    unsigned argsOffset,
+                                    int nDraws,
+                                    unsigned indexBufOffset,
+                                    GpuIndexType indexType);
+
 private:
     GpuDrawItemWriter(const GpuDrawItemWriter&);
     GpuDrawItemWriter& operator=(const GpuDrawItemWriter&);
@@ -0,0 +1,41 @@
+#include "GpuDevice/GpuFrameCounters.h"
+#include <string.h>
+
+GpuFrameCounters::GpuFrameCounters()
+    : m_frame()
+    , m_stats()
+{
+    Clear(m_frame);
+    Clear(m_stats);
+}
+
+void GpuFrameCounters::Clear(GpuFrameStats& stats)
+{
+    memset(&stats, 0, sizeof stats);
+}
+
+void GpuFrameCounters::EndFrame(const GpuStateFilterStats& stateFilterStats,
+                                const GpuDrawStats& drawStats,
+                                const GpuUploadHeapStats& uploadHeapStats)
+{
+    m_frame.nDraws = drawStats.nDraws;
+    m_frame.nIndexedPrimitives = drawStats.nIndexedPrimitives;
+    m_frame.nNonIndexedPrimitives = drawStats.nNonIndexedPrimitives;
+
+    const u32* binds = stateFilterStats.bindsIssued;
+    m_frame.nPipelineStateBinds = binds[GPU_STATE_PIPELINE];
+    m_frame.nBufferBinds = binds[GPU_STATE_VERTEX_BUFFER] + binds[GPU_STATE_CBUFFER];
+    m_frame.nTextureBinds = binds[GPU_STATE_TEXTURE];
+    m_frame.nSamplerBinds = binds[GPU_STATE_SAMPLER];
+
+    m_frame.uploadHeapBytesUsed = uploadHeapStats.frameBytesUsed;
+    m_frame.uploadHeapPageBytes = uploadHeapStats.nPageBytes;
+
+    m_stats = m_frame;
+    Clear(m_frame);
+}
+
+const GpuFrameStats& GpuFrameCounters::GetStats() const
+{
+    return m_stats;
+}
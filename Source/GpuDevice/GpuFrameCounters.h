@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ *   GpuFrameCounters.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuFrameCounters keeps the GpuFrameStats of the frame being built. The
+ *   backend calls the Count*() methods from the calls that they count; the
+ *   draw and bind counters are instead kept by the GpuStateCache, since it's
+ *   already kept per encoder.
+ *
+ *   The backend calls EndFrame() from ScenePresent(), after it has gathered
+ *   the frame's state cache statistics and ended the frame on its upload
+ *   heap. EndFrame() fills in the counters kept by those, makes the frame's
+ *   stats the ones returned by GetStats(), and starts counting the next frame.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUFRAMECOUNTERS_H
+#define GPUDEVICE_GPUFRAMECOUNTERS_H
+
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuFrameCounters {
+public:
+    GpuFrameCounters();
+
+    void CountCreate(GpuResourceType type)
+    {
+        ++m_frame.nCreated[type];
+    }
+
+    void CountDestroy(GpuResourceType type)
+    {
+        ++m_frame.nDestroyed[type];
+    }
+
+    void CountBufferMap(u32 nBytes)
+    {
+        m_frame.bufferMapBytes += nBytes;
+    }
+
+    void CountTextureUpload(GpuPixelFormat pixelFormat, const GpuRegion& region)
+    {
+        m_frame.textureUploadBytes += GpuDevice::TextureSizeInBytes(
+            GPU_TEXTURE_2D, pixelFormat, region.width, region.height, 1, 1
+        );
+    }
+
+    void EndFrame(const GpuStateFilterStats& stateFilterStats,
+                  const GpuDrawStats& drawStats,
+                  const GpuUploadHeapStats& uploadHeapStats);
+
+    const GpuFrameStats& GetStats() const;
+
+private:
+    GpuFrameCounters(const GpuFrameCounters&);
+    GpuFrameCounters& operator=(const GpuFrameCounters&);
+
+    static void Clear(GpuFrameStats& stats);
+
+    // The counters of the frame being built, and of the last presented one.
+    GpuFrameStats m_frame;
+    GpuFrameStats m_stats;
+};
+
+#endif // GPUDEVICE_GPUFRAMECOUNTERS_H
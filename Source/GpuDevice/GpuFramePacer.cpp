@@ -0,0 +1,101 @@
+#include "GpuDevice/GpuFramePacer.h"
+#include <chrono>
+#include "Core/Macros.h"
+
+GpuFramePacer::GpuFramePacer()
+    : m_maxFramesInFlight(GPU_DEFAULT_FRAMES_IN_FLIGHT)
+    , m_submittedFrame(0)
+    , m_mutex()
+    , m_frameCompleted()
+    , m_completedFrame(0)
+    , m_completedGpuMs(0.0)
+    , m_cpuWaitMs(0.0)
+    , m_stats()
+{
+    m_stats.nFramesInFlight = 0;
+    m_stats.cpuWaitMs = 0.0f;
+    m_stats.gpuMs = 0.0f;
+}
+
+void GpuFramePacer::SetMaxFramesInFlight(int nFrames)
+{
+    ASSERT(1 <= nFrames && nFrames <= GPU_MAX_FRAMES_IN_FLIGHT);
+    m_maxFramesInFlight = nFrames;
+}
+
+int GpuFramePacer::GetMaxFramesInFlight() const
+{
+    return m_maxFramesInFlight;
+}
+
+u64 GpuFramePacer::BeginFrame()
+{
+    u64 frame = m_submittedFrame + 1;
+    // Frame N may begin once frame N - maxFramesInFlight has completed.
+    if (frame > (u64)m_maxFramesInFlight)
+        WaitForFrame(frame - m_maxFramesInFlight);
+    return frame;
+}
+
+u64 GpuFramePacer::Submit()
+{
+    ++m_submittedFrame;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.nFramesInFlight = (u32)(m_submittedFrame - m_completedFrame);
+        m_stats.gpuMs = (float)m_completedGpuMs;
+    }
+    m_stats.cpuWaitMs = (float)m_cpuWaitMs;
+    m_cpuWaitMs = 0.0;
+
+    return m_submittedFrame;
+}
+
+void GpuFramePacer::Complete(u64 frame, double gpuMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ASSERT(frame > m_completedFrame);
+        m_completedFrame = frame;
+        m_completedGpuMs = gpuMs;
+    }
+    m_frameCompleted.notify_all();
+}
+
+u64 GpuFramePacer::GetSubmittedFrame() const
+{
+    return m_submittedFrame;
+}
+
+u64 GpuFramePacer::GetCompletedFrame() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_completedFrame;
+}
+
+void GpuFramePacer::WaitForFrame(u64 frame)
+{
+    ASSERT(frame <= m_submittedFrame);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_completedFrame >= frame)
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (m_completedFrame < frame)
+        m_frameCompleted.wait(lock);
+    std::chrono::duration<double, std::milli> waited
+        = std::chrono::steady_clock::now() - start;
+    m_cpuWaitMs += waited.count();
+}
+
+int GpuFramePacer::FrameSlot(u64 frame)
+{
+    return (int)(frame % GPU_MAX_FRAMES_IN_FLIGHT);
+}
+
+const GpuFramePacingStats& GpuFramePacer::GetStats() const
+{
+    return m_stats;
+}
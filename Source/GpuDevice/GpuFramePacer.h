@@ -0,0 +1,75 @@
+/******************************************************************************
+ *
+ *   GpuFramePacer.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuFramePacer tracks the frames that the CPU has submitted and that the
+ *   GPU has completed, and limits the number of frames in flight.
+ *
+ *   The backend calls BeginFrame() from SceneBegin(), which blocks until the
+ *   frame may begin, and Submit() from ScenePresent(). The GPU (or whatever
+ *   stands in for it) calls Complete() from any thread once it has finished
+ *   executing a frame.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUFRAMEPACER_H
+#define GPUDEVICE_GPUFRAMEPACER_H
+
+#include <condition_variable>
+#include <mutex>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuFramePacer {
+public:
+    GpuFramePacer();
+
+    void SetMaxFramesInFlight(int nFrames);
+    int GetMaxFramesInFlight() const;
+
+    // Waits until fewer than the maximum number of frames are in flight.
+    // Returns the number of the frame that's beginning.
+    u64 BeginFrame();
+    // Returns the number of the submitted frame.
+    u64 Submit();
+    // Thread-safe. The GPU executes frames in order, so completing a frame
+    // also completes every frame before it. gpuMs is the time that the GPU
+    // spent executing the frame.
+    void Complete(u64 frame, double gpuMs);
+
+    u64 GetSubmittedFrame() const;
+    u64 GetCompletedFrame() const; // Thread-safe
+    void WaitForFrame(u64 frame);
+
+    // Returns the index of the per-frame resources to use for the given
+    // frame, between 0 and GPU_MAX_FRAMES_IN_FLIGHT - 1.
+    static int FrameSlot(u64 frame);
+
+    const GpuFramePacingStats& GetStats() const;
+
+private:
+    GpuFramePacer(const GpuFramePacer&);
+    GpuFramePacer& operator=(const GpuFramePacer&);
+
+    int m_maxFramesInFlight;
+    u64 m_submittedFrame;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_frameCompleted;
+    u64 m_completedFrame;
+    double m_completedGpuMs;
+
+    // Accumulated over the frame being built, then copied into m_stats when
+    // the frame is submitted.
+    double m_cpuWaitMs;
+    GpuFramePacingStats m_stats;
+};
+
+#endif // GPUDEVICE_GPUFRAMEPACER_H
@@ -0,0 +1,63 @@
+#include "GpuDevice/GpuMemoryTracker.h"
+#include "Core/Macros.h"
+
+GpuMemoryTracker::GpuMemoryTracker()
+    : m_stats()
+    , m_budget(0)
+    , m_budgetCallback(NULL)
+    , m_budgetUserdata(NULL)
+{
+    for (int i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i) {
+        m_stats.nAllocations[i] = 0;
+        m_stats.bytes[i] = 0;
+        m_stats.peakBytes[i] = 0;
+    }
+    m_stats.totalBytes = 0;
+    m_stats.peakTotalBytes = 0;
+}
+
+void GpuMemoryTracker::Add(GpuMemoryCategory category, u64 bytes)
+{
+    ASSERT(0 <= category && category < GPU_MEMORY_CATEGORY_COUNT);
+
+    ++m_stats.nAllocations[category];
+    m_stats.bytes[category] += bytes;
+    if (m_stats.bytes[category] > m_stats.peakBytes[category])
+        m_stats.peakBytes[category] = m_stats.bytes[category];
+
+    m_stats.totalBytes += bytes;
+    if (m_stats.totalBytes > m_stats.peakTotalBytes)
+        m_stats.peakTotalBytes = m_stats.totalBytes;
+}
+
+void GpuMemoryTracker::Remove(GpuMemoryCategory category, u64 bytes)
+{
+    ASSERT(0 <= category && category < GPU_MEMORY_CATEGORY_COUNT);
+    ASSERT(m_stats.nAllocations[category] > 0);
+    ASSERT(m_stats.bytes[category] >= bytes);
+
+    --m_stats.nAllocations[category];
+    m_stats.bytes[category] -= bytes;
+    m_stats.totalBytes -= bytes;
+}
+
+void GpuMemoryTracker::SetBudget(u64 budget,
+                                 GpuMemoryBudgetCallback callback,
+                                 void* userdata)
+{
+    ASSERT(budget == 0 || callback != NULL);
+    m_budget = budget;
+    m_budgetCallback = callback;
+    m_budgetUserdata = userdata;
+}
+
+void GpuMemoryTracker::CheckBudget()
+{
+    if (m_budget != 0 && m_stats.totalBytes > m_budget)
+        m_budgetCallback(m_stats, m_budget, m_budgetUserdata);
+}
+
+const GpuMemoryStats& GpuMemoryTracker::GetStats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+ *
+ *   GpuMemoryTracker.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuMemoryTracker keeps the running totals of GpuMemoryStats. The backend
+ *   calls Add() when it creates a resource and Remove() with the same size
+ *   when it destroys it, so each resource must remember its size.
+ *
+ *   The backend calls CheckBudget() from ScenePresent(), which calls the
+ *   budget callback if the total is over the budget. The callback isn't
+ *   called from Add(), since it's allowed to destroy resources and Add() is
+ *   called in the middle of creating one.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUMEMORYTRACKER_H
+#define GPUDEVICE_GPUMEMORYTRACKER_H
+
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuMemoryTracker {
+public:
+    GpuMemoryTracker();
+
+    void Add(GpuMemoryCategory category, u64 bytes);
+    void Remove(GpuMemoryCategory category, u64 bytes);
+
+    void SetBudget(u64 budget, GpuMemoryBudgetCallback callback, void* userdata);
+    void CheckBudget();
+
+    const GpuMemoryStats& GetStats() const;
+
+private:
+    GpuMemoryTracker(const GpuMemoryTracker&);
+    GpuMemoryTracker& operator=(const GpuMemoryTracker&);
+
+    GpuMemoryStats m_stats;
+
+    u64 m_budget;
+    GpuMemoryBudgetCallback m_budgetCallback;
+    void* m_budgetUserdata;
+};
+
+#endif // GPUDEVICE_GPUMEMORYTRACKER_H
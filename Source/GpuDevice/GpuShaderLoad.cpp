@@ -1,5 +1,7 @@
 #include "GpuDevice/GpuShaderLoad.h"
 
+#include <string.h>
+
 #include "Core/Macros.h"
 #include "Core/Endian.h"
 
@@ -0,0 +1,126 @@
+#include "GpuDevice/GpuSimulatedGpu.h"
+#include <chrono>
+#include "Core/Macros.h"
+#include "GpuDevice/GpuCommandList.h"
+#include "GpuDevice/GpuFramePacer.h"
+#include "GpuDevice/GpuStateCache.h"
+
+GpuSimulatedGpu::GpuSimulatedGpu(GpuFramePacer& pacer)
+    : m_pacer(pacer)
+    , m_cost()
+    , m_mutex()
+    , m_frameSubmitted()
+    , m_frames()
+    , m_quit(false)
+    , m_thread()
+{
+    // Started last, once the members that it uses have been constructed.
+    m_thread = std::thread(&GpuSimulatedGpu::TimelineMain, this);
+}
+
+GpuSimulatedGpu::~GpuSimulatedGpu()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_frameSubmitted.notify_all();
+    m_thread.join();
+}
+
+void GpuSimulatedGpu::SetCost(const GpuSimulatedGpuCost& cost)
+{
+    ASSERT(cost.perFrame >= 0.0f);
+    ASSERT(cost.perStateBind >= 0.0f);
+    ASSERT(cost.perDraw >= 0.0f);
+    ASSERT(cost.perPrimitive >= 0.0f);
+    ASSERT(cost.perPixel >= 0.0f);
+    ASSERT(cost.perPipelineCompile >= 0.0f);
+    m_cost = cost;
+}
+
+const GpuSimulatedGpuCost& GpuSimulatedGpu::GetCost() const
+{
+    return m_cost;
+}
+
+double GpuSimulatedGpu::CommandsCost(const GpuSimulatedGpuCost& cost,
+                                     const GpuCommandList& commands,
+                                     size_t firstCommand)
+{
+    u64 nStateBinds = 0;
+    u64 nDraws = 0;
+    u64 nPrimitives = 0;
+
+    const GpuCommand* cmds = commands.Commands();
+    for (size_t i = firstCommand; i < commands.NumCommands(); ++i) {
+        const GpuCommand& cmd = cmds[i];
+        switch (cmd.type) {
+            case GPU_CMD_DRAW:
+            case GPU_CMD_DRAW_INDEXED: {
+                GpuPrimitiveType primType = (GpuPrimitiveType)(cmd.slot & 0xF);
+                ++nDraws;
+                u32 nInstancePrimitives = GpuStateCache::PrimitiveCount(primType, cmd.args[1]);
+                nPrimitives += (u64)nInstancePrimitives * cmd.args[3];
+                break;
+            }
+            default:
+                ++nStateBinds;
+                break;
+        }
+    }
+
+    return cost.perStateBind * (double)nStateBinds
+         + cost.perDraw * (double)nDraws
+         + cost.perPrimitive * (double)nPrimitives;
+}
+
+double GpuSimulatedGpu::ViewportCost(const GpuSimulatedGpuCost& cost,
+                                     const GpuViewport& viewport)
+{
+    return cost.perPixel * (double)viewport.width * (double)viewport.height;
+}
+
+void GpuSimulatedGpu::SubmitFrame(u64 frame, double microseconds)
+{
+    Frame f;
+    f.frame = frame;
+    f.microseconds = m_cost.perFrame + microseconds;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_frames.push_back(f);
+    }
+    m_frameSubmitted.notify_one();
+}
+
+void GpuSimulatedGpu::TimelineMain()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // The time at which the GPU finishes the frame that it's executing. A
+    // frame that was queued while the GPU was busy starts as soon as the
+    // previous one ends, so oversleeping doesn't accumulate across frames.
+    Clock::time_point busyUntil = Clock::now();
+
+    for (;;) {
+        Frame f;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_frames.empty() && !m_quit)
+                m_frameSubmitted.wait(lock);
+            if (m_frames.empty())
+                return;
+            f = m_frames.front();
+            m_frames.pop_front();
+        }
+
+        Clock::time_point now = Clock::now();
+        if (busyUntil < now)
+            busyUntil = now;
+        busyUntil += std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::micro>(f.microseconds));
+        std::this_thread::sleep_until(busyUntil);
+
+        m_pacer.Complete(f.frame, f.microseconds / 1000.0);
+    }
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ *
+ *   GpuSimulatedGpu.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuSimulatedGpu stands in for the GPU in backends that don't have one. A
+ *   timeline thread consumes the submitted frames in order, taking the time
+ *   given by a GpuSimulatedGpuCost model to "execute" each one, and completes
+ *   them on a GpuFramePacer. This makes it possible to measure CPU/GPU overlap
+ *   and stalls without any GPU hardware.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSIMULATEDGPU_H
+#define GPUDEVICE_GPUSIMULATEDGPU_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuCommandList;
+class GpuFramePacer;
+
+class GpuSimulatedGpu {
+public:
+    explicit GpuSimulatedGpu(GpuFramePacer& pacer);
+    // Waits for the queued frames to complete.
+    ~GpuSimulatedGpu();
+
+    void SetCost(const GpuSimulatedGpuCost& cost);
+    const GpuSimulatedGpuCost& GetCost() const;
+
+    // Returns the time in microseconds that the commands from firstCommand
+    // onwards take to execute under the given cost model, excluding the
+    // per-frame and per-pixel costs.
+    static double CommandsCost(const GpuSimulatedGpuCost& cost,
+                               const GpuCommandList& commands,
+                               size_t firstCommand);
+    // Returns the time in microseconds charged for the pixels of a Draw()
+    // call's viewport.
+    static double ViewportCost(const GpuSimulatedGpuCost& cost,
+                               const GpuViewport& viewport);
+
+    // Queues a submitted frame whose commands take the given time to execute.
+    // The per-frame cost is added to the time.
+    void SubmitFrame(u64 frame, double microseconds);
+
+private:
+    GpuSimulatedGpu(const GpuSimulatedGpu&);
+    GpuSimulatedGpu& operator=(const GpuSimulatedGpu&);
+
+    struct Frame {
+        u64 frame;
+        double microseconds;
+    };
+
+    void TimelineMain();
+
+    GpuFramePacer& m_pacer;
+    GpuSimulatedGpuCost m_cost;
+
+    std::mutex m_mutex;
+    std::condition_variable m_frameSubmitted;
+    std::deque<Frame> m_frames;
+    bool m_quit;
+
+    std::thread m_thread;
+};
+
+#endif // GPUDEVICE_GPUSIMULATEDGPU_H
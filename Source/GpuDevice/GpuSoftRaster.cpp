@@ -0,0 +1,487 @@
+#ifdef GPUDEVICE_API_SOFT
+
+#include "GpuDevice/GpuSoftRaster.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "Core/Macros.h"
+
+// Vertices are snapped to this fraction of a pixel before setup, so that the
+// edge functions of triangles sharing an edge agree exactly.
+const float SUBPIXEL_SCALE = 16.0f;
+
+// -----------------------------------------------------------------------------
+// Clipping
+// -----------------------------------------------------------------------------
+
+// Linearly interpolates the position and interpolated varyings of a vertex.
+static void LerpVertex(const GpuSoftVertex& a,
+                       const GpuSoftVertex& b,
+                       float t,
+                       int nVaryings,
+                       GpuSoftVertex* out)
+{
+    for (int i = 0; i < 4; ++i)
+        out->position[i] = a.position[i] + (b.position[i] - a.position[i]) * t;
+    for (int i = 0; i < nVaryings; ++i)
+        out->varyings[i] = a.varyings[i] + (b.varyings[i] - a.varyings[i]) * t;
+}
+
+// Clips a triangle against the near plane (z >= 0 in clip space). Returns the
+// number of vertices of the resulting convex polygon, which is 0, 3 or 4.
+static int ClipNear(const GpuSoftVertex* const* in, int nVaryings, GpuSoftVertex* out)
+{
+    int nOut = 0;
+    for (int i = 0; i < 3; ++i) {
+        const GpuSoftVertex& a = *in[i];
+        const GpuSoftVertex& b = *in[(i + 1) % 3];
+        float da = a.position[2];
+        float db = b.position[2];
+        if (da >= 0.0f)
+            out[nOut++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f))
+            LerpVertex(a, b, da / (da - db), nVaryings, &out[nOut++]);
+    }
+    return nOut;
+}
+
+// Returns true if all three vertices are outside the same clip plane.
+static bool IsTriviallyOutside(const GpuSoftVertex* const* v)
+{
+    for (int axis = 0; axis < 2; ++axis) {
+        bool allBelow = true;
+        bool allAbove = true;
+        for (int i = 0; i < 3; ++i) {
+            float x = v[i]->position[axis];
+            float w = v[i]->position[3];
+            allBelow = allBelow && x < -w;
+            allAbove = allAbove && x > w;
+        }
+        if (allBelow || allAbove)
+            return true;
+    }
+    return v[0]->position[2] < 0.0f &&
+           v[1]->position[2] < 0.0f &&
+           v[2]->position[2] < 0.0f;
+}
+
+// -----------------------------------------------------------------------------
+// GpuSoftBinner
+// -----------------------------------------------------------------------------
+
+GpuSoftBinner::GpuSoftBinner()
+    : m_target()
+    , m_drawStates()
+    , m_triangles()
+    , m_planes()
+    , m_bins()
+{}
+
+void GpuSoftBinner::Begin(const GpuSoftTarget& target)
+{
+    m_target = target;
+    m_drawStates.clear();
+    m_triangles.clear();
+    m_planes.clear();
+
+    size_t nTiles = (size_t)(target.nTilesX * target.nTilesY);
+    if (m_bins.size() < nTiles)
+        m_bins.resize(nTiles);
+    for (size_t i = 0; i < nTiles; ++i)
+        m_bins[i].clear();
+}
+
+u32 GpuSoftBinner::AddDrawState(const GpuSoftDrawState& state)
+{
+    m_drawStates.push_back(state);
+    return (u32)m_drawStates.size() - 1;
+}
+
+u32 GpuSoftBinner::GetTriangleCount() const
+{
+    return (u32)m_triangles.size();
+}
+
+void GpuSoftBinner::AddTriangle(u32 drawState,
+                                const GpuSoftVertex& v0,
+                                const GpuSoftVertex& v1,
+                                const GpuSoftVertex& v2)
+{
+    const GpuSoftShader& shader = *m_drawStates[drawState].shader;
+    const GpuSoftVertex* v[3] = {&v0, &v1, &v2};
+    const float* flat = v0.varyings + shader.nVaryings;
+
+    if (IsTriviallyOutside(v))
+        return;
+
+    if (v0.position[2] >= 0.0f && v1.position[2] >= 0.0f && v2.position[2] >= 0.0f) {
+        SetupTriangle(drawState, v, flat);
+        return;
+    }
+
+    GpuSoftVertex clipped[4];
+    int nClipped = ClipNear(v, shader.nVaryings, clipped);
+    for (int i = 1; i + 1 < nClipped; ++i) {
+        const GpuSoftVertex* fan[3] = {&clipped[0], &clipped[i], &clipped[i + 1]};
+        SetupTriangle(drawState, fan, flat);
+    }
+}
+
+void GpuSoftBinner::SetupTriangle(u32 drawState,
+                                  const GpuSoftVertex* const* v,
+                                  const float* flat)
+{
+    const GpuSoftDrawState& state = m_drawStates[drawState];
+    const GpuSoftShader& shader = *state.shader;
+    const GpuViewport& viewport = m_target.viewport;
+
+    // Viewport transform. In clip space, y points up and z is in [0, 1].
+    float x[3], y[3], z[3], invW[3];
+    for (int i = 0; i < 3; ++i) {
+        const float* position = v[i]->position;
+        if (position[3] <= 0.0f)
+            return;
+        invW[i] = 1.0f / position[3];
+        float ndcX = position[0] * invW[i];
+        float ndcY = position[1] * invW[i];
+        float ndcZ = position[2] / position[3];
+        x[i] = (float)viewport.x + (ndcX * 0.5f + 0.5f) * (float)viewport.width;
+        y[i] = (float)viewport.y + (0.5f - ndcY * 0.5f) * (float)viewport.height;
+        x[i] = floorf(x[i] * SUBPIXEL_SCALE + 0.5f) / SUBPIXEL_SCALE;
+        y[i] = floorf(y[i] * SUBPIXEL_SCALE + 0.5f) / SUBPIXEL_SCALE;
+        z[i] = viewport.zNear + ndcZ * (viewport.zFar - viewport.zNear);
+    }
+
+    float area2 = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area2 == 0.0f)
+        return;
+
+    // A triangle that is counter-clockwise in clip space is clockwise on the
+    // screen, since the viewport transform flips y.
+    bool counterClockwise = area2 < 0.0f;
+    bool frontFacing = (state.frontFaceWinding == GPU_WINDING_COUNTER_CLOCKWISE)
+                       == counterClockwise;
+    if (state.cullMode == GPU_CULL_BACK && !frontFacing)
+        return;
+    if (state.cullMode == GPU_CULL_FRONT && frontFacing)
+        return;
+
+    // Order the vertices so that the edge functions are positive inside.
+    int order[3] = {0, 1, 2};
+    if (area2 < 0.0f) {
+        order[1] = 2;
+        order[2] = 1;
+        area2 = -area2;
+    }
+
+    float minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (int i = 1; i < 3; ++i) {
+        minX = x[i] < minX ? x[i] : minX;
+        maxX = x[i] > maxX ? x[i] : maxX;
+        minY = y[i] < minY ? y[i] : minY;
+        maxY = y[i] > maxY ? y[i] : maxY;
+    }
+
+    Triangle tri;
+    tri.minX = (int)floorf(minX);
+    tri.minY = (int)floorf(minY);
+    tri.maxX = (int)ceilf(maxX);
+    tri.maxY = (int)ceilf(maxY);
+    if (tri.minX < m_target.scissorX0) tri.minX = m_target.scissorX0;
+    if (tri.minY < m_target.scissorY0) tri.minY = m_target.scissorY0;
+    if (tri.maxX > m_target.scissorX1) tri.maxX = m_target.scissorX1;
+    if (tri.maxY > m_target.scissorY1) tri.maxY = m_target.scissorY1;
+    if (tri.minX >= tri.maxX || tri.minY >= tri.maxY)
+        return;
+
+    // Edge k runs from vertex k to vertex k + 1, and is opposite vertex k + 2.
+    tri.topLeftEdges = 0;
+    for (int k = 0; k < 3; ++k) {
+        int a = order[k];
+        int b = order[(k + 1) % 3];
+        float A = y[a] - y[b];
+        float B = x[b] - x[a];
+        tri.edges[k][0] = A;
+        tri.edges[k][1] = B;
+        tri.edges[k][2] = x[a] * y[b] - x[b] * y[a];
+
+        // The edge's inward normal is (A, B), with y pointing down.
+        if (A > 0.0f || (A == 0.0f && B > 0.0f))
+            tri.topLeftEdges |= (u8)(1 << k);
+    }
+
+    int i0 = order[0];
+    tri.x0 = x[i0];
+    tri.y0 = y[i0];
+    tri.drawState = drawState;
+    tri.planesOffset = (u32)m_planes.size();
+
+    // The barycentric coordinate of vertex order[k] is the edge function of
+    // the opposite edge, k + 1, divided by area2.
+    float invArea2 = 1.0f / area2;
+    float ddx[3], ddy[3];
+    for (int k = 0; k < 3; ++k) {
+        const float* edge = tri.edges[(k + 1) % 3];
+        ddx[k] = edge[0] * invArea2;
+        ddy[k] = edge[1] * invArea2;
+    }
+
+    int nPlanes = 2 + shader.nVaryings;
+    m_planes.resize(m_planes.size() + 3 * nPlanes + shader.nFlatVaryings);
+    float* planes = &m_planes[tri.planesOffset];
+    for (int p = 0; p < nPlanes; ++p) {
+        float values[3];
+        for (int k = 0; k < 3; ++k) {
+            int i = order[k];
+            if (p == 0)
+                values[k] = z[i];
+            else if (p == 1)
+                values[k] = invW[i];
+            else
+                values[k] = v[i]->varyings[p - 2] * invW[i];
+        }
+        planes[3 * p + 0] = ddx[0] * values[0] + ddx[1] * values[1] + ddx[2] * values[2];
+        planes[3 * p + 1] = ddy[0] * values[0] + ddy[1] * values[1] + ddy[2] * values[2];
+        planes[3 * p + 2] = values[0];
+    }
+    memcpy(planes + 3 * nPlanes, flat, shader.nFlatVaryings * sizeof(float));
+
+    u32 index = (u32)m_triangles.size();
+    m_triangles.push_back(tri);
+
+    int tileX0 = tri.minX / GPU_SOFT_TILE_SIZE;
+    int tileY0 = tri.minY / GPU_SOFT_TILE_SIZE;
+    int tileX1 = (tri.maxX - 1) / GPU_SOFT_TILE_SIZE;
+    int tileY1 = (tri.maxY - 1) / GPU_SOFT_TILE_SIZE;
+    for (int ty = tileY0; ty <= tileY1; ++ty) {
+        for (int tx = tileX0; tx <= tileX1; ++tx)
+            m_bins[ty * m_target.nTilesX + tx].push_back(index);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Rasterization
+// -----------------------------------------------------------------------------
+
+static SimdMask DepthTest(GpuCompareFunction compare, const SimdFloat& z, const SimdFloat& dst)
+{
+    switch (compare) {
+        case GPU_COMPARE_NEVER: return SimdMaskFromBits(0);
+        case GPU_COMPARE_LESS: return z < dst;
+        case GPU_COMPARE_EQUAL: return z == dst;
+        case GPU_COMPARE_LESS_EQUAL: return z <= dst;
+        case GPU_COMPARE_GREATER: return z > dst;
+        case GPU_COMPARE_NOT_EQUAL: return z != dst;
+        case GPU_COMPARE_GREATER_EQUAL: return z >= dst;
+        case GPU_COMPARE_ALWAYS: return SimdMaskFromBits(0xF);
+    }
+    return SimdMaskFromBits(0xF);
+}
+
+static void BlendFactor(GpuBlendFactor factor,
+                        const SimdFloat* src,
+                        const SimdFloat* dst,
+                        SimdFloat* out)
+{
+    SimdFloat one = SimdSet(1.0f);
+    for (int i = 0; i < 4; ++i) {
+        switch (factor) {
+            case GPU_BLEND_ZERO: out[i] = SimdSet(0.0f); break;
+            case GPU_BLEND_ONE: out[i] = one; break;
+            case GPU_BLEND_SRC_COLOR: out[i] = src[i]; break;
+            case GPU_BLEND_ONE_MINUS_SRC_COLOR: out[i] = one - src[i]; break;
+            case GPU_BLEND_DST_COLOR: out[i] = dst[i]; break;
+            case GPU_BLEND_ONE_MINUS_DST_COLOR: out[i] = one - dst[i]; break;
+            case GPU_BLEND_SRC_ALPHA: out[i] = src[3]; break;
+            case GPU_BLEND_ONE_MINUS_SRC_ALPHA: out[i] = one - src[3]; break;
+            case GPU_BLEND_DST_ALPHA: out[i] = dst[3]; break;
+            case GPU_BLEND_ONE_MINUS_DST_ALPHA: out[i] = one - dst[3]; break;
+        }
+    }
+}
+
+static SimdFloat EvaluatePlane(const float* plane, const SimdFloat& dx, const SimdFloat& dy)
+{
+    return SimdSet(plane[0]) * dx + SimdSet(plane[1]) * dy + SimdSet(plane[2]);
+}
+
+void GpuSoftBinner::DrawBin(int tile, const GpuSoftTarget& target) const
+{
+    int tileX0 = (tile % target.nTilesX) * GPU_SOFT_TILE_SIZE;
+    int tileY0 = (tile / target.nTilesX) * GPU_SOFT_TILE_SIZE;
+    int tileX1 = tileX0 + GPU_SOFT_TILE_SIZE;
+    int tileY1 = tileY0 + GPU_SOFT_TILE_SIZE;
+
+    float minDepth = target.viewport.zNear < target.viewport.zFar
+                   ? target.viewport.zNear : target.viewport.zFar;
+    float maxDepth = target.viewport.zNear < target.viewport.zFar
+                   ? target.viewport.zFar : target.viewport.zNear;
+
+    const SimdFloat laneX = SimdSet(0.5f, 1.5f, 0.5f, 1.5f);
+    const SimdFloat laneY = SimdSet(0.5f, 0.5f, 1.5f, 1.5f);
+
+    const std::vector<u32>& bin = m_bins[tile];
+    for (size_t triIndex = 0; triIndex < bin.size(); ++triIndex) {
+        const Triangle& tri = m_triangles[bin[triIndex]];
+        const GpuSoftDrawState& state = m_drawStates[tri.drawState];
+        const GpuSoftShader& shader = *state.shader;
+        const float* planes = &m_planes[tri.planesOffset];
+
+        int x0 = tri.minX > tileX0 ? tri.minX : tileX0;
+        int y0 = tri.minY > tileY0 ? tri.minY : tileY0;
+        int x1 = tri.maxX < tileX1 ? tri.maxX : tileX1;
+        int y1 = tri.maxY < tileY1 ? tri.maxY : tileY1;
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        SimdFloat edgeA[3], edgeB[3], edgeC[3];
+        SimdMask edgeInclusive[3];
+        for (int k = 0; k < 3; ++k) {
+            edgeA[k] = SimdSet(tri.edges[k][0]);
+            edgeB[k] = SimdSet(tri.edges[k][1]);
+            edgeC[k] = SimdSet(tri.edges[k][2]);
+            edgeInclusive[k] = SimdMaskFromBits((tri.topLeftEdges & (1 << k)) ? 0xF : 0);
+        }
+
+        GpuSoftPixelQuad quad;
+        const float* flat = planes + 3 * (2 + shader.nVaryings);
+        for (int i = 0; i < shader.nFlatVaryings; ++i)
+            quad.varyings[shader.nVaryings + i] = SimdSet(flat[i]);
+
+        bool depthTest = target.depth && state.depthCompare != GPU_COMPARE_ALWAYS;
+        bool depthWrite = target.depth && state.depthWritesEnabled;
+        bool earlyDepth = !shader.writesDepth;
+
+        SimdFloat fx0 = SimdSet((float)x0), fx1 = SimdSet((float)x1);
+        SimdFloat fy0 = SimdSet((float)y0), fy1 = SimdSet((float)y1);
+
+        // Quads are aligned to even pixel coordinates, so may overhang the
+        // rectangle being drawn by one pixel on each side.
+        for (int y = y0 & ~1; y < y1; y += 2) {
+            SimdFloat py = laneY + SimdSet((float)y);
+            SimdMask rowMask = (py > fy0) & (py < fy1);
+
+            for (int x = x0 & ~1; x < x1; x += 2) {
+                SimdFloat px = laneX + SimdSet((float)x);
+                SimdMask mask = rowMask & (px > fx0) & (px < fx1);
+                for (int k = 0; k < 3; ++k) {
+                    SimdFloat e = edgeA[k] * px + edgeB[k] * py + edgeC[k];
+                    SimdFloat zero = SimdSet(0.0f);
+                    mask = mask & ((e > zero) | ((e == zero) & edgeInclusive[k]));
+                }
+                int coverage = SimdMaskBits(mask);
+                if (coverage == 0)
+                    continue;
+
+                SimdFloat dx = px - SimdSet(tri.x0);
+                SimdFloat dy = py - SimdSet(tri.y0);
+
+                SimdFloat z = EvaluatePlane(planes, dx, dy);
+                z = SimdMin(SimdMax(z, SimdSet(minDepth)), SimdSet(maxDepth));
+
+                float* depthRow0 = NULL;
+                float* depthRow1 = NULL;
+                SimdFloat dstDepth;
+                if (target.depth) {
+                    depthRow0 = (float*)(target.depth->texels + y * target.depth->stride + x);
+                    depthRow1 = depthRow0 + target.depth->stride;
+                    dstDepth = SimdSet(depthRow0[0], depthRow0[1], depthRow1[0], depthRow1[1]);
+                }
+
+                if (earlyDepth && depthTest) {
+                    coverage &= SimdMaskBits(DepthTest(state.depthCompare, z, dstDepth));
+                    if (coverage == 0)
+                        continue;
+                }
+
+                SimdFloat w = SimdSet(1.0f) / EvaluatePlane(planes + 3, dx, dy);
+                for (int i = 0; i < shader.nVaryings; ++i)
+                    quad.varyings[i] = EvaluatePlane(planes + 3 * (2 + i), dx, dy) * w;
+                quad.depth = z;
+
+                shader.pixelMain(state.resources, &quad);
+
+                if (!earlyDepth) {
+                    z = SimdMin(SimdMax(quad.depth, SimdSet(minDepth)), SimdSet(maxDepth));
+                    if (depthTest) {
+                        coverage &= SimdMaskBits(DepthTest(state.depthCompare, z, dstDepth));
+                        if (coverage == 0)
+                            continue;
+                    }
+                }
+
+                if (target.color) {
+                    u32* colorRow0 = target.color->texels + y * target.color->stride + x;
+                    u32* colorRow1 = colorRow0 + target.color->stride;
+                    u32* pixels[4] = {colorRow0, colorRow0 + 1, colorRow1, colorRow1 + 1};
+
+                    SimdFloat color[4] = {
+                        quad.color[0], quad.color[1], quad.color[2], quad.color[3]
+                    };
+                    if (state.blendingEnabled) {
+                        u32 dstPacked[4] = {*pixels[0], *pixels[1], *pixels[2], *pixels[3]};
+                        SimdFloat dst[4], srcFactor[4], dstFactor[4];
+                        SimdUnpackBGRA8(dstPacked, dst);
+                        BlendFactor(state.blendSrcFactor, color, dst, srcFactor);
+                        BlendFactor(state.blendDstFactor, color, dst, dstFactor);
+                        for (int i = 0; i < 4; ++i)
+                            color[i] = color[i] * srcFactor[i] + dst[i] * dstFactor[i];
+                    }
+
+                    u32 packed[4];
+                    SimdPackBGRA8(color, packed);
+                    for (int lane = 0; lane < 4; ++lane) {
+                        if (coverage & (1 << lane))
+                            *pixels[lane] = packed[lane];
+                    }
+                }
+
+                if (depthWrite) {
+                    float depth[4];
+                    SimdStore(depth, z);
+                    float* pixels[4] = {depthRow0, depthRow0 + 1, depthRow1, depthRow1 + 1};
+                    for (int lane = 0; lane < 4; ++lane) {
+                        if (coverage & (1 << lane))
+                            *pixels[lane] = depth[lane];
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void ClearTile(const GpuSoftSurface& surface,
+                      int tile,
+                      int nTilesX,
+                      u32 value)
+{
+    int x0 = (tile % nTilesX) * GPU_SOFT_TILE_SIZE;
+    int y0 = (tile / nTilesX) * GPU_SOFT_TILE_SIZE;
+    int x1 = x0 + GPU_SOFT_TILE_SIZE < surface.width ? x0 + GPU_SOFT_TILE_SIZE : surface.width;
+    int y1 = y0 + GPU_SOFT_TILE_SIZE < surface.height ? y0 + GPU_SOFT_TILE_SIZE : surface.height;
+    for (int y = y0; y < y1; ++y) {
+        u32* row = surface.texels + y * surface.stride;
+        for (int x = x0; x < x1; ++x)
+            row[x] = value;
+    }
+}
+
+void GpuSoftRaster::DrawTile(int tile,
+                             const GpuSoftTarget& target,
+                             const GpuSoftBinner* const* binners,
+                             int nBinners)
+{
+    if (target.clearColor && target.color)
+        ClearTile(*target.color, tile, target.nTilesX, target.clearColorValue);
+    if (target.clearDepth && target.depth) {
+        u32 depthBits;
+        memcpy(&depthBits, &target.clearDepthValue, sizeof depthBits);
+        ClearTile(*target.depth, tile, target.nTilesX, depthBits);
+    }
+
+    for (int i = 0; i < nBinners; ++i)
+        binners[i]->DrawBin(tile, target);
+}
+
+#endif // GPUDEVICE_API_SOFT
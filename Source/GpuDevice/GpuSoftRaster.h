@@ -0,0 +1,138 @@
+/******************************************************************************
+ *
+ *   GpuSoftRaster.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   The tile-based rasterizer of the software backend.
+ *
+ *   Each GpuDevice::Draw() call is rendered in two phases:
+ *
+ *   (1) Geometry. The draw items are split into chunks (see GpuDrawChunks.h)
+ *       that are processed in parallel, each into its own GpuSoftBinner. The
+ *       binner clips and sets up the shaded triangles and appends each one to
+ *       the bin of every tile that its bounding box overlaps.
+ *
+ *   (2) Rasterization. The tiles are rasterized in parallel with
+ *       GpuSoftRaster::DrawTile(). A tile draws the triangles in the bins of
+ *       each binner in turn, so triangles are drawn in submission order.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSOFTRASTER_H
+#define GPUDEVICE_GPUSOFTRASTER_H
+
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+#include "GpuDevice/GpuSoftShaders.h"
+#include "GpuDevice/GpuSoftTexture.h"
+
+const int GPU_SOFT_TILE_SIZE = 64;
+
+// The render target of a Draw() call.
+struct GpuSoftTarget {
+    // Either surface may be NULL.
+    GpuSoftSurface* color;
+    GpuSoftSurface* depth;
+
+    GpuViewport viewport;
+
+    // The viewport clipped to the surfaces. Pixels outside this rectangle are
+    // never written.
+    int scissorX0;
+    int scissorY0;
+    int scissorX1;
+    int scissorY1;
+
+    int nTilesX;
+    int nTilesY;
+
+    bool clearColor;
+    u32 clearColorValue; // BGRA8888
+    bool clearDepth;
+    float clearDepthValue;
+};
+
+// The state shared by all the triangles of a draw item.
+struct GpuSoftDrawState {
+    const GpuSoftShader* shader;
+    GpuSoftResources resources;
+    GpuCompareFunction depthCompare;
+    bool depthWritesEnabled;
+    GpuCullMode cullMode;
+    GpuWindingOrder frontFaceWinding;
+    bool blendingEnabled;
+    GpuBlendFactor blendSrcFactor;
+    GpuBlendFactor blendDstFactor;
+};
+
+class GpuSoftBinner {
+public:
+    GpuSoftBinner();
+
+    // Empties the bins, and sizes them for the given target.
+    void Begin(const GpuSoftTarget& target);
+
+    // Returns the index to pass to AddTriangle().
+    u32 AddDrawState(const GpuSoftDrawState& state);
+
+    // Clips, culls and sets up a triangle of shaded vertices and bins it. The
+    // flat varyings are taken from the first vertex.
+    void AddTriangle(u32 drawState,
+                     const GpuSoftVertex& v0,
+                     const GpuSoftVertex& v1,
+                     const GpuSoftVertex& v2);
+
+    // Returns the number of triangles that have been binned since Begin().
+    u32 GetTriangleCount() const;
+
+    // Draws the triangles in the bin of the given tile.
+    void DrawBin(int tile, const GpuSoftTarget& target) const;
+
+private:
+    struct Triangle {
+        // Edge functions A * x + B * y + C, non-negative inside the triangle.
+        float edges[3][3];
+        // Attributes are interpolated as planes relative to the first vertex:
+        // value(x, y) = dx * (x - x0) + dy * (y - y0) + value0.
+        float x0;
+        float y0;
+        // The planes of depth and 1/w, followed by those of each interpolated
+        // varying divided by w, then the values of the flat varyings.
+        u32 planesOffset;
+        u32 drawState;
+        // Set for each edge that owns the pixels exactly on it.
+        u8 topLeftEdges;
+        // Bounding box in pixels, clipped to the scissor rectangle. The
+        // maximums are exclusive.
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    void SetupTriangle(u32 drawState, const GpuSoftVertex* const* v, const float* flat);
+
+    GpuSoftTarget m_target;
+    std::vector<GpuSoftDrawState> m_drawStates;
+    std::vector<Triangle> m_triangles;
+    std::vector<float> m_planes;
+    std::vector<std::vector<u32> > m_bins;
+};
+
+namespace GpuSoftRaster {
+    // Applies the target's clears to the tile, then draws the triangles that
+    // were binned to it by each binner, in order.
+    void DrawTile(int tile,
+                  const GpuSoftTarget& target,
+                  const GpuSoftBinner* const* binners,
+                  int nBinners);
+}
+
+#endif // GPUDEVICE_GPUSOFTRASTER_H
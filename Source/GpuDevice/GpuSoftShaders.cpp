@@ -0,0 +1,301 @@
+#ifdef GPUDEVICE_API_SOFT
+
+#include "GpuDevice/GpuSoftShaders.h"
+
+#include <string.h>
+
+#include "GpuDevice/GpuSoftTexture.h"
+
+// -----------------------------------------------------------------------------
+// Types shared with the shaders (see Shaders/ModelTypes.h)
+// -----------------------------------------------------------------------------
+
+// Matrices are stored column-major, as in Metal.
+struct MDLSceneData {
+    float viewProjTransform[4][4];
+    float cameraPos[4];
+    float dirToLight[4];
+    float irradiance_over_pi[4];
+    float ambientRadiance[4];
+};
+
+struct MDLInstanceData {
+    float worldTransform[4][4];
+    float normalTransform[3][4];
+    float diffuseColor[4];
+    float specularColorAndGlossiness[4];
+    u32 textureSlice;
+    u32 padding[3];
+};
+
+static void Transform4(const float m[4][4], const float* v, float* out)
+{
+    for (int row = 0; row < 4; ++row) {
+        out[row] = m[0][row] * v[0] + m[1][row] * v[1]
+                 + m[2][row] * v[2] + m[3][row] * v[3];
+    }
+}
+
+static void Transform3(const float m[3][4], const float* v, float* out)
+{
+    for (int row = 0; row < 3; ++row)
+        out[row] = m[0][row] * v[0] + m[1][row] * v[1] + m[2][row] * v[2];
+}
+
+static void SampleTexture(const GpuSoftResources& resources,
+                          int texture,
+                          int sampler,
+                          const SimdFloat& u,
+                          const SimdFloat& v,
+                          SimdFloat* rgba)
+{
+    resources.textures[texture]->SampleQuad(*resources.samplers[sampler], 0, u, v, rgba);
+}
+
+static void SampleTextureArray(const GpuSoftResources& resources,
+                               int texture,
+                               int sampler,
+                               int slice,
+                               const SimdFloat& u,
+                               const SimdFloat& v,
+                               SimdFloat* rgba)
+{
+    resources.textures[texture]->SampleQuad(*resources.samplers[sampler], slice, u, v, rgba);
+}
+
+// -----------------------------------------------------------------------------
+// Model
+// -----------------------------------------------------------------------------
+
+// Varyings: normal (3), uv (2), dirToViewer (3), then flat diffuseColor (4)
+// and specularColorAndGlossiness (4).
+static void ModelVertexMain(const GpuSoftResources& resources,
+                            const GpuSoftVertexInput& input,
+                            GpuSoftVertex* output)
+{
+    const MDLSceneData& sceneData = *(const MDLSceneData*)resources.cbuffers[0];
+    const MDLInstanceData* instances
+        = (const MDLInstanceData*)resources.cbuffers[GPU_INSTANCE_BUFFER_SLOT];
+    const MDLInstanceData& instanceData = instances[input.instanceID];
+
+    float position[4] = {
+        input.attribs[0][0], input.attribs[0][1], input.attribs[0][2], 1.0f
+    };
+    float worldPos[4];
+    Transform4(instanceData.worldTransform, position, worldPos);
+    Transform4(sceneData.viewProjTransform, worldPos, output->position);
+
+    float* varyings = output->varyings;
+    Transform3(instanceData.normalTransform, input.attribs[1], &varyings[0]);
+    varyings[3] = input.attribs[2][0];
+    varyings[4] = input.attribs[2][1];
+    for (int i = 0; i < 3; ++i)
+        varyings[5 + i] = sceneData.cameraPos[i] - worldPos[i];
+    memcpy(&varyings[8], instanceData.diffuseColor, 4 * sizeof(float));
+    memcpy(&varyings[12], instanceData.specularColorAndGlossiness, 4 * sizeof(float));
+}
+
+// Shades a quad with the given diffuse texture color.
+static void ShadeModel(const GpuSoftResources& resources,
+                       const SimdFloat* texColor,
+                       GpuSoftPixelQuad* quad)
+{
+    const MDLSceneData& sceneData = *(const MDLSceneData*)resources.cbuffers[0];
+    const SimdFloat* varyings = quad->varyings;
+
+    SimdFloat n[3] = {varyings[0], varyings[1], varyings[2]};
+    SimdNormalize3(n);
+    SimdFloat l[3] = {
+        SimdSet(sceneData.dirToLight[0]),
+        SimdSet(sceneData.dirToLight[1]),
+        SimdSet(sceneData.dirToLight[2]),
+    };
+    SimdFloat v[3] = {varyings[5], varyings[6], varyings[7]};
+    SimdNormalize3(v);
+
+    SimdFloat cDiff[3];
+    for (int i = 0; i < 3; ++i)
+        cDiff[i] = varyings[8 + i] * texColor[i];
+
+    // The specular color and glossiness are flat, so are the same in every
+    // lane.
+    float glossiness = SimdLane(varyings[15], 0);
+
+    // BRDF
+    SimdFloat h[3] = {l[0] + v[0], l[1] + v[1], l[2] + v[2]};
+    SimdNormalize3(h);
+    SimdFloat NdotH = SimdSaturate(SimdDot3(n, h));
+    SimdFloat specular = SimdSet((glossiness + 8.0f) / 8.0f) * SimdPow(NdotH, glossiness);
+
+    SimdFloat cosTheta = SimdSaturate(SimdDot3(n, l));
+    for (int i = 0; i < 3; ++i) {
+        SimdFloat brdf = cDiff[i] + varyings[12 + i] * specular;
+        SimdFloat radiance = brdf * SimdSet(sceneData.irradiance_over_pi[i]) * cosTheta;
+        radiance = radiance + cDiff[i] * SimdSet(sceneData.ambientRadiance[i]);
+        quad->color[i] = radiance;
+    }
+    quad->color[3] = SimdSet(1.0f);
+}
+
+static void ModelPixelMain(const GpuSoftResources& resources, GpuSoftPixelQuad* quad)
+{
+    SimdFloat texColor[4];
+    SampleTexture(resources, 0, 0, quad->varyings[3], quad->varyings[4], texColor);
+    ShadeModel(resources, texColor, quad);
+}
+
+// -----------------------------------------------------------------------------
+// ModelArray
+// -----------------------------------------------------------------------------
+
+// The same as Model, but the diffuse texture is a slice of an array texture,
+// given by the instance. Varyings: those of Model, then flat textureSlice (1).
+static void ModelArrayVertexMain(const GpuSoftResources& resources,
+                                 const GpuSoftVertexInput& input,
+                                 GpuSoftVertex* output)
+{
+    ModelVertexMain(resources, input, output);
+
+    const MDLInstanceData* instances
+        = (const MDLInstanceData*)resources.cbuffers[GPU_INSTANCE_BUFFER_SLOT];
+    output->varyings[16] = (float)instances[input.instanceID].textureSlice;
+}
+
+static void ModelArrayPixelMain(const GpuSoftResources& resources, GpuSoftPixelQuad* quad)
+{
+    int slice = (int)SimdLane(quad->varyings[16], 0);
+
+    SimdFloat texColor[4];
+    SampleTextureArray(resources, 0, 0, slice, quad->varyings[3], quad->varyings[4], texColor);
+    ShadeModel(resources, texColor, quad);
+}
+
+// -----------------------------------------------------------------------------
+// Skybox
+// -----------------------------------------------------------------------------
+
+// Varyings: uv (2), then flat diffuseColor (4).
+static void SkyboxVertexMain(const GpuSoftResources& resources,
+                             const GpuSoftVertexInput& input,
+                             GpuSoftVertex* output)
+{
+    const MDLSceneData& sceneData = *(const MDLSceneData*)resources.cbuffers[0];
+    const MDLInstanceData* instances
+        = (const MDLInstanceData*)resources.cbuffers[GPU_INSTANCE_BUFFER_SLOT];
+    const MDLInstanceData& instanceData = instances[input.instanceID];
+
+    // Ensure that the skybox is always centered at the origin.
+    float vpTransform[4][4];
+    memcpy(vpTransform, sceneData.viewProjTransform, sizeof vpTransform);
+    vpTransform[3][0] = 0.0f;
+    vpTransform[3][1] = 0.0f;
+    vpTransform[3][2] = 0.0f;
+    vpTransform[3][3] = 1.0f;
+
+    float position[4] = {
+        input.attribs[0][0], input.attribs[0][1], input.attribs[0][2], 1.0f
+    };
+    float worldPos[4];
+    Transform4(instanceData.worldTransform, position, worldPos);
+    Transform4(vpTransform, worldPos, output->position);
+
+    // Ensure that the skybox is always at the far plane.
+    output->position[2] = output->position[3];
+
+    output->varyings[0] = input.attribs[2][0];
+    output->varyings[1] = input.attribs[2][1];
+    memcpy(&output->varyings[2], instanceData.diffuseColor, 4 * sizeof(float));
+}
+
+static void SkyboxPixelMain(const GpuSoftResources& resources, GpuSoftPixelQuad* quad)
+{
+    const SimdFloat* varyings = quad->varyings;
+
+    SimdFloat texColor[4];
+    SampleTexture(resources, 0, 0, varyings[0], varyings[1], texColor);
+    for (int i = 0; i < 3; ++i)
+        quad->color[i] = varyings[2 + i] * texColor[i];
+    quad->color[3] = SimdSet(1.0f);
+}
+
+// -----------------------------------------------------------------------------
+// SkyboxArray
+// -----------------------------------------------------------------------------
+
+// Varyings: those of Skybox, then flat textureSlice (1).
+static void SkyboxArrayVertexMain(const GpuSoftResources& resources,
+                                  const GpuSoftVertexInput& input,
+                                  GpuSoftVertex* output)
+{
+    SkyboxVertexMain(resources, input, output);
+
+    const MDLInstanceData* instances
+        = (const MDLInstanceData*)resources.cbuffers[GPU_INSTANCE_BUFFER_SLOT];
+    output->varyings[6] = (float)instances[input.instanceID].textureSlice;
+}
+
+static void SkyboxArrayPixelMain(const GpuSoftResources& resources, GpuSoftPixelQuad* quad)
+{
+    const SimdFloat* varyings = quad->varyings;
+    int slice = (int)SimdLane(varyings[6], 0);
+
+    SimdFloat texColor[4];
+    SampleTextureArray(resources, 0, 0, slice, varyings[0], varyings[1], texColor);
+    for (int i = 0; i < 3; ++i)
+        quad->color[i] = varyings[2 + i] * texColor[i];
+    quad->color[3] = SimdSet(1.0f);
+}
+
+// -----------------------------------------------------------------------------
+// BlitRT
+// -----------------------------------------------------------------------------
+
+// Varyings: uv (2).
+static void BlitRTVertexMain(const GpuSoftResources& resources,
+                             const GpuSoftVertexInput& input,
+                             GpuSoftVertex* output)
+{
+    output->position[0] = input.attribs[0][0];
+    output->position[1] = input.attribs[0][1];
+    output->position[2] = input.attribs[0][2];
+    output->position[3] = 1.0f;
+    output->varyings[0] = input.attribs[1][0];
+    output->varyings[1] = input.attribs[1][1];
+}
+
+static void BlitRTPixelMain(const GpuSoftResources& resources, GpuSoftPixelQuad* quad)
+{
+    const SimdFloat* varyings = quad->varyings;
+
+    SampleTexture(resources, 0, 0, varyings[0], varyings[1], quad->color);
+
+    SimdFloat depth[4];
+    SampleTexture(resources, 1, 0, varyings[0], varyings[1], depth);
+    quad->depth = depth[0];
+}
+
+// -----------------------------------------------------------------------------
+// Lookup
+// -----------------------------------------------------------------------------
+
+static const GpuSoftShader s_shaders[] = {
+    {"Model", 8, 8, false, &ModelVertexMain, &ModelPixelMain},
+    {"ModelArray", 8, 9, false, &ModelArrayVertexMain, &ModelArrayPixelMain},
+    {"Skybox", 2, 4, false, &SkyboxVertexMain, &SkyboxPixelMain},
+    {"SkyboxArray", 2, 5, false, &SkyboxArrayVertexMain, &SkyboxArrayPixelMain},
+    {"BlitRT", 2, 0, true, &BlitRTVertexMain, &BlitRTPixelMain},
+};
+
+const GpuSoftShader* GpuSoftShaders::Find(const char* name, int length)
+{
+    for (size_t i = 0; i < sizeof s_shaders / sizeof s_shaders[0]; ++i) {
+        const GpuSoftShader& shader = s_shaders[i];
+        if (strlen(shader.name) == (size_t)length &&
+            memcmp(shader.name, name, length) == 0) {
+            return &shader;
+        }
+    }
+    return NULL;
+}
+
+#endif // GPUDEVICE_API_SOFT
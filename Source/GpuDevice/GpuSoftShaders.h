@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ *   GpuSoftShaders.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   C++ implementations of the shaders in the Shaders directory, for the
+ *   software rasterizer.
+ *
+ *   A shader file for the software backend (language FourCC 'SOFT', built
+ *   by Tools/SoftShaderCompiler) doesn't contain code. Instead, the vertex and
+ *   pixel shader code of each permutation is the name of the shader, which is
+ *   looked up with GpuSoftShaders::Find().
+ *
+ *   Vertex shaders run on one vertex at a time. Pixel shaders run on a 2x2
+ *   quad of pixels at a time, with one pixel in each SIMD lane (see
+ *   GpuSoftSimd.h), so that texture sampling can take derivatives across the
+ *   quad.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSOFTSHADERS_H
+#define GPUDEVICE_GPUSOFTSHADERS_H
+
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+#include "GpuDevice/GpuSoftSimd.h"
+
+struct GpuSoftTexture;
+
+const int GPU_SOFT_MAX_VERTEX_ATTRIBS = 16;
+const int GPU_SOFT_MAX_TEXTURES = 16;
+const int GPU_SOFT_MAX_SAMPLERS = 16;
+
+// The maximum number of varyings (interpolated and flat) that a vertex
+// shader can output.
+const int GPU_SOFT_MAX_VARYINGS = 20;
+
+// The resources bound by a draw item. The instance buffer, if any, is in
+// cbuffer slot GPU_INSTANCE_BUFFER_SLOT, already offset to the draw item's
+// first instance.
+struct GpuSoftResources {
+    const u8* cbuffers[GPU_MAX_CBUFFERS];
+    const GpuSoftTexture* textures[GPU_SOFT_MAX_TEXTURES];
+    const GpuSamplerDesc* samplers[GPU_SOFT_MAX_SAMPLERS];
+};
+
+struct GpuSoftVertexInput {
+    // Each attribute is expanded to four components, with missing components
+    // set to (0, 0, 0, 1).
+    float attribs[GPU_SOFT_MAX_VERTEX_ATTRIBS][4];
+    u32 instanceID;
+};
+
+struct GpuSoftVertex {
+    // Clip space position.
+    float position[4];
+
+    // The interpolated varyings, followed by the flat ones.
+    float varyings[GPU_SOFT_MAX_VARYINGS];
+};
+
+struct GpuSoftPixelQuad {
+    // Input: the varyings of each pixel. Flat varyings are the same in every
+    // lane.
+    SimdFloat varyings[GPU_SOFT_MAX_VARYINGS];
+
+    // Input: the interpolated depth. Output: the depth to write, if the
+    // shader writes depth.
+    SimdFloat depth;
+
+    // Output: the color to write.
+    SimdFloat color[4];
+};
+
+typedef void (*GpuSoftVertexFunc)(const GpuSoftResources& resources,
+                                  const GpuSoftVertexInput& input,
+                                  GpuSoftVertex* output);
+
+typedef void (*GpuSoftPixelFunc)(const GpuSoftResources& resources,
+                                 GpuSoftPixelQuad* quad);
+
+struct GpuSoftShader {
+    const char* name;
+    int nVaryings;
+    int nFlatVaryings;
+    bool writesDepth;
+    GpuSoftVertexFunc vertexMain;
+    GpuSoftPixelFunc pixelMain;
+};
+
+namespace GpuSoftShaders {
+    // Returns NULL if there's no shader with the given name. The name doesn't
+    // need to be null-terminated.
+    const GpuSoftShader* Find(const char* name, int length);
+}
+
+#endif // GPUDEVICE_GPUSOFTSHADERS_H
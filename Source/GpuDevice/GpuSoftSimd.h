@@ -0,0 +1,235 @@
+/******************************************************************************
+ *
+ *   GpuSoftSimd.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   Four-wide float vectors for the software rasterizer. The rasterizer and
+ *   the software shaders work on 2x2 pixel quads, with one pixel in each lane:
+ *
+ *       lane 0: (x, y)      lane 1: (x + 1, y)
+ *       lane 2: (x, y + 1)  lane 3: (x + 1, y + 1)
+ *
+ *   SSE2 is used where it's available, and plain arrays otherwise.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSOFTSIMD_H
+#define GPUDEVICE_GPUSOFTSIMD_H
+
+#include <math.h>
+#include "Core/Types.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  define GPUSOFT_SSE2
+#  include <emmintrin.h>
+#endif
+
+struct SimdFloat {
+#ifdef GPUSOFT_SSE2
+    __m128 v;
+#else
+    float v[4];
+#endif
+};
+
+// Each lane is either all ones (true) or all zeros (false).
+struct SimdMask {
+#ifdef GPUSOFT_SSE2
+    __m128 v;
+#else
+    u32 v[4];
+#endif
+};
+
+#ifdef GPUSOFT_SSE2
+
+inline SimdFloat SimdMake(__m128 v) { SimdFloat r; r.v = v; return r; }
+inline SimdMask SimdMakeMask(__m128 v) { SimdMask r; r.v = v; return r; }
+
+inline SimdFloat SimdSet(float x) { return SimdMake(_mm_set1_ps(x)); }
+inline SimdFloat SimdSet(float x, float y, float z, float w)
+{ return SimdMake(_mm_setr_ps(x, y, z, w)); }
+inline SimdFloat SimdLoad(const float* p) { return SimdMake(_mm_loadu_ps(p)); }
+inline void SimdStore(float* p, const SimdFloat& a) { _mm_storeu_ps(p, a.v); }
+
+inline SimdFloat operator+(const SimdFloat& a, const SimdFloat& b) { return SimdMake(_mm_add_ps(a.v, b.v)); }
+inline SimdFloat operator-(const SimdFloat& a, const SimdFloat& b) { return SimdMake(_mm_sub_ps(a.v, b.v)); }
+inline SimdFloat operator*(const SimdFloat& a, const SimdFloat& b) { return SimdMake(_mm_mul_ps(a.v, b.v)); }
+inline SimdFloat operator/(const SimdFloat& a, const SimdFloat& b) { return SimdMake(_mm_div_ps(a.v, b.v)); }
+
+inline SimdFloat SimdMin(const SimdFloat& a, const SimdFloat& b) { return SimdMake(_mm_min_ps(a.v, b.v)); }
+inline SimdFloat SimdMax(const SimdFloat& a, const SimdFloat& b) { return SimdMake(_mm_max_ps(a.v, b.v)); }
+inline SimdFloat SimdSqrt(const SimdFloat& a) { return SimdMake(_mm_sqrt_ps(a.v)); }
+
+inline SimdMask operator<(const SimdFloat& a, const SimdFloat& b) { return SimdMakeMask(_mm_cmplt_ps(a.v, b.v)); }
+inline SimdMask operator<=(const SimdFloat& a, const SimdFloat& b) { return SimdMakeMask(_mm_cmple_ps(a.v, b.v)); }
+inline SimdMask operator>(const SimdFloat& a, const SimdFloat& b) { return SimdMakeMask(_mm_cmpgt_ps(a.v, b.v)); }
+inline SimdMask operator>=(const SimdFloat& a, const SimdFloat& b) { return SimdMakeMask(_mm_cmpge_ps(a.v, b.v)); }
+inline SimdMask operator==(const SimdFloat& a, const SimdFloat& b) { return SimdMakeMask(_mm_cmpeq_ps(a.v, b.v)); }
+inline SimdMask operator!=(const SimdFloat& a, const SimdFloat& b) { return SimdMakeMask(_mm_cmpneq_ps(a.v, b.v)); }
+
+inline SimdMask operator&(const SimdMask& a, const SimdMask& b) { return SimdMakeMask(_mm_and_ps(a.v, b.v)); }
+inline SimdMask operator|(const SimdMask& a, const SimdMask& b) { return SimdMakeMask(_mm_or_ps(a.v, b.v)); }
+
+inline SimdMask SimdMaskFromBits(int bits)
+{
+    return SimdMakeMask(_mm_castsi128_ps(_mm_setr_epi32(
+        (bits & 1) ? -1 : 0,
+        (bits & 2) ? -1 : 0,
+        (bits & 4) ? -1 : 0,
+        (bits & 8) ? -1 : 0
+    )));
+}
+
+// Returns the lanes of the mask as the bits of an integer (lane 0 is bit 0).
+inline int SimdMaskBits(const SimdMask& m) { return _mm_movemask_ps(m.v); }
+
+// Returns a where the mask is true, and b elsewhere.
+inline SimdFloat SimdSelect(const SimdMask& m, const SimdFloat& a, const SimdFloat& b)
+{ return SimdMake(_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))); }
+
+// Converts floats in [0, 1] to 8-bit unorm values and packs them into the
+// memory order of GPU_PIXEL_FORMAT_BGRA8888. Values outside [0, 1] saturate.
+inline void SimdPackBGRA8(const SimdFloat* rgba, u32 out[4])
+{
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128i c[4];
+    for (int i = 0; i < 4; ++i) {
+        __m128 x = _mm_min_ps(_mm_max_ps(rgba[i].v, zero), one);
+        c[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, scale), half));
+    }
+    __m128i packed = _mm_or_si128(
+        _mm_or_si128(c[2], _mm_slli_epi32(c[1], 8)),
+        _mm_or_si128(_mm_slli_epi32(c[0], 16), _mm_slli_epi32(c[3], 24))
+    );
+    _mm_storeu_si128((__m128i*)out, packed);
+}
+
+// The inverse of SimdPackBGRA8().
+inline void SimdUnpackBGRA8(const u32 in[4], SimdFloat* rgba)
+{
+    __m128i packed = _mm_loadu_si128((const __m128i*)in);
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    rgba[0].v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 16), mask)), scale);
+    rgba[1].v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 8), mask)), scale);
+    rgba[2].v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, mask)), scale);
+    rgba[3].v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packed, 24)), scale);
+}
+
+#else // GPUSOFT_SSE2
+
+#define GPUSOFT_LANEWISE(result, expr) \
+    do { for (int i = 0; i < 4; ++i) { (result).v[i] = (expr); } } while (0)
+
+inline SimdFloat SimdSet(float x) { SimdFloat r; GPUSOFT_LANEWISE(r, x); return r; }
+inline SimdFloat SimdSet(float x, float y, float z, float w)
+{ SimdFloat r; r.v[0] = x; r.v[1] = y; r.v[2] = z; r.v[3] = w; return r; }
+inline SimdFloat SimdLoad(const float* p) { SimdFloat r; GPUSOFT_LANEWISE(r, p[i]); return r; }
+inline void SimdStore(float* p, const SimdFloat& a) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+
+inline SimdFloat operator+(const SimdFloat& a, const SimdFloat& b) { SimdFloat r; GPUSOFT_LANEWISE(r, a.v[i] + b.v[i]); return r; }
+inline SimdFloat operator-(const SimdFloat& a, const SimdFloat& b) { SimdFloat r; GPUSOFT_LANEWISE(r, a.v[i] - b.v[i]); return r; }
+inline SimdFloat operator*(const SimdFloat& a, const SimdFloat& b) { SimdFloat r; GPUSOFT_LANEWISE(r, a.v[i] * b.v[i]); return r; }
+inline SimdFloat operator/(const SimdFloat& a, const SimdFloat& b) { SimdFloat r; GPUSOFT_LANEWISE(r, a.v[i] / b.v[i]); return r; }
+
+inline SimdFloat SimdMin(const SimdFloat& a, const SimdFloat& b) { SimdFloat r; GPUSOFT_LANEWISE(r, a.v[i] < b.v[i] ? a.v[i] : b.v[i]); return r; }
+inline SimdFloat SimdMax(const SimdFloat& a, const SimdFloat& b) { SimdFloat r; GPUSOFT_LANEWISE(r, a.v[i] > b.v[i] ? a.v[i] : b.v[i]); return r; }
+inline SimdFloat SimdSqrt(const SimdFloat& a) { SimdFloat r; GPUSOFT_LANEWISE(r, sqrtf(a.v[i])); return r; }
+
+inline SimdMask operator<(const SimdFloat& a, const SimdFloat& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] < b.v[i] ? ~0U : 0U); return r; }
+inline SimdMask operator<=(const SimdFloat& a, const SimdFloat& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] <= b.v[i] ? ~0U : 0U); return r; }
+inline SimdMask operator>(const SimdFloat& a, const SimdFloat& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] > b.v[i] ? ~0U : 0U); return r; }
+inline SimdMask operator>=(const SimdFloat& a, const SimdFloat& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] >= b.v[i] ? ~0U : 0U); return r; }
+inline SimdMask operator==(const SimdFloat& a, const SimdFloat& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] == b.v[i] ? ~0U : 0U); return r; }
+inline SimdMask operator!=(const SimdFloat& a, const SimdFloat& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] != b.v[i] ? ~0U : 0U); return r; }
+
+inline SimdMask operator&(const SimdMask& a, const SimdMask& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] & b.v[i]); return r; }
+inline SimdMask operator|(const SimdMask& a, const SimdMask& b) { SimdMask r; GPUSOFT_LANEWISE(r, a.v[i] | b.v[i]); return r; }
+
+inline SimdMask SimdMaskFromBits(int bits) { SimdMask r; GPUSOFT_LANEWISE(r, (bits & (1 << i)) ? ~0U : 0U); return r; }
+
+inline int SimdMaskBits(const SimdMask& m)
+{
+    int bits = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (m.v[i])
+            bits |= 1 << i;
+    }
+    return bits;
+}
+
+inline SimdFloat SimdSelect(const SimdMask& m, const SimdFloat& a, const SimdFloat& b)
+{ SimdFloat r; GPUSOFT_LANEWISE(r, m.v[i] ? a.v[i] : b.v[i]); return r; }
+
+inline void SimdPackBGRA8(const SimdFloat* rgba, u32 out[4])
+{
+    for (int i = 0; i < 4; ++i) {
+        u32 c[4];
+        for (int j = 0; j < 4; ++j) {
+            float x = rgba[j].v[i];
+            x = x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+            c[j] = (u32)(x * 255.0f + 0.5f);
+        }
+        out[i] = c[2] | (c[1] << 8) | (c[0] << 16) | (c[3] << 24);
+    }
+}
+
+inline void SimdUnpackBGRA8(const u32 in[4], SimdFloat* rgba)
+{
+    for (int i = 0; i < 4; ++i) {
+        rgba[0].v[i] = (float)((in[i] >> 16) & 0xFF) * (1.0f / 255.0f);
+        rgba[1].v[i] = (float)((in[i] >> 8) & 0xFF) * (1.0f / 255.0f);
+        rgba[2].v[i] = (float)(in[i] & 0xFF) * (1.0f / 255.0f);
+        rgba[3].v[i] = (float)(in[i] >> 24) * (1.0f / 255.0f);
+    }
+}
+
+#undef GPUSOFT_LANEWISE
+
+#endif // GPUSOFT_SSE2
+
+inline float SimdLane(const SimdFloat& a, int lane)
+{
+    float lanes[4];
+    SimdStore(lanes, a);
+    return lanes[lane];
+}
+
+inline SimdFloat SimdSaturate(const SimdFloat& a)
+{
+    return SimdMin(SimdMax(a, SimdSet(0.0f)), SimdSet(1.0f));
+}
+
+inline SimdFloat SimdDot3(const SimdFloat* a, const SimdFloat* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+inline void SimdNormalize3(SimdFloat* v)
+{
+    SimdFloat invLength = SimdSet(1.0f) / SimdSqrt(SimdDot3(v, v));
+    v[0] = v[0] * invLength;
+    v[1] = v[1] * invLength;
+    v[2] = v[2] * invLength;
+}
+
+inline SimdFloat SimdPow(const SimdFloat& a, float exponent)
+{
+    float lanes[4];
+    SimdStore(lanes, a);
+    for (int i = 0; i < 4; ++i)
+        lanes[i] = powf(lanes[i], exponent);
+    return SimdLoad(lanes);
+}
+
+#endif // GPUDEVICE_GPUSOFTSIMD_H
@@ -0,0 +1,368 @@
+#ifdef GPUDEVICE_API_SOFT
+
+#include "GpuDevice/GpuSoftTexture.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Core/Macros.h"
+
+// -----------------------------------------------------------------------------
+// DXT decompression
+// -----------------------------------------------------------------------------
+
+static u32 PackBGRA8(u32 r, u32 g, u32 b, u32 a)
+{
+    return b | (g << 8) | (r << 16) | (a << 24);
+}
+
+static void DecodeColorBlock(const u8* block, bool allowTransparent, u32 texels[16])
+{
+    u32 c0 = block[0] | (block[1] << 8);
+    u32 c1 = block[2] | (block[3] << 8);
+    u32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((u32)block[7] << 24);
+
+    u32 r[4], g[4], b[4], a[4];
+    r[0] = (c0 >> 11) & 0x1F; r[0] = (r[0] << 3) | (r[0] >> 2);
+    g[0] = (c0 >> 5) & 0x3F;  g[0] = (g[0] << 2) | (g[0] >> 4);
+    b[0] = c0 & 0x1F;         b[0] = (b[0] << 3) | (b[0] >> 2);
+    r[1] = (c1 >> 11) & 0x1F; r[1] = (r[1] << 3) | (r[1] >> 2);
+    g[1] = (c1 >> 5) & 0x3F;  g[1] = (g[1] << 2) | (g[1] >> 4);
+    b[1] = c1 & 0x1F;         b[1] = (b[1] << 3) | (b[1] >> 2);
+    a[0] = a[1] = a[2] = a[3] = 0xFF;
+
+    if (c0 > c1 || !allowTransparent) {
+        r[2] = (2 * r[0] + r[1]) / 3;
+        g[2] = (2 * g[0] + g[1]) / 3;
+        b[2] = (2 * b[0] + b[1]) / 3;
+        r[3] = (r[0] + 2 * r[1]) / 3;
+        g[3] = (g[0] + 2 * g[1]) / 3;
+        b[3] = (b[0] + 2 * b[1]) / 3;
+    } else {
+        r[2] = (r[0] + r[1]) / 2;
+        g[2] = (g[0] + g[1]) / 2;
+        b[2] = (b[0] + b[1]) / 2;
+        r[3] = g[3] = b[3] = a[3] = 0;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        u32 index = (indices >> (2 * i)) & 0x3;
+        texels[i] = PackBGRA8(r[index], g[index], b[index], a[index]);
+    }
+}
+
+static void DecodeExplicitAlphaBlock(const u8* block, u32 texels[16])
+{
+    for (int i = 0; i < 16; ++i) {
+        u32 alpha = (block[i / 2] >> (4 * (i & 1))) & 0xF;
+        alpha |= alpha << 4;
+        texels[i] = (texels[i] & 0x00FFFFFF) | (alpha << 24);
+    }
+}
+
+static void DecodeInterpolatedAlphaBlock(const u8* block, u32 texels[16])
+{
+    u32 alphas[8];
+    alphas[0] = block[0];
+    alphas[1] = block[1];
+    if (alphas[0] > alphas[1]) {
+        for (u32 i = 1; i < 7; ++i)
+            alphas[i + 1] = ((7 - i) * alphas[0] + i * alphas[1]) / 7;
+    } else {
+        for (u32 i = 1; i < 5; ++i)
+            alphas[i + 1] = ((5 - i) * alphas[0] + i * alphas[1]) / 5;
+        alphas[6] = 0;
+        alphas[7] = 0xFF;
+    }
+
+    u64 indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= (u64)block[2 + i] << (8 * i);
+
+    for (int i = 0; i < 16; ++i) {
+        u32 alpha = alphas[(indices >> (3 * i)) & 0x7];
+        texels[i] = (texels[i] & 0x00FFFFFF) | (alpha << 24);
+    }
+}
+
+static void DecodeBlock(GpuPixelFormat format, const u8* block, u32 texels[16])
+{
+    switch (format) {
+        case GPU_PIXEL_FORMAT_DXT1:
+            DecodeColorBlock(block, true, texels);
+            break;
+        case GPU_PIXEL_FORMAT_DXT3:
+            DecodeColorBlock(block + 8, false, texels);
+            DecodeExplicitAlphaBlock(block, texels);
+            break;
+        case GPU_PIXEL_FORMAT_DXT5:
+            DecodeColorBlock(block + 8, false, texels);
+            DecodeInterpolatedAlphaBlock(block, texels);
+            break;
+        default:
+            ASSERT(!"Not a block-compressed pixel format");
+            break;
+    }
+}
+
+static int BytesPerBlock(GpuPixelFormat format)
+{
+    switch (format) {
+        case GPU_PIXEL_FORMAT_DXT1: return 8;
+        case GPU_PIXEL_FORMAT_DXT3: return 16;
+        case GPU_PIXEL_FORMAT_DXT5: return 16;
+        default: return 0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Storage
+// -----------------------------------------------------------------------------
+
+void GpuSoftTexture::Allocate(GpuPixelFormat format,
+                              int width,
+                              int height,
+                              int nSlices,
+                              int nMipmapLevels)
+{
+    ASSERT(nSlices >= 1);
+    ASSERT(nMipmapLevels <= MAX_MIPMAP_LEVELS);
+
+    pixelFormat = format;
+    this->nSlices = nSlices;
+    this->nMipmapLevels = nMipmapLevels;
+
+    size_t totalTexels = 0;
+    for (int i = 0; i < nMipmapLevels; ++i) {
+        GpuSoftSurface& mip = mips[i];
+        mip.width = (width >> i) > 0 ? (width >> i) : 1;
+        mip.height = (height >> i) > 0 ? (height >> i) : 1;
+        mip.stride = (mip.width + 1) & ~1;
+        totalTexels += (size_t)mip.stride * (size_t)((mip.height + 1) & ~1);
+    }
+
+    sliceTexels = totalTexels;
+    memory = (u32*)calloc(totalTexels * (size_t)nSlices, sizeof(u32));
+
+    size_t offset = 0;
+    for (int i = 0; i < nMipmapLevels; ++i) {
+        GpuSoftSurface& mip = mips[i];
+        mip.texels = memory + offset;
+        offset += (size_t)mip.stride * (size_t)((mip.height + 1) & ~1);
+    }
+}
+
+void GpuSoftTexture::Free()
+{
+    free(memory);
+    memory = NULL;
+}
+
+bool GpuSoftTexture::IsDepth() const
+{
+    return pixelFormat == GPU_PIXEL_FORMAT_DEPTH_32 ||
+           pixelFormat == GPU_PIXEL_FORMAT_DEPTH_24_STENCIL_8;
+}
+
+void GpuSoftTexture::Upload(int slice,
+                            const GpuRegion& region,
+                            int mipmapLevel,
+                            int stride,
+                            const void* bytes)
+{
+    ASSERT(0 <= slice && slice < nSlices);
+    ASSERT(0 <= mipmapLevel && mipmapLevel < nMipmapLevels);
+    GpuSoftSurface mip = mips[mipmapLevel];
+    mip.texels += (size_t)slice * sliceTexels;
+    ASSERT(region.x >= 0 && region.y >= 0);
+    ASSERT(region.x + region.width <= mip.width);
+    ASSERT(region.y + region.height <= mip.height);
+
+    int bytesPerBlock = BytesPerBlock(pixelFormat);
+    if (bytesPerBlock == 0) {
+        for (int y = 0; y < region.height; ++y) {
+            memcpy(mip.texels + (region.y + y) * mip.stride + region.x,
+                   (const u8*)bytes + y * stride,
+                   region.width * sizeof(u32));
+        }
+        return;
+    }
+
+    int nBlocksX = (region.width + 3) / 4;
+    int nBlocksY = (region.height + 3) / 4;
+    for (int by = 0; by < nBlocksY; ++by) {
+        const u8* row = (const u8*)bytes + by * stride;
+        for (int bx = 0; bx < nBlocksX; ++bx) {
+            u32 texels[16];
+            DecodeBlock(pixelFormat, row + bx * bytesPerBlock, texels);
+
+            for (int i = 0; i < 16; ++i) {
+                int x = region.x + bx * 4 + (i & 3);
+                int y = region.y + by * 4 + (i >> 2);
+                if (x < mip.width && y < mip.height)
+                    mip.texels[y * mip.stride + x] = texels[i];
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Sampling
+// -----------------------------------------------------------------------------
+
+// Returns the texel coordinate to read for coordinate i, or -1 if the border
+// color should be used instead.
+static int ApplyAddressMode(int i, int n, GpuSamplerAddressMode mode)
+{
+    switch (mode) {
+        case GPU_SAMPLER_ADDRESS_CLAMP_TO_EDGE:
+            return i < 0 ? 0 : (i >= n ? n - 1 : i);
+        case GPU_SAMPLER_ADDRESS_MIRROR_CLAMP_TO_EDGE:
+            if (i < 0)
+                i = -1 - i;
+            return i >= n ? n - 1 : i;
+        case GPU_SAMPLER_ADDRESS_REPEAT:
+            i %= n;
+            return i < 0 ? i + n : i;
+        case GPU_SAMPLER_ADDRESS_MIRROR_REPEAT:
+            i %= 2 * n;
+            if (i < 0)
+                i += 2 * n;
+            return i < n ? i : 2 * n - 1 - i;
+        case GPU_SAMPLER_ADDRESS_CLAMP_TO_ZERO:
+            return (i < 0 || i >= n) ? -1 : i;
+    }
+    return 0;
+}
+
+static void FetchTexel(const GpuSoftTexture& tex,
+                       const GpuSoftSurface& surface,
+                       const GpuSamplerDesc& sampler,
+                       int x,
+                       int y,
+                       float* out)
+{
+    x = ApplyAddressMode(x, surface.width, sampler.uAddressMode);
+    y = ApplyAddressMode(y, surface.height, sampler.vAddressMode);
+    if (x < 0 || y < 0) {
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+        return;
+    }
+
+    const u32* texelPtr = &surface.texels[y * surface.stride + x];
+    if (tex.IsDepth()) {
+        memcpy(&out[0], texelPtr, sizeof(float));
+        out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+        return;
+    }
+    u32 texel = *texelPtr;
+    out[0] = (float)((texel >> 16) & 0xFF) * (1.0f / 255.0f);
+    out[1] = (float)((texel >> 8) & 0xFF) * (1.0f / 255.0f);
+    out[2] = (float)(texel & 0xFF) * (1.0f / 255.0f);
+    out[3] = (float)(texel >> 24) * (1.0f / 255.0f);
+}
+
+static void SampleSurface(const GpuSoftTexture& tex,
+                          const GpuSoftSurface& surface,
+                          const GpuSamplerDesc& sampler,
+                          GpuSamplerFilterMode filter,
+                          float u,
+                          float v,
+                          float* out)
+{
+    float x = u * (float)surface.width;
+    float y = v * (float)surface.height;
+
+    if (filter == GPU_SAMPLER_FILTER_NEAREST) {
+        FetchTexel(tex, surface, sampler, (int)floorf(x), (int)floorf(y), out);
+        return;
+    }
+
+    x -= 0.5f;
+    y -= 0.5f;
+    float x0 = floorf(x);
+    float y0 = floorf(y);
+    float tx = x - x0;
+    float ty = y - y0;
+
+    float t00[4], t10[4], t01[4], t11[4];
+    FetchTexel(tex, surface, sampler, (int)x0, (int)y0, t00);
+    FetchTexel(tex, surface, sampler, (int)x0 + 1, (int)y0, t10);
+    FetchTexel(tex, surface, sampler, (int)x0, (int)y0 + 1, t01);
+    FetchTexel(tex, surface, sampler, (int)x0 + 1, (int)y0 + 1, t11);
+
+    for (int i = 0; i < 4; ++i) {
+        float top = t00[i] + (t10[i] - t00[i]) * tx;
+        float bot = t01[i] + (t11[i] - t01[i]) * tx;
+        out[i] = top + (bot - top) * ty;
+    }
+}
+
+void GpuSoftTexture::SampleQuad(const GpuSamplerDesc& sampler,
+                                int slice,
+                                const SimdFloat& u,
+                                const SimdFloat& v,
+                                SimdFloat* rgba) const
+{
+    float us[4], vs[4];
+    SimdStore(us, u);
+    SimdStore(vs, v);
+
+    // Level of detail from the screen-space derivatives of the texel
+    // coordinates, taken across the quad.
+    float width = (float)mips[0].width;
+    float height = (float)mips[0].height;
+    float dudx = (us[1] - us[0]) * width;
+    float dvdx = (vs[1] - vs[0]) * height;
+    float dudy = (us[2] - us[0]) * width;
+    float dvdy = (vs[2] - vs[0]) * height;
+    float rhoX = dudx * dudx + dvdx * dvdx;
+    float rhoY = dudy * dudy + dvdy * dvdy;
+    float rho = rhoX > rhoY ? rhoX : rhoY;
+    float lod = rho > 0.0f ? 0.5f * log2f(rho) : -1.0f;
+
+    GpuSamplerFilterMode filter = (lod > 0.0f) ? sampler.minFilter : sampler.magFilter;
+
+    int level0 = 0;
+    int level1 = 0;
+    float levelBlend = 0.0f;
+    if (sampler.mipFilter != GPU_SAMPLER_MIPFILTER_NOT_MIPMAPPED && lod > 0.0f) {
+        float maxLevel = (float)(nMipmapLevels - 1);
+        if (lod > maxLevel)
+            lod = maxLevel;
+        if (sampler.mipFilter == GPU_SAMPLER_MIPFILTER_NEAREST) {
+            level0 = level1 = (int)(lod + 0.5f);
+        } else {
+            level0 = (int)lod;
+            level1 = level0 + 1 < nMipmapLevels ? level0 + 1 : level0;
+            levelBlend = lod - (float)level0;
+        }
+    }
+
+    slice = slice < 0 ? 0 : (slice >= nSlices ? nSlices - 1 : slice);
+    GpuSoftSurface surface0 = mips[level0];
+    GpuSoftSurface surface1 = mips[level1];
+    surface0.texels += (size_t)slice * sliceTexels;
+    surface1.texels += (size_t)slice * sliceTexels;
+
+    float result[4][4];
+    for (int lane = 0; lane < 4; ++lane) {
+        float texel[4];
+        SampleSurface(*this, surface0, sampler, filter, us[lane], vs[lane], texel);
+        if (level1 != level0) {
+            float texel1[4];
+            SampleSurface(*this, surface1, sampler, filter, us[lane], vs[lane], texel1);
+            for (int i = 0; i < 4; ++i)
+                texel[i] += (texel1[i] - texel[i]) * levelBlend;
+        }
+        for (int i = 0; i < 4; ++i)
+            result[i][lane] = texel[i];
+    }
+
+    for (int i = 0; i < 4; ++i)
+        rgba[i] = SimdLoad(result[i]);
+}
+
+#endif // GPUDEVICE_API_SOFT
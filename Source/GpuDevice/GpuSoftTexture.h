@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ *   GpuSoftTexture.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   Texture storage and sampling for the software rasterizer.
+ *
+ *   Every texel is stored in 32 bits: color formats as BGRA8888 and depth
+ *   formats as a float. DXT textures are decompressed to BGRA8888 when they're
+ *   uploaded. Surfaces are padded to an even width and height, so that the
+ *   rasterizer can always read and write whole 2x2 quads.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSOFTTEXTURE_H
+#define GPUDEVICE_GPUSOFTTEXTURE_H
+
+#include <stddef.h>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+#include "GpuDevice/GpuSoftSimd.h"
+
+struct GpuSoftSurface {
+    u32* texels;
+    int width;
+    int height;
+    int stride; // in texels
+};
+
+struct GpuSoftTexture {
+    static const int MAX_MIPMAP_LEVELS = 16;
+
+    // Array textures store every slice, and the mips of each slice are laid
+    // out as in mips[], sliceTexels apart. Only the first slice of cube and
+    // 3D textures is stored (pass nSlices = 1), since they can't be sampled
+    // by the software shaders.
+    void Allocate(GpuPixelFormat format,
+                  int width,
+                  int height,
+                  int nSlices,
+                  int nMipmapLevels);
+    void Free();
+
+    void Upload(int slice,
+                const GpuRegion& region,
+                int mipmapLevel,
+                int stride,
+                const void* bytes);
+
+    bool IsDepth() const;
+
+    // Samples the texture at the four pixels of a quad. The mipmap level is
+    // chosen from the differences between the texture coordinates of the
+    // pixels in the quad, as on a GPU. Depth textures return the depth in the
+    // red channel.
+    // The slice is clamped to the slices of the texture.
+    void SampleQuad(const GpuSamplerDesc& sampler,
+                    int slice,
+                    const SimdFloat& u,
+                    const SimdFloat& v,
+                    SimdFloat* rgba) const;
+
+    GpuPixelFormat pixelFormat;
+    int nSlices;
+    int nMipmapLevels;
+    size_t sliceTexels;
+    // The mips of the first slice.
+    GpuSoftSurface mips[MAX_MIPMAP_LEVELS];
+    u32* memory;
+};
+
+#endif // GPUDEVICE_GPUSOFTTEXTURE_H
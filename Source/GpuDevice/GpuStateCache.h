@@ -0,0 +1,251 @@
+/******************************************************************************
+ *
+ *   GpuStateCache.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuStateCache shadows the state that a backend has bound to its command
+ *   encoder. Each Set*() method compares the requested binding with the one
+ *   that is currently bound and returns true only if the backend actually
+ *   needs to issue the bind. Every call is recorded in a GpuStateFilterStats
+ *   as either issued or skipped. The cache also counts the encoded draws and
+ *   their primitives in a GpuDrawStats, since it's already kept per encoder.
+ *
+ *   Reset() must be called whenever the backend starts a new encoder, since
+ *   the bound state doesn't carry over between encoders.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSTATECACHE_H
+#define GPUDEVICE_GPUSTATECACHE_H
+
+#include <string.h>
+#include "Core/Types.h"
+#include "Core/Macros.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuStateCache {
+public:
+    static const int MAX_VERTEX_BUFFERS = 16;
+    static const int MAX_CBUFFERS = GPU_MAX_CBUFFERS;
+    static const int MAX_TEXTURES = 16;
+    static const int MAX_SAMPLERS = 16;
+
+    // Packs the depth-stencil part of a pipeline state description into a
+    // value that compares equal for equivalent depth-stencil states.
+    static u32 DepthStencilKey(const GpuPipelineStateDesc& desc)
+    {
+        return ((u32)desc.depthCompare << 1) | (desc.depthWritesEnabled ? 1 : 0);
+    }
+
+    // As above, but for the fill mode, cull mode and front face winding.
+    static u32 RasterStateKey(const GpuPipelineStateDesc& desc)
+    {
+        return (u32)desc.fillMode
+            | ((u32)desc.cullMode << 2)
+            | ((u32)desc.frontFaceWinding << 4);
+    }
+
+    // Returns the number of primitives drawn from count vertices.
+    static u32 PrimitiveCount(GpuPrimitiveType primType, u32 count)
+    {
+        switch (primType) {
+            case GPU_PRIMITIVE_TRIANGLES:
+                return count / 3;
+            case GPU_PRIMITIVE_TRIANGLE_STRIP:
+                return count >= 3 ? count - 2 : 0;
+            default:
+                ASSERT(!"Unknown primitive type");
+                return 0;
+        }
+    }
+
+    GpuStateCache()
+    {
+        Reset();
+        ResetStats();
+    }
+
+    void Reset()
+    {
+        m_pipelineState = INVALID;
+        m_depthStencilState = INVALID;
+        m_rasterState = INVALID;
+        for (int i = 0; i < MAX_VERTEX_BUFFERS; ++i) {
+            m_vertexBuffers[i].index = INVALID;
+            m_vertexBuffers[i].offset = 0;
+        }
+        for (int i = 0; i < MAX_CBUFFERS; ++i) {
+            m_cbuffers[i].index = INVALID;
+            m_cbuffers[i].offset = 0;
+        }
+        for (int i = 0; i < MAX_TEXTURES; ++i)
+            m_textures[i] = INVALID;
+        for (int i = 0; i < MAX_SAMPLERS; ++i)
+            m_samplers[i] = INVALID;
+    }
+
+    void ResetStats()
+    {
+        memset(&m_stats, 0, sizeof m_stats);
+        memset(&m_drawStats, 0, sizeof m_drawStats);
+    }
+
+    const GpuStateFilterStats& GetStats() const
+    {
+        return m_stats;
+    }
+
+    const GpuDrawStats& GetDrawStats() const
+    {
+        return m_drawStats;
+    }
+
+    // Records a draw item that was encoded as nDraws draws.
+    void CountDrawItem(bool indirect, u32 nDraws)
+    {
+        ++m_drawStats.nDrawItems;
+        if (indirect)
+            ++m_drawStats.nIndirectDrawItems;
+        m_drawStats.nDraws += nDraws;
+    }
+
+    // Records the primitives of a draw of count vertices or indices.
+    void CountPrimitives(bool indexed,
+                         GpuPrimitiveType primType,
+                         u32 count,
+                         u32 instanceCount)
+    {
+        u64 nPrimitives = (u64)PrimitiveCount(primType, count) * instanceCount;
+        if (indexed)
+            m_drawStats.nIndexedPrimitives += nPrimitives;
+        else
+            m_drawStats.nNonIndexedPrimitives += nPrimitives;
+    }
+
+    // Records a draw item whose pipeline state object was still compiling.
+    void CountPendingDrawItem(bool skipped)
+    {
+        if (skipped)
+            ++m_drawStats.nSkippedDrawItems;
+        else
+            ++m_drawStats.nFallbackDrawItems;
+    }
+
+    bool SetPipelineState(u16 index)
+    {
+        return Update(GPU_STATE_PIPELINE, m_pipelineState, index);
+    }
+
+    bool SetDepthStencilState(u32 key)
+    {
+        return Update(GPU_STATE_DEPTH_STENCIL, m_depthStencilState, key);
+    }
+
+    bool SetRasterState(u32 key)
+    {
+        return Update(GPU_STATE_RASTER, m_rasterState, key);
+    }
+
+    bool SetVertexBuffer(int slot, u16 index, u32 offset)
+    {
+        ASSERT(slot >= 0);
+        if (slot >= MAX_VERTEX_BUFFERS)
+            return Issue(GPU_STATE_VERTEX_BUFFER);
+        return Update(GPU_STATE_VERTEX_BUFFER, m_vertexBuffers[slot], index, offset);
+    }
+
+    bool SetCBuffer(int slot, u16 index, u32 offset)
+    {
+        ASSERT(slot >= 0);
+        if (slot >= MAX_CBUFFERS)
+            return Issue(GPU_STATE_CBUFFER);
+        return Update(GPU_STATE_CBUFFER, m_cbuffers[slot], index, offset);
+    }
+
+    bool SetTexture(int slot, u16 index)
+    {
+        ASSERT(slot >= 0);
+        if (slot >= MAX_TEXTURES)
+            return Issue(GPU_STATE_TEXTURE);
+        return Update(GPU_STATE_TEXTURE, m_textures[slot], index);
+    }
+
+    bool SetSampler(int slot, u16 index)
+    {
+        ASSERT(slot >= 0);
+        if (slot >= MAX_SAMPLERS)
+            return Issue(GPU_STATE_SAMPLER);
+        return Update(GPU_STATE_SAMPLER, m_samplers[slot], index);
+    }
+
+    // Adds the statistics recorded by another cache to this one. Used to
+    // gather the statistics of caches used to encode draw items in parallel.
+    void MergeStats(const GpuStateCache& other)
+    {
+        for (int i = 0; i < GPU_STATE_TYPE_COUNT; ++i) {
+            m_stats.bindsIssued[i] += other.m_stats.bindsIssued[i];
+            m_stats.bindsSkipped[i] += other.m_stats.bindsSkipped[i];
+        }
+        m_drawStats.nDrawItems += other.m_drawStats.nDrawItems;
+        m_drawStats.nIndirectDrawItems += other.m_drawStats.nIndirectDrawItems;
+        m_drawStats.nDraws += other.m_drawStats.nDraws;
+        m_drawStats.nFallbackDrawItems += other.m_drawStats.nFallbackDrawItems;
+        m_drawStats.nSkippedDrawItems += other.m_drawStats.nSkippedDrawItems;
+        m_drawStats.nIndexedPrimitives += other.m_drawStats.nIndexedPrimitives;
+        m_drawStats.nNonIndexedPrimitives += other.m_drawStats.nNonIndexedPrimitives;
+    }
+
+private:
+    static const u32 INVALID = 0xFFFFFFFF;
+
+    struct BufferBinding {
+        u32 index;
+        u32 offset;
+    };
+
+    bool Issue(GpuStateType type)
+    {
+        ++m_stats.bindsIssued[type];
+        return true;
+    }
+
+    bool Update(GpuStateType type, u32& bound, u32 value)
+    {
+        if (bound == value) {
+            ++m_stats.bindsSkipped[type];
+            return false;
+        }
+        bound = value;
+        return Issue(type);
+    }
+
+    bool Update(GpuStateType type, BufferBinding& bound, u32 index, u32 offset)
+    {
+        if (bound.index == index && bound.offset == offset) {
+            ++m_stats.bindsSkipped[type];
+            return false;
+        }
+        bound.index = index;
+        bound.offset = offset;
+        return Issue(type);
+    }
+
+    u32 m_pipelineState;
+    u32 m_depthStencilState;
+    u32 m_rasterState;
+    BufferBinding m_vertexBuffers[MAX_VERTEX_BUFFERS];
+    BufferBinding m_cbuffers[MAX_CBUFFERS];
+    u32 m_textures[MAX_TEXTURES];
+    u32 m_samplers[MAX_SAMPLERS];
+
+    GpuStateFilterStats m_stats;
+    GpuDrawStats m_drawStats;
+};
+
+#endif // GPUDEVICE_GPUSTATECACHE_H
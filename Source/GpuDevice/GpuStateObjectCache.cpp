@@ -0,0 +1,289 @@
+#include "GpuDevice/GpuStateObjectCache.h"
+
+#include <string.h>
+
+#include "Core/Macros.h"
+
+// -----------------------------------------------------------------------------
+// GpuStateObjectKey
+// -----------------------------------------------------------------------------
+
+const u32 FNV_OFFSET_BASIS = 2166136261u;
+const u32 FNV_PRIME = 16777619u;
+
+GpuStateObjectKey::GpuStateObjectKey(const GpuSamplerDesc& desc)
+    : m_type(GPU_STATE_OBJECT_SAMPLER)
+    , m_hash(0)
+    , m_words()
+    , m_resources()
+{
+    Begin(GPU_STATE_OBJECT_SAMPLER);
+    Add(desc.uAddressMode);
+    Add(desc.vAddressMode);
+    Add(desc.wAddressMode);
+    Add(desc.minFilter);
+    Add(desc.magFilter);
+    Add(desc.mipFilter);
+    Add((u32)desc.maxAnisotropy);
+}
+
+GpuStateObjectKey::GpuStateObjectKey(int nVertexAttribs,
+                                     const GpuVertexAttribute* attribs,
+                                     int nVertexBuffers,
+                                     const unsigned* strides)
+    : m_type(GPU_STATE_OBJECT_INPUT_LAYOUT)
+    , m_hash(0)
+    , m_words()
+    , m_resources()
+{
+    Begin(GPU_STATE_OBJECT_INPUT_LAYOUT);
+    Add((u32)nVertexAttribs);
+    for (int i = 0; i < nVertexAttribs; ++i) {
+        Add(attribs[i].format);
+        Add(attribs[i].offset);
+        Add((u32)attribs[i].bufferSlot);
+    }
+    Add((u32)nVertexBuffers);
+    for (int i = 0; i < nVertexBuffers; ++i)
+        Add(strides[i]);
+}
+
+GpuStateObjectKey::GpuStateObjectKey(const GpuPipelineStateDesc& desc)
+    : m_type(GPU_STATE_OBJECT_PIPELINE_STATE)
+    , m_hash(0)
+    , m_words()
+    , m_resources()
+{
+    Begin(GPU_STATE_OBJECT_PIPELINE_STATE);
+    AddResource(GPU_RESOURCE_SHADER_PROGRAM, desc.shaderProgram);
+    Add(desc.shaderStateBitfield);
+    AddResource(GPU_RESOURCE_INPUT_LAYOUT, desc.inputLayout);
+    Add(desc.depthCompare);
+    Add(desc.depthWritesEnabled);
+    Add(desc.fillMode);
+    Add(desc.cullMode);
+    Add(desc.frontFaceWinding);
+    Add(desc.blendingEnabled);
+    Add(desc.blendSrcFactor);
+    Add(desc.blendDstFactor);
+}
+
+GpuStateObjectKey::GpuStateObjectKey(const GpuRenderPassDesc& desc)
+    : m_type(GPU_STATE_OBJECT_RENDER_PASS)
+    , m_hash(0)
+    , m_words()
+    , m_resources()
+{
+    // The arrays of per-target values have one element for the backbuffer
+    // when there are no render targets. A NULL array (meaning the default
+    // values) is distinguished from a non-NULL one by a flag word.
+    int nColorValues = desc.numRenderTargets > 0 ? desc.numRenderTargets : 1;
+
+    Begin(GPU_STATE_OBJECT_RENDER_PASS);
+    Add((u32)desc.numRenderTargets);
+    for (int i = 0; i < desc.numRenderTargets; ++i)
+        AddResource(GPU_RESOURCE_TEXTURE, desc.renderTargets[i]);
+
+    Add(desc.clearColors != NULL);
+    if (desc.clearColors) {
+        for (int i = 0; i < nColorValues; ++i) {
+            AddFloat(desc.clearColors[i].r);
+            AddFloat(desc.clearColors[i].g);
+            AddFloat(desc.clearColors[i].b);
+            AddFloat(desc.clearColors[i].a);
+        }
+    }
+    Add(desc.colorLoadActions != NULL);
+    if (desc.colorLoadActions) {
+        for (int i = 0; i < nColorValues; ++i)
+            Add(desc.colorLoadActions[i]);
+    }
+    Add(desc.colorStoreActions != NULL);
+    if (desc.colorStoreActions) {
+        for (int i = 0; i < nColorValues; ++i)
+            Add(desc.colorStoreActions[i]);
+    }
+
+    AddResource(GPU_RESOURCE_TEXTURE, desc.depthStencilTarget);
+    AddFloat(desc.clearDepth);
+    Add(desc.depthStencilLoadAction);
+    Add(desc.depthStencilStoreAction);
+}
+
+void GpuStateObjectKey::Begin(GpuStateObjectType type)
+{
+    m_hash = FNV_OFFSET_BASIS;
+    Add(type);
+}
+
+void GpuStateObjectKey::Add(u32 word)
+{
+    m_words.push_back(word);
+    for (int i = 0; i < 4; ++i) {
+        m_hash ^= (word >> (i * 8)) & 0xFF;
+        m_hash *= FNV_PRIME;
+    }
+}
+
+void GpuStateObjectKey::AddFloat(float value)
+{
+    // Compare the bits, so that e.g. a NaN clear value still matches itself.
+    u32 word;
+    memcpy(&word, &value, sizeof word);
+    Add(word);
+}
+
+void GpuStateObjectKey::AddResource(GpuResourceType type, u32 id)
+{
+    Add(id);
+    // ID 0 is an unused optional resource, e.g. no depth target.
+    if (id != 0) {
+        ResourceRef ref;
+        ref.type = type;
+        ref.id = id;
+        m_resources.push_back(ref);
+    }
+}
+
+GpuStateObjectType GpuStateObjectKey::GetType() const
+{
+    return m_type;
+}
+
+u32 GpuStateObjectKey::GetHashValue() const
+{
+    return m_hash;
+}
+
+bool GpuStateObjectKey::operator==(const GpuStateObjectKey& other) const
+{
+    return m_hash == other.m_hash && m_words == other.m_words;
+}
+
+bool GpuStateObjectKey::RefersTo(GpuResourceType type, u32 id) const
+{
+    for (size_t i = 0; i < m_resources.size(); ++i) {
+        if (m_resources[i].type == type && m_resources[i].id == id)
+            return true;
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// GpuStateObjectCache
+// -----------------------------------------------------------------------------
+
+GpuStateObjectCache::Entry::Entry(const GpuStateObjectKey& key, u32 id)
+    : key(key)
+    , id(id)
+    , refCount(1)
+    , purged(false)
+    , m_link()
+{}
+
+u32 GpuStateObjectCache::IDKey::GetHashValue() const
+{
+    // IDs are mostly sequential, so scramble them with a multiplicative hash.
+    return (id * 2654435761u) ^ (u32)type;
+}
+
+GpuStateObjectCache::DescKey GpuStateObjectCache::GetDescKey::operator()(
+    const Entry* entry
+) const
+{
+    DescKey key;
+    key.key = &entry->key;
+    return key;
+}
+
+GpuStateObjectCache::IDKey GpuStateObjectCache::GetIDKey::operator()(
+    const Entry* entry
+) const
+{
+    IDKey key;
+    key.type = entry->key.GetType();
+    key.id = entry->id;
+    return key;
+}
+
+GpuStateObjectCache::GpuStateObjectCache()
+    : m_entries()
+    , m_entriesByDesc()
+    , m_entriesByID()
+    , m_stats()
+{
+    memset(&m_stats, 0, sizeof m_stats);
+}
+
+GpuStateObjectCache::~GpuStateObjectCache()
+{
+    // Any objects that are left were leaked by the client, and are reported
+    // by the backend.
+    m_entries.DeleteAll();
+}
+
+u32 GpuStateObjectCache::Acquire(const GpuStateObjectKey& key)
+{
+    DescKey descKey;
+    descKey.key = &key;
+    Entry* const* ppEntry = m_entriesByDesc.Get(descKey, GetDescKey());
+    if (!ppEntry) {
+        ++m_stats.misses[key.GetType()];
+        return 0;
+    }
+
+    ++m_stats.hits[key.GetType()];
+    ++(*ppEntry)->refCount;
+    return (*ppEntry)->id;
+}
+
+void GpuStateObjectCache::Insert(const GpuStateObjectKey& key, u32 id)
+{
+    ASSERT(id != 0);
+    Entry* entry = new Entry(key, id);
+    m_entries.InsertTail(entry);
+    m_entriesByDesc.Insert(entry, GetDescKey());
+    m_entriesByID.Insert(entry, GetIDKey());
+    ++m_stats.nObjects[key.GetType()];
+}
+
+bool GpuStateObjectCache::Release(GpuStateObjectType type, u32 id)
+{
+    IDKey idKey;
+    idKey.type = type;
+    idKey.id = id;
+    Entry* const* ppEntry = m_entriesByID.Get(idKey, GetIDKey());
+    ASSERT(ppEntry && "State object wasn't created by the device");
+
+    Entry* entry = *ppEntry;
+    ASSERT(entry->refCount > 0);
+    if (--entry->refCount > 0)
+        return false;
+
+    if (!entry->purged) {
+        DescKey descKey;
+        descKey.key = &entry->key;
+        m_entriesByDesc.Delete(descKey, GetDescKey());
+    }
+    m_entriesByID.Delete(idKey, GetIDKey());
+    --m_stats.nObjects[type];
+    delete entry; // Automatically unlinks from the list
+    return true;
+}
+
+void GpuStateObjectCache::PurgeResource(GpuResourceType type, u32 id)
+{
+    for (Entry* entry = m_entries.Head(); entry; entry = m_entries.Next(entry)) {
+        if (entry->purged || !entry->key.RefersTo(type, id))
+            continue;
+        DescKey descKey;
+        descKey.key = &entry->key;
+        m_entriesByDesc.Delete(descKey, GetDescKey());
+        entry->purged = true;
+    }
+}
+
+const GpuStateObjectCacheStats& GpuStateObjectCache::GetStats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ *
+ *   GpuStateObjectCache.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuStateObjectCache shares the state objects of a backend (samplers,
+ *   input layouts, pipeline states and render passes) between the create
+ *   calls with identical descriptions.
+ *
+ *   Each description is flattened into a GpuStateObjectKey, an array of
+ *   words that is hashed and compared as a whole. Resource IDs in a
+ *   description (shader programs, input layouts and textures) are compared
+ *   by value, but an ID can be reused once the inner IDs of its table wrap
+ *   around. So the backend calls PurgeResource() when it destroys one of
+ *   these resources, and the objects that refer to it are never returned
+ *   for a new resource with the same ID.
+ *
+ *   The backend calls Acquire() at the start of each create call. On a miss,
+ *   it creates the object and passes its ID to Insert(). Each destroy call
+ *   calls Release(), and the backend only destroys the object when the last
+ *   reference has been released.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUSTATEOBJECTCACHE_H
+#define GPUDEVICE_GPUSTATEOBJECTCACHE_H
+
+#include <vector>
+#include "Core/Hash.h"
+#include "Core/List.h"
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuStateObjectKey {
+public:
+    explicit GpuStateObjectKey(const GpuSamplerDesc& desc);
+    GpuStateObjectKey(int nVertexAttribs,
+                      const GpuVertexAttribute* attribs,
+                      int nVertexBuffers,
+                      const unsigned* strides);
+    explicit GpuStateObjectKey(const GpuPipelineStateDesc& desc);
+    explicit GpuStateObjectKey(const GpuRenderPassDesc& desc);
+
+    GpuStateObjectType GetType() const;
+    u32 GetHashValue() const;
+    bool operator==(const GpuStateObjectKey& other) const;
+    // Returns whether the description refers to the resource.
+    bool RefersTo(GpuResourceType type, u32 id) const;
+
+private:
+    struct ResourceRef {
+        GpuResourceType type;
+        u32 id;
+    };
+
+    void Begin(GpuStateObjectType type);
+    void Add(u32 word);
+    void AddFloat(float value);
+    void AddResource(GpuResourceType type, u32 id);
+
+    GpuStateObjectType m_type;
+    u32 m_hash;
+    std::vector<u32> m_words;
+    std::vector<ResourceRef> m_resources;
+};
+
+class GpuStateObjectCache {
+public:
+    GpuStateObjectCache();
+    ~GpuStateObjectCache();
+
+    // Returns the ID of the object with the given key and adds a reference to
+    // it, or returns 0 if there is no such object.
+    u32 Acquire(const GpuStateObjectKey& key);
+    // Adds a newly created object, with one reference.
+    void Insert(const GpuStateObjectKey& key, u32 id);
+    // Removes a reference to the object. Returns true if it was the last
+    // reference, in which case the caller must destroy the object.
+    bool Release(GpuStateObjectType type, u32 id);
+    // Stops returning the objects that refer to the resource from Acquire(),
+    // which must be done when the resource is destroyed. The objects stay
+    // valid until they are released. This goes through all the objects, but
+    // there are few of them compared to the resources.
+    void PurgeResource(GpuResourceType type, u32 id);
+
+    const GpuStateObjectCacheStats& GetStats() const;
+
+private:
+    GpuStateObjectCache(const GpuStateObjectCache&);
+    GpuStateObjectCache& operator=(const GpuStateObjectCache&);
+
+    struct Entry {
+        Entry(const GpuStateObjectKey& key, u32 id);
+
+        GpuStateObjectKey key;
+        u32 id;
+        int refCount;
+        // Whether PurgeResource() has removed the entry from m_entriesByDesc.
+        bool purged;
+        LIST_LINK(Entry) m_link;
+    };
+
+    struct DescKey {
+        u32 GetHashValue() const { return key->GetHashValue(); }
+        bool operator==(const DescKey& other) const { return *key == *other.key; }
+
+        const GpuStateObjectKey* key;
+    };
+
+    struct IDKey {
+        u32 GetHashValue() const;
+        bool operator==(const IDKey& other) const
+        { return type == other.type && id == other.id; }
+
+        GpuStateObjectType type;
+        u32 id;
+    };
+
+    struct GetDescKey {
+        DescKey operator()(const Entry* entry) const;
+    };
+
+    struct GetIDKey {
+        IDKey operator()(const Entry* entry) const;
+    };
+
+    LIST_DECLARE(Entry, m_link) m_entries;
+    THash<DescKey, Entry*> m_entriesByDesc;
+    THash<IDKey, Entry*> m_entriesByID;
+    GpuStateObjectCacheStats m_stats;
+};
+
+#endif // GPUDEVICE_GPUSTATEOBJECTCACHE_H
@@ -0,0 +1,140 @@
+#include "GpuDevice/GpuTimerQueries.h"
+#include "Core/Macros.h"
+#include "GpuDevice/GpuFramePacer.h"
+
+GpuTimerQueries::GpuTimerQueries()
+    : m_queryTable()
+    , m_frameSlots()
+{
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+        m_frameSlots[i].frame = 0;
+        m_frameSlots[i].resolved = true;
+        m_frameSlots[i].nTimestamps = 0;
+    }
+}
+
+bool GpuTimerQueries::Exists(GpuTimerQueryID queryID) const
+{
+    return m_queryTable.Has(queryID);
+}
+
+GpuTimerQueryID GpuTimerQueries::Create()
+{
+    GpuTimerQueryID queryID(m_queryTable.Add());
+    Query& query = m_queryTable.Lookup(queryID);
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+        query.frames[i] = 0;
+        query.begins[i] = NO_TIMESTAMP;
+        query.ends[i] = NO_TIMESTAMP;
+    }
+    query.hasResult = false;
+    query.resultFrame = 0;
+    query.resultMs = 0.0f;
+    return queryID;
+}
+
+void GpuTimerQueries::Destroy(GpuTimerQueryID queryID)
+{
+    ASSERT(Exists(queryID));
+    // The frames that still refer to the query skip it once it's gone.
+    m_queryTable.Remove(queryID);
+}
+
+GpuTimerQueries::FrameSlot& GpuTimerQueries::GetFrameSlot(u64 frame)
+{
+    FrameSlot& slot = m_frameSlots[GpuFramePacer::FrameSlot(frame)];
+    if (slot.frame != frame) {
+        slot.frame = frame;
+        slot.resolved = false;
+        slot.nTimestamps = 0;
+        slot.queries.clear();
+    }
+    return slot;
+}
+
+u32 GpuTimerQueries::AddTimestamp(u64 frame)
+{
+    FrameSlot& slot = GetFrameSlot(frame);
+    if (slot.nTimestamps == MAX_TIMESTAMPS_PER_FRAME)
+        return NO_TIMESTAMP;
+    slot.timestamps[slot.nTimestamps] = 0;
+    return slot.nTimestamps++;
+}
+
+u32 GpuTimerQueries::Begin(GpuTimerQueryID queryID, u64 frame)
+{
+    ASSERT(Exists(queryID));
+    Query& query = m_queryTable.Lookup(queryID);
+    int slot = GpuFramePacer::FrameSlot(frame);
+    ASSERT(query.frames[slot] != frame && "A timer query can only be measured once per frame");
+
+    query.frames[slot] = frame;
+    query.begins[slot] = AddTimestamp(frame);
+    query.ends[slot] = NO_TIMESTAMP;
+    return query.begins[slot];
+}
+
+u32 GpuTimerQueries::End(GpuTimerQueryID queryID, u64 frame)
+{
+    ASSERT(Exists(queryID));
+    Query& query = m_queryTable.Lookup(queryID);
+    int slot = GpuFramePacer::FrameSlot(frame);
+    ASSERT(query.frames[slot] == frame && query.ends[slot] == NO_TIMESTAMP &&
+           "TimerQueryEnd() must follow TimerQueryBegin() in the same frame");
+
+    query.ends[slot] = AddTimestamp(frame);
+    GetFrameSlot(frame).queries.push_back(queryID);
+    return query.ends[slot];
+}
+
+u32 GpuTimerQueries::GetTimestampCount(u64 frame) const
+{
+    const FrameSlot& slot = m_frameSlots[GpuFramePacer::FrameSlot(frame)];
+    return slot.frame == frame ? slot.nTimestamps : 0;
+}
+
+u64* GpuTimerQueries::GetTimestamps(u64 frame)
+{
+    return GetFrameSlot(frame).timestamps;
+}
+
+void GpuTimerQueries::Resolve(u64 completedFrame)
+{
+    for (int i = 0; i < GPU_MAX_FRAMES_IN_FLIGHT; ++i) {
+        FrameSlot& slot = m_frameSlots[i];
+        if (slot.resolved || slot.frame > completedFrame)
+            continue;
+
+        for (size_t j = 0; j < slot.queries.size(); ++j) {
+            if (!Exists(slot.queries[j]))
+                continue;
+            Query& query = m_queryTable.Lookup(slot.queries[j]);
+            if (query.frames[i] != slot.frame ||
+                query.begins[i] == NO_TIMESTAMP ||
+                query.ends[i] == NO_TIMESTAMP ||
+                (query.hasResult && query.resultFrame > slot.frame))
+                continue;
+
+            u64 begin = slot.timestamps[query.begins[i]];
+            u64 end = slot.timestamps[query.ends[i]];
+            query.hasResult = true;
+            query.resultFrame = slot.frame;
+            query.resultMs = end > begin ? (float)((double)(end - begin) / 1e6) : 0.0f;
+        }
+        slot.resolved = true;
+    }
+}
+
+bool GpuTimerQueries::GetResult(GpuTimerQueryID queryID,
+                                float* milliseconds,
+                                u64* frame) const
+{
+    ASSERT(Exists(queryID));
+    const Query& query = m_queryTable.Lookup(queryID);
+    if (!query.hasResult)
+        return false;
+    *milliseconds = query.resultMs;
+    if (frame)
+        *frame = query.resultFrame;
+    return true;
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ *   GpuTimerQueries.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuTimerQueries keeps the timer queries and their results. Each begin or
+ *   end marker of a query is assigned a timestamp index within its frame, and
+ *   the backend writes the GPU time of the marker, in nanoseconds, into the
+ *   frame's timestamp array at that index. The timestamps can be written from
+ *   any thread, as long as they're written before the frame is completed on
+ *   the GpuFramePacer.
+ *
+ *   The backend calls Resolve() from SceneBegin(), which computes the results
+ *   of the queries of the frames that the GPU has completed. A frame's
+ *   timestamps are kept until the frame that reuses its slot begins, so the
+ *   slots of completed frames must be resolved before new markers are added.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUTIMERQUERIES_H
+#define GPUDEVICE_GPUTIMERQUERIES_H
+
+#include <vector>
+#include "Core/IDLookupTable.h"
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuTimerQueries {
+public:
+    // Markers beyond this number in a frame are dropped, and the queries that
+    // they belong to have no result for the frame.
+    static const u32 MAX_TIMESTAMPS_PER_FRAME = 256;
+    static const u32 NO_TIMESTAMP = 0xFFFFFFFF;
+
+    GpuTimerQueries();
+
+    bool Exists(GpuTimerQueryID queryID) const;
+    GpuTimerQueryID Create();
+    void Destroy(GpuTimerQueryID queryID);
+
+    // Return the index of the marker's timestamp in the frame, or
+    // NO_TIMESTAMP if the frame has no more room for markers.
+    u32 Begin(GpuTimerQueryID queryID, u64 frame);
+    u32 End(GpuTimerQueryID queryID, u64 frame);
+
+    // The number of markers in the frame so far, and the frame's timestamps.
+    u32 GetTimestampCount(u64 frame) const;
+    u64* GetTimestamps(u64 frame);
+
+    void Resolve(u64 completedFrame);
+
+    bool GetResult(GpuTimerQueryID queryID, float* milliseconds, u64* frame) const;
+
+private:
+    GpuTimerQueries(const GpuTimerQueries&);
+    GpuTimerQueries& operator=(const GpuTimerQueries&);
+
+    struct Query {
+        // The markers of the query in the frame of each slot.
+        u64 frames[GPU_MAX_FRAMES_IN_FLIGHT];
+        u32 begins[GPU_MAX_FRAMES_IN_FLIGHT];
+        u32 ends[GPU_MAX_FRAMES_IN_FLIGHT];
+        bool hasResult;
+        u64 resultFrame;
+        float resultMs;
+    };
+
+    struct FrameSlot {
+        u64 frame;
+        bool resolved;
+        u32 nTimestamps;
+        u64 timestamps[MAX_TIMESTAMPS_PER_FRAME];
+        // The queries that ended in the frame.
+        std::vector<GpuTimerQueryID> queries;
+    };
+
+    FrameSlot& GetFrameSlot(u64 frame);
+    u32 AddTimestamp(u64 frame);
+
+    IDLookupTable<Query, GpuTimerQueryID::Type, 16, 16> m_queryTable;
+    FrameSlot m_frameSlots[GPU_MAX_FRAMES_IN_FLIGHT];
+};
+
+#endif // GPUDEVICE_GPUTIMERQUERIES_H
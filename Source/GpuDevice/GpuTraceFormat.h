@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ *   GpuTraceFormat.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   Layout of the binary trace files written by GpuTraceWriter and read by
+ *   GpuTraceReplay.
+ *
+ *   A trace starts with a GpuTraceHeader and is followed by a sequence of
+ *   records. Each record is a u8 GpuTraceOp followed by the arguments of the
+ *   call, written in the order of the GpuDevice function parameters. Integers
+ *   and floats are written in the native byte order; enums and bools are
+ *   written as u32. Variable-sized data (shader programs, buffer and texture
+ *   contents, draw items) is written as a u32 byte count followed by the
+ *   bytes.
+ *
+ *   Resource IDs are written as the IDs returned by the recording device. Draw
+ *   items are written as-is, so they contain the raw lookup table indices of
+ *   the recording device; the replayer maps both back to its own resources.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUTRACEFORMAT_H
+#define GPUDEVICE_GPUTRACEFORMAT_H
+
+#include "Core/Types.h"
+
+const u32 GPU_TRACE_VERSION = 5;
+
+struct GpuTraceHeader {
+    char code[4]; // "GTRC"
+    u32 version;
+};
+
+enum GpuTraceOp {
+    GPU_TRACE_OP_SET_FORMAT,
+    GPU_TRACE_OP_WINDOW_RESIZED,
+    GPU_TRACE_OP_SHADER_PROGRAM_CREATE,
+    GPU_TRACE_OP_SHADER_PROGRAM_DESTROY,
+    GPU_TRACE_OP_BUFFER_CREATE,
+    GPU_TRACE_OP_BUFFER_DESTROY,
+    GPU_TRACE_OP_BUFFER_STREAM_RESIZE,
+    // Written at BufferUnmap() time, as an offset and the bytes from there
+    // that changed since the previous update of the buffer (or its
+    // creation). The bytes outside that range keep their previous values,
+    // which the replayer has to supply itself, as BufferMap() doesn't keep
+    // them.
+    GPU_TRACE_OP_BUFFER_UPDATE,
+    GPU_TRACE_OP_BUFFER_UPLOAD,
+    GPU_TRACE_OP_TEXTURE_CREATE,
+    GPU_TRACE_OP_TEXTURE_DESTROY,
+    GPU_TRACE_OP_TEXTURE_UPLOAD,
+    GPU_TRACE_OP_SAMPLER_CREATE,
+    GPU_TRACE_OP_SAMPLER_DESTROY,
+    GPU_TRACE_OP_INPUT_LAYOUT_CREATE,
+    GPU_TRACE_OP_INPUT_LAYOUT_DESTROY,
+    GPU_TRACE_OP_PIPELINE_STATE_CREATE,
+    GPU_TRACE_OP_PIPELINE_STATE_DESTROY,
+    GPU_TRACE_OP_RENDER_PASS_CREATE,
+    GPU_TRACE_OP_RENDER_PASS_DESTROY,
+    GPU_TRACE_OP_DRAW,
+    GPU_TRACE_OP_DRAW_PARALLEL,
+    GPU_TRACE_OP_SCENE_BEGIN,
+    GPU_TRACE_OP_SCENE_PRESENT,
+    // Only the calls on timer queries that were created during the recording
+    // are written. The results aren't recorded; the replaying device measures
+    // its own.
+    GPU_TRACE_OP_TIMER_QUERY_CREATE,
+    GPU_TRACE_OP_TIMER_QUERY_DESTROY,
+    GPU_TRACE_OP_TIMER_QUERY_BEGIN,
+    GPU_TRACE_OP_TIMER_QUERY_END,
+};
+
+// The kinds of resource whose IDs are remapped by the replayer. Destroying
+// the resources in this order never destroys a resource that another one
+// still refers to.
+enum GpuTraceResourceType {
+    GPU_TRACE_RESOURCE_PIPELINE_STATE,
+    GPU_TRACE_RESOURCE_RENDER_PASS,
+    GPU_TRACE_RESOURCE_INPUT_LAYOUT,
+    GPU_TRACE_RESOURCE_SHADER_PROGRAM,
+    GPU_TRACE_RESOURCE_SAMPLER,
+    GPU_TRACE_RESOURCE_TEXTURE,
+    GPU_TRACE_RESOURCE_BUFFER,
+    GPU_TRACE_RESOURCE_TIMER_QUERY,
+
+    GPU_TRACE_RESOURCE_TYPE_COUNT,
+};
+
+#endif // GPUDEVICE_GPUTRACEFORMAT_H
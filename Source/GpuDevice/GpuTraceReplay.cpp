@@ -0,0 +1,603 @@
+#include "GpuDevice/GpuTraceReplay.h"
+#include <stdio.h>
+#include <string.h>
+#include "Core/Macros.h"
+#include "Core/TaskPool.h"
+#include "GpuDevice/GpuDrawItem.h"
+#include "GpuDevice/GpuTraceFormat.h"
+
+static u16 GetRawIndex(u32 resourceID)
+{
+    return (u16)(resourceID & 0xFFFF);
+}
+
+GpuTraceReplay::GpuTraceReplay(GpuDevice& device)
+    : m_device(device)
+    , m_trace()
+    , m_readPos(0)
+    , m_frameNumber(0)
+    , m_bufferContents()
+    , m_drawItemData()
+    , m_drawItemOffsets()
+    , m_drawItems()
+{
+    STATIC_ASSERT(NUM_RESOURCE_TYPES == GPU_TRACE_RESOURCE_TYPE_COUNT,
+                  "GpuTraceReplay::NUM_RESOURCE_TYPES is wrong");
+}
+
+GpuTraceReplay::~GpuTraceReplay()
+{
+    Rewind();
+}
+
+bool GpuTraceReplay::Load(const char* path)
+{
+    Rewind();
+    m_trace.clear();
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0) {
+        m_trace.resize((size_t)size);
+        if (fread(&m_trace[0], 1, (size_t)size, file) != (size_t)size)
+            m_trace.clear();
+    }
+    fclose(file);
+
+    GpuTraceHeader header;
+    if (m_trace.size() < sizeof header) {
+        m_trace.clear();
+        return false;
+    }
+    memcpy(&header, &m_trace[0], sizeof header);
+    if (memcmp(header.code, "GTRC", 4) != 0 || header.version != GPU_TRACE_VERSION) {
+        m_trace.clear();
+        return false;
+    }
+
+    m_readPos = sizeof header;
+    return true;
+}
+
+bool GpuTraceReplay::ReplayFrame(TaskPool* taskPool)
+{
+    while (!AtEnd()) {
+        u8 op = ReadU8();
+        ReplayCall(op, taskPool);
+        if (op == GPU_TRACE_OP_SCENE_PRESENT) {
+            ++m_frameNumber;
+            return true;
+        }
+    }
+    return false;
+}
+
+void GpuTraceReplay::Rewind()
+{
+    for (int type = 0; type < GPU_TRACE_RESOURCE_TYPE_COUNT; ++type) {
+        std::vector<u32>& ids = m_ids[type];
+        std::vector<u32>& refCounts = m_idRefCounts[type];
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] == 0)
+                continue;
+            for (u32 ref = 0; ref < refCounts[i]; ++ref) {
+                switch (type) {
+                    case GPU_TRACE_RESOURCE_PIPELINE_STATE:
+                        m_device.PipelineStateDestroy(GpuPipelineStateID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_RENDER_PASS:
+                        m_device.RenderPassDestroy(GpuRenderPassID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_INPUT_LAYOUT:
+                        m_device.InputLayoutDestroy(GpuInputLayoutID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_SHADER_PROGRAM:
+                        m_device.ShaderProgramDestroy(GpuShaderProgramID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_SAMPLER:
+                        m_device.SamplerDestroy(GpuSamplerID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_TEXTURE:
+                        m_device.TextureDestroy(GpuTextureID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_BUFFER:
+                        m_device.BufferDestroy(GpuBufferID(ids[i]));
+                        break;
+                    case GPU_TRACE_RESOURCE_TIMER_QUERY:
+                        m_device.TimerQueryDestroy(GpuTimerQueryID(ids[i]));
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+        ids.clear();
+        refCounts.clear();
+    }
+    m_bufferContents.clear();
+
+    m_readPos = m_trace.empty() ? 0 : sizeof(GpuTraceHeader);
+    m_frameNumber = 0;
+}
+
+int GpuTraceReplay::GetFrameNumber() const
+{
+    return m_frameNumber;
+}
+
+void GpuTraceReplay::ReplayCall(u8 op, TaskPool* taskPool)
+{
+    switch (op) {
+        case GPU_TRACE_OP_SET_FORMAT: {
+            GpuDeviceFormat format;
+            format.pixelColorFormat = (GpuPixelColorFormat)ReadU32();
+            format.pixelDepthFormat = (GpuPixelDepthFormat)ReadU32();
+            format.resolutionX = (int)ReadU32();
+            format.resolutionY = (int)ReadU32();
+            format.flags = ReadU32();
+            m_device.SetFormat(format);
+            break;
+        }
+        case GPU_TRACE_OP_WINDOW_RESIZED:
+            m_device.OnWindowResized();
+            break;
+
+        case GPU_TRACE_OP_SHADER_PROGRAM_CREATE: {
+            u32 recordedID = ReadU32();
+            u32 size;
+            const u8* data = ReadBlob(&size);
+            GpuShaderProgramID id = m_device.ShaderProgramCreate((const char*)data, size);
+            AddID(GPU_TRACE_RESOURCE_SHADER_PROGRAM, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_SHADER_PROGRAM_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_SHADER_PROGRAM, ReadU32());
+            m_device.ShaderProgramDestroy(GpuShaderProgramID(id));
+            break;
+        }
+
+        case GPU_TRACE_OP_BUFFER_CREATE: {
+            u32 recordedID = ReadU32();
+            GpuBufferType type = (GpuBufferType)ReadU32();
+            GpuBufferAccessMode accessMode = (GpuBufferAccessMode)ReadU32();
+            u32 size = ReadU32();
+            int maxUpdatesPerFrame = (int)ReadU32();
+            u32 dataSize;
+            const u8* data = ReadBlob(&dataSize);
+            GpuBufferID id = m_device.BufferCreate(
+                type,
+                accessMode,
+                dataSize ? data : NULL,
+                size,
+                maxUpdatesPerFrame
+            );
+            AddID(GPU_TRACE_RESOURCE_BUFFER, recordedID, id);
+
+            // Static-mode buffers can't be mapped, so their contents aren't
+            // needed.
+            u16 index = GetRawIndex(recordedID);
+            if (index >= m_bufferContents.size())
+                m_bufferContents.resize(index + 1);
+            if (accessMode != GPU_BUFFER_ACCESS_STATIC) {
+                m_bufferContents[index].assign(size, 0);
+                if (dataSize)
+                    memcpy(&m_bufferContents[index][0], data, dataSize);
+            }
+            break;
+        }
+        case GPU_TRACE_OP_BUFFER_DESTROY: {
+            u32 recordedID = ReadU32();
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_BUFFER, recordedID);
+            m_device.BufferDestroy(GpuBufferID(id));
+            std::vector<u8>().swap(m_bufferContents[GetRawIndex(recordedID)]);
+            break;
+        }
+        case GPU_TRACE_OP_BUFFER_STREAM_RESIZE: {
+            u32 recordedID = ReadU32();
+            GpuBufferID id(LookupID(GPU_TRACE_RESOURCE_BUFFER, recordedID));
+            u32 newSize = ReadU32();
+            m_device.BufferStreamResize(id, newSize);
+            m_bufferContents[GetRawIndex(recordedID)].resize(newSize, 0);
+            break;
+        }
+        case GPU_TRACE_OP_BUFFER_UPDATE: {
+            u32 recordedID = ReadU32();
+            GpuBufferID id(LookupID(GPU_TRACE_RESOURCE_BUFFER, recordedID));
+            u32 offset = ReadU32();
+            u32 size;
+            const u8* data = ReadBlob(&size);
+            std::vector<u8>& contents = m_bufferContents[GetRawIndex(recordedID)];
+            if ((u64)offset + size > contents.size())
+                FATAL("GpuTraceReplay: buffer update is out of range");
+            if (size)
+                memcpy(&contents[offset], data, size);
+
+            void* memory = m_device.BufferMap(id);
+            if (!contents.empty())
+                memcpy(memory, &contents[0], contents.size());
+            m_device.BufferUnmap(id);
+            break;
+        }
+        case GPU_TRACE_OP_BUFFER_UPLOAD: {
+            GpuBufferID id(LookupID(GPU_TRACE_RESOURCE_BUFFER, ReadU32()));
+            u32 offset = ReadU32();
+            u32 size;
+            const u8* data = ReadBlob(&size);
+            m_device.BufferUpload(id, offset, data, size);
+            break;
+        }
+
+        case GPU_TRACE_OP_TEXTURE_CREATE: {
+            u32 recordedID = ReadU32();
+            GpuTextureType type = (GpuTextureType)ReadU32();
+            GpuPixelFormat pixelFormat = (GpuPixelFormat)ReadU32();
+            u32 flags = ReadU32();
+            int width = (int)ReadU32();
+            int height = (int)ReadU32();
+            int depthOrArrayLength = (int)ReadU32();
+            int nMipmapLevels = (int)ReadU32();
+            GpuTextureID id = m_device.TextureCreate(
+                type,
+                pixelFormat,
+                flags,
+                width,
+                height,
+                depthOrArrayLength,
+                nMipmapLevels
+            );
+            AddID(GPU_TRACE_RESOURCE_TEXTURE, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_TEXTURE_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_TEXTURE, ReadU32());
+            m_device.TextureDestroy(GpuTextureID(id));
+            break;
+        }
+        case GPU_TRACE_OP_TEXTURE_UPLOAD: {
+            GpuTextureID id(LookupID(GPU_TRACE_RESOURCE_TEXTURE, ReadU32()));
+            int slice = (int)ReadU32();
+            GpuRegion region;
+            region.x = (int)ReadU32();
+            region.y = (int)ReadU32();
+            region.width = (int)ReadU32();
+            region.height = (int)ReadU32();
+            int mipmapLevel = (int)ReadU32();
+            int stride = (int)ReadU32();
+            u32 size;
+            const u8* bytes = ReadBlob(&size);
+            m_device.TextureUploadSlice(id, slice, region, mipmapLevel, stride, bytes);
+            break;
+        }
+
+        case GPU_TRACE_OP_SAMPLER_CREATE: {
+            u32 recordedID = ReadU32();
+            GpuSamplerDesc desc;
+            desc.uAddressMode = (GpuSamplerAddressMode)ReadU32();
+            desc.vAddressMode = (GpuSamplerAddressMode)ReadU32();
+            desc.wAddressMode = (GpuSamplerAddressMode)ReadU32();
+            desc.minFilter = (GpuSamplerFilterMode)ReadU32();
+            desc.magFilter = (GpuSamplerFilterMode)ReadU32();
+            desc.mipFilter = (GpuSamplerMipFilter)ReadU32();
+            desc.maxAnisotropy = (int)ReadU32();
+            GpuSamplerID id = m_device.SamplerCreate(desc);
+            AddID(GPU_TRACE_RESOURCE_SAMPLER, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_SAMPLER_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_SAMPLER, ReadU32());
+            m_device.SamplerDestroy(GpuSamplerID(id));
+            break;
+        }
+
+        case GPU_TRACE_OP_INPUT_LAYOUT_CREATE: {
+            u32 recordedID = ReadU32();
+            std::vector<GpuVertexAttribute> attribs(ReadU32());
+            for (size_t i = 0; i < attribs.size(); ++i) {
+                attribs[i].format = (GpuVertexAttribFormat)ReadU32();
+                attribs[i].offset = ReadU32();
+                attribs[i].bufferSlot = (int)ReadU32();
+            }
+            std::vector<unsigned> strides(ReadU32());
+            for (size_t i = 0; i < strides.size(); ++i)
+                strides[i] = ReadU32();
+            GpuInputLayoutID id = m_device.InputLayoutCreate(
+                (int)attribs.size(),
+                attribs.empty() ? NULL : &attribs[0],
+                (int)strides.size(),
+                strides.empty() ? NULL : &strides[0]
+            );
+            AddID(GPU_TRACE_RESOURCE_INPUT_LAYOUT, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_INPUT_LAYOUT_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_INPUT_LAYOUT, ReadU32());
+            m_device.InputLayoutDestroy(GpuInputLayoutID(id));
+            break;
+        }
+
+        case GPU_TRACE_OP_PIPELINE_STATE_CREATE: {
+            u32 recordedID = ReadU32();
+            GpuPipelineStateDesc desc;
+            desc.shaderProgram = GpuShaderProgramID(
+                LookupID(GPU_TRACE_RESOURCE_SHADER_PROGRAM, ReadU32()));
+            desc.shaderStateBitfield = ReadU32();
+            desc.inputLayout = GpuInputLayoutID(
+                LookupID(GPU_TRACE_RESOURCE_INPUT_LAYOUT, ReadU32()));
+            desc.depthCompare = (GpuCompareFunction)ReadU32();
+            desc.depthWritesEnabled = ReadU32() != 0;
+            desc.fillMode = (GpuFillMode)ReadU32();
+            desc.cullMode = (GpuCullMode)ReadU32();
+            desc.frontFaceWinding = (GpuWindingOrder)ReadU32();
+            desc.blendingEnabled = ReadU32() != 0;
+            desc.blendSrcFactor = (GpuBlendFactor)ReadU32();
+            desc.blendDstFactor = (GpuBlendFactor)ReadU32();
+            GpuPipelineStateID id = m_device.PipelineStateCreate(desc);
+            AddID(GPU_TRACE_RESOURCE_PIPELINE_STATE, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_PIPELINE_STATE_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_PIPELINE_STATE, ReadU32());
+            m_device.PipelineStateDestroy(GpuPipelineStateID(id));
+            break;
+        }
+
+        case GPU_TRACE_OP_RENDER_PASS_CREATE: {
+            u32 recordedID = ReadU32();
+            GpuRenderPassDesc desc;
+            std::vector<GpuTextureID> renderTargets(ReadU32());
+            for (size_t i = 0; i < renderTargets.size(); ++i) {
+                renderTargets[i] = GpuTextureID(
+                    LookupID(GPU_TRACE_RESOURCE_TEXTURE, ReadU32()));
+            }
+            desc.numRenderTargets = (int)renderTargets.size();
+            desc.renderTargets = renderTargets.empty() ? NULL : &renderTargets[0];
+
+            size_t nColorTargets = renderTargets.empty() ? 1 : renderTargets.size();
+            std::vector<GpuColor> clearColors;
+            if (ReadU32()) {
+                clearColors.resize(nColorTargets);
+                for (size_t i = 0; i < nColorTargets; ++i) {
+                    clearColors[i].r = ReadFloat();
+                    clearColors[i].g = ReadFloat();
+                    clearColors[i].b = ReadFloat();
+                    clearColors[i].a = ReadFloat();
+                }
+                desc.clearColors = &clearColors[0];
+            }
+            std::vector<GpuRenderLoadAction> loadActions;
+            if (ReadU32()) {
+                loadActions.resize(nColorTargets);
+                for (size_t i = 0; i < nColorTargets; ++i)
+                    loadActions[i] = (GpuRenderLoadAction)ReadU32();
+                desc.colorLoadActions = &loadActions[0];
+            }
+            std::vector<GpuRenderStoreAction> storeActions;
+            if (ReadU32()) {
+                storeActions.resize(nColorTargets);
+                for (size_t i = 0; i < nColorTargets; ++i)
+                    storeActions[i] = (GpuRenderStoreAction)ReadU32();
+                desc.colorStoreActions = &storeActions[0];
+            }
+
+            desc.depthStencilTarget = GpuTextureID(
+                LookupID(GPU_TRACE_RESOURCE_TEXTURE, ReadU32()));
+            desc.clearDepth = ReadFloat();
+            desc.depthStencilLoadAction = (GpuRenderLoadAction)ReadU32();
+            desc.depthStencilStoreAction = (GpuRenderStoreAction)ReadU32();
+
+            GpuRenderPassID id = m_device.RenderPassCreate(desc);
+            AddID(GPU_TRACE_RESOURCE_RENDER_PASS, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_RENDER_PASS_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_RENDER_PASS, ReadU32());
+            m_device.RenderPassDestroy(GpuRenderPassID(id));
+            break;
+        }
+
+        case GPU_TRACE_OP_DRAW:
+            ReplayDraw(false, taskPool);
+            break;
+        case GPU_TRACE_OP_DRAW_PARALLEL:
+            ReplayDraw(true, taskPool);
+            break;
+
+        case GPU_TRACE_OP_SCENE_BEGIN:
+            m_device.SceneBegin();
+            break;
+        case GPU_TRACE_OP_SCENE_PRESENT:
+            m_device.ScenePresent();
+            break;
+
+        case GPU_TRACE_OP_TIMER_QUERY_CREATE: {
+            u32 recordedID = ReadU32();
+            GpuTimerQueryID id = m_device.TimerQueryCreate();
+            AddID(GPU_TRACE_RESOURCE_TIMER_QUERY, recordedID, id);
+            break;
+        }
+        case GPU_TRACE_OP_TIMER_QUERY_DESTROY: {
+            u32 id = RemoveID(GPU_TRACE_RESOURCE_TIMER_QUERY, ReadU32());
+            m_device.TimerQueryDestroy(GpuTimerQueryID(id));
+            break;
+        }
+        case GPU_TRACE_OP_TIMER_QUERY_BEGIN: {
+            GpuTimerQueryID id(LookupID(GPU_TRACE_RESOURCE_TIMER_QUERY, ReadU32()));
+            m_device.TimerQueryBegin(id);
+            break;
+        }
+        case GPU_TRACE_OP_TIMER_QUERY_END: {
+            GpuTimerQueryID id(LookupID(GPU_TRACE_RESOURCE_TIMER_QUERY, ReadU32()));
+            m_device.TimerQueryEnd(id);
+            break;
+        }
+
+        default:
+            FATAL("GpuTraceReplay: unknown call %d in trace", op);
+            break;
+    }
+}
+
+void GpuTraceReplay::ReplayDraw(bool parallel, TaskPool* taskPool)
+{
+    GpuRenderPassID renderPass(LookupID(GPU_TRACE_RESOURCE_RENDER_PASS, ReadU32()));
+    GpuViewport viewport;
+    viewport.x = (u16)ReadU32();
+    viewport.y = (u16)ReadU32();
+    viewport.width = (u16)ReadU32();
+    viewport.height = (u16)ReadU32();
+    viewport.zNear = ReadFloat();
+    viewport.zFar = ReadFloat();
+
+    // Copy the draw items into memory that is suitably aligned for them.
+    u32 nItems = ReadU32();
+    m_drawItemData.clear();
+    m_drawItemOffsets.resize(nItems);
+    for (u32 i = 0; i < nItems; ++i) {
+        u32 size;
+        const u8* item = ReadBlob(&size);
+        if (size < sizeof(GpuDrawItem))
+            FATAL("GpuTraceReplay: draw item is truncated");
+        size_t offset = m_drawItemData.size();
+        m_drawItemData.resize(offset + (size + sizeof(u64) - 1) / sizeof(u64));
+        memcpy(&m_drawItemData[offset], item, size);
+        m_drawItemOffsets[i] = offset;
+    }
+
+    m_drawItems.resize(nItems);
+    for (u32 i = 0; i < nItems; ++i)
+        m_drawItems[i] = RemapDrawItem(&m_drawItemData[m_drawItemOffsets[i]]);
+
+    if (nItems > 0) {
+        if (parallel && taskPool)
+            m_device.DrawParallel(&m_drawItems[0], (int)nItems, renderPass, viewport, *taskPool);
+        else
+            m_device.Draw(&m_drawItems[0], (int)nItems, renderPass, viewport);
+    }
+
+    for (u32 i = 0; i < nItems; ++i)
+        GPUDEVICE_UNREGISTER_DRAWITEM(m_device, m_drawItems[i]);
+}
+
+GpuDrawItem* GpuTraceReplay::RemapDrawItem(u64* memory)
+{
+    GpuDrawItem* item = (GpuDrawItem*)memory;
+
+    item->pipelineStateIdx = LookupRawIndex(GPU_TRACE_RESOURCE_PIPELINE_STATE,
+                                            item->pipelineStateIdx);
+    if (item->IsIndexed())
+        item->indexBufferIdx = LookupRawIndex(GPU_TRACE_RESOURCE_BUFFER, item->indexBufferIdx);
+    if (item->HasInstanceBuffer()) {
+        item->instanceBufferIdx = LookupRawIndex(GPU_TRACE_RESOURCE_BUFFER,
+                                                 item->instanceBufferIdx);
+    }
+    if (item->IsIndirect()) {
+        item->drawArgsBufferIdx = LookupRawIndex(GPU_TRACE_RESOURCE_BUFFER,
+                                                 item->drawArgsBufferIdx);
+    }
+
+    u16* vertexBuffers = item->VertexBuffers();
+    for (int i = 0; i < item->nVertexBuffers; ++i)
+        vertexBuffers[i] = LookupRawIndex(GPU_TRACE_RESOURCE_BUFFER, vertexBuffers[i]);
+    u16* cbuffers = item->CBuffers();
+    for (int i = 0; i < item->nCBuffers; ++i)
+        cbuffers[i] = LookupRawIndex(GPU_TRACE_RESOURCE_BUFFER, cbuffers[i]);
+    u16* textures = item->Textures();
+    for (int i = 0; i < item->nTextures; ++i)
+        textures[i] = LookupRawIndex(GPU_TRACE_RESOURCE_TEXTURE, textures[i]);
+    u16* samplers = item->Samplers();
+    for (int i = 0; i < item->nSamplers; ++i)
+        samplers[i] = LookupRawIndex(GPU_TRACE_RESOURCE_SAMPLER, samplers[i]);
+
+#ifdef GPUDEVICE_DEBUG_MODE
+    m_device.RegisterDrawItem(item);
+#endif
+    return item;
+}
+
+void GpuTraceReplay::AddID(int type, u32 recordedID, u32 id)
+{
+    std::vector<u32>& ids = m_ids[type];
+    std::vector<u32>& refCounts = m_idRefCounts[type];
+    u16 index = GetRawIndex(recordedID);
+    if (index >= ids.size()) {
+        ids.resize(index + 1, 0);
+        refCounts.resize(index + 1, 0);
+    }
+    ASSERT(ids[index] == 0 || ids[index] == id);
+    ids[index] = id;
+    ++refCounts[index];
+}
+
+u32 GpuTraceReplay::RemoveID(int type, u32 recordedID)
+{
+    u32 id = LookupID(type, recordedID);
+    u16 index = GetRawIndex(recordedID);
+    if (--m_idRefCounts[type][index] == 0)
+        m_ids[type][index] = 0;
+    return id;
+}
+
+u32 GpuTraceReplay::LookupID(int type, u32 recordedID) const
+{
+    // ID 0 is never a valid resource, and is used for optional parameters.
+    if (recordedID == 0)
+        return 0;
+    const std::vector<u32>& ids = m_ids[type];
+    u16 index = GetRawIndex(recordedID);
+    if (index >= ids.size() || ids[index] == 0)
+        FATAL("GpuTraceReplay: trace refers to a resource that wasn't created "
+              "in the trace");
+    return ids[index];
+}
+
+u16 GpuTraceReplay::LookupRawIndex(int type, u16 recordedRawIndex) const
+{
+    const std::vector<u32>& ids = m_ids[type];
+    if (recordedRawIndex >= ids.size() || ids[recordedRawIndex] == 0)
+        FATAL("GpuTraceReplay: draw item refers to a resource that wasn't "
+              "created in the trace");
+    return GetRawIndex(ids[recordedRawIndex]);
+}
+
+bool GpuTraceReplay::AtEnd() const
+{
+    return m_readPos >= m_trace.size();
+}
+
+u8 GpuTraceReplay::ReadU8()
+{
+    return *ReadBytes(sizeof(u8));
+}
+
+u32 GpuTraceReplay::ReadU32()
+{
+    u32 value;
+    memcpy(&value, ReadBytes(sizeof value), sizeof value);
+    return value;
+}
+
+float GpuTraceReplay::ReadFloat()
+{
+    float value;
+    memcpy(&value, ReadBytes(sizeof value), sizeof value);
+    return value;
+}
+
+const u8* GpuTraceReplay::ReadBlob(u32* size)
+{
+    *size = ReadU32();
+    return ReadBytes(*size);
+}
+
+const u8* GpuTraceReplay::ReadBytes(size_t size)
+{
+    if (size > m_trace.size() - m_readPos)
+        FATAL("GpuTraceReplay: trace is truncated");
+    const u8* bytes = m_trace.empty() ? NULL : &m_trace[m_readPos];
+    m_readPos += size;
+    return bytes;
+}
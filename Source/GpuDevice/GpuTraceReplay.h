@@ -0,0 +1,81 @@
+#ifndef GPUDEVICE_GPUTRACEREPLAY_H
+#define GPUDEVICE_GPUTRACEREPLAY_H
+
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class TaskPool;
+
+// Replays a trace recorded with GpuDevice::TraceCaptureBegin() into a
+// GpuDevice, which may use a different backend from the recording device.
+// Resources created by the replay are owned by the GpuTraceReplay and are
+// destroyed by Rewind() and by the destructor.
+class GpuTraceReplay {
+public:
+    explicit GpuTraceReplay(GpuDevice& device);
+    ~GpuTraceReplay();
+
+    // Loads a trace file and rewinds to its start. Returns false if the file
+    // can't be read or isn't a trace file of a supported version.
+    bool Load(const char* path);
+
+    // Replays the calls up to and including the next ScenePresent(). Draw
+    // calls that were recorded from DrawParallel() are replayed with
+    // DrawParallel() if a task pool is given, otherwise with Draw(). Returns
+    // false if the end of the trace was reached before a ScenePresent().
+    bool ReplayFrame(TaskPool* taskPool);
+
+    // Destroys all the resources created by the replay and returns to the
+    // start of the trace.
+    void Rewind();
+
+    // The number of frames replayed since the last rewind.
+    int GetFrameNumber() const;
+
+private:
+    static const int NUM_RESOURCE_TYPES = 8;
+
+    GpuTraceReplay(const GpuTraceReplay&);
+    GpuTraceReplay& operator=(const GpuTraceReplay&);
+
+    void ReplayCall(u8 op, TaskPool* taskPool);
+    void ReplayDraw(bool parallel, TaskPool* taskPool);
+    GpuDrawItem* RemapDrawItem(u64* memory);
+
+    void AddID(int type, u32 recordedID, u32 id);
+    u32 RemoveID(int type, u32 recordedID);
+    u32 LookupID(int type, u32 recordedID) const;
+    u16 LookupRawIndex(int type, u16 recordedRawIndex) const;
+
+    bool AtEnd() const;
+    u8 ReadU8();
+    u32 ReadU32();
+    float ReadFloat();
+    const u8* ReadBlob(u32* size);
+    const u8* ReadBytes(size_t size);
+
+    GpuDevice& m_device;
+    std::vector<u8> m_trace;
+    size_t m_readPos;
+    int m_frameNumber;
+
+    // For each resource type, maps the raw lookup table index of a recorded
+    // resource ID to the ID created by the replay (or 0 if there is none).
+    std::vector<u32> m_ids[NUM_RESOURCE_TYPES];
+    // The number of create calls that returned each ID, less the number of
+    // destroy calls. The device shares state objects with identical
+    // descriptions, so the same ID may be created more than once.
+    std::vector<u32> m_idRefCounts[NUM_RESOURCE_TYPES];
+    // The contents of each buffer as of its last update, by the raw lookup
+    // table index of the recorded ID. Updates only record the bytes that
+    // changed, but BufferMap() returns memory with undefined contents.
+    std::vector<std::vector<u8> > m_bufferContents;
+
+    // Scratch memory for the draw items of a Draw() call.
+    std::vector<u64> m_drawItemData;
+    std::vector<size_t> m_drawItemOffsets;
+    std::vector<const GpuDrawItem*> m_drawItems;
+};
+
+#endif // GPUDEVICE_GPUTRACEREPLAY_H
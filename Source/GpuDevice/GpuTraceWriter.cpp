@@ -0,0 +1,453 @@
+#include "GpuDevice/GpuTraceWriter.h"
+#include <string.h>
+#include "Core/Macros.h"
+#include "GpuDevice/GpuDrawItem.h"
+#include "GpuDevice/GpuTraceFormat.h"
+
+// Pending data is written to the file once it exceeds this size.
+const size_t FLUSH_THRESHOLD = 1024 * 1024;
+
+// Returns the number of bytes that TextureUpload() reads from its input.
+static u32 TextureUploadSize(GpuPixelFormat pixelFormat,
+                             const GpuRegion& region,
+                             int stride)
+{
+    u32 nRows;
+    u32 rowSize;
+    switch (pixelFormat) {
+        case GPU_PIXEL_FORMAT_DXT1:
+            nRows = (region.height + 3) / 4;
+            rowSize = ((region.width + 3) / 4) * 8;
+            break;
+        case GPU_PIXEL_FORMAT_DXT3:
+        case GPU_PIXEL_FORMAT_DXT5:
+            nRows = (region.height + 3) / 4;
+            rowSize = ((region.width + 3) / 4) * 16;
+            break;
+        default:
+            nRows = region.height;
+            rowSize = region.width * 4;
+            break;
+    }
+    if (nRows == 0)
+        return 0;
+    return (nRows - 1) * (u32)stride + rowSize;
+}
+
+GpuTraceWriter::GpuTraceWriter()
+    : m_file(NULL)
+    , m_pending()
+    , m_buffers()
+    , m_texturePixelFormats()
+    , m_timerQueries()
+{}
+
+GpuTraceWriter::~GpuTraceWriter()
+{
+    End();
+}
+
+bool GpuTraceWriter::Begin(const char* path)
+{
+    ASSERT(!m_file && "Trace recording has already begun");
+    if (!(m_file = fopen(path, "wb")))
+        return false;
+
+    GpuTraceHeader header;
+    memcpy(header.code, "GTRC", 4);
+    header.version = GPU_TRACE_VERSION;
+    WriteBytes(&header, sizeof header);
+    return true;
+}
+
+void GpuTraceWriter::End()
+{
+    if (!m_file)
+        return;
+    Flush();
+    fclose(m_file);
+    m_file = NULL;
+    m_buffers.clear();
+    m_texturePixelFormats.clear();
+    m_timerQueries.clear();
+}
+
+void GpuTraceWriter::SetFormat(const GpuDeviceFormat& format)
+{
+    WriteOp(GPU_TRACE_OP_SET_FORMAT);
+    WriteU32(format.pixelColorFormat);
+    WriteU32(format.pixelDepthFormat);
+    WriteU32(format.resolutionX);
+    WriteU32(format.resolutionY);
+    WriteU32(format.flags);
+}
+
+void GpuTraceWriter::OnWindowResized()
+{
+    WriteOp(GPU_TRACE_OP_WINDOW_RESIZED);
+}
+
+void GpuTraceWriter::ShaderProgramCreate(GpuShaderProgramID shaderProgramID,
+                                         const char* data,
+                                         size_t length)
+{
+    WriteOp(GPU_TRACE_OP_SHADER_PROGRAM_CREATE);
+    WriteU32(shaderProgramID);
+    WriteBlob(data, length);
+}
+
+void GpuTraceWriter::ShaderProgramDestroy(GpuShaderProgramID shaderProgramID)
+{
+    WriteOp(GPU_TRACE_OP_SHADER_PROGRAM_DESTROY);
+    WriteU32(shaderProgramID);
+}
+
+void GpuTraceWriter::BufferCreate(GpuBufferID bufferID,
+                                  GpuBufferType type,
+                                  GpuBufferAccessMode accessMode,
+                                  const void* data,
+                                  unsigned size,
+                                  int maxUpdatesPerFrame)
+{
+    WriteOp(GPU_TRACE_OP_BUFFER_CREATE);
+    WriteU32(bufferID);
+    WriteU32(type);
+    WriteU32(accessMode);
+    WriteU32(size);
+    WriteU32((u32)maxUpdatesPerFrame);
+    WriteBlob(data, data ? size : 0);
+
+    BufferInfo& info = m_buffers[bufferID];
+    info.size = size;
+    info.mappedMemory = NULL;
+    // Static-mode buffers can't be mapped, so their contents aren't needed.
+    info.contents.clear();
+    if (accessMode != GPU_BUFFER_ACCESS_STATIC) {
+        info.contents.resize(size, 0);
+        if (data && size > 0)
+            memcpy(&info.contents[0], data, size);
+    }
+}
+
+void GpuTraceWriter::BufferDestroy(GpuBufferID bufferID)
+{
+    WriteOp(GPU_TRACE_OP_BUFFER_DESTROY);
+    WriteU32(bufferID);
+    m_buffers.erase(bufferID);
+}
+
+void GpuTraceWriter::BufferStreamResize(GpuBufferID bufferID, unsigned newSize)
+{
+    WriteOp(GPU_TRACE_OP_BUFFER_STREAM_RESIZE);
+    WriteU32(bufferID);
+    WriteU32(newSize);
+
+    std::map<u32, BufferInfo>::iterator it = m_buffers.find(bufferID);
+    if (it != m_buffers.end()) {
+        it->second.size = newSize;
+        it->second.contents.resize(newSize, 0);
+    }
+}
+
+void GpuTraceWriter::BufferMap(GpuBufferID bufferID, void* memory)
+{
+    std::map<u32, BufferInfo>::iterator it = m_buffers.find(bufferID);
+    if (it != m_buffers.end())
+        it->second.mappedMemory = memory;
+}
+
+void GpuTraceWriter::BufferUnmap(GpuBufferID bufferID)
+{
+    // The client may have written anywhere in the buffer, but usually only
+    // changes part of it, so only the range from the first to the last byte
+    // that differs from the previous update is recorded.
+    std::map<u32, BufferInfo>::iterator it = m_buffers.find(bufferID);
+    if (it == m_buffers.end() || !it->second.mappedMemory)
+        return;
+
+    BufferInfo& info = it->second;
+    const u8* memory = (const u8*)info.mappedMemory;
+    u32 begin = 0;
+    while (begin < info.size && memory[begin] == info.contents[begin])
+        ++begin;
+    u32 end = info.size;
+    while (end > begin && memory[end - 1] == info.contents[end - 1])
+        --end;
+    if (begin < end)
+        memcpy(&info.contents[begin], memory + begin, end - begin);
+
+    WriteOp(GPU_TRACE_OP_BUFFER_UPDATE);
+    WriteU32(bufferID);
+    WriteU32(begin);
+    WriteBlob(memory + begin, end - begin);
+    info.mappedMemory = NULL;
+}
+
+void GpuTraceWriter::BufferUpload(GpuBufferID bufferID,
+                                  unsigned offset,
+                                  const void* data,
+                                  unsigned size)
+{
+    WriteOp(GPU_TRACE_OP_BUFFER_UPLOAD);
+    WriteU32(bufferID);
+    WriteU32(offset);
+    WriteBlob(data, size);
+}
+
+void GpuTraceWriter::TextureCreate(GpuTextureID textureID,
+                                   GpuTextureType type,
+                                   GpuPixelFormat pixelFormat,
+                                   u32 flags,
+                                   int width,
+                                   int height,
+                                   int depthOrArrayLength,
+                                   int nMipmapLevels)
+{
+    WriteOp(GPU_TRACE_OP_TEXTURE_CREATE);
+    WriteU32(textureID);
+    WriteU32(type);
+    WriteU32(pixelFormat);
+    WriteU32(flags);
+    WriteU32((u32)width);
+    WriteU32((u32)height);
+    WriteU32((u32)depthOrArrayLength);
+    WriteU32((u32)nMipmapLevels);
+
+    m_texturePixelFormats[textureID] = pixelFormat;
+}
+
+void GpuTraceWriter::TextureDestroy(GpuTextureID textureID)
+{
+    WriteOp(GPU_TRACE_OP_TEXTURE_DESTROY);
+    WriteU32(textureID);
+    m_texturePixelFormats.erase(textureID);
+}
+
+void GpuTraceWriter::TextureUpload(GpuTextureID textureID,
+                                   int slice,
+                                   const GpuRegion& region,
+                                   int mipmapLevel,
+                                   int stride,
+                                   const void* bytes)
+{
+    std::map<u32, GpuPixelFormat>::iterator it = m_texturePixelFormats.find(textureID);
+    if (it == m_texturePixelFormats.end())
+        return;
+
+    WriteOp(GPU_TRACE_OP_TEXTURE_UPLOAD);
+    WriteU32(textureID);
+    WriteU32((u32)slice);
+    WriteU32((u32)region.x);
+    WriteU32((u32)region.y);
+    WriteU32((u32)region.width);
+    WriteU32((u32)region.height);
+    WriteU32((u32)mipmapLevel);
+    WriteU32((u32)stride);
+    WriteBlob(bytes, TextureUploadSize(it->second, region, stride));
+}
+
+void GpuTraceWriter::SamplerCreate(GpuSamplerID samplerID, const GpuSamplerDesc& desc)
+{
+    WriteOp(GPU_TRACE_OP_SAMPLER_CREATE);
+    WriteU32(samplerID);
+    WriteU32(desc.uAddressMode);
+    WriteU32(desc.vAddressMode);
+    WriteU32(desc.wAddressMode);
+    WriteU32(desc.minFilter);
+    WriteU32(desc.magFilter);
+    WriteU32(desc.mipFilter);
+    WriteU32((u32)desc.maxAnisotropy);
+}
+
+void GpuTraceWriter::SamplerDestroy(GpuSamplerID samplerID)
+{
+    WriteOp(GPU_TRACE_OP_SAMPLER_DESTROY);
+    WriteU32(samplerID);
+}
+
+void GpuTraceWriter::InputLayoutCreate(GpuInputLayoutID inputLayoutID,
+                                       int nVertexAttribs,
+                                       const GpuVertexAttribute* attribs,
+                                       int nVertexBuffers,
+                                       const unsigned* strides)
+{
+    WriteOp(GPU_TRACE_OP_INPUT_LAYOUT_CREATE);
+    WriteU32(inputLayoutID);
+    WriteU32((u32)nVertexAttribs);
+    for (int i = 0; i < nVertexAttribs; ++i) {
+        WriteU32(attribs[i].format);
+        WriteU32(attribs[i].offset);
+        WriteU32((u32)attribs[i].bufferSlot);
+    }
+    WriteU32((u32)nVertexBuffers);
+    for (int i = 0; i < nVertexBuffers; ++i)
+        WriteU32(strides[i]);
+}
+
+void GpuTraceWriter::InputLayoutDestroy(GpuInputLayoutID inputLayoutID)
+{
+    WriteOp(GPU_TRACE_OP_INPUT_LAYOUT_DESTROY);
+    WriteU32(inputLayoutID);
+}
+
+void GpuTraceWriter::PipelineStateCreate(GpuPipelineStateID pipelineStateID,
+                                         const GpuPipelineStateDesc& state)
+{
+    WriteOp(GPU_TRACE_OP_PIPELINE_STATE_CREATE);
+    WriteU32(pipelineStateID);
+    WriteU32(state.shaderProgram);
+    WriteU32(state.shaderStateBitfield);
+    WriteU32(state.inputLayout);
+    WriteU32(state.depthCompare);
+    WriteU32(state.depthWritesEnabled ? 1 : 0);
+    WriteU32(state.fillMode);
+    WriteU32(state.cullMode);
+    WriteU32(state.frontFaceWinding);
+    WriteU32(state.blendingEnabled ? 1 : 0);
+    WriteU32(state.blendSrcFactor);
+    WriteU32(state.blendDstFactor);
+}
+
+void GpuTraceWriter::PipelineStateDestroy(GpuPipelineStateID pipelineStateID)
+{
+    WriteOp(GPU_TRACE_OP_PIPELINE_STATE_DESTROY);
+    WriteU32(pipelineStateID);
+}
+
+void GpuTraceWriter::RenderPassCreate(GpuRenderPassID renderPassID,
+                                      const GpuRenderPassDesc& pass)
+{
+    WriteOp(GPU_TRACE_OP_RENDER_PASS_CREATE);
+    WriteU32(renderPassID);
+    WriteU32((u32)pass.numRenderTargets);
+    for (int i = 0; i < pass.numRenderTargets; ++i)
+        WriteU32(pass.renderTargets[i]);
+
+    // Each of the optional arrays is preceded by 1 if it's present, else 0.
+    int nColorTargets = pass.numRenderTargets > 0 ? pass.numRenderTargets : 1;
+    WriteU32(pass.clearColors ? 1 : 0);
+    for (int i = 0; pass.clearColors && i < nColorTargets; ++i) {
+        WriteFloat(pass.clearColors[i].r);
+        WriteFloat(pass.clearColors[i].g);
+        WriteFloat(pass.clearColors[i].b);
+        WriteFloat(pass.clearColors[i].a);
+    }
+    WriteU32(pass.colorLoadActions ? 1 : 0);
+    for (int i = 0; pass.colorLoadActions && i < nColorTargets; ++i)
+        WriteU32(pass.colorLoadActions[i]);
+    WriteU32(pass.colorStoreActions ? 1 : 0);
+    for (int i = 0; pass.colorStoreActions && i < nColorTargets; ++i)
+        WriteU32(pass.colorStoreActions[i]);
+
+    WriteU32(pass.depthStencilTarget);
+    WriteFloat(pass.clearDepth);
+    WriteU32(pass.depthStencilLoadAction);
+    WriteU32(pass.depthStencilStoreAction);
+}
+
+void GpuTraceWriter::RenderPassDestroy(GpuRenderPassID renderPassID)
+{
+    WriteOp(GPU_TRACE_OP_RENDER_PASS_DESTROY);
+    WriteU32(renderPassID);
+}
+
+void GpuTraceWriter::Draw(const GpuDrawItem* const* items,
+                          int nItems,
+                          GpuRenderPassID renderPass,
+                          const GpuViewport& viewport,
+                          bool parallel)
+{
+    WriteOp(parallel ? GPU_TRACE_OP_DRAW_PARALLEL : GPU_TRACE_OP_DRAW);
+    WriteU32(renderPass);
+    WriteU32(viewport.x);
+    WriteU32(viewport.y);
+    WriteU32(viewport.width);
+    WriteU32(viewport.height);
+    WriteFloat(viewport.zNear);
+    WriteFloat(viewport.zFar);
+    WriteU32((u32)nItems);
+    for (int i = 0; i < nItems; ++i)
+        WriteBlob(items[i], items[i]->SizeInBytes());
+}
+
+void GpuTraceWriter::SceneBegin()
+{
+    WriteOp(GPU_TRACE_OP_SCENE_BEGIN);
+}
+
+void GpuTraceWriter::ScenePresent()
+{
+    WriteOp(GPU_TRACE_OP_SCENE_PRESENT);
+    Flush();
+}
+
+void GpuTraceWriter::TimerQueryCreate(GpuTimerQueryID queryID)
+{
+    WriteOp(GPU_TRACE_OP_TIMER_QUERY_CREATE);
+    WriteU32(queryID);
+    m_timerQueries.insert(queryID);
+}
+
+void GpuTraceWriter::TimerQueryDestroy(GpuTimerQueryID queryID)
+{
+    if (!m_timerQueries.erase(queryID))
+        return;
+    WriteOp(GPU_TRACE_OP_TIMER_QUERY_DESTROY);
+    WriteU32(queryID);
+}
+
+void GpuTraceWriter::TimerQueryBegin(GpuTimerQueryID queryID)
+{
+    if (!m_timerQueries.count(queryID))
+        return;
+    WriteOp(GPU_TRACE_OP_TIMER_QUERY_BEGIN);
+    WriteU32(queryID);
+}
+
+void GpuTraceWriter::TimerQueryEnd(GpuTimerQueryID queryID)
+{
+    if (!m_timerQueries.count(queryID))
+        return;
+    WriteOp(GPU_TRACE_OP_TIMER_QUERY_END);
+    WriteU32(queryID);
+}
+
+void GpuTraceWriter::WriteOp(u8 op)
+{
+    WriteBytes(&op, sizeof op);
+}
+
+void GpuTraceWriter::WriteU32(u32 value)
+{
+    WriteBytes(&value, sizeof value);
+}
+
+void GpuTraceWriter::WriteFloat(float value)
+{
+    WriteBytes(&value, sizeof value);
+}
+
+void GpuTraceWriter::WriteBytes(const void* bytes, size_t size)
+{
+    const u8* begin = (const u8*)bytes;
+    m_pending.insert(m_pending.end(), begin, begin + size);
+    if (m_pending.size() >= FLUSH_THRESHOLD)
+        Flush();
+}
+
+void GpuTraceWriter::WriteBlob(const void* bytes, size_t size)
+{
+    ASSERT(size <= 0xFFFFFFFF);
+    WriteU32((u32)size);
+    if (size > 0)
+        WriteBytes(bytes, size);
+}
+
+void GpuTraceWriter::Flush()
+{
+    if (m_pending.empty())
+        return;
+    if (fwrite(&m_pending[0], 1, m_pending.size(), m_file) != m_pending.size())
+        FATAL("GpuTraceWriter: failed to write to the trace file");
+    m_pending.clear();
+}
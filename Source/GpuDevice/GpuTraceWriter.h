@@ -0,0 +1,137 @@
+/******************************************************************************
+ *
+ *   GpuTraceWriter.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuTraceWriter serializes GpuDevice calls into a trace file (see
+ *   GpuTraceFormat.h). Each backend owns one, and its GpuDevice forwarding
+ *   functions pass every call to it after forwarding the call itself, so the
+ *   IDs returned by the backend can be recorded.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUTRACEWRITER_H
+#define GPUDEVICE_GPUTRACEWRITER_H
+
+#include <stdio.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class GpuTraceWriter {
+public:
+    GpuTraceWriter();
+    ~GpuTraceWriter();
+
+    bool Begin(const char* path);
+    void End();
+    bool IsRecording() const { return m_file != NULL; }
+
+    void SetFormat(const GpuDeviceFormat& format);
+    void OnWindowResized();
+
+    void ShaderProgramCreate(GpuShaderProgramID shaderProgramID,
+                             const char* data,
+                             size_t length);
+    void ShaderProgramDestroy(GpuShaderProgramID shaderProgramID);
+
+    void BufferCreate(GpuBufferID bufferID,
+                      GpuBufferType type,
+                      GpuBufferAccessMode accessMode,
+                      const void* data,
+                      unsigned size,
+                      int maxUpdatesPerFrame);
+    void BufferDestroy(GpuBufferID bufferID);
+    void BufferStreamResize(GpuBufferID bufferID, unsigned newSize);
+    void BufferMap(GpuBufferID bufferID, void* memory);
+    void BufferUnmap(GpuBufferID bufferID);
+    void BufferUpload(GpuBufferID bufferID,
+                      unsigned offset,
+                      const void* data,
+                      unsigned size);
+
+    void TextureCreate(GpuTextureID textureID,
+                       GpuTextureType type,
+                       GpuPixelFormat pixelFormat,
+                       u32 flags,
+                       int width,
+                       int height,
+                       int depthOrArrayLength,
+                       int nMipmapLevels);
+    void TextureDestroy(GpuTextureID textureID);
+    void TextureUpload(GpuTextureID textureID,
+                       int slice,
+                       const GpuRegion& region,
+                       int mipmapLevel,
+                       int stride,
+                       const void* bytes);
+
+    void SamplerCreate(GpuSamplerID samplerID, const GpuSamplerDesc& desc);
+    void SamplerDestroy(GpuSamplerID samplerID);
+
+    void InputLayoutCreate(GpuInputLayoutID inputLayoutID,
+                           int nVertexAttribs,
+                           const GpuVertexAttribute* attribs,
+                           int nVertexBuffers,
+                           const unsigned* strides);
+    void InputLayoutDestroy(GpuInputLayoutID inputLayoutID);
+
+    void PipelineStateCreate(GpuPipelineStateID pipelineStateID,
+                             const GpuPipelineStateDesc& state);
+    void PipelineStateDestroy(GpuPipelineStateID pipelineStateID);
+
+    void RenderPassCreate(GpuRenderPassID renderPassID, const GpuRenderPassDesc& pass);
+    void RenderPassDestroy(GpuRenderPassID renderPassID);
+
+    void Draw(const GpuDrawItem* const* items,
+              int nItems,
+              GpuRenderPassID renderPass,
+              const GpuViewport& viewport,
+              bool parallel);
+
+    void SceneBegin();
+    void ScenePresent();
+
+    void TimerQueryCreate(GpuTimerQueryID queryID);
+    void TimerQueryDestroy(GpuTimerQueryID queryID);
+    void TimerQueryBegin(GpuTimerQueryID queryID);
+    void TimerQueryEnd(GpuTimerQueryID queryID);
+
+private:
+    GpuTraceWriter(const GpuTraceWriter&);
+    GpuTraceWriter& operator=(const GpuTraceWriter&);
+
+    struct BufferInfo {
+        u32 size;
+        void* mappedMemory;
+        // The contents as of the last recorded update, which the contents at
+        // the next BufferUnmap() are compared against.
+        std::vector<u8> contents;
+    };
+
+    void WriteOp(u8 op);
+    void WriteU32(u32 value);
+    void WriteFloat(float value);
+    void WriteBytes(const void* bytes, size_t size);
+    void WriteBlob(const void* bytes, size_t size);
+    void Flush();
+
+    FILE* m_file;
+    std::vector<u8> m_pending;
+
+    // Keyed by the resource ID. Calls on resources that were created before
+    // recording began aren't known here, and so aren't recorded.
+    std::map<u32, BufferInfo> m_buffers;
+    std::map<u32, GpuPixelFormat> m_texturePixelFormats;
+    std::set<u32> m_timerQueries;
+};
+
+#endif // GPUDEVICE_GPUTRACEWRITER_H
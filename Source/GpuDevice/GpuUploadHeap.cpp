@@ -0,0 +1,319 @@
+#include "GpuDevice/GpuUploadHeap.h"
+#include "Core/Macros.h"
+
+// Free pages that haven't been used for this many frames are destroyed.
+const u64 PAGE_IDLE_FRAMES = 120;
+
+// Persistent allocations are made in multiples of the block size, from pages
+// of (a multiple of) the persistent page size.
+const u32 PERSISTENT_BLOCK_SIZE = 256;
+const u32 PERSISTENT_PAGE_SIZE = 64 * 1024;
+
+static u32 RoundUp(u32 value, u32 multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+GpuUploadHeap::GpuUploadHeap(u32 pageSize,
+                             PFnPageCreate pageCreate,
+                             PFnPageDestroy pageDestroy,
+                             void* userdata)
+    : m_pageSize(pageSize)
+    , m_pageCreate(pageCreate)
+    , m_pageDestroy(pageDestroy)
+    , m_userdata(userdata)
+    , m_frame(1)
+    , m_pages()
+    , m_unusedPageSlots()
+    , m_freePages()
+    , m_retiringPages()
+    , m_framePages()
+    , m_persistentPages()
+    , m_pendingFrees()
+    , m_frameBytesUsed(0)
+    , m_stats()
+{
+    ASSERT(pageSize > 0);
+    ASSERT(pageCreate != NULL);
+    ASSERT(pageDestroy != NULL);
+
+    m_stats.frameBytesUsed = 0;
+    m_stats.peakFrameBytesUsed = 0;
+    m_stats.nPages = 0;
+    m_stats.nPageBytes = 0;
+    m_stats.peakPageBytes = 0;
+}
+
+GpuUploadHeap::~GpuUploadHeap()
+{
+    for (u32 i = 0; i < (u32)m_pages.size(); ++i) {
+        if (m_pages[i].handle != NULL)
+            DestroyPage(i);
+    }
+}
+
+void GpuUploadHeap::Reclaim(u64 completedFrame)
+{
+    size_t nRetiring = 0;
+    for (size_t i = 0; i < m_retiringPages.size(); ++i) {
+        u32 index = m_retiringPages[i];
+        Page& page = m_pages[index];
+        if (page.lastFrame > completedFrame) {
+            m_retiringPages[nRetiring++] = index;
+        } else if (page.size != m_pageSize) {
+            // Only pages of the standard size are kept for reuse.
+            DestroyPage(index);
+        } else {
+            page.cursor = 0;
+            m_freePages.push_back(index);
+        }
+    }
+    m_retiringPages.resize(nRetiring);
+
+    // The least recently used pages are at the bottom of the stack.
+    size_t nIdle = 0;
+    while (nIdle < m_freePages.size() &&
+           m_pages[m_freePages[nIdle]].lastFrame + PAGE_IDLE_FRAMES < m_frame) {
+        DestroyPage(m_freePages[nIdle]);
+        ++nIdle;
+    }
+    m_freePages.erase(m_freePages.begin(), m_freePages.begin() + nIdle);
+
+    size_t nPending = 0;
+    for (size_t i = 0; i < m_pendingFrees.size(); ++i) {
+        if (m_pendingFrees[i].frame > completedFrame)
+            m_pendingFrees[nPending++] = m_pendingFrees[i];
+        else
+            FreeBlock(m_pendingFrees[i].allocation);
+    }
+    m_pendingFrees.resize(nPending);
+
+    size_t nPersistent = 0;
+    for (size_t i = 0; i < m_persistentPages.size(); ++i) {
+        u32 index = m_persistentPages[i];
+        const Page& page = m_pages[index];
+        if (page.cursor == 0 && page.lastFrame + PAGE_IDLE_FRAMES < m_frame)
+            DestroyPage(index);
+        else
+            m_persistentPages[nPersistent++] = index;
+    }
+    m_persistentPages.resize(nPersistent);
+}
+
+void GpuUploadHeap::EndFrame()
+{
+    for (size_t i = 0; i < m_framePages.size(); ++i) {
+        u32 index = m_framePages[i];
+        m_pages[index].lastFrame = m_frame;
+        m_retiringPages.push_back(index);
+    }
+    m_framePages.clear();
+
+    m_stats.frameBytesUsed = m_frameBytesUsed;
+    if (m_stats.peakFrameBytesUsed < m_frameBytesUsed)
+        m_stats.peakFrameBytesUsed = m_frameBytesUsed;
+    m_frameBytesUsed = 0;
+
+    ++m_frame;
+}
+
+void* GpuUploadHeap::Allocate(u32 size, u32 alignment, GpuUploadAllocation* allocation)
+{
+    ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    ASSERT(allocation != NULL);
+
+    u32 offset = 0;
+    bool fits = false;
+    if (!m_framePages.empty()) {
+        const Page& page = m_pages[m_framePages.back()];
+        offset = (page.cursor + alignment - 1) & ~(alignment - 1);
+        fits = offset <= page.size && size <= page.size - offset;
+    }
+    if (!fits) {
+        m_framePages.push_back(AcquirePage(size));
+        offset = 0;
+    }
+
+    u32 index = m_framePages.back();
+    Page& page = m_pages[index];
+    m_frameBytesUsed += offset + size - page.cursor;
+    page.cursor = offset + size;
+
+    allocation->page = index;
+    allocation->offset = offset;
+    allocation->size = size;
+    return page.cpuAddress + offset;
+}
+
+void* GpuUploadHeap::AllocatePersistent(u32 size, u32 alignment, GpuUploadAllocation* allocation)
+{
+    ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    ASSERT(alignment <= PERSISTENT_BLOCK_SIZE);
+    ASSERT(allocation != NULL);
+
+    u32 blockSize = RoundUp(size > 0 ? size : 1, PERSISTENT_BLOCK_SIZE);
+    u32 newPageSize = RoundUp(blockSize, PERSISTENT_PAGE_SIZE);
+
+    // First fit, over the pages in the order that they were created.
+    u32 index = 0;
+    u32 offset = 0;
+    bool found = false;
+    for (size_t i = 0; i < m_persistentPages.size() && !found; ++i) {
+        Page& page = m_pages[m_persistentPages[i]];
+        // An empty page that's larger than the allocation needs is left for
+        // a larger allocation (such as the next update of the buffer that
+        // emptied it), rather than being kept alive by a small one.
+        if (page.cursor == 0 && page.size > newPageSize)
+            continue;
+
+        std::vector<Block>& blocks = page.freeBlocks;
+        for (size_t j = 0; j < blocks.size(); ++j) {
+            if (blocks[j].size >= blockSize) {
+                index = m_persistentPages[i];
+                offset = blocks[j].offset;
+                blocks[j].offset += blockSize;
+                blocks[j].size -= blockSize;
+                if (blocks[j].size == 0)
+                    blocks.erase(blocks.begin() + j);
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!found) {
+        index = CreatePage(newPageSize);
+        offset = 0;
+        if (blockSize < newPageSize) {
+            Block block;
+            block.offset = blockSize;
+            block.size = newPageSize - blockSize;
+            m_pages[index].freeBlocks.push_back(block);
+        }
+        m_persistentPages.push_back(index);
+    }
+
+    Page& page = m_pages[index];
+    page.cursor += blockSize;
+    page.lastFrame = m_frame;
+
+    allocation->page = index;
+    allocation->offset = offset;
+    allocation->size = blockSize;
+    return page.cpuAddress + offset;
+}
+
+void GpuUploadHeap::FreePersistent(const GpuUploadAllocation& allocation)
+{
+    ASSERT(m_pages[allocation.page].handle != NULL);
+    ASSERT(m_pages[allocation.page].cursor >= allocation.size);
+
+    PendingFree pending;
+    pending.allocation = allocation;
+    pending.frame = m_frame;
+    m_pendingFrees.push_back(pending);
+}
+
+void* GpuUploadHeap::GetPage(const GpuUploadAllocation& allocation) const
+{
+    return m_pages[allocation.page].handle;
+}
+
+void* GpuUploadHeap::GetCpuAddress(const GpuUploadAllocation& allocation) const
+{
+    return m_pages[allocation.page].cpuAddress + allocation.offset;
+}
+
+const GpuUploadHeapStats& GpuUploadHeap::GetStats() const
+{
+    return m_stats;
+}
+
+u32 GpuUploadHeap::AcquirePage(u32 minSize)
+{
+    if (minSize <= m_pageSize && !m_freePages.empty()) {
+        u32 index = m_freePages.back();
+        m_freePages.pop_back();
+        return index;
+    }
+
+    return CreatePage(minSize > m_pageSize ? minSize : m_pageSize);
+}
+
+u32 GpuUploadHeap::CreatePage(u32 size)
+{
+    u32 index;
+    if (!m_unusedPageSlots.empty()) {
+        index = m_unusedPageSlots.back();
+        m_unusedPageSlots.pop_back();
+    } else {
+        index = (u32)m_pages.size();
+        m_pages.push_back(Page());
+    }
+
+    Page& page = m_pages[index];
+    void* cpuAddress = NULL;
+    page.handle = m_pageCreate(size, &cpuAddress, m_userdata);
+    if (page.handle == NULL)
+        FATAL("GpuUploadHeap: failed to create a page of %u bytes", size);
+    page.cpuAddress = (u8*)cpuAddress;
+    page.size = size;
+    page.cursor = 0;
+    page.lastFrame = m_frame;
+    page.freeBlocks.clear();
+
+    ++m_stats.nPages;
+    m_stats.nPageBytes += size;
+    if (m_stats.peakPageBytes < m_stats.nPageBytes)
+        m_stats.peakPageBytes = m_stats.nPageBytes;
+
+    return index;
+}
+
+void GpuUploadHeap::DestroyPage(u32 index)
+{
+    Page& page = m_pages[index];
+    m_pageDestroy(page.handle, page.size, m_userdata);
+
+    --m_stats.nPages;
+    m_stats.nPageBytes -= page.size;
+
+    page.handle = NULL;
+    page.cpuAddress = NULL;
+    page.freeBlocks.clear();
+    m_unusedPageSlots.push_back(index);
+}
+
+void GpuUploadHeap::FreeBlock(const GpuUploadAllocation& allocation)
+{
+    Page& page = m_pages[allocation.page];
+    std::vector<Block>& blocks = page.freeBlocks;
+
+    // Insert the block in offset order, merging it with its neighbours.
+    size_t next = 0;
+    while (next < blocks.size() && blocks[next].offset < allocation.offset)
+        ++next;
+    bool mergePrev = next > 0 &&
+        blocks[next - 1].offset + blocks[next - 1].size == allocation.offset;
+    bool mergeNext = next < blocks.size() &&
+        allocation.offset + allocation.size == blocks[next].offset;
+
+    if (mergePrev && mergeNext) {
+        blocks[next - 1].size += allocation.size + blocks[next].size;
+        blocks.erase(blocks.begin() + next);
+    } else if (mergePrev) {
+        blocks[next - 1].size += allocation.size;
+    } else if (mergeNext) {
+        blocks[next].offset = allocation.offset;
+        blocks[next].size += allocation.size;
+    } else {
+        Block block;
+        block.offset = allocation.offset;
+        block.size = allocation.size;
+        blocks.insert(blocks.begin() + next, block);
+    }
+
+    page.cursor -= allocation.size;
+    // Start the page's idle time from when it became empty.
+    if (page.cursor == 0)
+        page.lastFrame = m_frame;
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+ *
+ *   GpuUploadHeap.h
+ *
+ ***/
+
+/******************************************************************************
+ *
+ *   This file is private to the GpuDevice module.
+ *   Do NOT use this file in client code.
+ *
+ *   GpuUploadHeap is a paged, per-frame linear allocator for data that the
+ *   CPU writes for the GPU to read: the contents of stream-mode buffers and
+ *   the updates of dynamic-mode buffers.
+ *
+ *   Each frame allocates linearly from pages that it takes from the free list,
+ *   creating new pages when the free list is empty, so the heap grows to fit
+ *   the frame. Once the GPU has finished the frame, its pages go back on the
+ *   free list. Pages that stay on the free list for a long time are
+ *   destroyed, so the heap also shrinks after a burst of uploads.
+ *
+ *   An allocation from Allocate() lives only until the end of its frame. The
+ *   contents of dynamic-mode buffers persist across frames until the buffer
+ *   is next updated, so they're allocated with AllocatePersistent() instead.
+ *   Persistent allocations come from a separate set of smaller pages, which
+ *   are managed with free lists, and they stay valid until FreePersistent()
+ *   is called and the GPU has finished the frame that called it. This keeps
+ *   a small, rarely updated buffer from holding on to a whole frame page.
+ *
+ *   The pages themselves are created and destroyed by the backend, through
+ *   callbacks.
+ *
+ ***/
+
+#ifndef GPUDEVICE_GPUUPLOADHEAP_H
+#define GPUDEVICE_GPUUPLOADHEAP_H
+
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+struct GpuUploadAllocation {
+    u32 page;
+    u32 offset;
+    u32 size;
+};
+
+class GpuUploadHeap {
+public:
+    // Returns the backend's handle for a new page of the given size, and
+    // stores a pointer to the page's memory in cpuAddress.
+    typedef void* (*PFnPageCreate)(u32 size, void** cpuAddress, void* userdata);
+    typedef void (*PFnPageDestroy)(void* page, u32 size, void* userdata);
+
+    GpuUploadHeap(u32 pageSize,
+                  PFnPageCreate pageCreate,
+                  PFnPageDestroy pageDestroy,
+                  void* userdata);
+    // The GPU must have finished with all the pages.
+    ~GpuUploadHeap();
+
+    // Returns the pages of the frames up to and including completedFrame to
+    // the free list, and frees the persistent allocations that were freed by
+    // those frames. Called at the start of each frame.
+    void Reclaim(u64 completedFrame);
+    // Called when the frame is submitted. Subsequent allocations belong to
+    // the next frame.
+    void EndFrame();
+
+    // The alignment must be a power of two. An allocation larger than the page
+    // size is given a page of its own.
+    void* Allocate(u32 size, u32 alignment, GpuUploadAllocation* allocation);
+
+    // The alignment must be a power of two, no larger than 256 bytes.
+    void* AllocatePersistent(u32 size, u32 alignment, GpuUploadAllocation* allocation);
+    // The allocation may still be read by the GPU until the current frame
+    // has completed, so its memory is only reused after that.
+    void FreePersistent(const GpuUploadAllocation& allocation);
+
+    void* GetPage(const GpuUploadAllocation& allocation) const;
+    void* GetCpuAddress(const GpuUploadAllocation& allocation) const;
+
+    const GpuUploadHeapStats& GetStats() const;
+
+private:
+    GpuUploadHeap(const GpuUploadHeap&);
+    GpuUploadHeap& operator=(const GpuUploadHeap&);
+
+    struct Block {
+        u32 offset;
+        u32 size;
+    };
+
+    struct Page {
+        void* handle;
+        u8* cpuAddress;
+        u32 size;
+        // Frame pages: the end of the allocations so far.
+        // Persistent pages: the number of bytes allocated.
+        u32 cursor;
+        // Frame pages: the last frame that may read from the page.
+        // Persistent pages: the last frame that allocated from the page, or
+        // that emptied it.
+        u64 lastFrame;
+        // Persistent pages only: the unallocated ranges, sorted by offset.
+        std::vector<Block> freeBlocks;
+    };
+
+    struct PendingFree {
+        GpuUploadAllocation allocation;
+        u64 frame;
+    };
+
+    u32 AcquirePage(u32 minSize);
+    u32 CreatePage(u32 size);
+    void DestroyPage(u32 page);
+    void FreeBlock(const GpuUploadAllocation& allocation);
+
+    u32 m_pageSize;
+    PFnPageCreate m_pageCreate;
+    PFnPageDestroy m_pageDestroy;
+    void* m_userdata;
+
+    u64 m_frame;
+
+    std::vector<Page> m_pages;
+    // Indices of the unused entries of m_pages.
+    std::vector<u32> m_unusedPageSlots;
+    // Used as a stack, so that recently used pages are reused first and the
+    // pages at the bottom of the stack can be destroyed once they've been
+    // idle for long enough.
+    std::vector<u32> m_freePages;
+    // Pages of submitted frames that the GPU may still be reading.
+    std::vector<u32> m_retiringPages;
+    // Pages allocated from by the current frame. The last one is the page
+    // that allocations are currently made from.
+    std::vector<u32> m_framePages;
+    // Pages that persistent allocations are made from, including empty ones
+    // that are kept for reuse until they've been idle for long enough.
+    std::vector<u32> m_persistentPages;
+    // Persistent allocations that are freed once their frame has completed.
+    std::vector<PendingFree> m_pendingFrees;
+
+    u32 m_frameBytesUsed;
+    GpuUploadHeapStats m_stats;
+};
+
+#endif // GPUDEVICE_GPUUPLOADHEAP_H
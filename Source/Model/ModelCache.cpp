@@ -27,6 +27,7 @@ ModelCache::~ModelCache()
 
 ModelShared* ModelCache::Get(
     GpuDevice& device,
+    ModelGeometryPool& geometryPool,
     TextureCache& textureCache,
     FileLoader& loader,
     const char* path
@@ -38,7 +39,13 @@ ModelShared* ModelCache::Get(
     if (ModelShared* const* ppShared = m_hash.Get(key, GetSharedKey()))
         return *ppShared;
 
-    ModelShared* shared = ModelShared::Create(device, textureCache, loader, path);
+    ModelShared* shared = ModelShared::Create(
+        device,
+        geometryPool,
+        textureCache,
+        loader,
+        path
+    );
 
     m_list.InsertTail(shared);
     m_hash.Insert(shared, GetSharedKey());
@@ -48,6 +55,7 @@ ModelShared* ModelCache::Get(
 
 void ModelCache::Reload(
     GpuDevice& device,
+    ModelGeometryPool& geometryPool,
     TextureCache& textureCache,
     FileLoader& loader,
     const char* path
@@ -62,7 +70,13 @@ void ModelCache::Reload(
 
     ModelShared* shared = *ppShared;
 
-    ModelShared* successor = ModelShared::Create(device, textureCache, loader, path);
+    ModelShared* successor = ModelShared::Create(
+        device,
+        geometryPool,
+        textureCache,
+        loader,
+        path
+    );
 
     ModelInstance* instance = shared->GetFirstInstance();
     for ( ; instance; instance = instance->NextInAssetGroup()) {
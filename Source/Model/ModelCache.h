@@ -6,6 +6,7 @@
 #include "Model/ModelShared.h"
 
 class GpuDevice;
+class ModelGeometryPool;
 class FileLoader;
 class TextureCache;
 class ModelShared;
@@ -17,12 +18,14 @@ public:
 
     ModelShared* Get(
         GpuDevice& device,
+        ModelGeometryPool& geometryPool,
         TextureCache& textureCache,
         FileLoader& loader,
         const char* path
     );
     void Reload(
         GpuDevice& device,
+        ModelGeometryPool& geometryPool,
         TextureCache& textureCache,
         FileLoader& loader,
         const char* path
@@ -0,0 +1,253 @@
+#include "Model/ModelGeometryPool.h"
+
+#include <algorithm>
+
+#include "Core/Macros.h"
+
+ModelGeometryPool::ModelGeometryPool(GpuDevice& device,
+                                     u32 vertexStride,
+                                     u32 blockVertices,
+                                     u32 blockIndices)
+    : m_device(device)
+    , m_vertexStride(vertexStride)
+    , m_blockVertices(blockVertices)
+    , m_blockIndices(blockIndices)
+    , m_blocks()
+    , m_pendingFrees()
+{
+    ASSERT(vertexStride > 0 && blockVertices > 0 && blockIndices > 0);
+}
+
+ModelGeometryPool::~ModelGeometryPool()
+{
+    for (u32 i = 0; i < (u32)m_blocks.size(); ++i) {
+        if (m_blocks[i])
+            DestroyBlock(i);
+    }
+}
+
+bool ModelGeometryPool::FindRange(const FreeList& list, u32 count, size_t* index)
+{
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (list[i].count >= count) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+u32 ModelGeometryPool::TakeRange(FreeList& list, size_t index, u32 count)
+{
+    Range& range = list[index];
+    u32 start = range.start;
+    range.start += count;
+    range.count -= count;
+    if (range.count == 0)
+        list.erase(list.begin() + index);
+    return start;
+}
+
+void ModelGeometryPool::ReturnRange(FreeList& list, u32 start, u32 count)
+{
+    if (count == 0)
+        return;
+
+    size_t i = 0;
+    while (i < list.size() && list[i].start < start)
+        ++i;
+
+    bool joinPrev = (i > 0) && (list[i - 1].start + list[i - 1].count == start);
+    bool joinNext = (i < list.size()) && (start + count == list[i].start);
+
+    if (joinPrev && joinNext) {
+        list[i - 1].count += count + list[i].count;
+        list.erase(list.begin() + i);
+    } else if (joinPrev) {
+        list[i - 1].count += count;
+    } else if (joinNext) {
+        list[i].start = start;
+        list[i].count += count;
+    } else {
+        Range range;
+        range.start = start;
+        range.count = count;
+        list.insert(list.begin() + i, range);
+    }
+}
+
+u32 ModelGeometryPool::CreateBlock(u32 nVertices, u32 nIndices)
+{
+    Block* block = new Block;
+    block->vertexBuf = m_device.BufferCreate(
+        GPU_BUFFER_TYPE_VERTEX,
+        GPU_BUFFER_ACCESS_STATIC,
+        NULL,
+        nVertices * m_vertexStride,
+        0 // maxUpdatesPerFrame (unused)
+    );
+    block->indexBuf = m_device.BufferCreate(
+        GPU_BUFFER_TYPE_INDEX,
+        GPU_BUFFER_ACCESS_STATIC,
+        NULL,
+        nIndices * sizeof(u32),
+        0 // maxUpdatesPerFrame (unused)
+    );
+    block->nVertices = nVertices;
+    block->nIndices = nIndices;
+    block->nAllocations = 0;
+    ReturnRange(block->freeVertices, 0, nVertices);
+    ReturnRange(block->freeIndices, 0, nIndices);
+
+    for (u32 i = 0; i < (u32)m_blocks.size(); ++i) {
+        if (!m_blocks[i]) {
+            m_blocks[i] = block;
+            return i;
+        }
+    }
+    m_blocks.push_back(block);
+    return (u32)m_blocks.size() - 1;
+}
+
+void ModelGeometryPool::DestroyBlock(u32 index)
+{
+    Block* block = m_blocks[index];
+    m_device.BufferDestroy(block->vertexBuf);
+    m_device.BufferDestroy(block->indexBuf);
+    delete block;
+    m_blocks[index] = NULL;
+}
+
+void ModelGeometryPool::Allocate(const void* vertices,
+                                 u32 nVertices,
+                                 const u32* indices,
+                                 u32 nIndices,
+                                 Allocation* alloc)
+{
+    ASSERT(nVertices > 0 && nIndices > 0);
+
+    u32 blockIndex = (u32)m_blocks.size();
+    size_t vertexRange = 0;
+    size_t indexRange = 0;
+    for (u32 i = 0; i < (u32)m_blocks.size(); ++i) {
+        Block* block = m_blocks[i];
+        if (block
+            && FindRange(block->freeVertices, nVertices, &vertexRange)
+            && FindRange(block->freeIndices, nIndices, &indexRange)) {
+            blockIndex = i;
+            break;
+        }
+    }
+    if (blockIndex == (u32)m_blocks.size()) {
+        blockIndex = CreateBlock(std::max(nVertices, m_blockVertices),
+                                 std::max(nIndices, m_blockIndices));
+        vertexRange = 0;
+        indexRange = 0;
+    }
+
+    Block& block = *m_blocks[blockIndex];
+    alloc->block = blockIndex;
+    alloc->firstVertex = TakeRange(block.freeVertices, vertexRange, nVertices);
+    alloc->nVertices = nVertices;
+    alloc->firstIndex = TakeRange(block.freeIndices, indexRange, nIndices);
+    alloc->nIndices = nIndices;
+    ++block.nAllocations;
+
+    m_device.BufferUpload(block.vertexBuf,
+                          alloc->firstVertex * m_vertexStride,
+                          vertices,
+                          nVertices * m_vertexStride);
+    m_device.BufferUpload(block.indexBuf,
+                          alloc->firstIndex * sizeof(u32),
+                          indices,
+                          nIndices * sizeof(u32));
+}
+
+void ModelGeometryPool::Free(const Allocation& alloc)
+{
+    ASSERT(alloc.block < m_blocks.size() && m_blocks[alloc.block]);
+
+    // The frame being built may also refer to the allocation.
+    PendingFree pending;
+    pending.alloc = alloc;
+    pending.frame = m_device.GetSubmittedFrame() + 1;
+    m_pendingFrees.push_back(pending);
+}
+
+void ModelGeometryPool::Update()
+{
+    u64 completedFrame = m_device.GetCompletedFrame();
+
+    size_t nRemaining = 0;
+    for (size_t i = 0; i < m_pendingFrees.size(); ++i) {
+        const PendingFree& pending = m_pendingFrees[i];
+        if (pending.frame > completedFrame) {
+            m_pendingFrees[nRemaining] = pending;
+            ++nRemaining;
+            continue;
+        }
+
+        const Allocation& alloc = pending.alloc;
+        Block& block = *m_blocks[alloc.block];
+        ReturnRange(block.freeVertices, alloc.firstVertex, alloc.nVertices);
+        ReturnRange(block.freeIndices, alloc.firstIndex, alloc.nIndices);
+        ASSERT(block.nAllocations > 0);
+        --block.nAllocations;
+    }
+    m_pendingFrees.resize(nRemaining);
+
+    // Keep one empty block of the default size around, so that reloading the
+    // only model in the pool doesn't recreate its buffers.
+    bool keptEmptyBlock = false;
+    for (u32 i = 0; i < (u32)m_blocks.size(); ++i) {
+        Block* block = m_blocks[i];
+        if (!block || block->nAllocations != 0)
+            continue;
+        bool isDefaultSize = (block->nVertices == m_blockVertices
+                              && block->nIndices == m_blockIndices);
+        if (isDefaultSize && !keptEmptyBlock)
+            keptEmptyBlock = true;
+        else
+            DestroyBlock(i);
+    }
+}
+
+GpuBufferID ModelGeometryPool::GetVertexBuf(const Allocation& alloc) const
+{
+    ASSERT(alloc.block < m_blocks.size() && m_blocks[alloc.block]);
+    return m_blocks[alloc.block]->vertexBuf;
+}
+
+GpuBufferID ModelGeometryPool::GetIndexBuf(const Allocation& alloc) const
+{
+    ASSERT(alloc.block < m_blocks.size() && m_blocks[alloc.block]);
+    return m_blocks[alloc.block]->indexBuf;
+}
+
+ModelGeometryPool::Stats ModelGeometryPool::GetStats() const
+{
+    Stats stats;
+    stats.nBlocks = 0;
+    stats.nAllocations = 0;
+    stats.nVerticesUsed = 0;
+    stats.nVerticesTotal = 0;
+    stats.nIndicesUsed = 0;
+    stats.nIndicesTotal = 0;
+
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        const Block* block = m_blocks[i];
+        if (!block)
+            continue;
+        ++stats.nBlocks;
+        stats.nAllocations += block->nAllocations;
+        stats.nVerticesTotal += block->nVertices;
+        stats.nIndicesTotal += block->nIndices;
+        stats.nVerticesUsed += block->nVertices;
+        stats.nIndicesUsed += block->nIndices;
+        for (size_t j = 0; j < block->freeVertices.size(); ++j)
+            stats.nVerticesUsed -= block->freeVertices[j].count;
+        for (size_t j = 0; j < block->freeIndices.size(); ++j)
+            stats.nIndicesUsed -= block->freeIndices[j].count;
+    }
+    return stats;
+}
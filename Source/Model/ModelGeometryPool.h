@@ -0,0 +1,107 @@
+#ifndef MODEL_MODELGEOMETRYPOOL_H
+#define MODEL_MODELGEOMETRYPOOL_H
+
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+// Suballocates the static geometry of all the models from a few large vertex
+// and index buffers, so that the draws of different models share their buffer
+// bindings. The draws of an allocation add its firstIndex to their first
+// index and use its firstVertex as their base vertex.
+//
+// Each block of the pool has one vertex buffer and one index buffer, whose
+// ranges are allocated first-fit. Geometry that doesn't fit in a block of the
+// default size gets a block of its own.
+class ModelGeometryPool {
+public:
+    struct Allocation {
+        u32 block;
+        u32 firstVertex;
+        u32 nVertices;
+        u32 firstIndex;
+        u32 nIndices;
+    };
+
+    struct Stats {
+        u32 nBlocks;
+        u32 nAllocations;
+        u32 nVerticesUsed;
+        u32 nVerticesTotal;
+        u32 nIndicesUsed;
+        u32 nIndicesTotal;
+    };
+
+    ModelGeometryPool(GpuDevice& device,
+                      u32 vertexStride,
+                      u32 blockVertices,
+                      u32 blockIndices);
+    ~ModelGeometryPool();
+
+    // Copies the vertices and indices into the pool. The indices are relative
+    // to the first vertex of the allocation.
+    void Allocate(const void* vertices,
+                  u32 nVertices,
+                  const u32* indices,
+                  u32 nIndices,
+                  Allocation* alloc);
+
+    // The ranges may still be read by the frames in flight, so they're only
+    // reused once the GPU has completed the current frame (see Update()).
+    void Free(const Allocation& alloc);
+
+    // Reclaims the freed ranges that the GPU has finished with, and destroys
+    // the blocks that are left empty. Call once per frame.
+    void Update();
+
+    GpuBufferID GetVertexBuf(const Allocation& alloc) const;
+    GpuBufferID GetIndexBuf(const Allocation& alloc) const;
+
+    Stats GetStats() const;
+
+private:
+    ModelGeometryPool(const ModelGeometryPool&);
+    ModelGeometryPool& operator=(const ModelGeometryPool&);
+
+    struct Range {
+        u32 start;
+        u32 count;
+    };
+
+    // Sorted by start, with no two ranges adjacent.
+    typedef std::vector<Range> FreeList;
+
+    struct Block {
+        GpuBufferID vertexBuf;
+        GpuBufferID indexBuf;
+        u32 nVertices;
+        u32 nIndices;
+        FreeList freeVertices;
+        FreeList freeIndices;
+        u32 nAllocations;
+    };
+
+    struct PendingFree {
+        Allocation alloc;
+        // The range can be reused once the GPU has completed this frame.
+        u64 frame;
+    };
+
+    static bool FindRange(const FreeList& list, u32 count, size_t* index);
+    static u32 TakeRange(FreeList& list, size_t index, u32 count);
+    static void ReturnRange(FreeList& list, u32 start, u32 count);
+
+    u32 CreateBlock(u32 nVertices, u32 nIndices);
+    void DestroyBlock(u32 index);
+
+    GpuDevice& m_device;
+    u32 m_vertexStride;
+    u32 m_blockVertices;
+    u32 m_blockIndices;
+    // Destroyed blocks leave a NULL entry, which is reused by the next block
+    // to be created.
+    std::vector<Block*> m_blocks;
+    std::vector<PendingFree> m_pendingFrees;
+};
+
+#endif // MODEL_MODELGEOMETRYPOOL_H
@@ -1,12 +1,11 @@
 #ifndef MODEL_MODELINSTANCE_H
 #define MODEL_MODELINSTANCE_H
 
+#include "Core/Types.h"
 #include "Core/List.h"
-#include "GpuDevice/GpuDevice.h"
-#include "GpuDevice/GpuDrawItemPool.h"
+#include "Math/Vector3.h"
 
 class Matrix44;
-class Vector3;
 class ModelShared;
 class ModelScene;
 
@@ -19,20 +18,34 @@ public:
         FLAG_WIREFRAME = 2,
     };
 
+    // The per-instance data read by the model shaders. This must match the
+    // layout of MDLInstanceData in Shaders/ModelTypes.h.
+    struct InstanceData {
+        float worldTransform[4][4];
+        float normalTransform[3][4];
+        float diffuseColor[4];
+        float specularColorAndGlossiness[4];
+        // The slice of the diffuse texture, for models whose textures are
+        // packed into an array texture. Written by ModelRenderQueue.
+        u32 textureSlice;
+        u32 padding[3];
+    };
+
     ModelShared* GetShared() const;
-    GpuBufferID GetCBuffer() const;
 
     u32 GetFlags() const;
     void SetFlags(u32 flags);
 
+    // Returns the translation of the world transform passed to Update().
+    const Vector3& GetPosition() const;
+    const InstanceData& GetInstanceData() const;
+
     void Update(const Matrix44& worldTransform,
                 const Vector3& diffuseColor,
                 const Vector3& specularColor,
                 float glossiness);
 
-    void RecreateDrawItems();
     void Reload(ModelShared* newShared);
-    void AddDrawItemsToList(std::vector<const GpuDrawItem*>& items);
 
     ModelInstance* NextInAssetGroup();
     void MarkLastInAssetGroup();
@@ -41,17 +54,20 @@ public:
 
 private:
     friend class ModelScene;
+    friend class ModelRenderQueue;
     ModelInstance(const ModelInstance&);
     ModelInstance& operator=(const ModelInstance&);
 
-    ModelInstance(ModelScene& scene, ModelShared* model, u32 flags);
+    ModelInstance(ModelShared* model, u32 flags);
     ~ModelInstance();
 
-    ModelScene& m_scene;
     ModelShared* m_shared;
     u32 m_flagsAndAssetGroupInfo;
-    GpuBufferID m_cbuffer;
-    GpuDrawItemPoolIndex m_drawItemIndex;
+    // The index of the instance's entry in the ModelRenderQueue that it was
+    // last added to. It's only valid if that entry refers to the instance.
+    u32 m_renderQueueEntry;
+    Vector3 m_position;
+    InstanceData m_instanceData;
 };
 
 #endif // MODEL_MODELINSTANCE_H
@@ -1,33 +1,378 @@
 #include "Model/ModelRenderQueue.h"
 
+#include <string.h>
+#include <algorithm>
+
 #include "Core/Macros.h"
+#include "Core/Profiler.h"
+#include "Core/RadixSort.h"
 
+#include "GpuDevice/GpuDrawItemWriter.h"
 #include "GpuDevice/GpuMathUtils.h"
 
+#include "Texture/TextureAsset.h"
+
 #include "Model/ModelInstance.h"
+#include "Model/ModelShared.h"
 #include "Model/ModelScene.h"
 
 const float PI = 3.141592654f;
 
+// Layout of the 64-bit sort key (most significant bits first):
+//   Bits 60-63 contain the layer.
+//   Bits 52-59 contain the pipeline state index (the ModelScene PSO flags).
+//   Bits 36-51 contain the raw index of the diffuse texture.
+//   Bits 20-35 contain the raw index of the sampler.
+//   Bits 0-19 contain the quantized view depth.
+const u32 SORTKEY_LAYER_SHIFT = 60;
+const u32 SORTKEY_PSO_SHIFT = 52;
+const u32 SORTKEY_TEXTURE_SHIFT = 36;
+const u32 SORTKEY_SAMPLER_SHIFT = 20;
+const u32 SORTKEY_DEPTH_BITS = 20;
+const u64 SORTKEY_DEPTH_MASK = (1ULL << SORTKEY_DEPTH_BITS) - 1;
+
+// Metal requires the offset of a buffer bound in the constant address space
+// to be a multiple of 256 bytes.
+const u32 INSTANCE_BUFFER_ALIGNMENT = 256;
+
+const u32 NO_SLICE = 0xFFFFFFFF;
+
+static GpuDrawItemWriterDesc CreateDrawItemWriterDesc()
+{
+    GpuDrawItemWriterDesc desc;
+    desc.SetNumCBuffers(1);
+    desc.SetNumVertexBuffers(1);
+    desc.SetNumTextures(1);
+    desc.SetNumSamplers(1);
+    return desc;
+}
+
+static u32 GetPSOFlags(u32 flags)
+{
+    u32 psoFlags = 0;
+    if (flags & ModelInstance::FLAG_SKYBOX)
+        psoFlags |= ModelScene::PSOFLAG_SKYBOX;
+    if (flags & ModelInstance::FLAG_WIREFRAME)
+        psoFlags |= ModelScene::PSOFLAG_WIREFRAME;
+    return psoFlags;
+}
+
+static GpuSamplerID GetSampler(ModelScene& scene, u32 flags)
+{
+    if (flags & ModelInstance::FLAG_SKYBOX)
+        return scene.GetSamplerUVClamp();
+    return scene.GetSamplerUVRepeat();
+}
+
+static GpuTextureID GetDiffuseTexture(ModelScene& scene,
+                                      const ModelShared& shared,
+                                      const MDLSubmesh& submesh,
+                                      u32* slice)
+{
+    *slice = NO_SLICE;
+    if (TextureArrayAsset* array = shared.GetDiffuseArray()) {
+        if (submesh.diffuseTextureIndex == MDL_NO_TEXTURE)
+            return scene.GetDefaultTexture();
+        *slice = (u32)submesh.diffuseTextureIndex;
+        return array->GetGpuTextureID();
+    }
+
+    // Textures that are still loading are drawn with the default texture.
+    if (submesh.diffuseTexture && submesh.diffuseTexture->IsLoaded())
+        return submesh.diffuseTexture->GetGpuTextureID();
+    return scene.GetDefaultTexture();
+}
+
+static u32 AlignInstanceBufferOffset(u32 offset)
+{
+    return (offset + INSTANCE_BUFFER_ALIGNMENT - 1) & ~(INSTANCE_BUFFER_ALIGNMENT - 1);
+}
+
+// For non-negative IEEE-754 floats, the ordering of the bit patterns matches
+// the ordering of the values, so the top bits of the bit pattern give a
+// quantized depth without needing to know the depth range of the scene. The
+// sign bit is always clear, so the 20 bits below it are used: the exponent
+// and 12 bits of mantissa, which is a relative precision of 1/4096.
+static u64 QuantizeDepth(float depth)
+{
+    // Also catches NaNs.
+    if (!(depth > 0.0f))
+        return 0;
+    u32 bits;
+    memcpy(&bits, &depth, sizeof bits);
+    return (u64)(bits >> (31 - SORTKEY_DEPTH_BITS)) & SORTKEY_DEPTH_MASK;
+}
+
+u64 ModelRenderQueue::MakeSortKey(Layer layer,
+                                  u32 psoIndex,
+                                  u32 textureIndex,
+                                  u32 samplerIndex,
+                                  float viewDepth)
+{
+    u64 key = 0;
+    key |= (u64)(layer & 0xF) << SORTKEY_LAYER_SHIFT;
+    key |= (u64)(psoIndex & 0xFF) << SORTKEY_PSO_SHIFT;
+    key |= (u64)(textureIndex & 0xFFFF) << SORTKEY_TEXTURE_SHIFT;
+    key |= (u64)(samplerIndex & 0xFFFF) << SORTKEY_SAMPLER_SHIFT;
+    key |= QuantizeDepth(viewDepth);
+    return key;
+}
+
 ModelRenderQueue::ModelRenderQueue()
-    : m_drawItems()
+    : m_viewPos()
+    , m_viewDir(0.0f, 1.0f, 0.0f)
+    , m_entries()
+    , m_groupedEntries()
+    , m_batches()
+    , m_submeshRefs()
+    , m_packets()
+    , m_drawItemData()
+    , m_items()
+    , m_sortScratch()
+    , m_drawItems()
 {}
 
 void ModelRenderQueue::Clear()
 {
+    m_entries.clear();
+    m_batches.clear();
+    m_submeshRefs.clear();
+    m_packets.clear();
+    m_items.clear();
     m_drawItems.clear();
 }
 
+void ModelRenderQueue::SetViewpoint(const Vector3& cameraPos, const Vector3& viewDir)
+{
+    m_viewPos = cameraPos;
+    m_viewDir = viewDir;
+}
+
 void ModelRenderQueue::Add(ModelInstance* instance)
 {
-    instance->AddDrawItemsToList(m_drawItems);
+    u32 index = instance->m_renderQueueEntry;
+    ASSERT((index >= m_entries.size() || m_entries[index].instance != instance)
+           && "Instance was already added to the queue");
+
+    Entry entry;
+    entry.instance = instance;
+    entry.shared = instance->GetShared();
+    entry.flags = instance->GetFlags();
+    entry.viewDepth = Dot(instance->GetPosition() - m_viewPos, m_viewDir);
+    instance->m_renderQueueEntry = (u32)m_entries.size();
+    m_entries.push_back(entry);
+}
+
+bool ModelRenderQueue::EntryLess(const Entry& a, const Entry& b)
+{
+    if (a.flags != b.flags)
+        return a.flags < b.flags;
+    return a.viewDepth < b.viewDepth;
+}
+
+// Returns the size on screen, in pixels, of the bounding sphere of an instance
+// at the given view depth. The scale of the instance's transform is ignored.
+static float ScreenSize(float radius, float viewDepth, float screenScale)
+{
+    // Clamp the depth so that the size doesn't blow up when the camera is
+    // inside the sphere.
+    float depth = viewDepth > radius ? viewDepth : radius;
+    return 2.0f * radius * screenScale / depth;
+}
+
+u32 ModelRenderQueue::BuildBatches(float screenScale)
+{
+    PROFILE_ZONE("ModelRenderQueue::BuildBatches");
+
+    // The ModelScene keeps the instances of each model together in its list
+    // of instances, so the entries are grouped by walking the asset group of
+    // each model, in the order in which the models were first added. Only
+    // the entries of a model are sorted, so the order doesn't depend on where
+    // the models are in memory. The grouped instances are marked by
+    // invalidating their entry index.
+    const u32 NO_ENTRY = 0xFFFFFFFF;
+    u32 nEntries = (u32)m_entries.size();
+    m_groupedEntries.clear();
+    for (u32 i = 0; i < nEntries; ++i) {
+        if (m_entries[i].instance->m_renderQueueEntry != i)
+            continue;
+        ModelShared* shared = m_entries[i].shared;
+        size_t first = m_groupedEntries.size();
+        for (ModelInstance* instance = shared->GetFirstInstance();
+             instance;
+             instance = instance->NextInAssetGroup()) {
+            ASSERT(instance->GetShared() == shared);
+            u32 index = instance->m_renderQueueEntry;
+            if (index < nEntries && m_entries[index].instance == instance) {
+                m_groupedEntries.push_back(m_entries[index]);
+                instance->m_renderQueueEntry = NO_ENTRY;
+            }
+        }
+        std::sort(m_groupedEntries.begin() + first, m_groupedEntries.end(), EntryLess);
+    }
+    ASSERT(m_groupedEntries.size() == m_entries.size());
+    m_entries.swap(m_groupedEntries);
+
+    m_batches.clear();
+    u32 instanceBufferSize = 0;
+    for (u32 i = 0; i < nEntries; ) {
+        Batch batch;
+        batch.shared = m_entries[i].shared;
+        batch.flags = m_entries[i].flags;
+        batch.firstEntry = i;
+        batch.instanceBufferOffset = instanceBufferSize;
+        // The entries are sorted front-to-back within the batch, so the
+        // batch is sorted by the depth of its nearest instance.
+        batch.viewDepth = m_entries[i].viewDepth;
+
+        ++i;
+        while (i < nEntries
+               && m_entries[i].shared == batch.shared
+               && m_entries[i].flags == batch.flags)
+            ++i;
+        batch.nEntries = i - batch.firstEntry;
+
+        // The nearest instance that isn't entirely behind the camera is the
+        // largest on screen.
+        float radius = batch.shared->GetBoundingRadius();
+        batch.screenSize = 0.0f;
+        for (u32 j = batch.firstEntry; j < i; ++j) {
+            if (m_entries[j].viewDepth >= -radius) {
+                batch.screenSize = ScreenSize(radius, m_entries[j].viewDepth, screenScale);
+                break;
+            }
+        }
+
+        instanceBufferSize += batch.nEntries * sizeof(ModelInstance::InstanceData);
+        instanceBufferSize = AlignInstanceBufferOffset(instanceBufferSize);
+
+        m_batches.push_back(batch);
+    }
+    return instanceBufferSize;
+}
+
+bool ModelRenderQueue::SubmeshRefLess(const SubmeshRef& a, const SubmeshRef& b)
+{
+    if (a.texture != b.texture)
+        return a.texture < b.texture;
+    if (a.slice != b.slice)
+        return a.slice < b.slice;
+    return a.submesh < b.submesh;
+}
+
+u32 ModelRenderQueue::BuildPackets(ModelScene& scene, u32* instanceBufferSize)
+{
+    PROFILE_ZONE("ModelRenderQueue::BuildPackets");
+
+    m_submeshRefs.clear();
+    m_packets.clear();
+    u32 nDrawArgs = 0;
+    for (u32 i = 0; i < (u32)m_batches.size(); ++i) {
+        const Batch& batch = m_batches[i];
+        const u8* mdlData = batch.shared->GetMDLData();
+        const MDLHeader* header = (const MDLHeader*)mdlData;
+        const MDLSubmesh* submeshes = (const MDLSubmesh*)(mdlData + header->ofsSubmeshes);
+
+        // Sort the submeshes of the model by texture, so that the submeshes
+        // that share all their bindings are adjacent. Array textures aren't
+        // streamed.
+        bool hasArray = batch.shared->GetDiffuseArray() != NULL;
+        u32 first = (u32)m_submeshRefs.size();
+        for (u32 j = 0; j < header->nSubmeshes; ++j) {
+            if (!hasArray && submeshes[j].diffuseTexture)
+                submeshes[j].diffuseTexture->RequestScreenSize(batch.screenSize);
+
+            SubmeshRef ref;
+            ref.texture = GetDiffuseTexture(scene, *batch.shared, submeshes[j], &ref.slice);
+            ref.submesh = j;
+            m_submeshRefs.push_back(ref);
+        }
+        u32 end = (u32)m_submeshRefs.size();
+        std::sort(m_submeshRefs.begin() + first, m_submeshRefs.end(), SubmeshRefLess);
+
+        for (u32 j = first; j < end; ) {
+            Packet packet;
+            packet.batch = i;
+            packet.firstSubmesh = j;
+            packet.texture = m_submeshRefs[j].texture;
+            packet.drawArgsOffset = 0;
+            packet.nSlices = 0;
+            packet.instanceBufferOffset = batch.instanceBufferOffset;
+
+            u32 lastSlice = NO_SLICE;
+            for (; j < end && m_submeshRefs[j].texture == packet.texture; ++j) {
+                if (m_submeshRefs[j].slice != lastSlice) {
+                    lastSlice = m_submeshRefs[j].slice;
+                    ++packet.nSlices;
+                }
+            }
+            packet.nSubmeshes = j - packet.firstSubmesh;
+
+            if (packet.nSlices > 0) {
+                packet.instanceBufferOffset = *instanceBufferSize;
+                *instanceBufferSize += packet.nSlices * batch.nEntries
+                    * sizeof(ModelInstance::InstanceData);
+                *instanceBufferSize = AlignInstanceBufferOffset(*instanceBufferSize);
+            }
+
+            // A single submesh is cheaper to draw directly.
+            if (packet.nSubmeshes > 1) {
+                packet.drawArgsOffset = nDrawArgs * sizeof(GpuDrawArgs);
+                nDrawArgs += packet.nSubmeshes;
+            }
+
+            m_packets.push_back(packet);
+        }
+    }
+    return nDrawArgs;
+}
+
+void ModelRenderQueue::WriteInstanceData(u8* instanceData) const
+{
+    for (size_t i = 0; i < m_batches.size(); ++i) {
+        const Batch& batch = m_batches[i];
+        ModelInstance::InstanceData* dest =
+            (ModelInstance::InstanceData*)(instanceData + batch.instanceBufferOffset);
+        for (u32 j = 0; j < batch.nEntries; ++j) {
+            const Entry& entry = m_entries[batch.firstEntry + j];
+            memcpy(&dest[j], &entry.instance->GetInstanceData(), sizeof dest[j]);
+        }
+    }
+
+    // The array texture packets have a copy of their batch's instance data
+    // for each slice that they use.
+    for (size_t i = 0; i < m_packets.size(); ++i) {
+        const Packet& packet = m_packets[i];
+        if (packet.nSlices == 0)
+            continue;
+        const Batch& batch = m_batches[packet.batch];
+        ModelInstance::InstanceData* dest =
+            (ModelInstance::InstanceData*)(instanceData + packet.instanceBufferOffset);
+
+        u32 lastSlice = NO_SLICE;
+        for (u32 j = 0; j < packet.nSubmeshes; ++j) {
+            u32 slice = m_submeshRefs[packet.firstSubmesh + j].slice;
+            if (slice == lastSlice)
+                continue;
+            lastSlice = slice;
+            for (u32 k = 0; k < batch.nEntries; ++k) {
+                const Entry& entry = m_entries[batch.firstEntry + k];
+                memcpy(dest, &entry.instance->GetInstanceData(), sizeof *dest);
+                dest->textureSlice = slice;
+                ++dest;
+            }
+        }
+    }
 }
 
 void ModelRenderQueue::Draw(ModelScene& scene,
                             const SceneInfo& sceneInfo,
                             const GpuViewport& viewport,
-                            GpuRenderPassID renderPass)
+                            GpuRenderPassID renderPass,
+                            TaskPool& taskPool)
 {
+    PROFILE_ZONE("ModelRenderQueue::Draw");
+
     GpuDevice& device = scene.GetGpuDevice();
     GpuBufferID sceneCBuffer = scene.GetSceneCBuffer();
 
@@ -55,5 +400,132 @@ void ModelRenderQueue::Draw(ModelScene& scene,
 
     device.BufferUnmap(sceneCBuffer);
 
-    device.Draw(&m_drawItems[0], (int)m_drawItems.size(), renderPass, viewport);
+    if (m_entries.empty())
+        return;
+
+    u32 instanceBufferSize = BuildBatches(sceneInfo.screenScale);
+    u32 nDrawArgs = BuildPackets(scene, &instanceBufferSize);
+
+    GpuBufferID instanceBuffer = scene.GetInstanceBuffer(instanceBufferSize);
+    WriteInstanceData((u8*)device.BufferMap(instanceBuffer));
+    device.BufferUnmap(instanceBuffer);
+
+    GpuBufferID drawArgsBuffer(0);
+    if (nDrawArgs > 0) {
+        drawArgsBuffer = scene.GetDrawArgsBuffer(nDrawArgs * sizeof(GpuDrawArgs));
+        GpuDrawArgs* drawArgs = (GpuDrawArgs*)device.BufferMap(drawArgsBuffer);
+        for (size_t i = 0; i < m_packets.size(); ++i) {
+            const Packet& packet = m_packets[i];
+            if (packet.nSubmeshes == 1)
+                continue;
+            const Batch& batch = m_batches[packet.batch];
+            const u8* mdlData = batch.shared->GetMDLData();
+            const MDLHeader* header = (const MDLHeader*)mdlData;
+            const MDLSubmesh* submeshes = (const MDLSubmesh*)(mdlData + header->ofsSubmeshes);
+
+            GpuDrawArgs* dest = drawArgs + packet.drawArgsOffset / sizeof(GpuDrawArgs);
+            u32 sliceIndex = 0;
+            for (u32 j = 0; j < packet.nSubmeshes; ++j) {
+                const SubmeshRef& ref = m_submeshRefs[packet.firstSubmesh + j];
+                if (j > 0 && ref.slice != m_submeshRefs[packet.firstSubmesh + j - 1].slice)
+                    ++sliceIndex;
+                const MDLSubmesh& submesh = submeshes[ref.submesh];
+                dest[j].count = submesh.indexCount;
+                dest[j].instanceCount = batch.nEntries;
+                dest[j].first = batch.shared->GetFirstIndex() + submesh.indexStart;
+                dest[j].baseVertex = (i32)batch.shared->GetBaseVertex();
+                dest[j].baseInstance = sliceIndex * batch.nEntries;
+            }
+        }
+        device.BufferUnmap(drawArgsBuffer);
+    }
+
+    // Reserve the memory for all the draw items up front, since the draw items
+    // are referred to by pointer once they've been written.
+    GpuDrawItemWriterDesc desc = CreateDrawItemWriterDesc();
+    size_t drawItemWords = (GpuDrawItemWriter::SizeInBytes(desc) + sizeof(u64) - 1)
+        / sizeof(u64);
+    m_drawItemData.resize(m_packets.size() * drawItemWords);
+
+    m_items.clear();
+    u64* drawItemMem = m_drawItemData.empty() ? NULL : &m_drawItemData[0];
+    for (size_t i = 0; i < m_packets.size(); ++i) {
+        const Packet& packet = m_packets[i];
+        const Batch& batch = m_batches[packet.batch];
+
+        ModelRenderQueue::Layer layer = (batch.flags & ModelInstance::FLAG_SKYBOX)
+            ? LAYER_SKYBOX
+            : LAYER_OPAQUE;
+        u32 psoFlags = GetPSOFlags(batch.flags);
+        if (packet.nSlices > 0)
+            psoFlags |= ModelScene::PSOFLAG_TEXTURE_ARRAY;
+        GpuSamplerID sampler = GetSampler(scene, batch.flags);
+
+        GpuDrawItemWriter writer;
+        writer.Begin(&device, desc, drawItemMem);
+        writer.SetPipelineState(scene.RequestPSO(psoFlags));
+        writer.SetVertexBuffer(0, batch.shared->GetVertexBuf(), 0);
+        writer.SetCBuffer(0, sceneCBuffer);
+        writer.SetTexture(0, packet.texture);
+        writer.SetSampler(0, sampler);
+        writer.SetIndexBuffer(batch.shared->GetIndexBuf());
+        writer.SetInstanceBuffer(instanceBuffer, packet.instanceBufferOffset);
+        if (packet.nSubmeshes == 1) {
+            const u8* mdlData = batch.shared->GetMDLData();
+            const MDLHeader* header = (const MDLHeader*)mdlData;
+            const MDLSubmesh* submeshes = (const MDLSubmesh*)(mdlData + header->ofsSubmeshes);
+            const MDLSubmesh& submesh = submeshes[m_submeshRefs[packet.firstSubmesh].submesh];
+
+            writer.SetInstanceCount((int)batch.nEntries);
+            writer.SetBaseVertex((int)batch.shared->GetBaseVertex());
+            writer.SetDrawCallIndexed(
+                GPU_PRIMITIVE_TRIANGLES,
+                batch.shared->GetFirstIndex() + submesh.indexStart,
+                submesh.indexCount,
+                0,
+                GPU_INDEX_U32
+            );
+        } else {
+            writer.SetDrawCallIndexedIndirect(
+                GPU_PRIMITIVE_TRIANGLES,
+                drawArgsBuffer,
+                packet.drawArgsOffset,
+                (int)packet.nSubmeshes,
+                0,
+                GPU_INDEX_U32
+            );
+        }
+
+        Item item;
+        item.key = MakeSortKey(
+            layer,
+            psoFlags,
+            packet.texture & 0xFFFF,
+            sampler & 0xFFFF,
+            batch.viewDepth
+        );
+        item.drawItem = writer.End();
+        m_items.push_back(item);
+
+        drawItemMem += drawItemWords;
+    }
+
+    if (m_items.empty())
+        return;
+
+    m_sortScratch.resize(m_items.size());
+    RadixSort64(&m_items[0], &m_sortScratch[0], m_items.size());
+
+    m_drawItems.resize(m_items.size());
+    for (size_t i = 0; i < m_items.size(); ++i)
+        m_drawItems[i] = m_items[i].drawItem;
+
+    {
+        PROFILE_ZONE("GpuDevice::DrawParallel");
+        device.DrawParallel(&m_drawItems[0], (int)m_drawItems.size(), renderPass,
+                            viewport, taskPool);
+    }
+
+    for (size_t i = 0; i < m_items.size(); ++i)
+        GPUDEVICE_UNREGISTER_DRAWITEM(device, m_items[i].drawItem);
 }
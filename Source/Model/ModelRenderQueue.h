@@ -9,30 +9,136 @@
 class ShaderAsset;
 class ModelAsset;
 class ModelInstance;
+class ModelShared;
 class ModelScene;
+class TaskPool;
 
 class ModelRenderQueue {
 public:
+    // Layers are drawn in the order listed here, regardless of the rest of
+    // the sort key.
+    enum Layer {
+        LAYER_OPAQUE,
+        LAYER_SKYBOX,
+    };
+
     struct SceneInfo {
         Matrix44 viewProjTransform;
         Vector3 cameraPos;
         Vector3 dirToLight;
         Vector3 irradiance;
         Vector3 ambientRadiance;
+        // The viewport height divided by 2 * tan(fovY / 2). An object of size
+        // s at view depth d covers about s * screenScale / d pixels. This is
+        // used to request the resolution at which textures are streamed in.
+        float screenScale;
+    };
+
+    struct Item {
+        u64 key;
+        const GpuDrawItem* drawItem;
     };
 
+    // Builds a sort key such that sorting the queue in ascending key order
+    // groups draw items by layer, then pipeline state, then texture and
+    // sampler, and finally orders them front-to-back.
+    static u64 MakeSortKey(Layer layer,
+                           u32 psoIndex,
+                           u32 textureIndex,
+                           u32 samplerIndex,
+                           float viewDepth);
+
     ModelRenderQueue();
 
     void Clear();
+    // Sets the viewpoint used to compute the depth of each instance added to
+    // the queue. This should be called before calling Add().
+    void SetViewpoint(const Vector3& cameraPos, const Vector3& viewDir);
+    // Instances with the same model and flags are drawn together with
+    // hardware instancing, so the ModelInstance objects don't own any draw
+    // items themselves.
     void Add(ModelInstance* instance);
     void Draw(ModelScene& scene,
               const SceneInfo& sceneInfo,
               const GpuViewport& viewport,
-              GpuRenderPassID renderPass);
+              GpuRenderPassID renderPass,
+              TaskPool& taskPool);
 private:
     ModelRenderQueue(const ModelRenderQueue&);
     ModelRenderQueue& operator=(const ModelRenderQueue&);
 
+    struct Entry {
+        ModelInstance* instance;
+        ModelShared* shared;
+        u32 flags;
+        float viewDepth;
+    };
+
+    // A run of instances that share a model and flags, and so can be drawn
+    // with one instanced draw call per submesh.
+    struct Batch {
+        ModelShared* shared;
+        u32 flags;
+        u32 firstEntry;
+        u32 nEntries;
+        u32 instanceBufferOffset;
+        float viewDepth;
+        // The largest size on screen of the instances, in pixels.
+        float screenSize;
+    };
+
+    struct SubmeshRef {
+        GpuTextureID texture;
+        // The slice of the texture, if it's an array texture, or NO_SLICE.
+        u32 slice;
+        u32 submesh;
+    };
+
+    // The submeshes of a batch that share all their bindings. These are drawn
+    // with one indirect draw item, which reads a GpuDrawArgs record for each
+    // submesh at drawArgsOffset in the draw arguments buffer.
+    //
+    // If the texture is an array texture, the submeshes can use different
+    // slices of it. The packet then has its own copy of the batch's instance
+    // data for each distinct slice, at instanceBufferOffset, and the draw of
+    // each submesh uses the copy for its slice as its base instance.
+    struct Packet {
+        u32 batch;
+        u32 firstSubmesh;
+        u32 nSubmeshes;
+        u32 drawArgsOffset;
+        GpuTextureID texture;
+        // The number of distinct slices; 0 if the texture isn't an array.
+        u32 nSlices;
+        u32 instanceBufferOffset;
+    };
+
+    static bool EntryLess(const Entry& a, const Entry& b);
+    static bool SubmeshRefLess(const SubmeshRef& a, const SubmeshRef& b);
+
+    // Orders the entries by model, following the asset groups of the
+    // ModelScene, then by flags and depth, and groups them into batches.
+    // Returns the number of bytes of instance data needed for all the
+    // batches.
+    u32 BuildBatches(float screenScale);
+    // Groups the submeshes of each batch into packets, and requests the
+    // screen size of each batch for the textures of its submeshes. Adds the
+    // instance data needed for the array texture packets to
+    // *instanceBufferSize. Returns the number of GpuDrawArgs records needed
+    // for the indirect packets.
+    u32 BuildPackets(ModelScene& scene, u32* instanceBufferSize);
+    void WriteInstanceData(u8* instanceData) const;
+
+    Vector3 m_viewPos;
+    Vector3 m_viewDir;
+    std::vector<Entry> m_entries;
+    std::vector<Entry> m_groupedEntries;
+    std::vector<Batch> m_batches;
+    std::vector<SubmeshRef> m_submeshRefs;
+    std::vector<Packet> m_packets;
+    std::vector<u64> m_drawItemData;
+    std::vector<Item> m_items;
+    std::vector<Item> m_sortScratch;
     std::vector<const GpuDrawItem*> m_drawItems;
 };
 
@@ -39,15 +39,13 @@ static GpuInputLayoutID CreateInputLayout(GpuDevice& device)
     );
 }
 
-static GpuDrawItemWriterDesc CreateDrawItemWriterDesc()
-{
-    GpuDrawItemWriterDesc desc;
-    desc.SetNumCBuffers(2);
-    desc.SetNumVertexBuffers(1);
-    desc.SetNumTextures(1);
-    desc.SetNumSamplers(1);
-    return desc;
-}
+// The size of the blocks of the geometry pool: 8 MB of vertices and 4 MB of
+// indices.
+const u32 GEOMETRY_BLOCK_VERTICES = 256 * 1024;
+const u32 GEOMETRY_BLOCK_INDICES = 1024 * 1024;
+
+const u32 MIN_INSTANCE_BUFFER_SIZE = 64 * sizeof(ModelInstance::InstanceData);
+const u32 MIN_DRAW_ARGS_BUFFER_SIZE = 64 * sizeof(GpuDrawArgs);
 
 void ModelScene::SamplerCacheCallback(GpuSamplerCache& cache, void* userdata)
 {
@@ -59,11 +57,8 @@ void ModelScene::SamplerCacheCallback(GpuSamplerCache& cache, void* userdata)
     self->m_samplerUVClamp = cache.Acquire(GPU_SAMPLER_ADDRESS_CLAMP_TO_EDGE);
     self->m_samplerUVRepeat = cache.Acquire(GPU_SAMPLER_ADDRESS_REPEAT);
 
-    for (ModelInstance* instance = self->m_modelInstances.Head(); instance;
-         instance = instance->m_link.Next()) {
-        instance->RecreateDrawItems();
-    }
-
+    // The model draw items are created afresh each frame (see
+    // ModelRenderQueue), so nothing else refers to the old samplers.
     cache.Release(oldSamplerUVClamp);
     cache.Release(oldSamplerUVRepeat);
 }
@@ -81,19 +76,29 @@ ModelScene::ModelScene(
     , m_textureCache(textureCache)
 
     , m_modelInstances()
+    , m_geometryPool(device,
+                     sizeof(ModelShared::Vertex),
+                     GEOMETRY_BLOCK_VERTICES,
+                     GEOMETRY_BLOCK_INDICES)
     , m_modelCache()
 
-    , m_drawItemPool(m_device, CreateDrawItemWriterDesc())
-
     , m_modelShader(NULL)
     , m_skyboxShader(NULL)
+    , m_modelArrayShader(NULL)
+    , m_skyboxArrayShader(NULL)
 
     , m_sceneCBuffer(0)
+    , m_instanceBuffer(0)
+    , m_instanceBufferSize(0)
+    , m_drawArgsBuffer(0)
+    , m_drawArgsBufferSize(0)
     , m_defaultTexture(0)
     , m_samplerUVClamp(samplerCache.Acquire(GPU_SAMPLER_ADDRESS_CLAMP_TO_EDGE))
     , m_samplerUVRepeat(samplerCache.Acquire(GPU_SAMPLER_ADDRESS_REPEAT))
     , m_inputLayout(0)
     , m_PSOs()
+    , m_PSOShaderPrograms()
+    , m_fallbackPSOs()
 {
     m_modelShader = shaderCache.FindOrLoad("Shaders\\Model");
     m_modelShader->AddRef();
@@ -101,6 +106,12 @@ ModelScene::ModelScene(
     m_skyboxShader = shaderCache.FindOrLoad("Shaders\\Skybox");
     m_skyboxShader->AddRef();
 
+    m_modelArrayShader = shaderCache.FindOrLoad("Shaders\\ModelArray");
+    m_modelArrayShader->AddRef();
+
+    m_skyboxArrayShader = shaderCache.FindOrLoad("Shaders\\SkyboxArray");
+    m_skyboxArrayShader->AddRef();
+
     m_sceneCBuffer = device.BufferCreate(
         GPU_BUFFER_TYPE_CONSTANT,
         GPU_BUFFER_ACCESS_STREAM,
@@ -126,35 +137,79 @@ ModelScene::~ModelScene()
     for (int i = 0; i < sizeof m_PSOs / sizeof m_PSOs[0]; ++i) {
         if (m_PSOs[i])
             m_device.PipelineStateDestroy(m_PSOs[i]);
+        if (m_fallbackPSOs[i]) {
+            m_device.PipelineStateDestroy(m_fallbackPSOs[i]);
+            GetPSOShader(i)->ReleasePreviousPrograms();
+        }
     }
     m_device.TextureDestroy(m_defaultTexture);
     m_device.InputLayoutDestroy(m_inputLayout);
     m_device.BufferDestroy(m_sceneCBuffer);
+    if (m_instanceBuffer)
+        m_device.BufferDestroy(m_instanceBuffer);
+    if (m_drawArgsBuffer)
+        m_device.BufferDestroy(m_drawArgsBuffer);
 
     m_modelShader->Release();
     m_skyboxShader->Release();
+    m_modelArrayShader->Release();
+    m_skyboxArrayShader->Release();
 }
 
-void ModelScene::RefreshPSOsMatching(u32 bits, u32 enabled)
+ShaderAsset* ModelScene::GetPSOShader(u32 flags) const
 {
-    GpuPipelineStateID toDestroy[sizeof m_PSOs / sizeof m_PSOs[0]];
-    int toDestroyCount = 0;
+    if (flags & PSOFLAG_TEXTURE_ARRAY)
+        return (flags & PSOFLAG_SKYBOX) ? m_skyboxArrayShader : m_modelArrayShader;
+    return (flags & PSOFLAG_SKYBOX) ? m_skyboxShader : m_modelShader;
+}
+
+void ModelScene::CreatePSO(u32 flags, GpuPipelineStateID fallback)
+{
+    GpuPipelineStateDesc desc;
+    desc.shaderProgram = GetPSOShader(flags)->GetGpuShaderProgramID();
+    desc.shaderStateBitfield = 0;
+    desc.inputLayout = m_inputLayout;
+    desc.depthCompare = GPU_COMPARE_LESS_EQUAL;
+    desc.depthWritesEnabled = true;
+    if (flags & PSOFLAG_WIREFRAME)
+        desc.fillMode = GPU_FILL_MODE_WIREFRAME;
+    else
+        desc.fillMode = GPU_FILL_MODE_SOLID;
+    desc.cullMode = GPU_CULL_BACK;
+    desc.frontFaceWinding = GPU_WINDING_COUNTER_CLOCKWISE;
+    m_PSOs[flags] = m_device.PipelineStateCreateAsync(desc, fallback);
+    m_PSOShaderPrograms[flags] = desc.shaderProgram;
+}
 
+void ModelScene::RefreshPSOsMatching(u32 bits, u32 enabled)
+{
     for (u32 i = 0; i < sizeof m_PSOs / sizeof m_PSOs[0]; ++i) {
-        if ((m_PSOs[i] != 0) && ((i & bits) == enabled)) {
-            toDestroy[toDestroyCount] = m_PSOs[i];
-            ++toDestroyCount;
-            m_PSOs[i] = GpuPipelineStateID(0);
+        if ((m_PSOs[i] == 0) || ((i & bits) != enabled))
+            continue;
+        ShaderAsset* shader = GetPSOShader(i);
+        if (m_PSOShaderPrograms[i] == shader->GetGpuShaderProgramID())
+            continue;
+
+        if (m_fallbackPSOs[i]) {
+            // The PSO from an earlier refresh hasn't compiled yet, so keep
+            // falling back to the one from before that refresh.
+            m_device.PipelineStateDestroy(m_PSOs[i]);
+        } else {
+            m_fallbackPSOs[i] = m_PSOs[i];
+            shader->HoldPreviousPrograms();
         }
+        CreatePSO(i, m_fallbackPSOs[i]);
     }
+}
 
-    for (ModelInstance* instance = m_modelInstances.Head(); instance;
-         instance = instance->m_link.Next()) {
-        instance->RecreateDrawItems();
-    }
-
-    for (int i = 0; i < toDestroyCount; ++i) {
-        m_device.PipelineStateDestroy(toDestroy[i]);
+void ModelScene::RetireFallbackPSOs()
+{
+    for (u32 i = 0; i < sizeof m_PSOs / sizeof m_PSOs[0]; ++i) {
+        if (m_fallbackPSOs[i] && m_device.PipelineStateIsReady(m_PSOs[i])) {
+            m_device.PipelineStateDestroy(m_fallbackPSOs[i]);
+            m_fallbackPSOs[i] = GpuPipelineStateID(0);
+            GetPSOShader(i)->ReleasePreviousPrograms();
+        }
     }
 }
 
@@ -162,11 +217,12 @@ ModelInstance* ModelScene::CreateModelInstance(const char* path, u32 flags)
 {
     ModelShared* shared = m_modelCache.Get(
         m_device,
+        m_geometryPool,
         m_textureCache,
         m_fileLoader,
         path
     );
-    ModelInstance* instance = new ModelInstance(*this, shared, flags);
+    ModelInstance* instance = new ModelInstance(shared, flags);
     ModelInstance* firstInGroup = shared->GetFirstInstance();
     if (firstInGroup != NULL) {
         m_modelInstances.InsertBefore(instance, firstInGroup);
@@ -186,39 +242,36 @@ void ModelScene::DestroyModelInstance(ModelInstance* instance)
 
 void ModelScene::Reload(const char* path)
 {
-    m_modelCache.Reload(m_device, m_textureCache, m_fileLoader, path);
+    m_modelCache.Reload(m_device, m_geometryPool, m_textureCache, m_fileLoader, path);
 }
 
 GpuPipelineStateID ModelScene::RequestPSO(u32 flags)
 {
     ASSERT(flags < sizeof m_PSOs / sizeof m_PSOs[0]);
     if (!m_PSOs[flags]) {
-        GpuPipelineStateDesc desc;
-        if (flags & PSOFLAG_SKYBOX)
-            desc.shaderProgram = m_skyboxShader->GetGpuShaderProgramID();
-        else
-            desc.shaderProgram = m_modelShader->GetGpuShaderProgramID();
-        desc.shaderStateBitfield = 0;
-        desc.inputLayout = m_inputLayout;
-        desc.depthCompare = GPU_COMPARE_LESS_EQUAL;
-        desc.depthWritesEnabled = true;
+        // Draw wireframe models as solid until the wireframe PSO is ready.
+        GpuPipelineStateID fallback(0);
         if (flags & PSOFLAG_WIREFRAME)
-            desc.fillMode = GPU_FILL_MODE_WIREFRAME;
-        else
-            desc.fillMode = GPU_FILL_MODE_SOLID;
-        desc.cullMode = GPU_CULL_BACK;
-        desc.frontFaceWinding = GPU_WINDING_COUNTER_CLOCKWISE;
-        m_PSOs[flags] = m_device.PipelineStateCreate(desc);
+            fallback = m_PSOs[flags & ~PSOFLAG_WIREFRAME];
+        CreatePSO(flags, fallback);
     }
     return m_PSOs[flags];
 }
 
 void ModelScene::Update()
 {
+    m_geometryPool.Update();
+
+    const u32 shaderBits = PSOFLAG_SKYBOX | PSOFLAG_TEXTURE_ARRAY;
     if (m_modelShader->PollRefreshed())
-        RefreshPSOsMatching(PSOFLAG_SKYBOX, 0);
+        RefreshPSOsMatching(shaderBits, 0);
     if (m_skyboxShader->PollRefreshed())
-        RefreshPSOsMatching(PSOFLAG_SKYBOX, PSOFLAG_SKYBOX);
+        RefreshPSOsMatching(shaderBits, PSOFLAG_SKYBOX);
+    if (m_modelArrayShader->PollRefreshed())
+        RefreshPSOsMatching(shaderBits, PSOFLAG_TEXTURE_ARRAY);
+    if (m_skyboxArrayShader->PollRefreshed())
+        RefreshPSOsMatching(shaderBits, PSOFLAG_SKYBOX | PSOFLAG_TEXTURE_ARRAY);
+    RetireFallbackPSOs();
 }
 
 GpuSamplerID ModelScene::GetSamplerUVClamp() const
@@ -236,14 +289,54 @@ GpuTextureID ModelScene::GetDefaultTexture() const
     return m_defaultTexture;
 }
 
-GpuDrawItemPool& ModelScene::GetDrawItemPool()
+GpuBufferID ModelScene::GetSceneCBuffer() const
 {
-    return m_drawItemPool;
+    return m_sceneCBuffer;
 }
 
-GpuBufferID ModelScene::GetSceneCBuffer() const
+GpuBufferID ModelScene::GetInstanceBuffer(u32 minSize)
 {
-    return m_sceneCBuffer;
+    GrowFrameBuffer(&m_instanceBuffer, &m_instanceBufferSize,
+                    GPU_BUFFER_TYPE_CONSTANT, minSize, MIN_INSTANCE_BUFFER_SIZE);
+    return m_instanceBuffer;
+}
+
+GpuBufferID ModelScene::GetDrawArgsBuffer(u32 minSize)
+{
+    GrowFrameBuffer(&m_drawArgsBuffer, &m_drawArgsBufferSize,
+                    GPU_BUFFER_TYPE_INDIRECT, minSize, MIN_DRAW_ARGS_BUFFER_SIZE);
+    return m_drawArgsBuffer;
+}
+
+void ModelScene::GrowFrameBuffer(GpuBufferID* buffer,
+                                 u32* size,
+                                 GpuBufferType type,
+                                 u32 minSize,
+                                 u32 initialSize)
+{
+    if (minSize <= *size)
+        return;
+
+    // Earlier draws of the frame may still use the old buffer. No draw items
+    // refer to it past the frame, as they're only kept for the duration of
+    // ModelRenderQueue::Draw().
+    if (*buffer)
+        m_device.BufferDestroyDeferred(*buffer);
+
+    u32 newSize = *size * 2;
+    if (newSize < initialSize)
+        newSize = initialSize;
+    if (newSize < minSize)
+        newSize = minSize;
+
+    *buffer = m_device.BufferCreate(
+        type,
+        GPU_BUFFER_ACCESS_DYNAMIC,
+        NULL,
+        newSize,
+        1 // maxUpdatesPerFrame
+    );
+    *size = newSize;
 }
 
 GpuDevice& ModelScene::GetGpuDevice() const
@@ -2,9 +2,9 @@
 #define MODEL_MODELSCENE_H
 
 #include "GpuDevice/GpuDevice.h"
-#include "GpuDevice/GpuDrawItemPool.h"
 #include "Model/ModelInstance.h"
 #include "Model/ModelCache.h"
+#include "Model/ModelGeometryPool.h"
 
 class FileLoader;
 class GpuSamplerCache;
@@ -18,8 +18,10 @@ public:
     enum PSOFlag {
         PSOFLAG_SKYBOX = 1 << 0,
         PSOFLAG_WIREFRAME = 1 << 1,
+        // The diffuse texture is an array texture, sliced by the instance.
+        PSOFLAG_TEXTURE_ARRAY = 1 << 2,
 
-        PSOFLAG_NUMPERMUTATIONS = 1 << 2,
+        PSOFLAG_NUMPERMUTATIONS = 1 << 3,
     };
 
     struct SceneCBuffer {
@@ -45,19 +47,39 @@ public:
 
     void Update();
 
+    // Pipeline state objects are compiled asynchronously. Until the returned
+    // PSO is ready, draw items that use it are drawn with a fallback PSO (the
+    // PSO that it replaces after a shader refresh, or the solid PSO for a
+    // wireframe PSO), or are skipped if there is no fallback that's ready.
     GpuPipelineStateID RequestPSO(u32 flags);
     GpuSamplerID GetSamplerUVClamp() const;
     GpuSamplerID GetSamplerUVRepeat() const;
     GpuTextureID GetDefaultTexture() const;
-    GpuDrawItemPool& GetDrawItemPool();
     GpuBufferID GetSceneCBuffer() const;
+
+    // Returns a dynamic-mode buffer of at least minSize bytes to hold the
+    // per-instance data for the current frame. The buffer may be recreated
+    // when it needs to grow, so the returned ID is only valid until the next
+    // call. The buffer must be mapped at most once per frame.
+    GpuBufferID GetInstanceBuffer(u32 minSize);
+    // As above, but returns a buffer to hold GpuDrawArgs records for the
+    // indirect draw items of the current frame.
+    GpuBufferID GetDrawArgsBuffer(u32 minSize);
     GpuDevice& GetGpuDevice() const;
 private:
     ModelScene(const ModelScene&);
     ModelScene& operator=(const ModelScene&);
 
     static void SamplerCacheCallback(GpuSamplerCache& cache, void* userdata);
-    void RefreshPSOsMatching(u32, u32);
+    void CreatePSO(u32 flags, GpuPipelineStateID fallback);
+    ShaderAsset* GetPSOShader(u32 flags) const;
+    void RefreshPSOsMatching(u32 bits, u32 enabled);
+    void RetireFallbackPSOs();
+    void GrowFrameBuffer(GpuBufferID* buffer,
+                         u32* size,
+                         GpuBufferType type,
+                         u32 minSize,
+                         u32 initialSize);
 
     GpuDevice& m_device;
     FileLoader& m_fileLoader;
@@ -65,19 +87,31 @@ private:
     TextureCache& m_textureCache;
 
     LIST_DECLARE(ModelInstance, m_link) m_modelInstances;
+    // Declared before m_modelCache, which frees its geometry on destruction.
+    ModelGeometryPool m_geometryPool;
     ModelCache m_modelCache;
 
-    GpuDrawItemPool m_drawItemPool;
-
     ShaderAsset* m_modelShader;
     ShaderAsset* m_skyboxShader;
+    ShaderAsset* m_modelArrayShader;
+    ShaderAsset* m_skyboxArrayShader;
 
     GpuBufferID m_sceneCBuffer;
+    GpuBufferID m_instanceBuffer;
+    u32 m_instanceBufferSize;
+    GpuBufferID m_drawArgsBuffer;
+    u32 m_drawArgsBufferSize;
     GpuTextureID m_defaultTexture;
     GpuSamplerID m_samplerUVClamp;
     GpuSamplerID m_samplerUVRepeat;
     GpuInputLayoutID m_inputLayout;
     GpuPipelineStateID m_PSOs[PSOFLAG_NUMPERMUTATIONS];
+    // The shader program that each PSO was created with.
+    GpuShaderProgramID m_PSOShaderPrograms[PSOFLAG_NUMPERMUTATIONS];
+    // The PSOs replaced after a shader refresh, which are kept as fallbacks
+    // until their replacements are ready. Each one holds the previous shader
+    // programs of its shader.
+    GpuPipelineStateID m_fallbackPSOs[PSOFLAG_NUMPERMUTATIONS];
 };
 
 #endif // MODEL_MODELSCENE_H
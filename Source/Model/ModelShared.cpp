@@ -1,6 +1,8 @@
 #include "Model/ModelShared.h"
 
+#include <math.h>
 #include <string.h>
+#include <vector>
 
 #include "Core/Macros.h"
 #include "Core/Endian.h"
@@ -103,6 +105,7 @@ static void MDGFixEndian(u8* mdgData)
 
 ModelShared::ModelShared(
     GpuDevice& device,
+    ModelGeometryPool& geometryPool,
     TextureCache& textureCache,
     u8* mdlData,
     u8* mdgData,
@@ -111,9 +114,11 @@ ModelShared::ModelShared(
     : m_link()
 
     , m_device(device)
-    , m_vertexBuf(0)
-    , m_indexBuf(0)
+    , m_geometryPool(geometryPool)
+    , m_geometry()
     , m_firstInstance(NULL)
+    , m_diffuseArray(NULL)
+    , m_boundingRadius(0.0f)
     , m_refCount(0)
     , m_path()
 {
@@ -128,34 +133,50 @@ ModelShared::ModelShared(
 
     MDGHeader* mdgHeader = (MDGHeader*)mdgData;
 
-    m_vertexBuf = device.BufferCreate(
-        GPU_BUFFER_TYPE_VERTEX,
-        GPU_BUFFER_ACCESS_STATIC,
-        mdgData + mdgHeader->ofsVertices,
-        mdgHeader->nVertices * sizeof(Vertex),
-        0 // maxUpdatesPerFrame (unused)
-    );
+    const Vertex* vertices = (const Vertex*)(mdgData + mdgHeader->ofsVertices);
+    float maxLengthSquared = 0.0f;
+    for (u32 i = 0; i < mdgHeader->nVertices; ++i) {
+        const float* p = vertices[i].position;
+        float lengthSquared = p[0] * p[0] + p[1] * p[1] + p[2] * p[2];
+        if (lengthSquared > maxLengthSquared)
+            maxLengthSquared = lengthSquared;
+    }
+    m_boundingRadius = sqrtf(maxLengthSquared);
 
-    m_indexBuf = device.BufferCreate(
-        GPU_BUFFER_TYPE_INDEX,
-        GPU_BUFFER_ACCESS_STATIC,
-        mdgData + mdgHeader->ofsIndices,
-        mdgHeader->nIndices * sizeof(u32),
-        0 // maxUpdatesPerFrame (unused)
+    geometryPool.Allocate(
+        mdgData + mdgHeader->ofsVertices,
+        mdgHeader->nVertices,
+        (const u32*)(mdgData + mdgHeader->ofsIndices),
+        mdgHeader->nIndices,
+        &m_geometry
     );
 
     MDGTextureInfo* textures = (MDGTextureInfo*)(mdgData + mdgHeader->ofsTextures);
 
+    u32 nTextures = mdgHeader->nTextures;
+    if (nTextures >= 2) {
+        std::vector<const char*> paths(nTextures);
+        for (u32 i = 0; i < nTextures; ++i)
+            paths[i] = (const char*)(mdgData + textures[i].ofsFilename);
+        m_diffuseArray = textureCache.FindOrLoadArray(&paths[0], nTextures);
+    }
+
+    // The texture indices of the submeshes are the slices of the array.
+    if (m_diffuseArray) {
+        m_diffuseArray->AddRef();
+        return;
+    }
+
     u32 nSubmeshes = mdlHeader->nSubmeshes;
     MDLSubmesh* submeshes = (MDLSubmesh*)(GetMDLData() + mdlHeader->ofsSubmeshes);
     for (u32 i = 0; i < nSubmeshes; ++i) {
-        if (submeshes[i].diffuseTextureIndex == 0xFFFFFFFFFFFFFFFF) {
+        if (submeshes[i].diffuseTextureIndex == MDL_NO_TEXTURE) {
             submeshes[i].diffuseTexture = NULL;
         } else {
             MDGTextureInfo& textureInfo = textures[submeshes[i].diffuseTextureIndex];
             const char* filename = (const char*)(mdgData + textureInfo.ofsFilename);
 
-            TextureAsset* texture = textureCache.FindOrLoad(filename);
+            TextureAsset* texture = textureCache.FindOrLoadAsync(filename);
             texture->AddRef();
 
             submeshes[i].diffuseTexture = texture;
@@ -168,15 +189,18 @@ ModelShared::~ModelShared()
     MDLHeader* mdlHeader = (MDLHeader*)GetMDLData();
 
     // Release all the textures
-    u32 nSubmeshes = mdlHeader->nSubmeshes;
-    MDLSubmesh* submeshes = (MDLSubmesh*)(GetMDLData() + mdlHeader->ofsSubmeshes);
-    for (u32 i = 0; i < nSubmeshes; ++i) {
-        if (submeshes[i].diffuseTexture)
-            submeshes[i].diffuseTexture->Release();
+    if (m_diffuseArray) {
+        m_diffuseArray->Release();
+    } else {
+        u32 nSubmeshes = mdlHeader->nSubmeshes;
+        MDLSubmesh* submeshes = (MDLSubmesh*)(GetMDLData() + mdlHeader->ofsSubmeshes);
+        for (u32 i = 0; i < nSubmeshes; ++i) {
+            if (submeshes[i].diffuseTexture)
+                submeshes[i].diffuseTexture->Release();
+        }
     }
 
-    m_device.BufferDestroy(m_vertexBuf);
-    m_device.BufferDestroy(m_indexBuf);
+    m_geometryPool.Free(m_geometry);
 }
 
 void* MDLAlloc(u32 size, void* userdata)
@@ -192,6 +216,7 @@ void* MDGAlloc(u32 size, void* userdata)
 
 ModelShared* ModelShared::Create(
     GpuDevice& device,
+    ModelGeometryPool& geometryPool,
     TextureCache& textureCache,
     FileLoader& loader,
     const char* path
@@ -209,6 +234,7 @@ ModelShared* ModelShared::Create(
     void* assetLocation = mdlData - sizeof(ModelShared);
     ModelShared* asset = new (assetLocation) ModelShared(
         device,
+        geometryPool,
         textureCache,
         mdlData,
         mdgData,
@@ -259,12 +285,32 @@ GpuDevice& ModelShared::GetGpuDevice() const
 
 GpuBufferID ModelShared::GetVertexBuf() const
 {
-    return m_vertexBuf;
+    return m_geometryPool.GetVertexBuf(m_geometry);
 }
 
 GpuBufferID ModelShared::GetIndexBuf() const
 {
-    return m_indexBuf;
+    return m_geometryPool.GetIndexBuf(m_geometry);
+}
+
+u32 ModelShared::GetBaseVertex() const
+{
+    return m_geometry.firstVertex;
+}
+
+u32 ModelShared::GetFirstIndex() const
+{
+    return m_geometry.firstIndex;
+}
+
+float ModelShared::GetBoundingRadius() const
+{
+    return m_boundingRadius;
+}
+
+TextureArrayAsset* ModelShared::GetDiffuseArray() const
+{
+    return m_diffuseArray;
 }
 
 void ModelShared::SetFirstInstance(ModelInstance* instance)
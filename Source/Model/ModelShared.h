@@ -4,9 +4,11 @@
 #include "Core/Types.h"
 #include "Core/List.h"
 #include "GpuDevice/GpuDevice.h"
+#include "Model/ModelGeometryPool.h"
 
 class FileLoader;
 class TextureAsset;
+class TextureArrayAsset;
 class TextureCache;
 class ModelInstance;
 
@@ -17,9 +19,15 @@ struct MDLHeader {
     u32 ofsSubmeshes;
 };
 
+// The diffuseTextureIndex of a submesh without a texture.
+const u64 MDL_NO_TEXTURE = 0xFFFFFFFFFFFFFFFF;
+
 struct MDLSubmesh {
     u32 indexStart;
     u32 indexCount;
+    // Once the model is loaded, this is the diffuse texture, or, if the
+    // model's textures are packed into an array texture (see
+    // ModelShared::GetDiffuseArray()), the slice of the array.
     union {
         u64 diffuseTextureIndex;
         TextureAsset* diffuseTexture;
@@ -38,6 +46,7 @@ public:
 
     static ModelShared* Create(
         GpuDevice& device,
+        ModelGeometryPool& geometryPool,
         TextureCache& textureCache,
         FileLoader& loader,
         const char* path
@@ -51,8 +60,22 @@ public:
     const char* GetPath() const;
     const u8* GetMDLData() const;
     GpuDevice& GetGpuDevice() const;
+    // The geometry is suballocated from buffers shared with other models. The
+    // draws of the model must add GetFirstIndex() to the index starts of the
+    // submeshes and use GetBaseVertex() as their base vertex.
     GpuBufferID GetVertexBuf() const;
     GpuBufferID GetIndexBuf() const;
+    u32 GetBaseVertex() const;
+    u32 GetFirstIndex() const;
+    // The radius of a sphere around the model space origin that contains all
+    // the vertices.
+    float GetBoundingRadius() const;
+    // If the model has at least two textures and they all have the same
+    // format, size and number of mipmap levels, they're packed into an array
+    // texture so that the submeshes can be drawn together. In that case this
+    // returns the array, and the diffuseTextureIndex of each submesh is its
+    // slice (or MDL_NO_TEXTURE). Otherwise this returns NULL.
+    TextureArrayAsset* GetDiffuseArray() const;
 
     void SetFirstInstance(ModelInstance* instance);
     ModelInstance* GetFirstInstance() const;
@@ -65,6 +88,7 @@ private:
 
     ModelShared(
         GpuDevice& device,
+        ModelGeometryPool& geometryPool,
         TextureCache& textureCache,
         u8* mdlData,
         u8* mdgData,
@@ -73,9 +97,11 @@ private:
     ~ModelShared();
 
     GpuDevice& m_device;
-    GpuBufferID m_vertexBuf;
-    GpuBufferID m_indexBuf;
+    ModelGeometryPool& m_geometryPool;
+    ModelGeometryPool::Allocation m_geometry;
     ModelInstance* m_firstInstance;
+    TextureArrayAsset* m_diffuseArray;
+    float m_boundingRadius;
     int m_refCount;
     char m_path[MAX_PATH_LENGTH];
 };
@@ -1,8 +1,10 @@
 #include "Network/NetClient.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "Core/Endian.h"
+#include "Core/Profiler.h"
 #include "Os/SocketOsFunctions.h"
 
 const u32 FLAG_CONNECTED = 1;
@@ -221,6 +223,8 @@ NetClient::~NetClient()
 
 void NetClient::Update()
 {
+    PROFILE_ZONE("NetClient::Update");
+
     fd_set readSet, writeSet;
     FD_ZERO(&readSet);
     FD_ZERO(&writeSet);
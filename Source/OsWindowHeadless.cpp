@@ -0,0 +1,158 @@
+#ifndef __APPLE__
+
+#include "OsWindow.h"
+#include <vector>
+#include <queue>
+
+#include "Core/Macros.h"
+
+// A window that's never shown, for running on machines without a display (for
+// example, with the Null GpuDevice on a Linux build server). It doesn't
+// receive any input, so the only events that it sends are the idle and paint
+// events of each turn of the event loop.
+
+// -----------------------------------------------------------------------------
+// OsWindowHeadlessImpl class declaration
+// -----------------------------------------------------------------------------
+
+class OsWindowHeadlessImpl {
+public:
+    OsWindowHeadlessImpl(int width, int height, const OsWindowPixelFormat& pf);
+    ~OsWindowHeadlessImpl();
+
+    void RegisterEvent(OsEventType type,
+                       void (*callback)(const OsEvent&, void*),
+                       void* userdata);
+    void UnregisterEvent(OsEventType type,
+                         void (*callback)(const OsEvent&, void*),
+                         void* userdata);
+
+    // Implementation-detail methods that don't correspond to OsWindow methods
+    void DispatchEvents();
+    void DispatchEvent(const OsEvent& event);
+    void EnqueueEvent(const OsEvent& event);
+private:
+    struct EventHandler {
+        OsEventType type;
+        void (*callback)(const OsEvent&, void*);
+        void* userdata;
+    };
+
+    std::queue<OsEvent> m_eventQueue;
+    std::vector<EventHandler> m_eventHandlers;
+};
+
+static OsWindowHeadlessImpl* Cast(OsWindow* w) { return (OsWindowHeadlessImpl*)w; }
+static OsWindow* Cast(OsWindowHeadlessImpl* w) { return (OsWindow*)w; }
+
+// The windows that the event loop sends events to, in order of creation.
+static std::vector<OsWindowHeadlessImpl*> s_windows;
+static bool s_quitEventLoop = false;
+
+// -----------------------------------------------------------------------------
+// OsWindowHeadlessImpl class implementation
+// -----------------------------------------------------------------------------
+
+OsWindowHeadlessImpl::OsWindowHeadlessImpl(int width, int height, const OsWindowPixelFormat& pf)
+    : m_eventQueue()
+    , m_eventHandlers()
+{
+    (void)width;
+    (void)height;
+    (void)pf;
+    s_windows.push_back(this);
+}
+
+OsWindowHeadlessImpl::~OsWindowHeadlessImpl()
+{
+    for (size_t i = 0; i < s_windows.size(); ++i) {
+        if (s_windows[i] == this) {
+            s_windows.erase(s_windows.begin() + i);
+            break;
+        }
+    }
+}
+
+void OsWindowHeadlessImpl::RegisterEvent(OsEventType type,
+                                         void (*callback)(const OsEvent&, void*),
+                                         void* userdata)
+{
+    EventHandler handler = {type, callback, userdata};
+    m_eventHandlers.push_back(handler);
+}
+
+void OsWindowHeadlessImpl::UnregisterEvent(OsEventType type,
+                                           void (*callback)(const OsEvent&, void*),
+                                           void* userdata)
+{
+    for (size_t i = 0; i < m_eventHandlers.size(); ++i) {
+        const EventHandler& h = m_eventHandlers[i];
+        if (h.type == type && h.callback == callback && h.userdata == userdata) {
+            m_eventHandlers.erase(m_eventHandlers.begin() + i);
+            break;
+        }
+    }
+}
+
+void OsWindowHeadlessImpl::DispatchEvents()
+{
+    OsEvent idleEvent;
+    idleEvent.type = OSEVENT_IDLE;
+    OsEvent paintEvent;
+    paintEvent.type = OSEVENT_PAINT;
+
+    while (!m_eventQueue.empty()) {
+        DispatchEvent(m_eventQueue.front());
+        m_eventQueue.pop();
+    }
+
+    DispatchEvent(idleEvent);
+    DispatchEvent(paintEvent);
+}
+
+void OsWindowHeadlessImpl::DispatchEvent(const OsEvent& event)
+{
+    for (size_t i = 0; i < m_eventHandlers.size(); ++i) {
+        const EventHandler& h = m_eventHandlers[i];
+        if (h.type == event.type)
+            h.callback(event, h.userdata);
+    }
+}
+
+void OsWindowHeadlessImpl::EnqueueEvent(const OsEvent& event)
+{
+    m_eventQueue.push(event);
+}
+
+void OsWindow::RunEventLoop()
+{
+    s_quitEventLoop = false;
+    while (!s_quitEventLoop) {
+        // An event handler may destroy its window, so the index is checked
+        // against the current number of windows on each iteration.
+        for (size_t i = 0; i < s_windows.size() && !s_quitEventLoop; ++i)
+            s_windows[i]->DispatchEvents();
+    }
+}
+
+void OsWindow::QuitEventLoop()
+{
+    s_quitEventLoop = true;
+}
+
+OsWindow* OsWindow::Create(int width, int height, const OsWindowPixelFormat& pf)
+{ return Cast(new OsWindowHeadlessImpl(width, height, pf)); }
+
+void OsWindow::Destroy(OsWindow* w) { delete Cast(w); }
+
+void OsWindow::RegisterEvent(OsEventType type,
+                             void (*callback)(const OsEvent&, void*),
+                             void* userdata)
+{ Cast(this)->RegisterEvent(type, callback, userdata); }
+
+void OsWindow::UnregisterEvent(OsEventType type,
+                               void (*callback)(const OsEvent&, void*),
+                               void* userdata)
+{ Cast(this)->UnregisterEvent(type, callback, userdata); }
+
+#endif // !__APPLE__
@@ -0,0 +1,147 @@
+#include "Scene/DynamicResolution.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "Core/Macros.h"
+
+// The number of frames after a change of scale whose GPU times are ignored, as
+// they were rendered at the previous scale.
+const int SKIPPED_FRAMES = 3;
+
+// The number of frames that the GPU must be over the budget, on average, for
+// the scale to be lowered, and under HIGH_LOAD of the budget for the scale to
+// be raised. Lowering reacts quickly to avoid dropping frames, while raising
+// waits longer so that the scale doesn't oscillate.
+const int LOWER_FRAMES = 4;
+const int RAISE_FRAMES = 30;
+const float HIGH_LOAD = 0.75f;
+
+// The fraction of the budget that a new scale aims the GPU time at.
+const float TARGET_LOAD = 0.9f;
+// The largest increase of the scale in a single step.
+const float MAX_RAISE = 1.1f;
+// Changes smaller than this aren't made, to avoid reallocating nothing but a
+// few rows of pixels.
+const float MIN_CHANGE = 0.02f;
+
+DynamicResolution::DynamicResolution(const DynamicResolutionDesc& desc)
+    : m_desc()
+    , m_scale(desc.maxScale)
+    , m_gpuMs()
+    , m_nFrames(0)
+    , m_nSkippedFrames(0)
+{
+    SetDesc(desc);
+}
+
+const DynamicResolutionDesc& DynamicResolution::GetDesc() const
+{
+    return m_desc;
+}
+
+void DynamicResolution::SetDesc(const DynamicResolutionDesc& desc)
+{
+    ASSERT(desc.targetFrameMs > 0.0f);
+    ASSERT(0.0f < desc.minScale && desc.minScale <= desc.maxScale);
+    m_desc = desc;
+    SetScale(m_scale);
+}
+
+void DynamicResolution::Update(float cpuMs, float gpuMs)
+{
+    // Before the first frame completes there's no GPU time.
+    if (gpuMs <= 0.0f)
+        return;
+
+    if (m_nSkippedFrames < SKIPPED_FRAMES) {
+        ++m_nSkippedFrames;
+        return;
+    }
+
+    if (m_nFrames == MAX_HISTORY) {
+        memmove(&m_gpuMs[0], &m_gpuMs[1], (MAX_HISTORY - 1) * sizeof m_gpuMs[0]);
+        --m_nFrames;
+    }
+    m_gpuMs[m_nFrames++] = gpuMs;
+
+    const float budget = m_desc.targetFrameMs;
+
+    if (m_nFrames >= LOWER_FRAMES) {
+        float sum = 0.0f;
+        for (int i = m_nFrames - LOWER_FRAMES; i < m_nFrames; ++i)
+            sum += m_gpuMs[i];
+        float average = sum / (float)LOWER_FRAMES;
+        if (average > budget) {
+            SetScale(m_scale * sqrtf(budget * TARGET_LOAD / average));
+            return;
+        }
+    }
+
+    if (m_nFrames >= RAISE_FRAMES && cpuMs <= budget) {
+        float highest = 0.0f;
+        for (int i = m_nFrames - RAISE_FRAMES; i < m_nFrames; ++i) {
+            if (m_gpuMs[i] > highest)
+                highest = m_gpuMs[i];
+        }
+        if (highest < budget * HIGH_LOAD) {
+            float scale = m_scale * sqrtf(budget * TARGET_LOAD / highest);
+            if (scale > m_scale * MAX_RAISE)
+                scale = m_scale * MAX_RAISE;
+            SetScale(scale);
+        }
+    }
+}
+
+void DynamicResolution::SetScale(float scale)
+{
+    if (scale < m_desc.minScale)
+        scale = m_desc.minScale;
+    if (scale > m_desc.maxScale)
+        scale = m_desc.maxScale;
+    if (fabsf(scale - m_scale) < MIN_CHANGE &&
+        scale != m_desc.minScale && scale != m_desc.maxScale)
+        return;
+    if (scale == m_scale)
+        return;
+
+    m_scale = scale;
+    m_nFrames = 0;
+    m_nSkippedFrames = 0;
+}
+
+float DynamicResolution::GetScale() const
+{
+    return m_scale;
+}
+
+void DynamicResolution::ScaleSize(float scale,
+                                  int displayWidth,
+                                  int displayHeight,
+                                  int* width,
+                                  int* height)
+{
+    *width = (int)(displayWidth * scale + 0.5f);
+    *height = (int)(displayHeight * scale + 0.5f);
+    if (*width < 1)
+        *width = 1;
+    if (*height < 1)
+        *height = 1;
+}
+
+void DynamicResolution::GetRenderSize(int displayWidth,
+                                      int displayHeight,
+                                      int* width,
+                                      int* height) const
+{
+    ScaleSize(m_scale, displayWidth, displayHeight, width, height);
+}
+
+void DynamicResolution::GetMaxRenderSize(const DynamicResolutionDesc& desc,
+                                         int displayWidth,
+                                         int displayHeight,
+                                         int* width,
+                                         int* height)
+{
+    ScaleSize(desc.maxScale, displayWidth, displayHeight, width, height);
+}
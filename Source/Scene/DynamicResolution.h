@@ -0,0 +1,74 @@
+#ifndef SCENE_DYNAMICRESOLUTION_H
+#define SCENE_DYNAMICRESOLUTION_H
+
+#include "Core/Types.h"
+
+struct DynamicResolutionDesc {
+    // The frame time to hold, in milliseconds.
+    float targetFrameMs;
+    // The bounds of the scale, which applies to the width and the height of
+    // the display resolution.
+    float minScale;
+    float maxScale;
+};
+
+// Chooses the resolution to render the scene at from the recent CPU and GPU
+// frame times, so that the GPU time stays within the frame budget.
+//
+// Only the GPU time depends on the resolution, so the scale is lowered when
+// the GPU goes over the budget, and raised when it has been comfortably under
+// it for a while. The GPU time is assumed to be proportional to the number of
+// pixels. Rendering fewer pixels doesn't help a CPU-bound frame, so the CPU
+// time never lowers the scale, but the scale isn't raised while the CPU is
+// over the budget, so that the GPU still has headroom once the CPU recovers.
+class DynamicResolution {
+public:
+    explicit DynamicResolution(const DynamicResolutionDesc& desc);
+
+    const DynamicResolutionDesc& GetDesc() const;
+    void SetDesc(const DynamicResolutionDesc& desc);
+
+    // Called once per frame with the CPU time of the frame and the most recent
+    // GPU frame time, in milliseconds.
+    void Update(float cpuMs, float gpuMs);
+
+    float GetScale() const;
+
+    // Returns the size to render at for the given display size, which is at
+    // least 1x1.
+    void GetRenderSize(int displayWidth,
+                       int displayHeight,
+                       int* width,
+                       int* height) const;
+    // Returns the render size at the largest scale, which render targets can
+    // be allocated at so that any scale fits in them.
+    static void GetMaxRenderSize(const DynamicResolutionDesc& desc,
+                                 int displayWidth,
+                                 int displayHeight,
+                                 int* width,
+                                 int* height);
+
+private:
+    DynamicResolution(const DynamicResolution&);
+    DynamicResolution& operator=(const DynamicResolution&);
+
+    void SetScale(float scale);
+    static void ScaleSize(float scale,
+                          int displayWidth,
+                          int displayHeight,
+                          int* width,
+                          int* height);
+
+    static const int MAX_HISTORY = 32;
+
+    DynamicResolutionDesc m_desc;
+    float m_scale;
+    // The GPU times of the frames since the scale last changed. The GPU time
+    // lags the CPU by the frames in flight, so the frames just after a change
+    // are still at the old scale; they're skipped.
+    float m_gpuMs[MAX_HISTORY];
+    int m_nFrames;
+    int m_nSkippedFrames;
+};
+
+#endif // SCENE_DYNAMICRESOLUTION_H
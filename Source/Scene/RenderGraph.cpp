@@ -0,0 +1,552 @@
+#include "Scene/RenderGraph.h"
+
+#include <string.h>
+
+#include "Core/Macros.h"
+#include "Core/Profiler.h"
+
+const u32 NO_INDEX = 0xFFFFFFFF;
+
+// The physical textures that no transient texture was assigned to, and the
+// render passes that no pass used, for this many frames are destroyed, e.g.
+// after the resolution changes.
+const u32 MAX_UNUSED_FRAMES = 3;
+
+static bool DescsEqual(const RenderGraphTextureDesc& a, const RenderGraphTextureDesc& b)
+{
+    return a.pixelFormat == b.pixelFormat &&
+           a.width == b.width &&
+           a.height == b.height;
+}
+
+#ifndef NDEBUG
+// Only used by assertions.
+static bool IsDepthFormat(GpuPixelFormat format)
+{
+    return format == GPU_PIXEL_FORMAT_DEPTH_32 ||
+           format == GPU_PIXEL_FORMAT_DEPTH_24_STENCIL_8;
+}
+#endif
+
+RenderGraph::RenderGraph(GpuDevice& device)
+    : m_device(device)
+    , m_textures()
+    , m_passes()
+    , m_physicalTextures()
+    , m_renderPasses()
+    , m_passTimers()
+    , m_contentsNeeded()
+    , m_contentsWritten()
+    , m_frame(0)
+    , m_executingPass(NO_INDEX)
+    , m_stats()
+{
+    Reset();
+}
+
+RenderGraph::~RenderGraph()
+{
+    for (size_t i = 0; i < m_physicalTextures.size(); ++i)
+        m_device.TextureDestroy(m_physicalTextures[i].texture);
+    for (size_t i = 0; i < m_renderPasses.size(); ++i)
+        m_device.RenderPassDestroy(m_renderPasses[i].renderPass);
+    for (size_t i = 0; i < m_passTimers.size(); ++i)
+        m_device.TimerQueryDestroy(m_passTimers[i].query);
+}
+
+void RenderGraph::Reset()
+{
+    m_textures.clear();
+    m_passes.clear();
+
+    Texture backbuffer;
+    backbuffer.name = "Backbuffer";
+    backbuffer.desc.pixelFormat = GPU_PIXEL_FORMAT_BGRA8888;
+    backbuffer.desc.width = 0;
+    backbuffer.desc.height = 0;
+    backbuffer.gpuTexture = GpuTextureID(0);
+    backbuffer.transient = false;
+    backbuffer.backbuffer = true;
+    backbuffer.output = true;
+    backbuffer.firstPass = NO_INDEX;
+    backbuffer.lastPass = NO_INDEX;
+    backbuffer.physicalTexture = NO_INDEX;
+    m_textures.push_back(backbuffer);
+}
+
+RenderGraphTextureID RenderGraph::GetBackbuffer() const
+{
+    return RenderGraphTextureID(1);
+}
+
+RenderGraphTextureID RenderGraph::CreateTexture(const char* name,
+                                                const RenderGraphTextureDesc& desc)
+{
+    ASSERT(desc.width > 0 && desc.height > 0);
+
+    Texture texture;
+    texture.name = name;
+    texture.desc = desc;
+    texture.gpuTexture = GpuTextureID(0);
+    texture.transient = true;
+    texture.backbuffer = false;
+    texture.output = false;
+    texture.firstPass = NO_INDEX;
+    texture.lastPass = NO_INDEX;
+    texture.physicalTexture = NO_INDEX;
+    m_textures.push_back(texture);
+
+    return RenderGraphTextureID((u32)m_textures.size());
+}
+
+RenderGraphTextureID RenderGraph::ImportTexture(const char* name, GpuTextureID gpuTexture)
+{
+    ASSERT(m_device.TextureExists(gpuTexture));
+
+    Texture texture;
+    texture.name = name;
+    texture.desc.pixelFormat = GPU_PIXEL_FORMAT_BGRA8888;
+    texture.desc.width = 0;
+    texture.desc.height = 0;
+    texture.gpuTexture = gpuTexture;
+    texture.transient = false;
+    texture.backbuffer = false;
+    texture.output = true;
+    texture.firstPass = NO_INDEX;
+    texture.lastPass = NO_INDEX;
+    texture.physicalTexture = NO_INDEX;
+    m_textures.push_back(texture);
+
+    return RenderGraphTextureID((u32)m_textures.size());
+}
+
+void RenderGraph::MarkOutput(RenderGraphTextureID texture)
+{
+    ASSERT(0 < texture && texture <= m_textures.size());
+    m_textures[texture - 1].output = true;
+}
+
+RenderGraphPassID RenderGraph::AddPass(const char* name,
+                                       RenderGraphExecuteFunc execute,
+                                       void* userdata)
+{
+    ASSERT(execute);
+
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.userdata = userdata;
+    pass.nReads = 0;
+    pass.nColorTargets = 0;
+    pass.depthTarget.texture = NO_INDEX;
+    pass.depthTarget.clear = false;
+    pass.depthTarget.store = false;
+    pass.clearDepth = 0.0f;
+    pass.culled = false;
+    m_passes.push_back(pass);
+
+    return RenderGraphPassID((u32)m_passes.size());
+}
+
+void RenderGraph::Read(RenderGraphPassID passID, RenderGraphTextureID texture)
+{
+    ASSERT(0 < passID && passID <= m_passes.size());
+    ASSERT(0 < texture && texture <= m_textures.size());
+    ASSERT(texture != GetBackbuffer() && "The backbuffer can't be read");
+
+    Pass& pass = m_passes[passID - 1];
+    ASSERT(pass.nReads < MAX_PASS_READS);
+    pass.reads[pass.nReads++] = texture - 1;
+}
+
+void RenderGraph::WriteColor(RenderGraphPassID passID,
+                             RenderGraphTextureID texture,
+                             const GpuColor* clearColor)
+{
+    ASSERT(0 < passID && passID <= m_passes.size());
+    ASSERT(0 < texture && texture <= m_textures.size());
+    ASSERT(!IsDepthFormat(m_textures[texture - 1].desc.pixelFormat));
+
+    Pass& pass = m_passes[passID - 1];
+    ASSERT(pass.nColorTargets < MAX_COLOR_TARGETS);
+    // The backbuffer is bound with numRenderTargets == 0, so it can't be
+    // combined with other color targets.
+    ASSERT(pass.nColorTargets == 0 ||
+           (texture != GetBackbuffer() &&
+            pass.colorTargets[0].texture != GetBackbuffer() - 1));
+
+    Target& target = pass.colorTargets[pass.nColorTargets];
+    target.texture = texture - 1;
+    target.clear = (clearColor != NULL);
+    target.store = false;
+    if (clearColor)
+        pass.clearColors[pass.nColorTargets] = *clearColor;
+    else
+        pass.clearColors[pass.nColorTargets] = GpuColor();
+    ++pass.nColorTargets;
+}
+
+void RenderGraph::WriteDepth(RenderGraphPassID passID,
+                             RenderGraphTextureID texture,
+                             const float* clearDepth)
+{
+    ASSERT(0 < passID && passID <= m_passes.size());
+    ASSERT(0 < texture && texture <= m_textures.size());
+    ASSERT(texture != GetBackbuffer());
+
+    Pass& pass = m_passes[passID - 1];
+    ASSERT(pass.depthTarget.texture == NO_INDEX);
+    pass.depthTarget.texture = texture - 1;
+    pass.depthTarget.clear = (clearDepth != NULL);
+    pass.depthTarget.store = false;
+    pass.clearDepth = clearDepth ? *clearDepth : 0.0f;
+}
+
+bool RenderGraph::UsedByPass(const Pass& pass, u32 texture) const
+{
+    for (u32 i = 0; i < pass.nReads; ++i) {
+        if (pass.reads[i] == texture)
+            return true;
+    }
+    for (u32 i = 0; i < pass.nColorTargets; ++i) {
+        if (pass.colorTargets[i].texture == texture)
+            return true;
+    }
+    return pass.depthTarget.texture == texture;
+}
+
+void RenderGraph::CullPasses()
+{
+    // Walk the passes backwards, tracking which textures' contents are needed
+    // by the passes after the current one. A pass is kept if it writes a
+    // texture whose contents are needed. Its targets are stored if their
+    // contents are needed; a target that the pass clears isn't needed before
+    // the pass, and the textures that it reads or loads are.
+    m_contentsNeeded.assign(m_textures.size(), false);
+    for (size_t i = 0; i < m_textures.size(); ++i)
+        m_contentsNeeded[i] = m_textures[i].output;
+
+    for (size_t i = m_passes.size(); i-- > 0; ) {
+        Pass& pass = m_passes[i];
+
+        Target* targets[MAX_COLOR_TARGETS + 1];
+        u32 nTargets = 0;
+        for (u32 j = 0; j < pass.nColorTargets; ++j)
+            targets[nTargets++] = &pass.colorTargets[j];
+        if (pass.depthTarget.texture != NO_INDEX)
+            targets[nTargets++] = &pass.depthTarget;
+
+        pass.culled = true;
+        for (u32 j = 0; j < nTargets; ++j) {
+            targets[j]->store = m_contentsNeeded[targets[j]->texture];
+            if (targets[j]->store)
+                pass.culled = false;
+        }
+        if (pass.culled)
+            continue;
+
+        for (u32 j = 0; j < nTargets; ++j)
+            m_contentsNeeded[targets[j]->texture] = !targets[j]->clear;
+        for (u32 j = 0; j < pass.nReads; ++j) {
+            for (u32 k = 0; k < nTargets; ++k) {
+                ASSERT(targets[k]->texture != pass.reads[j] &&
+                       "A pass can't read a texture that it writes");
+            }
+            m_contentsNeeded[pass.reads[j]] = true;
+        }
+    }
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+    for (u32 i = 0; i < (u32)m_passes.size(); ++i) {
+        const Pass& pass = m_passes[i];
+        if (pass.culled)
+            continue;
+        for (u32 j = 0; j < (u32)m_textures.size(); ++j) {
+            if (!UsedByPass(pass, j))
+                continue;
+            Texture& texture = m_textures[j];
+            if (texture.firstPass == NO_INDEX)
+                texture.firstPass = i;
+            texture.lastPass = i;
+        }
+    }
+}
+
+u32 RenderGraph::AcquirePhysicalTexture(const RenderGraphTextureDesc& desc)
+{
+    for (u32 i = 0; i < (u32)m_physicalTextures.size(); ++i) {
+        PhysicalTexture& physical = m_physicalTextures[i];
+        if (!physical.inUse && DescsEqual(physical.desc, desc)) {
+            physical.inUse = true;
+            physical.lastUsedFrame = m_frame;
+            return i;
+        }
+    }
+
+    PhysicalTexture physical;
+    physical.desc = desc;
+    physical.texture = m_device.TextureCreate(
+        GPU_TEXTURE_2D,
+        desc.pixelFormat,
+        GPU_TEXTURE_FLAG_RENDER_TARGET,
+        desc.width,
+        desc.height,
+        1, // depthOrArrayLength
+        1 // nMipmapLevels
+    );
+    physical.inUse = true;
+    physical.lastUsedFrame = m_frame;
+    m_physicalTextures.push_back(physical);
+    return (u32)m_physicalTextures.size() - 1;
+}
+
+void RenderGraph::FreeUnusedPhysicalTextures()
+{
+    for (size_t i = 0; i < m_physicalTextures.size(); ) {
+        PhysicalTexture& physical = m_physicalTextures[i];
+        if (m_frame - physical.lastUsedFrame >= MAX_UNUSED_FRAMES) {
+            // The frames in flight may still be using the texture.
+            m_device.TextureDestroyDeferred(physical.texture);
+            m_physicalTextures[i] = m_physicalTextures.back();
+            m_physicalTextures.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+bool RenderGraph::RenderPassesEqual(const CachedRenderPass& a,
+                                    const CachedRenderPass& b)
+{
+    if (a.nColorTargets != b.nColorTargets ||
+        a.numRenderTargets != b.numRenderTargets ||
+        a.depthStencilTarget != b.depthStencilTarget ||
+        a.clearDepth != b.clearDepth ||
+        a.depthStencilLoadAction != b.depthStencilLoadAction ||
+        a.depthStencilStoreAction != b.depthStencilStoreAction)
+        return false;
+    for (int i = 0; i < a.numRenderTargets; ++i) {
+        if (a.renderTargets[i] != b.renderTargets[i])
+            return false;
+    }
+    for (u32 i = 0; i < a.nColorTargets; ++i) {
+        const GpuColor& ca = a.clearColors[i];
+        const GpuColor& cb = b.clearColors[i];
+        if (ca.r != cb.r || ca.g != cb.g || ca.b != cb.b || ca.a != cb.a ||
+            a.colorLoadActions[i] != b.colorLoadActions[i] ||
+            a.colorStoreActions[i] != b.colorStoreActions[i])
+            return false;
+    }
+    return true;
+}
+
+GpuRenderPassID RenderGraph::AcquireRenderPass(const CachedRenderPass& key)
+{
+    for (size_t i = 0; i < m_renderPasses.size(); ++i) {
+        CachedRenderPass& cached = m_renderPasses[i];
+        if (RenderPassesEqual(cached, key)) {
+            cached.lastUsedFrame = m_frame;
+            return cached.renderPass;
+        }
+    }
+
+    GpuRenderPassDesc desc;
+    desc.numRenderTargets = key.numRenderTargets;
+    desc.renderTargets = key.renderTargets;
+    desc.clearColors = key.clearColors;
+    desc.colorLoadActions = key.colorLoadActions;
+    desc.colorStoreActions = key.colorStoreActions;
+    desc.depthStencilTarget = key.depthStencilTarget;
+    desc.clearDepth = key.clearDepth;
+    desc.depthStencilLoadAction = key.depthStencilLoadAction;
+    desc.depthStencilStoreAction = key.depthStencilStoreAction;
+
+    CachedRenderPass cached = key;
+    cached.renderPass = m_device.RenderPassCreate(desc);
+    cached.lastUsedFrame = m_frame;
+    m_renderPasses.push_back(cached);
+    return cached.renderPass;
+}
+
+void RenderGraph::FreeUnusedRenderPasses()
+{
+    // A render pass that refers to a destroyed physical texture hasn't been
+    // used since that texture was last used, so it's destroyed no later than
+    // the texture and is never returned for a new texture with the same ID.
+    for (size_t i = 0; i < m_renderPasses.size(); ) {
+        if (m_frame - m_renderPasses[i].lastUsedFrame >= MAX_UNUSED_FRAMES) {
+            // Render passes are only used while the draws are submitted, so
+            // unlike the textures, they can be destroyed immediately.
+            m_device.RenderPassDestroy(m_renderPasses[i].renderPass);
+            m_renderPasses[i] = m_renderPasses.back();
+            m_renderPasses.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+static GpuRenderLoadAction LoadAction(bool clear, bool written)
+{
+    if (clear)
+        return GPU_RENDER_LOAD_ACTION_CLEAR;
+    return written ? GPU_RENDER_LOAD_ACTION_LOAD : GPU_RENDER_LOAD_ACTION_DISCARD;
+}
+
+static GpuRenderStoreAction StoreAction(bool store)
+{
+    return store ? GPU_RENDER_STORE_ACTION_STORE : GPU_RENDER_STORE_ACTION_DISCARD;
+}
+
+void RenderGraph::ExecutePass(u32 passIndex)
+{
+    const Pass& pass = m_passes[passIndex];
+    // A render pass without color targets renders to the backbuffer.
+    ASSERT(pass.nColorTargets > 0);
+
+    // Assign GPU textures to the transient textures that the pass is the
+    // first to use.
+    for (u32 i = 0; i < (u32)m_textures.size(); ++i) {
+        Texture& texture = m_textures[i];
+        if (texture.transient && texture.firstPass == passIndex) {
+            texture.physicalTexture = AcquirePhysicalTexture(texture.desc);
+            texture.gpuTexture = m_physicalTextures[texture.physicalTexture].texture;
+        }
+    }
+
+    CachedRenderPass key;
+    key.nColorTargets = pass.nColorTargets;
+    key.numRenderTargets = 0;
+    for (u32 i = 0; i < pass.nColorTargets; ++i) {
+        const Target& target = pass.colorTargets[i];
+        const Texture& texture = m_textures[target.texture];
+        key.clearColors[i] = pass.clearColors[i];
+        key.colorLoadActions[i] = LoadAction(target.clear,
+                                             m_contentsWritten[target.texture]);
+        key.colorStoreActions[i] = StoreAction(target.store);
+        if (!texture.backbuffer)
+            key.renderTargets[key.numRenderTargets++] = texture.gpuTexture;
+    }
+
+    // Without a depth target, the pass uses the device's depth buffer, which
+    // nothing reads afterwards.
+    key.depthStencilTarget = GpuTextureID(0);
+    key.clearDepth = 0.0f;
+    key.depthStencilLoadAction = GPU_RENDER_LOAD_ACTION_DISCARD;
+    key.depthStencilStoreAction = GPU_RENDER_STORE_ACTION_DISCARD;
+    if (pass.depthTarget.texture != NO_INDEX) {
+        const Target& target = pass.depthTarget;
+        key.depthStencilTarget = m_textures[target.texture].gpuTexture;
+        key.clearDepth = pass.clearDepth;
+        key.depthStencilLoadAction = LoadAction(target.clear,
+                                                m_contentsWritten[target.texture]);
+        key.depthStencilStoreAction = StoreAction(target.store);
+    }
+
+    GpuRenderPassID renderPass = AcquireRenderPass(key);
+
+    u32 timer = FindPassTimer(pass.name);
+    if (timer == NO_INDEX) {
+        PassTimer passTimer;
+        passTimer.name = pass.name;
+        passTimer.query = m_device.TimerQueryCreate();
+        passTimer.lastFrame = 0;
+        m_passTimers.push_back(passTimer);
+        timer = (u32)m_passTimers.size() - 1;
+    }
+    bool timed = (m_passTimers[timer].lastFrame != m_frame);
+    m_passTimers[timer].lastFrame = m_frame;
+
+    if (timed)
+        m_device.TimerQueryBegin(m_passTimers[timer].query);
+    m_executingPass = passIndex;
+    pass.execute(*this, renderPass, pass.userdata);
+    m_executingPass = NO_INDEX;
+    if (timed)
+        m_device.TimerQueryEnd(m_passTimers[timer].query);
+
+    for (u32 i = 0; i < pass.nColorTargets; ++i)
+        m_contentsWritten[pass.colorTargets[i].texture] = true;
+    if (pass.depthTarget.texture != NO_INDEX)
+        m_contentsWritten[pass.depthTarget.texture] = true;
+
+    // Return the GPU textures of the transient textures that the pass is the
+    // last to use, so that later passes can reuse them.
+    for (u32 i = 0; i < (u32)m_textures.size(); ++i) {
+        Texture& texture = m_textures[i];
+        if (texture.transient && texture.lastPass == passIndex)
+            m_physicalTextures[texture.physicalTexture].inUse = false;
+    }
+}
+
+void RenderGraph::Execute()
+{
+    PROFILE_ZONE("RenderGraph::Execute");
+
+    ++m_frame;
+
+    CullPasses();
+    ComputeLifetimes();
+
+    m_contentsWritten.assign(m_textures.size(), false);
+    for (size_t i = 0; i < m_textures.size(); ++i)
+        m_contentsWritten[i] = !m_textures[i].transient && !m_textures[i].backbuffer;
+
+    m_stats.nPasses = (u32)m_passes.size();
+    m_stats.nCulledPasses = 0;
+    for (u32 i = 0; i < (u32)m_passes.size(); ++i) {
+        if (m_passes[i].culled)
+            ++m_stats.nCulledPasses;
+        else
+            ExecutePass(i);
+    }
+
+    FreeUnusedPhysicalTextures();
+    FreeUnusedRenderPasses();
+
+    m_stats.nTransientTextures = 0;
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        if (m_textures[i].transient && m_textures[i].firstPass != NO_INDEX)
+            ++m_stats.nTransientTextures;
+    }
+    m_stats.nPhysicalTextures = (u32)m_physicalTextures.size();
+    m_stats.physicalBytes = 0;
+    for (size_t i = 0; i < m_physicalTextures.size(); ++i) {
+        const RenderGraphTextureDesc& desc = m_physicalTextures[i].desc;
+        m_stats.physicalBytes += GpuDevice::TextureSizeInBytes(
+            GPU_TEXTURE_2D, desc.pixelFormat, desc.width, desc.height, 1, 1
+        );
+    }
+}
+
+GpuTextureID RenderGraph::GetGpuTexture(RenderGraphTextureID texture) const
+{
+    ASSERT(0 < texture && texture <= m_textures.size());
+    ASSERT(m_executingPass != NO_INDEX &&
+           UsedByPass(m_passes[m_executingPass], texture - 1));
+    return m_textures[texture - 1].gpuTexture;
+}
+
+const RenderGraphStats& RenderGraph::GetStats() const
+{
+    return m_stats;
+}
+
+u32 RenderGraph::FindPassTimer(const char* name) const
+{
+    for (u32 i = 0; i < (u32)m_passTimers.size(); ++i) {
+        if (strcmp(m_passTimers[i].name, name) == 0)
+            return i;
+    }
+    return NO_INDEX;
+}
+
+bool RenderGraph::GetPassGpuTime(const char* name, float* milliseconds) const
+{
+    u32 timer = FindPassTimer(name);
+    if (timer == NO_INDEX)
+        return false;
+    return m_device.TimerQueryGetResult(m_passTimers[timer].query, milliseconds, NULL);
+}
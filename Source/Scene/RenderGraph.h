@@ -0,0 +1,214 @@
+#ifndef SCENE_RENDERGRAPH_H
+#define SCENE_RENDERGRAPH_H
+
+#include <vector>
+#include "Core/Types.h"
+#include "GpuDevice/GpuDevice.h"
+
+class RenderGraph;
+
+DECLARE_PRIMITIVE_WRAPPER(u32, RenderGraphTextureID);
+DECLARE_PRIMITIVE_WRAPPER(u32, RenderGraphPassID);
+
+struct RenderGraphTextureDesc {
+    GpuPixelFormat pixelFormat;
+    int width;
+    int height;
+};
+
+struct RenderGraphStats {
+    u32 nPasses;
+    // The passes that were skipped because nothing used their output.
+    u32 nCulledPasses;
+    u32 nTransientTextures;
+    // The GPU textures that the transient textures of the frame were assigned
+    // to, and the memory that they use.
+    u32 nPhysicalTextures;
+    u64 physicalBytes;
+};
+
+// Called to draw a pass, with the render pass that the graph created for it.
+typedef void (*RenderGraphExecuteFunc)(RenderGraph& graph,
+                                       GpuRenderPassID renderPass,
+                                       void* userdata);
+
+// Schedules the render passes of a frame from the render targets that they
+// read and write.
+//
+// Each frame, the renderer declares its textures and passes, then calls
+// Execute(), which:
+//   - Skips the passes whose output isn't read by a later pass or written to
+//     the backbuffer, an imported texture or an output texture.
+//   - Chooses the load and store action of each render target: a target is
+//     cleared if the pass asks for it, loaded if an earlier pass wrote it, and
+//     otherwise discarded; it's stored only if a later pass needs it.
+//   - Assigns GPU textures to the transient textures. Transient textures with
+//     the same description whose lifetimes don't overlap share a GPU texture,
+//     and the GPU textures are kept from frame to frame, so render-target
+//     memory doesn't grow with the number of passes.
+//   - Creates the render pass of each executed pass. Render passes are kept
+//     from frame to frame and only recreated when a pass's targets, clear
+//     values or load and store actions change, e.g. when a transient texture
+//     is assigned a different GPU texture or the resolution changes.
+//
+// The passes are executed in the order that they were added. Names must
+// outlive the graph, e.g. be string literals. The GPU time of each executed
+// pass is measured with a timer query, which is kept for the pass's name from
+// frame to frame, so only the first of several passes with the same name in a
+// frame is timed.
+class RenderGraph {
+public:
+    static const int MAX_COLOR_TARGETS = 4;
+    static const int MAX_PASS_READS = 8;
+
+    explicit RenderGraph(GpuDevice& device);
+    ~RenderGraph();
+
+    // Starts declaring a new frame, forgetting the passes and textures of the
+    // previous one.
+    void Reset();
+
+    // The device's backbuffer. A pass that writes it is never skipped.
+    RenderGraphTextureID GetBackbuffer() const;
+    // Transient textures only exist within the frame: their contents are
+    // undefined before the first pass that writes them.
+    RenderGraphTextureID CreateTexture(const char* name,
+                                       const RenderGraphTextureDesc& desc);
+    // Imported textures are owned by the caller, and their contents are kept
+    // between frames.
+    RenderGraphTextureID ImportTexture(const char* name, GpuTextureID texture);
+    // Keeps the passes that write the texture, even if no pass reads it.
+    void MarkOutput(RenderGraphTextureID texture);
+
+    RenderGraphPassID AddPass(const char* name,
+                              RenderGraphExecuteFunc execute,
+                              void* userdata);
+    // The pass samples the texture.
+    void Read(RenderGraphPassID pass, RenderGraphTextureID texture);
+    // The pass renders to the texture, as the next color target. If
+    // clearColor is NULL, the pass keeps the texture's current contents.
+    void WriteColor(RenderGraphPassID pass,
+                    RenderGraphTextureID texture,
+                    const GpuColor* clearColor);
+    // The pass uses the texture as its depth target. If clearDepth is NULL,
+    // the pass keeps the texture's current contents.
+    void WriteDepth(RenderGraphPassID pass,
+                    RenderGraphTextureID texture,
+                    const float* clearDepth);
+
+    void Execute();
+
+    // Returns the GPU texture of a texture. This can only be called from the
+    // execute function of a pass that uses the texture.
+    GpuTextureID GetGpuTexture(RenderGraphTextureID texture) const;
+
+    // The statistics of the last call to Execute().
+    const RenderGraphStats& GetStats() const;
+
+    // Returns the most recently measured GPU time of the pass with the given
+    // name, in milliseconds, or false if none has been resolved yet. The time
+    // is from a few frames ago.
+    bool GetPassGpuTime(const char* name, float* milliseconds) const;
+
+private:
+    RenderGraph(const RenderGraph&);
+    RenderGraph& operator=(const RenderGraph&);
+
+    struct Texture {
+        const char* name;
+        RenderGraphTextureDesc desc;
+        // For transient textures, the GPU texture assigned by Execute().
+        GpuTextureID gpuTexture;
+        bool transient;
+        bool backbuffer;
+        bool output;
+        // The range of passes that use the texture, among those that aren't
+        // culled.
+        u32 firstPass;
+        u32 lastPass;
+        u32 physicalTexture;
+    };
+
+    struct Target {
+        u32 texture;
+        bool clear;
+        // Set by Execute(): whether a later pass needs the contents.
+        bool store;
+    };
+
+    struct Pass {
+        const char* name;
+        RenderGraphExecuteFunc execute;
+        void* userdata;
+        u32 nReads;
+        u32 reads[MAX_PASS_READS];
+        u32 nColorTargets;
+        Target colorTargets[MAX_COLOR_TARGETS];
+        GpuColor clearColors[MAX_COLOR_TARGETS];
+        Target depthTarget;
+        float clearDepth;
+        bool culled;
+    };
+
+    struct PassTimer {
+        const char* name;
+        GpuTimerQueryID query;
+        u32 lastFrame;
+    };
+
+    // A render pass created by ExecutePass(), with the description that it was
+    // created from. The arrays have nColorTargets elements, except for
+    // renderTargets, which has numRenderTargets.
+    struct CachedRenderPass {
+        u32 nColorTargets;
+        int numRenderTargets;
+        GpuTextureID renderTargets[MAX_COLOR_TARGETS];
+        GpuColor clearColors[MAX_COLOR_TARGETS];
+        GpuRenderLoadAction colorLoadActions[MAX_COLOR_TARGETS];
+        GpuRenderStoreAction colorStoreActions[MAX_COLOR_TARGETS];
+        GpuTextureID depthStencilTarget;
+        float clearDepth;
+        GpuRenderLoadAction depthStencilLoadAction;
+        GpuRenderStoreAction depthStencilStoreAction;
+
+        GpuRenderPassID renderPass;
+        u32 lastUsedFrame;
+    };
+
+    // A GPU texture that transient textures are assigned to.
+    struct PhysicalTexture {
+        RenderGraphTextureDesc desc;
+        GpuTextureID texture;
+        bool inUse;
+        u32 lastUsedFrame;
+    };
+
+    void CullPasses();
+    void ComputeLifetimes();
+    void ExecutePass(u32 passIndex);
+    u32 AcquirePhysicalTexture(const RenderGraphTextureDesc& desc);
+    void FreeUnusedPhysicalTextures();
+    static bool RenderPassesEqual(const CachedRenderPass& a,
+                                  const CachedRenderPass& b);
+    GpuRenderPassID AcquireRenderPass(const CachedRenderPass& key);
+    void FreeUnusedRenderPasses();
+    bool UsedByPass(const Pass& pass, u32 texture) const;
+    u32 FindPassTimer(const char* name) const;
+
+    GpuDevice& m_device;
+    std::vector<Texture> m_textures;
+    std::vector<Pass> m_passes;
+    std::vector<PhysicalTexture> m_physicalTextures;
+    std::vector<CachedRenderPass> m_renderPasses;
+    std::vector<PassTimer> m_passTimers;
+    // Used by CullPasses(): whether a later pass needs each texture's
+    // contents.
+    std::vector<bool> m_contentsNeeded;
+    // Used by ExecutePass(): whether each texture has been written.
+    std::vector<bool> m_contentsWritten;
+    u32 m_frame;
+    u32 m_executingPass;
+    RenderGraphStats m_stats;
+};
+
+#endif // SCENE_RENDERGRAPH_H
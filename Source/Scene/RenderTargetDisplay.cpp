@@ -1,11 +1,16 @@
 #include "Scene/RenderTargetDisplay.h"
 
+#include <string.h>
+
 #include "Core/Macros.h"
 
 #include "GpuDevice/GpuSamplerCache.h"
 
 #include "Shader/ShaderAsset.h"
 
+// Four vertices of a position (3 floats) and a texture coordinate (2 floats).
+const unsigned VERTEX_BUF_SIZE = 4 * 5 * sizeof(float);
+
 static GpuDrawItemWriterDesc GetDrawItemDesc()
 {
     GpuDrawItemWriterDesc desc;
@@ -31,8 +36,9 @@ RenderTargetDisplay::RenderTargetDisplay(
     : m_device(device)
     , m_samplerCache(samplerCache)
     , m_shader(shaderCache.FindOrLoad("Shaders\\BlitRT"))
-    , m_renderPass()
     , m_vertexBuf()
+    , m_scaleX(0.0f)
+    , m_scaleY(0.0f)
     , m_inputLayout()
     , m_sampler(samplerCache.Acquire(GPU_SAMPLER_ADDRESS_CLAMP_TO_EDGE))
     , m_pipelineStateObj()
@@ -43,34 +49,16 @@ RenderTargetDisplay::RenderTargetDisplay(
     m_samplerCache.RegisterCallback(&RenderTargetDisplay::SamplerCacheCallback,
                                     (void*)this);
 
-    GpuRenderLoadAction loadAction = GPU_RENDER_LOAD_ACTION_DISCARD;
-    GpuRenderStoreAction storeAction = GPU_RENDER_STORE_ACTION_STORE;
-
-    GpuRenderPassDesc renderPassDesc;
-    renderPassDesc.numRenderTargets = 0;
-    renderPassDesc.colorLoadActions = &loadAction;
-    renderPassDesc.colorStoreActions = &storeAction;
-    renderPassDesc.depthStencilLoadAction = GPU_RENDER_LOAD_ACTION_DISCARD;
-    renderPassDesc.depthStencilStoreAction = GPU_RENDER_STORE_ACTION_STORE;
-    m_renderPass = m_device.RenderPassCreate(renderPassDesc);
-
-    float vertices[] = {
-        // Top right
-        1.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-        // Top left
-        -1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-        // Bottom right
-        1.0f, -1.0f, 0.0f, 1.0f, 1.0f,
-        // Bottom left
-        -1.0f, -1.0f, 0.0f, 0.0f, 1.0f,
-    };
+    // Rewritten when the scale changes, which is rare enough for a dynamic
+    // buffer.
     m_vertexBuf = m_device.BufferCreate(
         GPU_BUFFER_TYPE_VERTEX,
-        GPU_BUFFER_ACCESS_STATIC,
-        vertices,
-        sizeof vertices,
+        GPU_BUFFER_ACCESS_DYNAMIC,
+        NULL,
+        VERTEX_BUF_SIZE,
         0 // maxUpdatesPerFrame (unused)
     );
+    WriteVertices(1.0f, 1.0f);
 
     GpuVertexAttribute attribs[] = {
         {GPU_VERTEX_ATTRIB_FLOAT3, 0, 0},
@@ -92,7 +80,6 @@ RenderTargetDisplay::~RenderTargetDisplay()
     m_device.PipelineStateDestroy(m_pipelineStateObj);
     m_device.InputLayoutDestroy(m_inputLayout);
     m_device.BufferDestroy(m_vertexBuf);
-    m_device.RenderPassDestroy(m_renderPass);
     m_samplerCache.Release(m_sampler);
 
     m_samplerCache.UnregisterCallback(&RenderTargetDisplay::SamplerCacheCallback,
@@ -103,13 +90,19 @@ RenderTargetDisplay::~RenderTargetDisplay()
 
 void RenderTargetDisplay::CopyToBackbuffer(
     const GpuViewport& viewport,
+    GpuRenderPassID renderPass,
     GpuTextureID colorBuf,
-    GpuTextureID depthBuf
+    GpuTextureID depthBuf,
+    float scaleX,
+    float scaleY
 )
 {
     if (m_shader->PollRefreshed())
         CreatePSO();
 
+    if (scaleX != m_scaleX || scaleY != m_scaleY)
+        WriteVertices(scaleX, scaleY);
+
     ASSERT(GpuDrawItemWriter::SizeInBytes(GetDrawItemDesc()) == sizeof m_drawItem);
     GpuDrawItemWriter writer;
     writer.Begin(&m_device, GetDrawItemDesc(), m_drawItem);
@@ -121,7 +114,7 @@ void RenderTargetDisplay::CopyToBackbuffer(
     writer.SetDrawCall(GPU_PRIMITIVE_TRIANGLE_STRIP, 0, 4);
     GpuDrawItem* drawItem = writer.End();
 
-    m_device.Draw(&drawItem, 1, m_renderPass, viewport);
+    m_device.Draw(&drawItem, 1, renderPass, viewport);
 
     GPUDEVICE_UNREGISTER_DRAWITEM(m_device, drawItem);
 }
@@ -141,3 +134,23 @@ void RenderTargetDisplay::CreatePSO()
 
     m_pipelineStateObj = m_device.PipelineStateCreate(pipelineStateDesc);
 }
+
+void RenderTargetDisplay::WriteVertices(float scaleX, float scaleY)
+{
+    float vertices[] = {
+        // Top right
+        1.0f, 1.0f, 0.0f, scaleX, 0.0f,
+        // Top left
+        -1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+        // Bottom right
+        1.0f, -1.0f, 0.0f, scaleX, scaleY,
+        // Bottom left
+        -1.0f, -1.0f, 0.0f, 0.0f, scaleY,
+    };
+    ASSERT(sizeof vertices == VERTEX_BUF_SIZE);
+    memcpy(m_device.BufferMap(m_vertexBuf), vertices, sizeof vertices);
+    m_device.BufferUnmap(m_vertexBuf);
+
+    m_scaleX = scaleX;
+    m_scaleY = scaleY;
+}
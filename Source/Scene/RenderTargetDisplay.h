@@ -18,10 +18,15 @@ public:
     );
     ~RenderTargetDisplay();
 
+    // Stretches the top-left corner of the buffers, of the given fraction of
+    // their width and height, over the viewport, filtering the pixels.
     void CopyToBackbuffer(
         const GpuViewport& viewport,
+        GpuRenderPassID renderPass,
         GpuTextureID colorBuf,
-        GpuTextureID depthBuf
+        GpuTextureID depthBuf,
+        float scaleX,
+        float scaleY
     );
 
 private:
@@ -30,6 +35,7 @@ private:
 
     static void SamplerCacheCallback(GpuSamplerCache& cache, void* userdata);
     void CreatePSO();
+    void WriteVertices(float scaleX, float scaleY);
 
     static const int DRAW_ITEM_SIZE =
         GpuDrawItemSize::Base
@@ -40,8 +46,9 @@ private:
     GpuDevice& m_device;
     GpuSamplerCache& m_samplerCache;
     ShaderAsset* m_shader;
-    GpuRenderPassID m_renderPass;
     GpuBufferID m_vertexBuf;
+    float m_scaleX;
+    float m_scaleY;
     GpuInputLayoutID m_inputLayout;
     GpuSamplerID m_sampler;
     GpuPipelineStateID m_pipelineStateObj;
@@ -2,30 +2,50 @@
 
 #include <math.h>
 
+#include "Core/Profiler.h"
+
 #include "Model/ModelInstance.h"
 
 static const Vector3 s_dirToLight(0.0f, 0.0f, 1.0f);
 static const Vector3 s_irradiance(1.0f, 1.0f, 1.0f);
 static const Vector3 s_ambientRadiance(0.3f, 0.3f, 0.3f);
 
+static DynamicResolutionDesc DefaultDynamicResolutionDesc()
+{
+    DynamicResolutionDesc desc;
+    desc.targetFrameMs = 1000.0f / 60.0f;
+    desc.minScale = 0.5f;
+    desc.maxScale = 1.0f;
+    return desc;
+}
+
 Scene::Scene(
     GpuDevice& device,
     FileLoader& loader,
     GpuSamplerCache& samplerCache,
     ShaderCache& shaderCache,
-    TextureCache& textureCache
+    TextureCache& textureCache,
+    TaskPool& taskPool
 )
     : m_device(device)
+    , m_taskPool(taskPool)
     , m_renderTargetDisplay(device, samplerCache, shaderCache)
+    , m_renderGraph(device)
 
     , m_modelScene(device, loader, samplerCache, shaderCache, textureCache)
     , m_modelRenderQueue()
     , m_modelInstances(NULL)
     , m_skybox(NULL)
 
+    , m_dynamicResolution(DefaultDynamicResolutionDesc())
+
+    , m_viewport()
+    , m_renderViewport()
+    , m_renderScaleX(1.0f)
+    , m_renderScaleY(1.0f)
+    , m_sceneInfo()
     , m_colorRenderTarget()
     , m_depthRenderTarget()
-    , m_renderPass()
 
     , m_cameraPos()
     , m_forward()
@@ -35,47 +55,10 @@ Scene::Scene(
     , m_zFar(0.0f)
     , m_fovY(0.0f)
 {
-    m_colorRenderTarget = device.TextureCreate(
-        GPU_TEXTURE_2D,
-        GPU_PIXEL_FORMAT_BGRA8888,
-        GPU_TEXTURE_FLAG_RENDER_TARGET,
-        device.GetFormat().resolutionX, // width
-        device.GetFormat().resolutionY, // height
-        1, // depthOrArrayLength
-        1 // nMipmapLevels
-    );
-    m_depthRenderTarget = device.TextureCreate(
-        GPU_TEXTURE_2D,
-        GPU_PIXEL_FORMAT_DEPTH_32,
-        GPU_TEXTURE_FLAG_RENDER_TARGET,
-        device.GetFormat().resolutionX, // width
-        device.GetFormat().resolutionY, // height
-        1, // depthOrArrayLength
-        1 // nMipmapLevels
-    );
-
-    GpuRenderLoadAction colorLoadAction = GPU_RENDER_LOAD_ACTION_DISCARD;
-    GpuRenderStoreAction colorStoreAction = GPU_RENDER_STORE_ACTION_STORE;
-    GpuColor clearColor = {0.0f, 0.0f, 0.0f, 0.0f};
-    GpuRenderPassDesc renderPassDesc;
-    renderPassDesc.clearColors = &clearColor;
-    renderPassDesc.colorLoadActions = &colorLoadAction;
-    renderPassDesc.colorStoreActions = &colorStoreAction;
-    renderPassDesc.clearDepth = 1.0f;
-    renderPassDesc.numRenderTargets = 1;
-    renderPassDesc.renderTargets = &m_colorRenderTarget;
-    renderPassDesc.depthStencilTarget = m_depthRenderTarget;
-    renderPassDesc.depthStencilLoadAction = GPU_RENDER_LOAD_ACTION_CLEAR;
-    renderPassDesc.depthStencilStoreAction = GPU_RENDER_STORE_ACTION_STORE;
-    m_renderPass = device.RenderPassCreate(renderPassDesc);
 }
 
 Scene::~Scene()
 {
-    m_device.TextureDestroy(m_colorRenderTarget);
-    m_device.TextureDestroy(m_depthRenderTarget);
-    m_device.RenderPassDestroy(m_renderPass);
-
     for (size_t i = 0; i < m_modelInstances.size(); ++i) {
         m_modelScene.DestroyModelInstance(m_modelInstances[i]);
     }
@@ -134,6 +117,8 @@ static Matrix44 CreatePerspectiveMatrix(float aspect, float fovY, float zNear, f
 
 void Scene::Render(const GpuViewport& viewport)
 {
+    PROFILE_ZONE("Scene::Render");
+
     float aspect = (float)viewport.width / (float)viewport.height;
     Matrix44 projTransform = CreatePerspectiveMatrix(aspect, m_fovY, m_zNear, m_zFar);
 
@@ -145,24 +130,96 @@ void Scene::Render(const GpuViewport& viewport)
     );
     Matrix44 viewTransform = ZUpToYUpMatrix() * cameraToWorld.AffineInverse();
 
-    ModelRenderQueue::SceneInfo info;
-    info.viewProjTransform = projTransform * viewTransform;
-    info.cameraPos = m_cameraPos;
-    info.dirToLight = s_dirToLight;
-    info.irradiance = s_irradiance;
-    info.ambientRadiance = s_ambientRadiance;
+    m_viewport = viewport;
+
+    int renderWidth, renderHeight;
+    m_dynamicResolution.GetRenderSize(viewport.width, viewport.height,
+                                      &renderWidth, &renderHeight);
+    int targetWidth, targetHeight;
+    DynamicResolution::GetMaxRenderSize(m_dynamicResolution.GetDesc(),
+                                        viewport.width, viewport.height,
+                                        &targetWidth, &targetHeight);
+    m_renderViewport = viewport;
+    m_renderViewport.x = 0;
+    m_renderViewport.y = 0;
+    m_renderViewport.width = (u16)renderWidth;
+    m_renderViewport.height = (u16)renderHeight;
+    m_renderScaleX = (float)renderWidth / (float)targetWidth;
+    m_renderScaleY = (float)renderHeight / (float)targetHeight;
+
+    m_sceneInfo.viewProjTransform = projTransform * viewTransform;
+    m_sceneInfo.cameraPos = m_cameraPos;
+    m_sceneInfo.dirToLight = s_dirToLight;
+    m_sceneInfo.irradiance = s_irradiance;
+    m_sceneInfo.ambientRadiance = s_ambientRadiance;
+    m_sceneInfo.screenScale = (float)viewport.height / (2.0f * tanf(m_fovY * 0.5f));
 
     m_modelScene.Update();
 
     m_modelRenderQueue.Clear();
+    m_modelRenderQueue.SetViewpoint(m_cameraPos, m_forward);
     for (size_t i = 0; i < m_modelInstances.size(); ++i) {
         m_modelRenderQueue.Add(m_modelInstances[i]);
     }
     if (m_skybox)
         m_modelRenderQueue.Add(m_skybox);
-    m_modelRenderQueue.Draw(m_modelScene, info, viewport, m_renderPass);
 
-    m_renderTargetDisplay.CopyToBackbuffer(
-        viewport, m_colorRenderTarget, m_depthRenderTarget
+    m_renderGraph.Reset();
+
+    RenderGraphTextureDesc colorDesc;
+    colorDesc.pixelFormat = GPU_PIXEL_FORMAT_BGRA8888;
+    colorDesc.width = targetWidth;
+    colorDesc.height = targetHeight;
+    m_colorRenderTarget = m_renderGraph.CreateTexture("SceneColor", colorDesc);
+
+    RenderGraphTextureDesc depthDesc = colorDesc;
+    depthDesc.pixelFormat = GPU_PIXEL_FORMAT_DEPTH_32;
+    m_depthRenderTarget = m_renderGraph.CreateTexture("SceneDepth", depthDesc);
+
+    // The skybox covers the whole screen, so the color target isn't cleared.
+    const float clearDepth = 1.0f;
+    RenderGraphPassID modelPass = m_renderGraph.AddPass(
+        "Models", &Scene::DrawModels, (void*)this
     );
+    m_renderGraph.WriteColor(modelPass, m_colorRenderTarget, NULL);
+    m_renderGraph.WriteDepth(modelPass, m_depthRenderTarget, &clearDepth);
+
+    RenderGraphPassID displayPass = m_renderGraph.AddPass(
+        "Display", &Scene::DisplayRenderTargets, (void*)this
+    );
+    m_renderGraph.Read(displayPass, m_colorRenderTarget);
+    m_renderGraph.Read(displayPass, m_depthRenderTarget);
+    m_renderGraph.WriteColor(displayPass, m_renderGraph.GetBackbuffer(), NULL);
+
+    m_renderGraph.Execute();
+}
+
+void Scene::DrawModels(RenderGraph& graph, GpuRenderPassID renderPass, void* userdata)
+{
+    Scene* self = (Scene*)userdata;
+    self->m_modelRenderQueue.Draw(self->m_modelScene,
+                                  self->m_sceneInfo,
+                                  self->m_renderViewport,
+                                  renderPass,
+                                  self->m_taskPool);
+}
+
+void Scene::DisplayRenderTargets(RenderGraph& graph,
+                                 GpuRenderPassID renderPass,
+                                 void* userdata)
+{
+    Scene* self = (Scene*)userdata;
+    self->m_renderTargetDisplay.CopyToBackbuffer(
+        self->m_viewport,
+        renderPass,
+        graph.GetGpuTexture(self->m_colorRenderTarget),
+        graph.GetGpuTexture(self->m_depthRenderTarget),
+        self->m_renderScaleX,
+        self->m_renderScaleY
+    );
+}
+
+DynamicResolution& Scene::GetDynamicResolution()
+{
+    return m_dynamicResolution;
 }
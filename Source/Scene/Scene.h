@@ -4,10 +4,13 @@
 #include "Math/Matrix44.h"
 #include "Model/ModelScene.h"
 #include "Model/ModelRenderQueue.h"
+#include "Scene/DynamicResolution.h"
+#include "Scene/RenderGraph.h"
 #include "Scene/RenderTargetDisplay.h"
 
 class GpuSamplerCache;
 class ShaderCache;
+class TaskPool;
 template<class T> class AssetCache;
 
 struct SceneUpdateInfo {
@@ -27,7 +30,8 @@ public:
         FileLoader& loader,
         GpuSamplerCache& samplerCache,
         ShaderCache& shaderCache,
-        TextureCache& textureCache
+        TextureCache& textureCache,
+        TaskPool& taskPool
     );
     ~Scene();
 
@@ -36,22 +40,45 @@ public:
     void RefreshModel(const char* path);
 
     void Update(const SceneUpdateInfo& info);
+    // Renders the scene at the resolution chosen by the dynamic resolution
+    // controller, and upscales it to the viewport of the backbuffer.
     void Render(const GpuViewport& viewport);
+
+    DynamicResolution& GetDynamicResolution();
 private:
     Scene(const Scene&);
     Scene& operator=(const Scene&);
 
+    static void DrawModels(RenderGraph& graph,
+                           GpuRenderPassID renderPass,
+                           void* userdata);
+    static void DisplayRenderTargets(RenderGraph& graph,
+                                     GpuRenderPassID renderPass,
+                                     void* userdata);
+
     GpuDevice& m_device;
+    TaskPool& m_taskPool;
     RenderTargetDisplay m_renderTargetDisplay;
+    RenderGraph m_renderGraph;
 
     ModelScene m_modelScene;
     ModelRenderQueue m_modelRenderQueue;
     std::vector<ModelInstance*> m_modelInstances;
     ModelInstance* m_skybox;
 
-    GpuTextureID m_colorRenderTarget;
-    GpuTextureID m_depthRenderTarget;
-    GpuRenderPassID m_renderPass;
+    DynamicResolution m_dynamicResolution;
+
+    // The state of the frame being rendered, for the render graph's passes.
+    // The scene is rendered into the top-left corner of the render targets,
+    // which are sized for the largest scale so that changing the scale doesn't
+    // reallocate them.
+    GpuViewport m_viewport;
+    GpuViewport m_renderViewport;
+    float m_renderScaleX;
+    float m_renderScaleY;
+    ModelRenderQueue::SceneInfo m_sceneInfo;
+    RenderGraphTextureID m_colorRenderTarget;
+    RenderGraphTextureID m_depthRenderTarget;
 
     Vector3 m_cameraPos;
     Vector3 m_forward;
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "Core/Macros.h"
+#include "Core/Profiler.h"
 #include "Core/Str.h"
 #include "Core/Path.h"
 #include "Core/FileLoader.h"
@@ -27,7 +28,11 @@ static void* Alloc(u32 size, void*) { return malloc(size); }
 
 static void PrintFullPath(char* dst, size_t dstChars, const char* shaderName)
 {
+#ifdef GPUDEVICE_API_SOFT
+    StrPrintf(dst, dstChars, "%s_SW.shd", shaderName);
+#else
     StrPrintf(dst, dstChars, "%s_MTL.shd", shaderName);
+#endif
 }
 
 ShaderAsset::ShaderAsset(GpuDevice& device, FileLoader& loader, const char* name)
@@ -36,6 +41,7 @@ ShaderAsset::ShaderAsset(GpuDevice& device, FileLoader& loader, const char* name
     , m_device(device)
     , m_shaderProgram(0)
     , m_refCountAndRefreshStatus(0)
+    , m_nPreviousProgramHolds(0)
 {
     char fullPath[SHADER_MAX_PATH_LENGTH];
     PrintFullPath(fullPath, sizeof fullPath, name);
@@ -51,7 +57,7 @@ ShaderAsset::ShaderAsset(GpuDevice& device, FileLoader& loader, const char* name
 
 ShaderAsset::~ShaderAsset()
 {
-    m_device.ShaderProgramDestroy(m_shaderProgram);
+    m_device.ShaderProgramDestroyDeferred(m_shaderProgram);
 }
 
 GpuShaderProgramID ShaderAsset::GetGpuShaderProgramID() const
@@ -104,6 +110,22 @@ bool ShaderAsset::PollRefreshed() const
     return (m_refCountAndRefreshStatus & REFRESH_STATUS_MASK);
 }
 
+void ShaderAsset::HoldPreviousPrograms()
+{
+    ++m_nPreviousProgramHolds;
+}
+
+void ShaderAsset::ReleasePreviousPrograms()
+{
+    ASSERT(m_nPreviousProgramHolds > 0);
+    --m_nPreviousProgramHolds;
+}
+
+bool ShaderAsset::ArePreviousProgramsHeld() const
+{
+    return m_nPreviousProgramHolds > 0;
+}
+
 void ShaderAsset::ClearRefreshedStatus()
 {
     m_refCountAndRefreshStatus &= ~(REFRESH_STATUS_MASK);
@@ -220,6 +242,7 @@ void ShaderCache::RefreshWithPath(const char* path)
 
 void ShaderCache::UpdateRefreshSystem()
 {
+    PROFILE_ZONE("ShaderCache::UpdateRefreshSystem");
     m_refreshQueue.Update();
 }
 
@@ -233,15 +256,19 @@ GpuShaderProgramID ShaderCache::RefreshPerform(ShaderAsset* shader,
     return old;
 }
 
-void ShaderCache::RefreshFinalize(ShaderAsset* shader,
+bool ShaderCache::RefreshFinalize(ShaderAsset* shader,
                                   GpuShaderProgramID oldProgram,
                                   void* userdata)
 {
     ShaderCache* self = (ShaderCache*)userdata;
 
+    if (shader->ArePreviousProgramsHeld())
+        return false;
+
     if (oldProgram != GpuShaderProgramID())
-        self->m_device.ShaderProgramDestroy(oldProgram);
+        self->m_device.ShaderProgramDestroyDeferred(oldProgram);
 
     shader->ClearRefreshedStatus();
     shader->Release();
+    return true;
 }
@@ -23,6 +23,14 @@ public:
     GpuShaderProgramID Refresh(FileLoader& loader);
     bool PollRefreshed() const;
 
+    // Keeps the shader programs replaced by refreshes alive until a matching
+    // call to ReleasePreviousPrograms(). A pipeline state object that uses an
+    // old program can then serve as a fallback while its replacement is
+    // compiled.
+    void HoldPreviousPrograms();
+    void ReleasePreviousPrograms();
+    bool ArePreviousProgramsHeld() const;
+
     // For use by the ShaderCache class -- these shouldn't need to be called
     // by user code.
     void ClearRefreshedStatus();
@@ -41,6 +49,7 @@ private:
     GpuDevice& m_device;
     GpuShaderProgramID m_shaderProgram;
     int m_refCountAndRefreshStatus;
+    int m_nPreviousProgramHolds;
 };
 
 class ShaderCache {
@@ -63,7 +72,7 @@ private:
     static GpuShaderProgramID RefreshPerform(
         ShaderAsset* shader, void* userdata
     );
-    static void RefreshFinalize(
+    static bool RefreshFinalize(
         ShaderAsset* shader, GpuShaderProgramID oldProgram, void* userdata
     );
 
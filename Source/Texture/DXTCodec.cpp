@@ -0,0 +1,532 @@
+#include "Texture/DXTCodec.h"
+
+#include <string.h>
+
+#include "Core/Macros.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  define DXT_SSE2
+#  include <emmintrin.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+static u32 PackBGRA8(u32 r, u32 g, u32 b, u32 a)
+{
+    return b | (g << 8) | (r << 16) | (a << 24);
+}
+
+static u32 Expand565(u32 c, u32* r, u32* g, u32* b)
+{
+    *r = (c >> 11) & 0x1F; *r = (*r << 3) | (*r >> 2);
+    *g = (c >> 5) & 0x3F;  *g = (*g << 2) | (*g >> 4);
+    *b = c & 0x1F;         *b = (*b << 3) | (*b >> 2);
+    return PackBGRA8(*r, *g, *b, 0xFF);
+}
+
+static u32 Quantize565(u32 r, u32 g, u32 b)
+{
+    u32 r5 = (r * 31 + 127) / 255;
+    u32 g6 = (g * 63 + 127) / 255;
+    u32 b5 = (b * 31 + 127) / 255;
+    return (r5 << 11) | (g6 << 5) | b5;
+}
+
+static u32 Channel(u32 texel, int shift)
+{
+    return (texel >> shift) & 0xFF;
+}
+
+// -----------------------------------------------------------------------------
+// Decompression
+// -----------------------------------------------------------------------------
+
+// Writes the 4x4 block of texels as four rows, stride texels apart.
+static void DecodeColorBlock(const u8* block, bool allowTransparent,
+                             u32* texels, unsigned stride)
+{
+    u32 c0 = block[0] | (block[1] << 8);
+    u32 c1 = block[2] | (block[3] << 8);
+    u32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((u32)block[7] << 24);
+
+    u32 r[4], g[4], b[4];
+    u32 palette[4];
+    palette[0] = Expand565(c0, &r[0], &g[0], &b[0]);
+    palette[1] = Expand565(c1, &r[1], &g[1], &b[1]);
+    if (c0 > c1 || !allowTransparent) {
+        palette[2] = PackBGRA8((2 * r[0] + r[1]) / 3,
+                               (2 * g[0] + g[1]) / 3,
+                               (2 * b[0] + b[1]) / 3,
+                               0xFF);
+        palette[3] = PackBGRA8((r[0] + 2 * r[1]) / 3,
+                               (g[0] + 2 * g[1]) / 3,
+                               (b[0] + 2 * b[1]) / 3,
+                               0xFF);
+    } else {
+        palette[2] = PackBGRA8((r[0] + r[1]) / 2,
+                               (g[0] + g[1]) / 2,
+                               (b[0] + b[1]) / 2,
+                               0xFF);
+        palette[3] = 0;
+    }
+
+#ifdef DXT_SSE2
+    // Each row's indices are selected four at a time, by comparing the bits of
+    // each lane's index against each possible value.
+    const __m128i laneMask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+    const __m128i laneOne = _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6);
+    __m128i p0 = _mm_set1_epi32((int)palette[0]);
+    __m128i p1 = _mm_set1_epi32((int)palette[1]);
+    __m128i p2 = _mm_set1_epi32((int)palette[2]);
+    __m128i p3 = _mm_set1_epi32((int)palette[3]);
+    __m128i k1 = laneOne;
+    __m128i k2 = _mm_add_epi32(laneOne, laneOne);
+    for (int row = 0; row < 4; ++row) {
+        __m128i bits = _mm_and_si128(_mm_set1_epi32((int)(indices >> (8 * row))), laneMask);
+        __m128i out = _mm_and_si128(_mm_cmpeq_epi32(bits, _mm_setzero_si128()), p0);
+        out = _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi32(bits, k1), p1));
+        out = _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi32(bits, k2), p2));
+        out = _mm_or_si128(out, _mm_and_si128(_mm_cmpeq_epi32(bits, laneMask), p3));
+        _mm_storeu_si128((__m128i*)(texels + row * stride), out);
+    }
+#else
+    for (int i = 0; i < 16; ++i)
+        texels[(i / 4) * stride + (i % 4)] = palette[(indices >> (2 * i)) & 0x3];
+#endif
+}
+
+// Replaces the alpha of the block's texels with the given alphas, which are
+// already shifted into the top byte.
+static void MergeAlpha(const u32 alphas[16], u32* texels, unsigned stride)
+{
+#ifdef DXT_SSE2
+    const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+    for (int row = 0; row < 4; ++row) {
+        __m128i* dest = (__m128i*)(texels + row * stride);
+        __m128i color = _mm_and_si128(_mm_loadu_si128(dest), colorMask);
+        __m128i alpha = _mm_loadu_si128((const __m128i*)(alphas + row * 4));
+        _mm_storeu_si128(dest, _mm_or_si128(color, alpha));
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        u32& texel = texels[(i / 4) * stride + (i % 4)];
+        texel = (texel & 0x00FFFFFF) | alphas[i];
+    }
+#endif
+}
+
+static void DecodeExplicitAlphaBlock(const u8* block, u32* texels, unsigned stride)
+{
+    u32 alphas[16];
+    for (int i = 0; i < 16; ++i) {
+        u32 alpha = (block[i / 2] >> (4 * (i & 1))) & 0xF;
+        alphas[i] = (alpha | (alpha << 4)) << 24;
+    }
+    MergeAlpha(alphas, texels, stride);
+}
+
+static void DecodeInterpolatedAlphaBlock(const u8* block, u32* texels, unsigned stride)
+{
+    u32 palette[8];
+    palette[0] = block[0];
+    palette[1] = block[1];
+    if (palette[0] > palette[1]) {
+        for (u32 i = 1; i < 7; ++i)
+            palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+    } else {
+        for (u32 i = 1; i < 5; ++i)
+            palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+        palette[6] = 0;
+        palette[7] = 0xFF;
+    }
+
+    u64 indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= (u64)block[2 + i] << (8 * i);
+
+    u32 alphas[16];
+    for (int i = 0; i < 16; ++i)
+        alphas[i] = palette[(indices >> (3 * i)) & 0x7] << 24;
+    MergeAlpha(alphas, texels, stride);
+}
+
+static void DecodeBlock(DDSTextureFormat format, const u8* block,
+                        u32* texels, unsigned stride)
+{
+    switch (format) {
+        case DDSTEXFORMAT_DXT1:
+            DecodeColorBlock(block, true, texels, stride);
+            break;
+        case DDSTEXFORMAT_DXT3:
+            DecodeColorBlock(block + 8, false, texels, stride);
+            DecodeExplicitAlphaBlock(block, texels, stride);
+            break;
+        case DDSTEXFORMAT_DXT5:
+            DecodeColorBlock(block + 8, false, texels, stride);
+            DecodeInterpolatedAlphaBlock(block, texels, stride);
+            break;
+        default:
+            ASSERT(!"Not a DXT format");
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Compression
+// -----------------------------------------------------------------------------
+
+// Finds the smallest and largest value of each channel of the texels.
+static void ColorBounds(const u32 texels[16], u32* minColor, u32* maxColor)
+{
+#ifdef DXT_SSE2
+    __m128i v0 = _mm_loadu_si128((const __m128i*)(texels + 0));
+    __m128i v1 = _mm_loadu_si128((const __m128i*)(texels + 4));
+    __m128i v2 = _mm_loadu_si128((const __m128i*)(texels + 8));
+    __m128i v3 = _mm_loadu_si128((const __m128i*)(texels + 12));
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(v0, v1), _mm_min_epu8(v2, v3));
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(v0, v1), _mm_max_epu8(v2, v3));
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    *minColor = (u32)_mm_cvtsi128_si32(lo);
+    *maxColor = (u32)_mm_cvtsi128_si32(hi);
+#else
+    u32 lo[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    u32 hi[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            u32 value = Channel(texels[i], 8 * c);
+            if (value < lo[c]) lo[c] = value;
+            if (value > hi[c]) hi[c] = value;
+        }
+    }
+    *minColor = lo[0] | (lo[1] << 8) | (lo[2] << 16) | (lo[3] << 24);
+    *maxColor = hi[0] | (hi[1] << 8) | (hi[2] << 16) | (hi[3] << 24);
+#endif
+}
+
+// Chooses the four-color mode index of each texel, by projecting it onto the
+// line from the color of endpoint 1 to the color of endpoint 0 and rounding to
+// the nearest of the four palette entries.
+static u32 ChooseColorIndices(const u32 texels[16], u32 color0, u32 color1)
+{
+    int dr = (int)Channel(color0, 16) - (int)Channel(color1, 16);
+    int dg = (int)Channel(color0, 8) - (int)Channel(color1, 8);
+    int db = (int)Channel(color0, 0) - (int)Channel(color1, 0);
+    int dd = dr * dr + dg * dg + db * db;
+    if (dd == 0)
+        return 0; // Every texel uses endpoint 0
+
+    // With t the projection scaled by dd, the palette entries are at
+    // t = dd, 2dd/3, dd/3 and 0 (indices 0, 2, 3 and 1), so the rounding
+    // thresholds are at 6t = dd, 3dd and 5dd.
+    u32 indices = 0;
+#ifdef DXT_SSE2
+    // The channels are split into pairs of 16-bit values, so that the dot
+    // product can be done with _mm_madd_epi16().
+    const __m128i byteMask = _mm_set1_epi32(0x00FF00FF);
+    __m128i c1BR = _mm_set1_epi32((int)(color1 & 0x00FF00FF));
+    __m128i c1GA = _mm_set1_epi32((int)((color1 >> 8) & 0x00FF00FF));
+    __m128i dBR = _mm_set1_epi32((db & 0xFFFF) | (dr << 16));
+    __m128i dGA = _mm_set1_epi32(dg & 0xFFFF);
+    __m128i threshold1 = _mm_set1_epi32(dd - 1);
+    __m128i threshold2 = _mm_set1_epi32(3 * dd - 1);
+    __m128i threshold3 = _mm_set1_epi32(5 * dd - 1);
+    __m128i one = _mm_set1_epi32(1);
+    __m128i two = _mm_set1_epi32(2);
+    for (int row = 0; row < 4; ++row) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(texels + row * 4));
+        __m128i br = _mm_sub_epi16(_mm_and_si128(v, byteMask), c1BR);
+        __m128i ga = _mm_sub_epi16(_mm_and_si128(_mm_srli_epi32(v, 8), byteMask), c1GA);
+        __m128i t = _mm_add_epi32(_mm_madd_epi16(br, dBR), _mm_madd_epi16(ga, dGA));
+        // 6t = 4t + 2t
+        __m128i t6 = _mm_add_epi32(_mm_slli_epi32(t, 2), _mm_slli_epi32(t, 1));
+
+        __m128i m1 = _mm_cmpgt_epi32(t6, threshold1);
+        __m128i m2 = _mm_cmpgt_epi32(t6, threshold2);
+        __m128i m3 = _mm_cmpgt_epi32(t6, threshold3);
+        // Levels 0-3 (from endpoint 1 to endpoint 0) map to indices 1, 3, 2, 0:
+        // bit 0 is set below level 2 and bit 1 is set for levels 1 and 2.
+        __m128i bit0 = _mm_andnot_si128(m2, one);
+        __m128i bit1 = _mm_and_si128(_mm_andnot_si128(m3, m1), two);
+        __m128i index = _mm_or_si128(bit0, bit1);
+
+        u32 lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, index);
+        indices |= (lanes[0] | (lanes[1] << 2) | (lanes[2] << 4) | (lanes[3] << 6))
+            << (8 * row);
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        int r = (int)Channel(texels[i], 16) - (int)Channel(color1, 16);
+        int g = (int)Channel(texels[i], 8) - (int)Channel(color1, 8);
+        int b = (int)Channel(texels[i], 0) - (int)Channel(color1, 0);
+        int t6 = 6 * (r * dr + g * dg + b * db);
+        bool m1 = t6 >= dd;
+        bool m2 = t6 >= 3 * dd;
+        bool m3 = t6 >= 5 * dd;
+        u32 index = (m2 ? 0 : 1) | ((m1 && !m3) ? 2 : 0);
+        indices |= index << (2 * i);
+    }
+#endif
+    return indices;
+}
+
+static void WriteColorBlock(u8* block, u32 c0, u32 c1, u32 indices)
+{
+    block[0] = (u8)c0;
+    block[1] = (u8)(c0 >> 8);
+    block[2] = (u8)c1;
+    block[3] = (u8)(c1 >> 8);
+    block[4] = (u8)indices;
+    block[5] = (u8)(indices >> 8);
+    block[6] = (u8)(indices >> 16);
+    block[7] = (u8)(indices >> 24);
+}
+
+// Encodes the texels in the four-color mode, with c0 > c1.
+static void EncodeOpaqueColorBlock(const u32 texels[16], u8* block)
+{
+    u32 minColor, maxColor;
+    ColorBounds(texels, &minColor, &maxColor);
+
+    // Inset the bounding box slightly, since the extremes are often outliers.
+    u32 lo[3], hi[3];
+    for (int c = 0; c < 3; ++c) {
+        u32 minValue = Channel(minColor, 8 * c);
+        u32 maxValue = Channel(maxColor, 8 * c);
+        u32 inset = (maxValue - minValue) >> 4;
+        lo[c] = minValue + inset;
+        hi[c] = maxValue - inset;
+    }
+
+    u32 c0 = Quantize565(hi[2], hi[1], hi[0]);
+    u32 c1 = Quantize565(lo[2], lo[1], lo[0]);
+    if (c0 < c1) {
+        u32 temp = c0;
+        c0 = c1;
+        c1 = temp;
+    }
+
+    u32 r, g, b;
+    u32 color0 = Expand565(c0, &r, &g, &b);
+    u32 color1 = Expand565(c1, &r, &g, &b);
+    u32 indices = (c0 == c1) ? 0 : ChooseColorIndices(texels, color0, color1);
+    WriteColorBlock(block, c0, c1, indices);
+}
+
+// Encodes the texels in the three-color mode, with c0 <= c1 and index 3 for
+// the transparent texels.
+static void EncodeTransparentColorBlock(const u32 texels[16], u8* block)
+{
+    u32 lo[3] = { 0xFF, 0xFF, 0xFF };
+    u32 hi[3] = { 0, 0, 0 };
+    bool anyOpaque = false;
+    for (int i = 0; i < 16; ++i) {
+        if (Channel(texels[i], 24) < 128)
+            continue;
+        anyOpaque = true;
+        for (int c = 0; c < 3; ++c) {
+            u32 value = Channel(texels[i], 8 * c);
+            if (value < lo[c]) lo[c] = value;
+            if (value > hi[c]) hi[c] = value;
+        }
+    }
+    if (!anyOpaque) {
+        WriteColorBlock(block, 0, 0, 0xFFFFFFFF);
+        return;
+    }
+
+    u32 c0 = Quantize565(lo[2], lo[1], lo[0]);
+    u32 c1 = Quantize565(hi[2], hi[1], hi[0]);
+    if (c0 > c1) {
+        u32 temp = c0;
+        c0 = c1;
+        c1 = temp;
+    }
+
+    u32 r0, g0, b0, r1, g1, b1;
+    Expand565(c0, &r0, &g0, &b0);
+    Expand565(c1, &r1, &g1, &b1);
+    int dr = (int)r1 - (int)r0;
+    int dg = (int)g1 - (int)g0;
+    int db = (int)b1 - (int)b0;
+    int dd = dr * dr + dg * dg + db * db;
+
+    // The palette entries are at t = 0, dd/2 and dd (indices 0, 2 and 1).
+    u32 indices = 0;
+    for (int i = 0; i < 16; ++i) {
+        u32 index;
+        if (Channel(texels[i], 24) < 128) {
+            index = 3;
+        } else if (dd == 0) {
+            index = 0;
+        } else {
+            int r = (int)Channel(texels[i], 16) - (int)r0;
+            int g = (int)Channel(texels[i], 8) - (int)g0;
+            int b = (int)Channel(texels[i], 0) - (int)b0;
+            int t4 = 4 * (r * dr + g * dg + b * db);
+            if (t4 >= 3 * dd)
+                index = 1;
+            else if (t4 >= dd)
+                index = 2;
+            else
+                index = 0;
+        }
+        indices |= index << (2 * i);
+    }
+    WriteColorBlock(block, c0, c1, indices);
+}
+
+static void EncodeExplicitAlphaBlock(const u32 texels[16], u8* block)
+{
+    memset(block, 0, 8);
+    for (int i = 0; i < 16; ++i) {
+        u32 alpha = (Channel(texels[i], 24) * 15 + 127) / 255;
+        block[i / 2] |= (u8)(alpha << (4 * (i & 1)));
+    }
+}
+
+// Encodes the alphas in the eight-alpha mode (a0 > a1), with the endpoints at
+// the smallest and largest alpha.
+static void EncodeInterpolatedAlphaBlock(const u32 texels[16], u8* block)
+{
+    u32 minAlpha = 0xFF;
+    u32 maxAlpha = 0;
+    for (int i = 0; i < 16; ++i) {
+        u32 alpha = Channel(texels[i], 24);
+        if (alpha < minAlpha) minAlpha = alpha;
+        if (alpha > maxAlpha) maxAlpha = alpha;
+    }
+
+    block[0] = (u8)maxAlpha;
+    block[1] = (u8)minAlpha;
+
+    u64 indices = 0;
+    u32 range = maxAlpha - minAlpha;
+    if (range != 0) {
+        for (int i = 0; i < 16; ++i) {
+            // Level 0 is the minimum and level 7 the maximum. Index 0 is a0
+            // (the maximum), index 1 is a1, and indices 2-7 step from a0
+            // towards a1.
+            u32 level = ((Channel(texels[i], 24) - minAlpha) * 14 + range) / (2 * range);
+            u64 index = (level == 7) ? 0 : (level == 0) ? 1 : 8 - level;
+            indices |= index << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i)
+        block[2 + i] = (u8)(indices >> (8 * i));
+}
+
+static bool HasTransparentTexels(const u32 texels[16])
+{
+    for (int i = 0; i < 16; ++i) {
+        if (Channel(texels[i], 24) < 128)
+            return true;
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// Public functions
+// -----------------------------------------------------------------------------
+
+unsigned DXTBlockSize(DDSTextureFormat format)
+{
+    switch (format) {
+        case DDSTEXFORMAT_DXT1: return 8;
+        case DDSTEXFORMAT_DXT3: return 16;
+        case DDSTEXFORMAT_DXT5: return 16;
+        default:
+            ASSERT(!"Not a DXT format");
+            return 0;
+    }
+}
+
+size_t DXTImageSize(DDSTextureFormat format, unsigned width, unsigned height)
+{
+    size_t blocksWide = (width + 3) / 4;
+    size_t blocksHigh = (height + 3) / 4;
+    return blocksWide * blocksHigh * DXTBlockSize(format);
+}
+
+void DXTDecompressBlock(DDSTextureFormat format, const u8* block, u32 texels[16])
+{
+    DecodeBlock(format, block, texels, 4);
+}
+
+void DXTCompressBlock(DDSTextureFormat format, const u32 texels[16], u8* block)
+{
+    switch (format) {
+        case DDSTEXFORMAT_DXT1:
+            if (HasTransparentTexels(texels))
+                EncodeTransparentColorBlock(texels, block);
+            else
+                EncodeOpaqueColorBlock(texels, block);
+            break;
+        case DDSTEXFORMAT_DXT3:
+            EncodeExplicitAlphaBlock(texels, block);
+            EncodeOpaqueColorBlock(texels, block + 8);
+            break;
+        case DDSTEXFORMAT_DXT5:
+            EncodeInterpolatedAlphaBlock(texels, block);
+            EncodeOpaqueColorBlock(texels, block + 8);
+            break;
+        default:
+            ASSERT(!"Not a DXT format");
+            break;
+    }
+}
+
+void DXTDecompressImage(DDSTextureFormat format,
+                        const u8* blocks,
+                        unsigned width,
+                        unsigned height,
+                        u32* texels,
+                        unsigned stride)
+{
+    unsigned blockSize = DXTBlockSize(format);
+    for (unsigned y = 0; y < height; y += 4) {
+        for (unsigned x = 0; x < width; x += 4) {
+            if (x + 4 <= width && y + 4 <= height) {
+                DecodeBlock(format, blocks, texels + y * stride + x, stride);
+            } else {
+                // Partial blocks are decoded to a temporary and clipped.
+                u32 block[16];
+                DecodeBlock(format, blocks, block, 4);
+                for (unsigned j = 0; j < 4 && y + j < height; ++j) {
+                    for (unsigned i = 0; i < 4 && x + i < width; ++i)
+                        texels[(y + j) * stride + x + i] = block[j * 4 + i];
+                }
+            }
+            blocks += blockSize;
+        }
+    }
+}
+
+void DXTCompressImage(DDSTextureFormat format,
+                      const u32* texels,
+                      unsigned width,
+                      unsigned height,
+                      unsigned stride,
+                      u8* blocks)
+{
+    unsigned blockSize = DXTBlockSize(format);
+    for (unsigned y = 0; y < height; y += 4) {
+        for (unsigned x = 0; x < width; x += 4) {
+            u32 block[16];
+            for (unsigned j = 0; j < 4; ++j) {
+                unsigned row = (y + j < height) ? y + j : height - 1;
+                for (unsigned i = 0; i < 4; ++i) {
+                    unsigned col = (x + i < width) ? x + i : width - 1;
+                    block[j * 4 + i] = texels[row * stride + col];
+                }
+            }
+            DXTCompressBlock(format, block, blocks);
+            blocks += blockSize;
+        }
+    }
+}
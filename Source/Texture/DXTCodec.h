@@ -0,0 +1,45 @@
+#ifndef TEXTURE_DXTCODEC_H
+#define TEXTURE_DXTCODEC_H
+
+#include <stddef.h>
+#include "Core/Types.h"
+#include "Texture/DDSFile.h"
+
+// CPU compression and decompression of DXT1, DXT3 and DXT5 (BC1-3) textures.
+//
+// Uncompressed texels are BGRA8888, packed into a u32 with blue in the lowest
+// byte (the layout of GPU_PIXEL_FORMAT_BGRA8888). Blocks are stored in rows,
+// as in a DDS file. SSE2 is used where it's available, and plain C++
+// otherwise; both produce identical results.
+//
+// The encoder fits the endpoints to the bounding box of each block's colors,
+// so it's fast rather than optimal. It's intended for textures generated at
+// runtime or at import; DXT1 blocks with texels whose alpha is below 128 are
+// encoded in the three-color mode with those texels transparent.
+
+// Returns the size in bytes of one 4x4 block.
+unsigned DXTBlockSize(DDSTextureFormat format);
+// Returns the size in bytes of an image, rounding the dimensions up to whole
+// blocks.
+size_t DXTImageSize(DDSTextureFormat format, unsigned width, unsigned height);
+
+void DXTDecompressBlock(DDSTextureFormat format, const u8* block, u32 texels[16]);
+void DXTCompressBlock(DDSTextureFormat format, const u32 texels[16], u8* block);
+
+// The stride is the distance between rows of texels, in texels. Texels
+// outside the image aren't written by DXTDecompressImage(), and the edge
+// texels are repeated to fill the partial blocks in DXTCompressImage().
+void DXTDecompressImage(DDSTextureFormat format,
+                        const u8* blocks,
+                        unsigned width,
+                        unsigned height,
+                        u32* texels,
+                        unsigned stride);
+void DXTCompressImage(DDSTextureFormat format,
+                      const u32* texels,
+                      unsigned width,
+                      unsigned height,
+                      unsigned stride,
+                      u8* blocks);
+
+#endif // TEXTURE_DXTCODEC_H
@@ -1,6 +1,9 @@
 #include "Texture/TextureAsset.h"
 
+#include <algorithm>
+
 #include "Core/Macros.h"
+#include "Core/Profiler.h"
 #include "Core/FileLoader.h"
 
 #include "Texture/DDSFile.h"
@@ -14,73 +17,145 @@ namespace {
             return key;
         }
     };
+
+    struct GetTextureArrayKey {
+        HashKey_Str operator()(TextureArrayAsset* array) const
+        {
+            HashKey_Str key;
+            key.str = array->GetKey();
+            return key;
+        }
+    };
 }
 
 const int REFRESH_STATUS_MASK = 0x80000000;
 const int REF_COUNT_MASK = ~(REFRESH_STATUS_MASK);
 
-static GpuTextureID CreateTexture(GpuDevice& device, DDSFile& file)
+const u64 DEFAULT_STREAMING_BUDGET = 256 * 1024 * 1024;
+
+// Limits the uploads done by UpdateStreaming() in a single frame.
+const u32 MAX_STREAM_INS_PER_FRAME = 4;
+
+const int LOAD_THREADS = 2;
+
+// The maximum number of slices of an array texture, as in Metal.
+const u32 MAX_ARRAY_SLICES = 2048;
+
+static GpuPixelFormat GetPixelFormat(const DDSFile& file, unsigned* bytesPerBlock)
 {
-    GpuPixelFormat pixelFormat;
-    unsigned bytesPerBlock;
     switch (file.Format()) {
         case DDSTEXFORMAT_DXT1:
-            pixelFormat = GPU_PIXEL_FORMAT_DXT1;
-            bytesPerBlock = 8;
-            break;
+            *bytesPerBlock = 8;
+            return GPU_PIXEL_FORMAT_DXT1;
         case DDSTEXFORMAT_DXT3:
-            pixelFormat = GPU_PIXEL_FORMAT_DXT3;
-            bytesPerBlock = 16;
-            break;
+            *bytesPerBlock = 16;
+            return GPU_PIXEL_FORMAT_DXT3;
         case DDSTEXFORMAT_DXT5:
-            pixelFormat = GPU_PIXEL_FORMAT_DXT5;
-            bytesPerBlock = 16;
-            break;
-        default: ASSERT(!"Unknown DDSTextureFormat"); break;
+            *bytesPerBlock = 16;
+            return GPU_PIXEL_FORMAT_DXT5;
+        default:
+            ASSERT(!"Unknown DDSTextureFormat");
+            *bytesPerBlock = 0;
+            return GPU_PIXEL_FORMAT_DXT1;
     }
+}
+
+static unsigned MipDimension(unsigned size, int mip)
+{
+    unsigned dim = size >> mip;
+    return dim > 0 ? dim : 1;
+}
+
+// Uploads the mipmap levels of the file from firstMip onwards to a slice of
+// the texture.
+static void UploadMips(GpuDevice& device,
+                       GpuTextureID texture,
+                       int slice,
+                       const DDSFile& file,
+                       int firstMip)
+{
+    unsigned bytesPerBlock;
+    GetPixelFormat(file, &bytesPerBlock);
 
     unsigned width = file.Width();
     unsigned height = file.Height();
-    unsigned nMips = file.MipCount();
+    int nMips = (int)file.MipCount();
+
+    // The levels before firstMip are skipped over. Each level is stored as
+    // whole 4x4 blocks, so the smallest levels take up one block.
+    const u8* pixels = file.Pixels();
+    for (int i = 0; i < nMips; ++i) {
+        unsigned w = MipDimension(width, i);
+        unsigned h = MipDimension(height, i);
+        unsigned stride = (w + 3) / 4 * bytesPerBlock;
+        unsigned mipSize = (h + 3) / 4 * stride;
+        if (i >= firstMip) {
+            GpuRegion region;
+            region.x = 0;
+            region.y = 0;
+            region.width = w;
+            region.height = h;
+            device.TextureUploadSlice(texture, slice, region, i - firstMip,
+                                      stride, pixels);
+        }
+        pixels += mipSize;
+    }
+}
+
+static GpuTextureID CreateTexture(GpuDevice& device, const DDSFile& file, int firstMip)
+{
+    unsigned bytesPerBlock;
+    GpuPixelFormat pixelFormat = GetPixelFormat(file, &bytesPerBlock);
+
+    int nMips = (int)file.MipCount();
+    ASSERT(firstMip >= 0 && firstMip < nMips);
     GpuTextureID texture = device.TextureCreate(
         GPU_TEXTURE_2D,
         pixelFormat,
         0,
-        width,
-        height,
+        MipDimension(file.Width(), firstMip),
+        MipDimension(file.Height(), firstMip),
         1,
-        file.MipCount()
+        nMips - firstMip
     );
-
-    const u8* pixels = file.Pixels();
-    for (unsigned i = 0; i < nMips; ++i) {
-        unsigned w = width >> i;
-        unsigned h = height >> i;
-        unsigned mipSize = w / 4 * h / 4 * bytesPerBlock;
-        unsigned stride = w / 4 * bytesPerBlock;
-        GpuRegion region;
-        region.x = 0;
-        region.y = 0;
-        region.width = w;
-        region.height = h;
-        device.TextureUpload(texture, region, i, stride, pixels);
-        pixels += mipSize;
-    }
+    UploadMips(device, texture, 0, file, firstMip);
 
     return texture;
 }
 
-TextureAsset::TextureAsset(GpuDevice& device, DDSFile& file)
+static int TailFirstMip(const DDSFile& file)
+{
+    unsigned maxDim = std::max(file.Width(), file.Height());
+    int lastMip = (int)file.MipCount() - 1;
+    int mip = 0;
+    while (mip < lastMip && (maxDim >> mip) > TEXTURE_STREAMING_TAIL_SIZE)
+        ++mip;
+    return mip;
+}
+
+TextureAsset::TextureAsset(GpuDevice& device)
     : m_link()
 
     , m_device(device)
-    , m_texture(CreateTexture(device, file))
+    , m_file(NULL)
+    , m_texture()
+    , m_firstResidentMip(0)
+    , m_requestedScreenSize(-1.0f)
+    , m_lastRequestedFrame(0)
     , m_refCountAndRefreshStatus(0)
 {}
 
 TextureAsset::~TextureAsset()
 {
-    m_device.TextureDestroy(m_texture);
+    if (m_file) {
+        m_device.TextureDestroyDeferred(m_texture);
+        delete m_file;
+    }
+}
+
+bool TextureAsset::IsLoaded() const
+{
+    return m_file != NULL;
 }
 
 GpuTextureID TextureAsset::GetGpuTextureID() const
@@ -88,6 +163,13 @@ GpuTextureID TextureAsset::GetGpuTextureID() const
     return m_texture;
 }
 
+void TextureAsset::RequestScreenSize(float pixels)
+{
+    ASSERT(pixels >= 0.0f);
+    if (pixels > m_requestedScreenSize)
+        m_requestedScreenSize = pixels;
+}
+
 int TextureAsset::RefCount() const
 {
     return (m_refCountAndRefreshStatus & REF_COUNT_MASK);
@@ -109,10 +191,16 @@ const char* TextureAsset::GetPath() const
     return (const char*)(this + 1);
 }
 
-GpuTextureID TextureAsset::Refresh(DDSFile& file)
+GpuTextureID TextureAsset::Refresh(DDSFile* file)
 {
+    delete m_file;
+    m_file = file;
+
+    // Keep the same levels resident, if the new file still has them.
+    m_firstResidentMip = std::min(m_firstResidentMip, TailFirstMip(*file));
+
     GpuTextureID oldTex = m_texture;
-    m_texture = CreateTexture(m_device, file);
+    m_texture = CreateTexture(m_device, *file, m_firstResidentMip);
     return oldTex;
 }
 
@@ -126,7 +214,81 @@ void TextureAsset::ClearRefreshedStatus()
     m_refCountAndRefreshStatus &= ~(REFRESH_STATUS_MASK);
 }
 
-TextureAsset* TextureAsset::Create(GpuDevice& device, DDSFile& file,
+float TextureAsset::TakeRequestedScreenSize()
+{
+    float size = m_requestedScreenSize;
+    m_requestedScreenSize = -1.0f;
+    return size;
+}
+
+int TextureAsset::GetFirstMipForScreenSize(float pixels) const
+{
+    // Use the smallest level that's at least as large as the requested size,
+    // but never drop below the tail.
+    unsigned maxDim = std::max(m_file->Width(), m_file->Height());
+    int mip = GetTailFirstMip();
+    while (mip > 0 && (float)(maxDim >> mip) < pixels)
+        --mip;
+    return mip;
+}
+
+int TextureAsset::GetTailFirstMip() const
+{
+    return TailFirstMip(*m_file);
+}
+
+int TextureAsset::GetFirstResidentMip() const
+{
+    return m_firstResidentMip;
+}
+
+u64 TextureAsset::GetResidentBytes() const
+{
+    return GetBytesForFirstMip(m_firstResidentMip);
+}
+
+u64 TextureAsset::GetBytesForFirstMip(int firstMip) const
+{
+    unsigned bytesPerBlock;
+    return GpuDevice::TextureSizeInBytes(
+        GPU_TEXTURE_2D,
+        GetPixelFormat(*m_file, &bytesPerBlock),
+        MipDimension(m_file->Width(), firstMip),
+        MipDimension(m_file->Height(), firstMip),
+        1,
+        (int)m_file->MipCount() - firstMip
+    );
+}
+
+GpuTextureID TextureAsset::SetFirstResidentMip(int firstMip)
+{
+    ASSERT(firstMip != m_firstResidentMip);
+    m_firstResidentMip = firstMip;
+
+    GpuTextureID oldTex = m_texture;
+    m_texture = CreateTexture(m_device, *m_file, firstMip);
+    return oldTex;
+}
+
+u32 TextureAsset::GetLastRequestedFrame() const
+{
+    return m_lastRequestedFrame;
+}
+
+void TextureAsset::SetLastRequestedFrame(u32 frame)
+{
+    m_lastRequestedFrame = frame;
+}
+
+void TextureAsset::Load(DDSFile* file)
+{
+    ASSERT(!IsLoaded());
+    m_file = file;
+    m_firstResidentMip = TailFirstMip(*file);
+    m_texture = CreateTexture(m_device, *file, m_firstResidentMip);
+}
+
+TextureAsset* TextureAsset::Create(GpuDevice& device, DDSFile* file,
                                    const char* path)
 {
     size_t pathLen = StrLen(path) + 1; // includes the null terminator ( + 1 )
@@ -136,7 +298,10 @@ TextureAsset* TextureAsset::Create(GpuDevice& device, DDSFile& file,
     memcpy((u8*)memory + sizeof(TextureAsset), path, pathLen);
 
     // Create the texture
-    return new (memory) TextureAsset(device, file);
+    TextureAsset* texture = new (memory) TextureAsset(device);
+    if (file)
+        texture->Load(file);
+    return texture;
 }
 
 void TextureAsset::Destroy(TextureAsset* texture)
@@ -145,6 +310,96 @@ void TextureAsset::Destroy(TextureAsset* texture)
     free(texture);
 }
 
+TextureArrayAsset::TextureArrayAsset(GpuDevice& device,
+                                     GpuTextureID texture,
+                                     u32 nSlices)
+    : m_link()
+
+    , m_device(device)
+    , m_texture(texture)
+    , m_nSlices(nSlices)
+    , m_refCount(0)
+{}
+
+TextureArrayAsset::~TextureArrayAsset()
+{
+    m_device.TextureDestroyDeferred(m_texture);
+}
+
+GpuTextureID TextureArrayAsset::GetGpuTextureID() const
+{
+    return m_texture;
+}
+
+u32 TextureArrayAsset::GetSliceCount() const
+{
+    return m_nSlices;
+}
+
+int TextureArrayAsset::RefCount() const
+{
+    return m_refCount;
+}
+
+void TextureArrayAsset::AddRef()
+{
+    ++m_refCount;
+}
+
+void TextureArrayAsset::Release()
+{
+    ASSERT(m_refCount > 0);
+    --m_refCount;
+}
+
+const char* TextureArrayAsset::GetKey() const
+{
+    return (const char*)(this + 1);
+}
+
+TextureArrayAsset* TextureArrayAsset::Create(GpuDevice& device,
+                                             const DDSFile* const* files,
+                                             u32 nFiles,
+                                             const char* key)
+{
+    if (nFiles == 0 || nFiles > MAX_ARRAY_SLICES)
+        return NULL;
+
+    const DDSFile& first = *files[0];
+    for (u32 i = 1; i < nFiles; ++i) {
+        if (files[i]->Format() != first.Format() ||
+            files[i]->Width() != first.Width() ||
+            files[i]->Height() != first.Height() ||
+            files[i]->MipCount() != first.MipCount())
+            return NULL;
+    }
+
+    unsigned bytesPerBlock;
+    GpuTextureID texture = device.TextureCreate(
+        GPU_TEXTURE_2D_ARRAY,
+        GetPixelFormat(first, &bytesPerBlock),
+        0,
+        first.Width(),
+        first.Height(),
+        (int)nFiles,
+        (int)first.MipCount()
+    );
+    for (u32 i = 0; i < nFiles; ++i)
+        UploadMips(device, texture, (int)i, *files[i], 0);
+
+    size_t keyLen = StrLen(key) + 1; // includes the null terminator ( + 1 )
+    void* memory = malloc(sizeof(TextureArrayAsset) + keyLen);
+    memcpy((u8*)memory + sizeof(TextureArrayAsset), key, keyLen);
+
+    return new (memory) TextureArrayAsset(device, texture, nFiles);
+}
+
+void TextureArrayAsset::Destroy(TextureArrayAsset* array)
+{
+    array->~TextureArrayAsset();
+    free(array);
+}
+
 static void* Alloc(u32 size, void* userdata)
 {
     return malloc(size);
@@ -162,17 +417,40 @@ TextureCache::TextureCache(GpuDevice& device, FileLoader& loader)
     , m_textureList()
     , m_textureHash()
 
+    , m_arrayList()
+    , m_arrayHash()
+    , m_arrayKey()
+
     , m_refreshQueue(&TextureCache::RefreshPerform,
                      &TextureCache::RefreshFinalize, (void*)this)
-{}
+
+    , m_loadQueue(LOAD_THREADS, &TextureCache::LoadFile, (void*)this)
+    , m_loadJobs()
+
+    , m_streamingFrame(0)
+    , m_streamingStats()
+    , m_streamIns()
+    , m_evictions()
+{
+    m_streamingStats.budgetBytes = DEFAULT_STREAMING_BUDGET;
+}
 
 TextureCache::~TextureCache()
 {
+    for (size_t i = 0; i < m_loadJobs.size(); ++i) {
+        m_loadQueue.Cancel(m_loadJobs[i]);
+        delete m_loadJobs[i]->file;
+        delete m_loadJobs[i];
+    }
+    m_loadJobs.clear();
+
     m_refreshQueue.Clear();
 
     RemoveUnusedTextures();
     ASSERT(m_textureList.Head() == NULL);
     ASSERT(m_textureHash.Count() == 0);
+    ASSERT(m_arrayList.Head() == NULL);
+    ASSERT(m_arrayHash.Count() == 0);
 }
 
 TextureAsset* TextureCache::FindOrLoad(const char* path)
@@ -180,15 +458,98 @@ TextureAsset* TextureCache::FindOrLoad(const char* path)
     HashKey_Str key;
     key.str = path;
 
-    if (TextureAsset* const* ppTexture = m_textureHash.Get(key, GetTextureKey()))
-        return *ppTexture;
+    if (TextureAsset* const* ppTexture = m_textureHash.Get(key, GetTextureKey())) {
+        TextureAsset* texture = *ppTexture;
+        if (!texture->IsLoaded())
+            FinishLoad(texture);
+        return texture;
+    }
 
     u8* data;
     u32 size;
     m_fileLoader.Load(path, &data, &size, Alloc, NULL);
 
-    DDSFile file(data, size, path, &Destroy, NULL);
+    DDSFile* file = new DDSFile(data, size, path, &Destroy, NULL);
+
+    return Insert(file, path);
+}
+
+TextureAsset* TextureCache::FindOrLoadAsync(const char* path)
+{
+    HashKey_Str key;
+    key.str = path;
 
+    if (TextureAsset* const* ppTexture = m_textureHash.Get(key, GetTextureKey()))
+        return *ppTexture;
+
+    TextureAsset* texture = Insert(NULL, path);
+
+    LoadJob* job = new LoadJob;
+    job->texture = texture;
+    job->file = NULL;
+    m_loadJobs.push_back(job);
+    m_loadQueue.Enqueue(job);
+
+    return texture;
+}
+
+void TextureCache::UpdateAsyncLoads()
+{
+    PROFILE_ZONE("TextureCache::UpdateAsyncLoads");
+    size_t nKept = 0;
+    for (size_t i = 0; i < m_loadJobs.size(); ++i) {
+        LoadJob* job = m_loadJobs[i];
+        if (m_loadQueue.IsDone(job)) {
+            job->texture->Load(job->file);
+            delete job;
+        } else {
+            m_loadJobs[nKept++] = job;
+        }
+    }
+    m_loadJobs.resize(nKept);
+}
+
+TextureArrayAsset* TextureCache::FindOrLoadArray(const char* const* paths,
+                                                 u32 nPaths)
+{
+    m_arrayKey.clear();
+    for (u32 i = 0; i < nPaths; ++i) {
+        if (i > 0)
+            m_arrayKey.push_back('|');
+        m_arrayKey.insert(m_arrayKey.end(), paths[i], paths[i] + StrLen(paths[i]));
+    }
+    m_arrayKey.push_back('\0');
+
+    HashKey_Str key;
+    key.str = &m_arrayKey[0];
+
+    if (TextureArrayAsset* const* ppArray = m_arrayHash.Get(key, GetTextureArrayKey()))
+        return *ppArray;
+
+    std::vector<DDSFile*> files(nPaths);
+    for (u32 i = 0; i < nPaths; ++i) {
+        u8* data;
+        u32 size;
+        m_fileLoader.Load(paths[i], &data, &size, Alloc, NULL);
+        files[i] = new DDSFile(data, size, paths[i], &Destroy, NULL);
+    }
+
+    TextureArrayAsset* array = TextureArrayAsset::Create(
+        m_device, nPaths ? &files[0] : NULL, nPaths, &m_arrayKey[0]
+    );
+
+    for (u32 i = 0; i < nPaths; ++i)
+        delete files[i];
+
+    if (array) {
+        m_arrayList.InsertTail(array);
+        m_arrayHash.Insert(array, GetTextureArrayKey());
+    }
+    return array;
+}
+
+TextureAsset* TextureCache::Insert(DDSFile* file, const char* path)
+{
     TextureAsset* texture = TextureAsset::Create(m_device, file, path);
 
     m_textureList.InsertTail(texture);
@@ -197,12 +558,60 @@ TextureAsset* TextureCache::FindOrLoad(const char* path)
     return texture;
 }
 
+void TextureCache::LoadFile(void* job, void* userdata)
+{
+    // Runs on a worker thread. The texture's path is immutable, and the
+    // texture isn't destroyed until its load has been cancelled.
+    LoadJob* loadJob = (LoadJob*)job;
+    TextureCache* self = (TextureCache*)userdata;
+
+    const char* path = loadJob->texture->GetPath();
+
+    u8* data;
+    u32 size;
+    self->m_fileLoader.Load(path, &data, &size, Alloc, NULL);
+
+    loadJob->file = new DDSFile(data, size, path, &Destroy, NULL);
+}
+
+void TextureCache::FinishLoad(TextureAsset* texture)
+{
+    for (size_t i = 0; i < m_loadJobs.size(); ++i) {
+        LoadJob* job = m_loadJobs[i];
+        if (job->texture == texture) {
+            m_loadQueue.Finish(job);
+            texture->Load(job->file);
+            m_loadJobs.erase(m_loadJobs.begin() + i);
+            delete job;
+            return;
+        }
+    }
+    ASSERT(!"Texture has no load in progress");
+}
+
+void TextureCache::CancelLoad(TextureAsset* texture)
+{
+    for (size_t i = 0; i < m_loadJobs.size(); ++i) {
+        LoadJob* job = m_loadJobs[i];
+        if (job->texture == texture) {
+            m_loadQueue.Cancel(job);
+            delete job->file;
+            m_loadJobs.erase(m_loadJobs.begin() + i);
+            delete job;
+            return;
+        }
+    }
+}
+
 void TextureCache::RemoveUnusedTextures()
 {
     for (TextureAsset* texture = m_textureList.Head(); texture; ) {
         TextureAsset* next = texture->m_link.Next();
 
         if (texture->RefCount() == 0) {
+            if (!texture->IsLoaded())
+                CancelLoad(texture);
+
             HashKey_Str key;
             key.str = texture->GetPath();
             ASSERT(m_textureHash.Delete(key, GetTextureKey()));
@@ -211,6 +620,21 @@ void TextureCache::RemoveUnusedTextures()
 
         texture = next;
     }
+
+    for (TextureArrayAsset* array = m_arrayList.Head(); array; ) {
+        TextureArrayAsset* next = array->m_link.Next();
+
+        if (array->RefCount() == 0) {
+            HashKey_Str key;
+            key.str = array->GetKey();
+            bool deleted = m_arrayHash.Delete(key, GetTextureArrayKey());
+            ASSERT(deleted);
+            (void)deleted;
+            TextureArrayAsset::Destroy(array);
+        }
+
+        array = next;
+    }
 }
 
 void TextureCache::Refresh(const char* path)
@@ -224,12 +648,17 @@ void TextureCache::Refresh(const char* path)
 
     TextureAsset* texture = *ppTexture;
 
+    // A load that's still in progress reads the new file anyway.
+    if (!texture->IsLoaded())
+        return;
+
     texture->AddRef();
     m_refreshQueue.QueueRefresh(texture);
 }
 
 void TextureCache::UpdateRefreshSystem()
 {
+    PROFILE_ZONE("TextureCache::UpdateRefreshSystem");
     m_refreshQueue.Update();
 }
 
@@ -244,21 +673,140 @@ GpuTextureID TextureCache::RefreshPerform(TextureAsset* texture,
     u32 size;
     self->m_fileLoader.Load(path, &data, &size, Alloc, NULL);
 
-    DDSFile file(data, size, path, &Destroy, NULL);
+    DDSFile* file = new DDSFile(data, size, path, &Destroy, NULL);
 
     GpuTextureID old = texture->Refresh(file);
 
     return old;
 }
 
-void TextureCache::RefreshFinalize(TextureAsset* texture,
+bool TextureCache::RefreshFinalize(TextureAsset* texture,
                                    GpuTextureID oldTexture,
                                    void* userdata)
 {
     TextureCache* self = (TextureCache*)userdata;
 
     if (oldTexture != GpuTextureID())
-        self->m_device.TextureDestroy(oldTexture);
+        self->m_device.TextureDestroyDeferred(oldTexture);
     texture->ClearRefreshedStatus();
     texture->Release();
+    return true;
+}
+
+void TextureCache::UpdateStreaming()
+{
+    PROFILE_ZONE("TextureCache::UpdateStreaming");
+    ++m_streamingFrame;
+    m_streamingStats.residentBytes = 0;
+    m_streamingStats.requestedBytes = 0;
+    m_streamingStats.nStreamedIn = 0;
+    m_streamingStats.nEvicted = 0;
+    m_streamingStats.nDeferred = 0;
+
+    m_streamIns.clear();
+    m_evictions.clear();
+    for (TextureAsset* texture = m_textureList.Head(); texture;
+         texture = texture->m_link.Next()) {
+        StreamingRequest request;
+        request.texture = texture;
+        request.screenSize = texture->TakeRequestedScreenSize();
+        if (!texture->IsLoaded())
+            continue;
+        if (request.screenSize >= 0.0f) {
+            request.firstMip = texture->GetFirstMipForScreenSize(request.screenSize);
+            texture->SetLastRequestedFrame(m_streamingFrame);
+        } else {
+            request.firstMip = texture->GetTailFirstMip();
+        }
+
+        int firstResidentMip = texture->GetFirstResidentMip();
+        if (request.firstMip < firstResidentMip)
+            m_streamIns.push_back(request);
+        else if (request.firstMip > firstResidentMip)
+            m_evictions.push_back(request);
+
+        m_streamingStats.residentBytes += texture->GetResidentBytes();
+        m_streamingStats.requestedBytes += texture->GetBytesForFirstMip(request.firstMip);
+    }
+
+    std::sort(m_evictions.begin(), m_evictions.end(), EvictLess);
+    u64 budget = m_streamingStats.budgetBytes;
+    if (m_streamingStats.residentBytes > budget)
+        Evict(budget);
+
+    std::sort(m_streamIns.begin(), m_streamIns.end(), StreamInLess);
+    for (size_t i = 0; i < m_streamIns.size(); ++i) {
+        const StreamingRequest& request = m_streamIns[i];
+        if (m_streamingStats.nStreamedIn == MAX_STREAM_INS_PER_FRAME) {
+            m_streamingStats.nDeferred += (u32)(m_streamIns.size() - i);
+            break;
+        }
+
+        TextureAsset* texture = request.texture;
+        u64 extraBytes = texture->GetBytesForFirstMip(request.firstMip)
+            - texture->GetResidentBytes();
+        if (extraBytes > budget) {
+            ++m_streamingStats.nDeferred;
+            continue;
+        }
+        if (m_streamingStats.residentBytes + extraBytes > budget)
+            Evict(budget - extraBytes);
+        if (m_streamingStats.residentBytes + extraBytes > budget) {
+            ++m_streamingStats.nDeferred;
+            continue;
+        }
+
+        SetFirstResidentMip(texture, request.firstMip);
+        ++m_streamingStats.nStreamedIn;
+    }
+}
+
+void TextureCache::SetStreamingBudget(u64 bytes)
+{
+    m_streamingStats.budgetBytes = bytes;
+}
+
+const TextureStreamingStats& TextureCache::GetStreamingStats() const
+{
+    return m_streamingStats;
+}
+
+bool TextureCache::StreamInLess(const StreamingRequest& a,
+                                const StreamingRequest& b)
+{
+    // The textures drawn the largest on screen are streamed in first.
+    return a.screenSize > b.screenSize;
+}
+
+bool TextureCache::EvictLess(const StreamingRequest& a,
+                             const StreamingRequest& b)
+{
+    return a.texture->GetLastRequestedFrame() < b.texture->GetLastRequestedFrame();
+}
+
+void TextureCache::Evict(u64 targetBytes)
+{
+    for (size_t i = 0; i < m_evictions.size(); ++i) {
+        if (m_streamingStats.residentBytes <= targetBytes)
+            break;
+
+        const StreamingRequest& request = m_evictions[i];
+        if (request.texture->GetFirstResidentMip() >= request.firstMip)
+            continue; // Already evicted this frame
+
+        SetFirstResidentMip(request.texture, request.firstMip);
+        ++m_streamingStats.nEvicted;
+    }
+}
+
+void TextureCache::SetFirstResidentMip(TextureAsset* texture, int firstMip)
+{
+    u64 oldBytes = texture->GetResidentBytes();
+
+    // The old texture may still be used by the current frame, which is
+    // presented after this call.
+    m_device.TextureDestroyDeferred(texture->SetFirstResidentMip(firstMip));
+
+    m_streamingStats.residentBytes -= oldBytes;
+    m_streamingStats.residentBytes += texture->GetResidentBytes();
 }
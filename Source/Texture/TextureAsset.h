@@ -1,68 +1,225 @@
 #ifndef TEXTURE_TEXTUREASSET_H
 #define TEXTURE_TEXTUREASSET_H
 
+#include <vector>
 #include "Core/List.h"
 #include "Core/Hash.h"
 #include "Core/HashTypes.h"
+#include "Core/JobQueue.h"
 #include "GpuDevice/GpuDevice.h"
 #include "Asset/AssetRefreshQueue.h"
 
 class FileLoader;
 class DDSFile;
 
+// Textures are streamed by mipmap level. A texture starts with only its
+// low-resolution tail resident (the mipmap levels no larger than
+// TEXTURE_STREAMING_TAIL_SIZE), and TextureCache::UpdateStreaming() streams in
+// the larger levels that the renderer has requested with RequestScreenSize().
+// Streaming a texture in or out replaces its GPU texture, so the GpuTextureID
+// must be fetched with GetGpuTextureID() each frame rather than kept.
+const unsigned TEXTURE_STREAMING_TAIL_SIZE = 64;
+
+struct TextureStreamingStats {
+    // The bytes used by the resident mipmap levels of all the textures.
+    u64 residentBytes;
+    // The bytes that the textures would use if every texture had the
+    // mipmap levels that were last requested for it resident.
+    u64 requestedBytes;
+    u64 budgetBytes;
+    // The number of textures streamed in and evicted by the most recent
+    // call to UpdateStreaming().
+    u32 nStreamedIn;
+    u32 nEvicted;
+    // The number of textures that weren't streamed in by the most recent
+    // call to UpdateStreaming(), because of the budget or the per-frame limit.
+    u32 nDeferred;
+};
+
 class TextureAsset {
 public:
+    // Returns false until the data of a texture from
+    // TextureCache::FindOrLoadAsync() has been loaded. Until then
+    // GetGpuTextureID() returns 0, and the renderer should draw with a
+    // placeholder texture instead.
+    bool IsLoaded() const;
     GpuTextureID GetGpuTextureID() const;
 
+    // Requests that the texture be streamed in at a resolution suitable for
+    // drawing it at the given size on screen, in pixels. The renderer calls
+    // this every frame for each texture that it draws; the largest request
+    // of the frame is used.
+    void RequestScreenSize(float pixels);
+
     int RefCount() const;
     void AddRef();
     void Release();
 
     const char* GetPath() const;
 
-    // Returns the old GpuTextureID
-    GpuTextureID Refresh(DDSFile& file);
+    // Takes ownership of the file. Returns the old GpuTextureID.
+    GpuTextureID Refresh(DDSFile* file);
     bool PollRefreshed() const;
 
     // For use by the TextureCache class -- these shouldn't need to be called
     // by user code.
     void ClearRefreshedStatus();
-    static TextureAsset* Create(GpuDevice& device, DDSFile& file, const char* path);
+    // Returns the largest size requested since the last call, or a negative
+    // value if there were no requests, and clears the requests.
+    float TakeRequestedScreenSize();
+    // Returns the first mipmap level that needs to be resident to draw the
+    // texture at the given size on screen.
+    int GetFirstMipForScreenSize(float pixels) const;
+    int GetTailFirstMip() const;
+    int GetFirstResidentMip() const;
+    u64 GetResidentBytes() const;
+    u64 GetBytesForFirstMip(int firstMip) const;
+    // Replaces the GPU texture with one that has the mipmap levels from
+    // firstMip onwards. Returns the old GpuTextureID.
+    GpuTextureID SetFirstResidentMip(int firstMip);
+    u32 GetLastRequestedFrame() const;
+    void SetLastRequestedFrame(u32 frame);
+    // Creates the GPU texture of a texture that isn't loaded yet. Takes
+    // ownership of the file.
+    void Load(DDSFile* file);
+    // Takes ownership of the file. If the file is NULL, the texture isn't
+    // loaded until Load() is called.
+    static TextureAsset* Create(GpuDevice& device, DDSFile* file, const char* path);
     static void Destroy(TextureAsset* texture);
 
     LIST_LINK(TextureAsset) m_link;
 
 private:
-    TextureAsset(GpuDevice& device, DDSFile& file);
+    explicit TextureAsset(GpuDevice& device);
     ~TextureAsset();
     TextureAsset(const TextureAsset&);
     TextureAsset& operator=(const TextureAsset&);
 
     GpuDevice& m_device;
+    // The file is kept as the source of the mipmap levels that are streamed
+    // in, since FileLoader can only load whole files.
+    DDSFile* m_file;
     GpuTextureID m_texture;
+    int m_firstResidentMip;
+    float m_requestedScreenSize;
+    u32 m_lastRequestedFrame;
     int m_refCountAndRefreshStatus;
 };
 
+// An array texture packed from DDS files that have the same format, size and
+// number of mipmap levels, with one slice per file, so that the renderer can
+// draw submeshes with different textures without switching textures. Array
+// textures are loaded synchronously and in full, and aren't streamed or
+// refreshed.
+class TextureArrayAsset {
+public:
+    GpuTextureID GetGpuTextureID() const;
+    u32 GetSliceCount() const;
+
+    int RefCount() const;
+    void AddRef();
+    void Release();
+
+    // The paths of the slices, separated by '|'.
+    const char* GetKey() const;
+
+    // For use by the TextureCache class -- these shouldn't need to be called
+    // by user code.
+    // Returns NULL if the files can't be packed into an array texture.
+    static TextureArrayAsset* Create(GpuDevice& device,
+                                     const DDSFile* const* files,
+                                     u32 nFiles,
+                                     const char* key);
+    static void Destroy(TextureArrayAsset* array);
+
+    LIST_LINK(TextureArrayAsset) m_link;
+
+private:
+    TextureArrayAsset(GpuDevice& device, GpuTextureID texture, u32 nSlices);
+    ~TextureArrayAsset();
+    TextureArrayAsset(const TextureArrayAsset&);
+    TextureArrayAsset& operator=(const TextureArrayAsset&);
+
+    GpuDevice& m_device;
+    GpuTextureID m_texture;
+    u32 m_nSlices;
+    int m_refCount;
+};
+
 class TextureCache {
 public:
     TextureCache(GpuDevice& device, FileLoader& loader);
     ~TextureCache();
 
     TextureAsset* FindOrLoad(const char* path);
-
+    // Returns the texture straight away, and reads and parses its file on an
+    // I/O worker thread if it isn't already loaded. The GPU texture is
+    // created by the first call to UpdateAsyncLoads() after the file has
+    // been read; see TextureAsset::IsLoaded().
+    TextureAsset* FindOrLoadAsync(const char* path);
+    // Creates the GPU textures of the asynchronous loads that have finished
+    // reading their files. This should be called once per frame.
+    void UpdateAsyncLoads();
+
+    // Loads the files and packs them into an array texture, in the order
+    // given. Returns NULL if the files don't all have the same format, size
+    // and number of mipmap levels. The files are loaded separately from the
+    // TextureAssets of the same paths.
+    TextureArrayAsset* FindOrLoadArray(const char* const* paths, u32 nPaths);
+
+    // Removes the unused textures and array textures.
     void RemoveUnusedTextures();
 
     void Refresh(const char* path);
     void UpdateRefreshSystem();
 
+    // Streams mipmap levels in and out of the textures according to the
+    // sizes requested since the last call, keeping the resident bytes within
+    // the budget. Textures that weren't requested in the frame are evicted
+    // first, least recently used first; a requested texture is never trimmed
+    // below its requested size, so the budget may be exceeded if the textures
+    // of a single frame need more. This should be called once per frame,
+    // after the frame's draws and before it's presented.
+    void UpdateStreaming();
+    void SetStreamingBudget(u64 bytes);
+    const TextureStreamingStats& GetStreamingStats() const;
+
 private:
     TextureCache(const TextureCache&);
     TextureCache& operator=(const TextureCache&);
 
+    struct LoadJob {
+        TextureAsset* texture;
+        // Written by the worker thread.
+        DDSFile* file;
+    };
+
+    struct StreamingRequest {
+        TextureAsset* texture;
+        int firstMip;
+        float screenSize;
+    };
+
+    static void LoadFile(void* job, void* userdata);
+    TextureAsset* Insert(DDSFile* file, const char* path);
+    // Completes the load of a texture, waiting for its file to be read if
+    // necessary.
+    void FinishLoad(TextureAsset* texture);
+    void CancelLoad(TextureAsset* texture);
+
+    static bool StreamInLess(const StreamingRequest& a, const StreamingRequest& b);
+    static bool EvictLess(const StreamingRequest& a, const StreamingRequest& b);
+
+    // Trims textures that have more mipmap levels resident than requested,
+    // least recently used first, until the resident bytes are at most
+    // targetBytes or there are no more such textures.
+    void Evict(u64 targetBytes);
+    void SetFirstResidentMip(TextureAsset* texture, int firstMip);
+
     static GpuTextureID RefreshPerform(
         TextureAsset* texture, void* userdata
     );
-    static void RefreshFinalize(
+    static bool RefreshFinalize(
         TextureAsset* texture, GpuTextureID oldProgram, void* userdata
     );
 
@@ -72,7 +229,19 @@ private:
     LIST_DECLARE(TextureAsset, m_link) m_textureList;
     THash<HashKey_Str, TextureAsset*> m_textureHash;
 
+    LIST_DECLARE(TextureArrayAsset, m_link) m_arrayList;
+    THash<HashKey_Str, TextureArrayAsset*> m_arrayHash;
+    std::vector<char> m_arrayKey;
+
     AssetRefreshQueue<TextureAsset, GpuTextureID> m_refreshQueue;
+
+    JobQueue m_loadQueue;
+    std::vector<LoadJob*> m_loadJobs;
+
+    u32 m_streamingFrame;
+    TextureStreamingStats m_streamingStats;
+    std::vector<StreamingRequest> m_streamIns;
+    std::vector<StreamingRequest> m_evictions;
 };
 
 #endif // TEXTURE_TEXTUREASSET_H
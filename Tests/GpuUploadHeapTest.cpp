@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#include "Tests/Test.h"
+
+#include "GpuDevice/GpuDevice.h"
+#include "GpuDevice/GpuUploadHeap.h"
+
+// Tests of the upload heap, both directly and through the dynamic-mode and
+// stream-mode buffers of the Null GpuDevice.
+
+const u32 PAGE_SIZE = 2 * 1024 * 1024;
+// The number of frames that the tests keep in flight when they use the heap
+// directly.
+const u64 FRAMES_IN_FLIGHT = 3;
+// Longer than the heap keeps idle pages for.
+const int IDLE_FRAMES = 200;
+
+static void* CreatePage(u32 size, void** cpuAddress, void* userdata)
+{
+    void* page = malloc(size);
+    *cpuAddress = page;
+    return page;
+}
+
+static void DestroyPage(void* page, u32 size, void* userdata)
+{
+    free(page);
+}
+
+static u32 s_random = 1;
+
+static u32 Random(u32 n)
+{
+    s_random = s_random * 1664525 + 1013904223;
+    return (s_random >> 8) % n;
+}
+
+struct LiveAllocation {
+    GpuUploadAllocation allocation;
+    u32 size;
+    u8 pattern;
+};
+
+static void Fill(GpuUploadHeap& heap, const LiveAllocation& live)
+{
+    memset(heap.GetCpuAddress(live.allocation), live.pattern, live.size);
+}
+
+static bool HasPattern(GpuUploadHeap& heap, const LiveAllocation& live)
+{
+    const u8* bytes = (const u8*)heap.GetCpuAddress(live.allocation);
+    for (u32 i = 0; i < live.size; ++i) {
+        if (bytes[i] != live.pattern)
+            return false;
+    }
+    return true;
+}
+
+static void NextFrame(GpuUploadHeap& heap, u64* frame)
+{
+    heap.EndFrame();
+    ++*frame;
+    heap.Reclaim(*frame > FRAMES_IN_FLIGHT ? *frame - FRAMES_IN_FLIGHT : 0);
+}
+
+// Persistent allocations keep their contents while others are made and
+// freed around them, and the heap gives its pages back once they're freed.
+static void TestPersistentAllocations()
+{
+    GpuUploadHeap heap(PAGE_SIZE, &CreatePage, &DestroyPage, NULL);
+    u64 frame = 1;
+
+    std::vector<LiveAllocation> live(64);
+    for (size_t i = 0; i < live.size(); ++i) {
+        live[i].size = 16 + Random(4000);
+        live[i].pattern = (u8)i;
+        heap.AllocatePersistent(live[i].size, 16, &live[i].allocation);
+        Fill(heap, live[i]);
+    }
+
+    bool contentsKept = true;
+    for (int f = 0; f < 500; ++f) {
+        for (int j = 0; j < 4; ++j) {
+            LiveAllocation& update = live[Random((u32)live.size())];
+            heap.FreePersistent(update.allocation);
+            update.size = 16 + Random(4000);
+            ++update.pattern;
+            heap.AllocatePersistent(update.size, 16, &update.allocation);
+            Fill(heap, update);
+        }
+        GpuUploadAllocation stream;
+        memset(heap.Allocate(8192, 16, &stream), 0xFF, 8192);
+
+        for (size_t i = 0; i < live.size(); ++i)
+            contentsKept = contentsKept && HasPattern(heap, live[i]);
+        NextFrame(heap, &frame);
+    }
+    TEST_CHECK(contentsKept);
+
+    // 64 allocations of at most 4 KB, plus those waiting to be freed, fit
+    // in a few persistent pages and a frame page for each frame in flight.
+    TEST_CHECK(heap.GetStats().peakPageBytes <= 8 * PAGE_SIZE);
+
+    for (size_t i = 0; i < live.size(); ++i)
+        heap.FreePersistent(live[i].allocation);
+    for (int f = 0; f < IDLE_FRAMES; ++f)
+        NextFrame(heap, &frame);
+    TEST_CHECK(heap.GetStats().nPages == 0);
+    TEST_CHECK(heap.GetStats().nPageBytes == 0);
+}
+
+// A freed persistent allocation isn't reused until its frame has completed.
+static void TestPersistentFreeIsDeferred()
+{
+    GpuUploadHeap heap(PAGE_SIZE, &CreatePage, &DestroyPage, NULL);
+    u64 frame = 1;
+
+    LiveAllocation first;
+    first.size = 256;
+    first.pattern = 0xAB;
+    heap.AllocatePersistent(first.size, 16, &first.allocation);
+    Fill(heap, first);
+    heap.FreePersistent(first.allocation);
+
+    bool notReused = true;
+    for (u64 f = 0; f < FRAMES_IN_FLIGHT; ++f) {
+        GpuUploadAllocation other;
+        heap.AllocatePersistent(256, 16, &other);
+        notReused = notReused &&
+            (other.page != first.allocation.page ||
+             other.offset != first.allocation.offset);
+        memset(heap.GetCpuAddress(other), 0, 256);
+        notReused = notReused && HasPattern(heap, first);
+        NextFrame(heap, &frame);
+    }
+    TEST_CHECK(notReused);
+}
+
+static GpuDevice* CreateGpuDevice()
+{
+    GpuDeviceFormat deviceFormat;
+    deviceFormat.pixelColorFormat = GPU_PIXEL_COLOR_FORMAT_RGBA8888;
+    deviceFormat.pixelDepthFormat = GPU_PIXEL_DEPTH_FORMAT_FLOAT32;
+    deviceFormat.resolutionX = 640;
+    deviceFormat.resolutionY = 480;
+    deviceFormat.flags = 0;
+    return GpuDevice::Create(deviceFormat, NULL);
+}
+
+// Many small dynamic buffers that are each mapped once, on different frames,
+// share a small amount of memory rather than each keeping a page alive.
+static void TestManySmallDynamicBuffers()
+{
+    std::unique_ptr<GpuDevice, void (*)(GpuDevice*)>
+        device(CreateGpuDevice(), &GpuDevice::Destroy);
+
+    const int N_BUFFERS = 64;
+    const unsigned BUFFER_SIZE = 64;
+    GpuBufferID buffers[N_BUFFERS];
+    for (int i = 0; i < N_BUFFERS; ++i) {
+        buffers[i] = device->BufferCreate(GPU_BUFFER_TYPE_CONSTANT,
+                                          GPU_BUFFER_ACCESS_DYNAMIC,
+                                          NULL, BUFFER_SIZE, 1);
+    }
+
+    for (int f = 0; f < N_BUFFERS + 10; ++f) {
+        device->SceneBegin();
+        if (f < N_BUFFERS) {
+            memset(device->BufferMap(buffers[f]), f, BUFFER_SIZE);
+            device->BufferUnmap(buffers[f]);
+        }
+        device->ScenePresent();
+    }
+
+    const GpuUploadHeapStats& heapStats = device->GetUploadHeapStats();
+    const GpuMemoryStats& memoryStats = device->GetMemoryStats();
+    TEST_CHECK(heapStats.peakPageBytes <= 256 * 1024);
+    TEST_CHECK(heapStats.nPageBytes <= 256 * 1024);
+    TEST_CHECK(memoryStats.peakBytes[GPU_MEMORY_UPLOAD_HEAP] <= 256 * 1024);
+
+    for (int i = 0; i < N_BUFFERS; ++i)
+        device->BufferDestroy(buffers[i]);
+}
+
+// A large dynamic buffer that's mapped every frame reuses the pages that its
+// earlier contents are freed from, rather than creating a page every frame.
+static void TestLargeDynamicBufferMappedEveryFrame()
+{
+    std::unique_ptr<GpuDevice, void (*)(GpuDevice*)>
+        device(CreateGpuDevice(), &GpuDevice::Destroy);
+
+    const unsigned BUFFER_SIZE = 1024 * 1024;
+    GpuBufferID buffer = device->BufferCreate(GPU_BUFFER_TYPE_CONSTANT,
+                                              GPU_BUFFER_ACCESS_DYNAMIC,
+                                              NULL, BUFFER_SIZE, 1);
+
+    for (int f = 0; f < 300; ++f) {
+        device->SceneBegin();
+        memset(device->BufferMap(buffer), f, BUFFER_SIZE);
+        device->BufferUnmap(buffer);
+        device->ScenePresent();
+    }
+
+    // A page for each frame that the device keeps in flight, however many
+    // that is on this machine.
+    const GpuUploadHeapStats& heapStats = device->GetUploadHeapStats();
+    TEST_CHECK(heapStats.peakPageBytes <= 8 * BUFFER_SIZE);
+    TEST_CHECK(heapStats.nPages <= 8);
+
+    device->BufferDestroy(buffer);
+}
+
+void RunGpuUploadHeapTests()
+{
+    TestPersistentAllocations();
+    TestPersistentFreeIsDeferred();
+    TestManySmallDynamicBuffers();
+    TestLargeDynamicBufferMappedEveryFrame();
+}
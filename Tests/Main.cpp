@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Tests/Test.h"
+
+struct TestSuite {
+    const char* name;
+    void (*run)();
+};
+
+static const TestSuite s_suites[] = {
+    { "uploadheap", &RunGpuUploadHeapTests },
+};
+
+static const int N_SUITES = (int)(sizeof s_suites / sizeof s_suites[0]);
+
+static int s_nChecks = 0;
+static int s_nFailures = 0;
+
+void TestCheck(bool passed, const char* condition, const char* file, int line)
+{
+    ++s_nChecks;
+    if (!passed) {
+        ++s_nFailures;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+    }
+}
+
+static bool IsSuiteName(const char* name)
+{
+    for (int i = 0; i < N_SUITES; ++i) {
+        if (strcmp(name, s_suites[i].name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: Tests [suite...]\nSuites:");
+    for (int i = 0; i < N_SUITES; ++i)
+        fprintf(stderr, " %s", s_suites[i].name);
+    fprintf(stderr, "\n");
+}
+
+// Usage: Tests [suite...]
+// Runs the named suites, or all of them if none are given. Exits with a
+// non-zero status if any check failed, or if a suite name is unknown.
+int main(int argc, char** argv)
+{
+    for (int j = 1; j < argc; ++j) {
+        if (!IsSuiteName(argv[j])) {
+            fprintf(stderr, "Unknown test suite: %s\n", argv[j]);
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < N_SUITES; ++i) {
+        bool run = (argc == 1);
+        for (int j = 1; j < argc; ++j) {
+            if (strcmp(argv[j], s_suites[i].name) == 0)
+                run = true;
+        }
+        if (run) {
+            printf("== %s\n", s_suites[i].name);
+            s_suites[i].run();
+        }
+    }
+
+    printf("%d checks, %d failed\n", s_nChecks, s_nFailures);
+    return s_nFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+// Checks a condition, and reports it as a failure of the current test if it's
+// false. The test carries on, so that one run reports every failed check.
+#define TEST_CHECK(condition) \
+    TestCheck((condition), #condition, __FILE__, __LINE__)
+
+void TestCheck(bool passed, const char* condition, const char* file, int line);
+
+// The test suites. Each runs all of its tests.
+void RunGpuUploadHeapTests();
+
+#endif // TESTS_TEST_H
@@ -60,6 +60,23 @@ Rule("Assets/Shaders/(.*)_MTL%.shd", {
     end
 })
 
+Rule("Assets/Shaders/(.*)_SW%.shd", {
+    Parse = function(path, name)
+        local inputs = {string.format("Shaders/%s.metal", name)}
+        local outputs = {path}
+        return inputs, outputs, nil
+    end,
+    Execute = function(inputPaths, outputPaths)
+        print("Compiling " .. inputPaths[1])
+        local status, stdout, stderr = RunProcess("Tools/SoftShaderCompiler",
+                                                  inputPaths[1], outputPaths[1])
+        if status ~= 0 then
+            return false, stderr
+        end
+        return true, nil
+    end
+})
+
 ContentDir("Shaders")
 DataDir("Assets")
 Manifest("AssetManifest.txt")
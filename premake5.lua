@@ -1,6 +1,14 @@
 workspace "GfxDemo"
-    configurations { "Debug", "Release" }
-    platforms { "OSX" }
+    configurations { "Debug", "Release", "Profile" }
+    platforms { "OSX", "Linux" }
+
+    -- Linux builds run headless (see Source/OsWindowHeadless.cpp), so they're
+    -- only useful with the Null and Soft GpuDevices.
+    filter "platforms:OSX"
+        system "macosx"
+    filter "platforms:Linux"
+        system "linux"
+    filter {}
 
 function CreateProject(apiName, apiDefine, frameworks)
     project("GfxDemo-"..apiName)
@@ -18,7 +26,8 @@ function CreateProject(apiName, apiDefine, frameworks)
         filter "configurations:Debug"
             defines {
                 "DEBUG",
-                "GPUDEVICE_DEBUG_MODE"
+                "GPUDEVICE_DEBUG_MODE",
+                "PROFILER_ENABLED"
             }
             flags { "Symbols" }
 
@@ -26,6 +35,14 @@ function CreateProject(apiName, apiDefine, frameworks)
             defines { "NDEBUG" }
             optimize "On"
 
+        -- Release with the CPU profiler (see Source/Core/Profiler.h).
+        filter "configurations:Profile"
+            defines {
+                "NDEBUG",
+                "PROFILER_ENABLED"
+            }
+            optimize "On"
+
         filter "platforms:OSX"
             files { "Source/**.m", "Source/**.mm", "Mac/**.xib", "Mac/**.strings", "Mac/Info.plist" }
             architecture "x64"
@@ -43,6 +60,15 @@ function CreateProject(apiName, apiDefine, frameworks)
                 'ln -s "${SRCROOT}/Assets" %{cfg.buildtarget.directory}/Assets',
             }
 
+        filter "platforms:Linux"
+            architecture "x64"
+            links { "pthread" }
+            buildoptions { "-std=c++14" }
+            postbuildcommands {
+                'rm -f %{cfg.buildtarget.directory}/Assets',
+                'ln -s "%{wks.location}/Assets" %{cfg.buildtarget.directory}/Assets',
+            }
+
         filter "files:**.xib"
             buildaction "Resource"
         filter "files:**.plist"
@@ -53,4 +79,159 @@ function CreateProject(apiName, apiDefine, frameworks)
 end
 
 CreateProject("Metal", "GPUDEVICE_API_METAL", "Metal.framework")
+    filter {}
+    removeplatforms { "Linux" }
 CreateProject("Null", "GPUDEVICE_API_NULL")
+CreateProject("Soft", "GPUDEVICE_API_SOFT")
+
+-- Command-line benchmarks of engine code that doesn't need a window or a GPU.
+-- Run with no arguments to run every suite, or name the suites to run.
+project "Benchmarks"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin/%{cfg.buildcfg}/Benchmarks"
+
+    files {
+        "Benchmarks/**.h",
+        "Benchmarks/**.cpp",
+        "Source/Core/HashTypes.h",
+        "Source/Core/HashTypes.cpp",
+        "Source/Core/Str.h",
+        "Source/Core/Str.cpp",
+        "Source/Texture/DXTCodec.h",
+        "Source/Texture/DXTCodec.cpp",
+    }
+    removefiles { "Benchmarks/Frame/**" }
+
+    includedirs { "Source", "." }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        flags { "Symbols" }
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+    filter "configurations:Profile"
+        defines { "NDEBUG" }
+        optimize "On"
+
+    filter "platforms:OSX"
+        architecture "x64"
+        buildoptions { "-std=c++14" }
+
+    filter "platforms:Linux"
+        architecture "x64"
+        buildoptions { "-std=c++14" }
+
+-- Renders a generated scene on the Null GpuDevice for a fixed number of frames,
+-- without a window or compiled assets, and writes the CPU frame times as JSON.
+-- With --replay, it times the replay of a GpuDevice trace file instead.
+-- Usage: FrameBenchmark [instances] [frames] [output.json]
+--        FrameBenchmark --replay trace [frames] [output.json]
+project "FrameBenchmark"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin/%{cfg.buildcfg}/FrameBenchmark"
+
+    defines "GPUDEVICE_API_NULL"
+
+    files {
+        "Benchmarks/Frame/**.h",
+        "Benchmarks/Frame/**.cpp",
+        "Source/**.h",
+        "Source/**.c",
+        "Source/**.cpp",
+    }
+    removefiles {
+        "Source/Main.cpp",
+        "Source/Application.h",
+        "Source/Application.cpp",
+    }
+
+    includedirs { "Source", "." }
+
+    filter "configurations:Debug"
+        defines {
+            "DEBUG",
+            "GPUDEVICE_DEBUG_MODE",
+            "PROFILER_ENABLED"
+        }
+        flags { "Symbols" }
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+    filter "configurations:Profile"
+        defines {
+            "NDEBUG",
+            "PROFILER_ENABLED"
+        }
+        optimize "On"
+
+    filter "platforms:OSX"
+        architecture "x64"
+        links { "CoreFoundation.framework" }
+        buildoptions { "-std=c++14" }
+
+    filter "platforms:Linux"
+        architecture "x64"
+        links { "pthread" }
+        buildoptions { "-std=c++14" }
+
+-- Unit tests of engine code, run on the Null GpuDevice. Run with no arguments
+-- to run every suite, or name the suites to run. Exits with a non-zero status
+-- if any check fails.
+-- Usage: Tests [suite...]
+project "Tests"
+    kind "ConsoleApp"
+    language "C++"
+    targetdir "bin/%{cfg.buildcfg}/Tests"
+
+    defines "GPUDEVICE_API_NULL"
+
+    files {
+        "Tests/**.h",
+        "Tests/**.cpp",
+        "Source/**.h",
+        "Source/**.c",
+        "Source/**.cpp",
+    }
+    removefiles {
+        "Source/Main.cpp",
+        "Source/Application.h",
+        "Source/Application.cpp",
+    }
+
+    includedirs { "Source", "." }
+
+    filter "configurations:Debug"
+        defines {
+            "DEBUG",
+            "GPUDEVICE_DEBUG_MODE",
+            "PROFILER_ENABLED"
+        }
+        flags { "Symbols" }
+
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+    filter "configurations:Profile"
+        defines {
+            "NDEBUG",
+            "PROFILER_ENABLED"
+        }
+        optimize "On"
+
+    filter "platforms:OSX"
+        architecture "x64"
+        links { "CoreFoundation.framework" }
+        buildoptions { "-std=c++14" }
+
+    filter "platforms:Linux"
+        architecture "x64"
+        links { "pthread" }
+        buildoptions { "-std=c++14" }